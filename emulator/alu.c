@@ -7,10 +7,66 @@
  */
 
 #include "alu.h"
+#include "util.h" // LUT_* macros
 #include "stdio.h"
 
 int update_flags(flags_t* flags_to_update, uint16_t value, bit_t sub_bool, uint8_t msb_low, uint8_t msb_high);
 
+// ======================================================================
+// Lookup tables, all built at compile time
+
+// index of alu_flags_table: bit 9 half-carry, bit 8 carry (or borrow), bits 0-7 result
+#define FLAGS_ENTRY(i) \
+	(flags_t) ((((i) & 0xFF) == 0 ? FLAG_Z : 0) | ((i) & 0x200 ? FLAG_H : 0) | ((i) & 0x100 ? FLAG_C : 0))
+
+const flags_t alu_flags_table[ALU_FLAGS_TABLE_SIZE] = { LUT_1024(FLAGS_ENTRY, 0) };
+
+// shift and rotate tables hold the result in their 8 lsb and its flags in their 8 msb
+#define SHIFT_ENTRY(value, carry) \
+	(uint16_t) (((value) & 0xFF) | (((((value) & 0xFF) == 0 ? FLAG_Z : 0) | ((carry) ? FLAG_C : 0)) << 8))
+
+#define SHIFT_L_ENTRY(x)  SHIFT_ENTRY((x) << 1, (x) & 0x80)
+#define SHIFT_R_ENTRY(x)  SHIFT_ENTRY((x) >> 1, (x) & 0x01)
+#define SHIFT_RA_ENTRY(x) SHIFT_ENTRY(((x) >> 1) | ((x) & 0x80), (x) & 0x01)
+#define ROT_L_ENTRY(x)    SHIFT_ENTRY(((x) << 1) | ((x) >> 7), (x) & 0x80)
+#define ROT_R_ENTRY(x)    SHIFT_ENTRY(((x) >> 1) | (((x) & 0x01) << 7), (x) & 0x01)
+// carry rotations are indexed by carry << 8 | x
+#define ROTC_L_ENTRY(i)   SHIFT_ENTRY((((i) & 0xFF) << 1) | ((i) >> 8), (i) & 0x80)
+#define ROTC_R_ENTRY(i)   SHIFT_ENTRY((((i) & 0xFF) >> 1) | (((i) >> 8) << 7), (i) & 0x01)
+
+static const uint16_t shift_table[2][256] = { { LUT_256(SHIFT_L_ENTRY, 0) }, { LUT_256(SHIFT_R_ENTRY, 0) } };
+static const uint16_t shiftR_A_table[256] = { LUT_256(SHIFT_RA_ENTRY, 0) };
+static const uint16_t rotate_table[2][256] = { { LUT_256(ROT_L_ENTRY, 0) }, { LUT_256(ROT_R_ENTRY, 0) } };
+static const uint16_t carry_rotate_table[2][512] = { { LUT_512(ROTC_L_ENTRY, 0) }, { LUT_512(ROTC_R_ENTRY, 0) } };
+
+// DAA table is indexed by N, H, C (the msb4 of F, shifted by 4) << 8 | x
+#define DAA_X(i) ((i) & 0xFF)
+#define DAA_N(i) ((i) & 0x400)
+#define DAA_H(i) ((i) & 0x200)
+#define DAA_C(i) ((i) & 0x100)
+#define DAA_ADJUST(i) \
+	(DAA_N(i) ? ((DAA_C(i) ? 0x60 : 0) | (DAA_H(i) ? 0x06 : 0)) \
+	          : ((DAA_C(i) || DAA_X(i) > 0x99 ? 0x60 : 0) | (DAA_H(i) || (DAA_X(i) & 0x0F) > 0x09 ? 0x06 : 0)))
+#define DAA_VALUE(i) ((DAA_N(i) ? DAA_X(i) - DAA_ADJUST(i) : DAA_X(i) + DAA_ADJUST(i)) & 0xFF)
+#define DAA_ENTRY(i) \
+	(uint16_t) (DAA_VALUE(i) | (((DAA_VALUE(i) == 0 ? FLAG_Z : 0) | (DAA_N(i) ? FLAG_N : 0) \
+	                            | (DAA_ADJUST(i) & 0x60 ? FLAG_C : 0)) << 8))
+
+static const uint16_t daa_table[2048] = { LUT_2048(DAA_ENTRY, 0) };
+
+/**
+ * Auxiliary function
+ * @brief Unpacks an entry of the shift, rotate or DAA tables
+ *
+ * @param result alu_output_t to write into
+ * @param entry table entry (result in the 8 lsb, flags in the 8 msb)
+ */
+static inline void alu_output_from_entry(alu_output_t* result, uint16_t entry)
+{
+	result->value = lsb8(entry);
+	result->flags = msb8(entry);
+}
+
 // ==== see alu.h ========================================
 flag_bit_t get_flag(flags_t flags, flag_bit_t flag) {
 	// check argument validity
@@ -61,15 +117,11 @@ int alu_add8(alu_output_t* result, uint8_t x, uint8_t y, bit_t c0) {
 	// check argument validity
 	M_REQUIRE_NON_NULL(result);
 	M_REQUIRE(c0 == 0 || c0 == 1, ERR_BAD_PARAMETER, "input carry (%u) should be binary (== 0 || == 1)", c0);
-	// divide 8 bit addition into two times 4 bit additions, i.e. lsb4 and msb4
-	uint8_t add_lsb4 = (uint8_t) (lsb4(x) + lsb4(y) + c0);
-	uint8_t add_msb4 = (uint8_t) (msb4(x) + msb4(y) + msb4(add_lsb4));
-	// merge the result of the disjoint operations
-	uint8_t merge_add = merge4(add_lsb4, add_msb4);
+	// 9-bit sum, its bit 8 is the carry
+	const unsigned sum = (unsigned) x + y + c0;
 	// assign the result of addition to the value of the ALU operation
-	result->value = merge_add;
-	
-	M_EXIT_IF_ERR(update_flags(&result->flags, merge_add, 0, add_lsb4, msb4(add_msb4)));
+	result->value = lsb8(sum);
+	result->flags = alu_flags_table[ALU_FLAGS_INDEX(x, y, sum)];
 	
 	// return with no errors
 	return ERR_NONE;
@@ -80,15 +132,11 @@ int alu_sub8(alu_output_t* result, uint8_t x, uint8_t y, bit_t b0) {
 	// check argument validity
 	M_REQUIRE_NON_NULL(result);
 	M_REQUIRE(b0 == 0 || b0 == 1, ERR_BAD_PARAMETER, "input borrow (%u) should be binary (== 0 || == 1)", b0);
-	// divide 8 bit subtraction into two times 4 bit subtraction, i.e. lsb4 and msb4
-	uint8_t sub_lsb4 = lsb4(x) - (lsb4(y) + b0);
-	uint8_t sub_msb4 = msb4(x) - msb4(y) + msb4(sub_lsb4);
-	// merge the result of the disjoint operations
-	uint8_t merge_sub = merge4(sub_lsb4, sub_msb4);
-	// assign the result of addition to the value of the ALU operation
-	result->value = merge_sub;
-	
-	M_EXIT_IF_ERR(update_flags(&result->flags, merge_sub, 1, sub_lsb4, (y + b0) > x));
+	// unsigned difference, its bit 8 is the borrow
+	const unsigned diff = (unsigned) x - y - b0;
+	// assign the result of subtraction to the value of the ALU operation
+	result->value = lsb8(diff);
+	result->flags = alu_flags_table[ALU_FLAGS_INDEX(x, y, diff)] | FLAG_N;
 	
 	// return with no errors
 	return ERR_NONE;
@@ -144,28 +192,7 @@ int alu_shift(alu_output_t* result, uint8_t x, rot_dir_t dir) {
 	M_REQUIRE_NON_NULL(result);
 	M_REQUIRE(dir == LEFT || dir == RIGHT, ERR_BAD_PARAMETER, "input direction (%d) should be LEFT (0) or RIGHT (1)", (int)dir);
 
-	// define all flags to be 0 and set those which need to be modified
-	flags_t flags = 0;
-	
-	switch (dir) {
-
-		case LEFT:	// if msb bit is 1 set the carry
-					if(bit_get(x, 7) == 1) set_C(&flags);
-					x = x << 1;
-					break;
-		
-		case RIGHT:	// if lsb bit is 1 set the carry
-					if(bit_get(x, 0) == 1) set_C(&flags);
-					x = x >> 1;
-					break;
-	}
-	// check after the shift whether the result is 0
-	if(x == 0) set_Z(&flags);
-	
-	// assign the result of addition to the value of the ALU operation
-	result->value = x;
-	// assign the flags of addition to the flags of the ALU operation
-	result->flags = flags;
+	alu_output_from_entry(result, shift_table[dir][x]);
 	
 	// return with no errors
 	return ERR_NONE;
@@ -175,10 +202,8 @@ int alu_shift(alu_output_t* result, uint8_t x, rot_dir_t dir) {
 int alu_shiftR_A(alu_output_t* result, uint8_t x) {
 	// check argument validity
 	M_REQUIRE_NON_NULL(result);
-	M_EXIT_IF_ERR(alu_shift(result, x, RIGHT));
-	// check the msb bit to decide the sign of the arithmetic shift
-	// in case of negative value modify the 8th bit of the value of ALU
-	if (bit_get(x, 7) == 1) result->value |= (1 << (BIT_8 - 1));
+
+	alu_output_from_entry(result, shiftR_A_table[x]);
 	
 	// return with no errors
 	return ERR_NONE;
@@ -190,29 +215,7 @@ int alu_rotate(alu_output_t* result, uint8_t x, rot_dir_t dir) {
 	M_REQUIRE_NON_NULL(result);
 	M_REQUIRE(dir == LEFT || dir == RIGHT, ERR_BAD_PARAMETER, "input direction (%d) should be LEFT (0) or RIGHT (1)", (int)dir);
 	
-	// define all flags to be 0 and set those which need to be modified
-	flags_t flags = 0;
-	
-	// check if carry occures in both directions
-	switch (dir) {
-		
-		case LEFT:	if(bit_get(x, 7) == 1) set_C(&flags);
-					break;
-		
-		case RIGHT:	if(bit_get(x, 0) == 1) set_C(&flags);
-					break;
-	}
-
-	// rotate the value x by to the corresponding direction
-	bit_rotate(&x, dir, 1);
-
-	// check after rotation whether the result is 0
-	if (x == 0) set_Z(&flags);
-	
-	// assign the result of addition to the value of the ALU operation
-	result->value = x;
-	// assign the flags of addition to the flags of the ALU operation
-	result->flags = flags;
+	alu_output_from_entry(result, rotate_table[dir][x]);
 	
 	// return with no errors
 	return ERR_NONE;
@@ -225,29 +228,20 @@ int alu_carry_rotate(alu_output_t* result, uint8_t x, rot_dir_t dir, flags_t fla
 	M_REQUIRE(dir == LEFT || dir == RIGHT, ERR_BAD_PARAMETER, "input direction (%d) should be LEFT (0) or RIGHT (1)", (int)dir);
 	M_REQUIRE(lsb4(flags) == 0, ERR_BAD_PARAMETER, "input flags (%u) should have the form bxxxx0000", flags);
 	
-	// define all flags to be 0 and set those which need to be modified
-	flags_t flags_o = 0;
-	bit_t carry = 0;
-	
-	// check if carry occures in both directions
-	switch (dir) {
-		case LEFT:	if(bit_get(x, (BIT_8 - 1)) == 1) set_C(&flags_o);
-					carry = (get_C(flags) == 0) ? 0 : 1;
-					x = (x << 1) | carry;
-					break;
-		
-		case RIGHT:	if(bit_get(x, 0) == 1) set_C(&flags_o);
-					x = (x >> 1);
-					bit_edit(&x, (BIT_8 - 1), get_C(flags));
-					break;
-	}	
-	// check whether the result is 0
-	if (x == 0) set_Z(&flags_o);
+	alu_output_from_entry(result, carry_rotate_table[dir][(flags & FLAG_C ? 0x100 : 0) | x]);
 	
-	// assign the result of addition to the value of the ALU operation
-	result->value = x;
-	// assign the flags of addition to the flags of the ALU operation
-	result->flags = flags_o;
+	// return with no errors
+	return ERR_NONE;
+}
+
+// ==== see alu.h ========================================
+int alu_daa(alu_output_t* result, uint8_t x, flags_t flags) {
+	// check argument validity
+	M_REQUIRE_NON_NULL(result);
+	M_REQUIRE(lsb4(flags) == 0, ERR_BAD_PARAMETER, "input flags (%u) should have the form bxxxx0000", flags);
+	
+	// Z is not part of the index
+	alu_output_from_entry(result, daa_table[((flags & (FLAG_N | FLAG_H | FLAG_C)) << 4) | x]);
 	
 	// return with no errors
 	return ERR_NONE;
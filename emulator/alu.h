@@ -71,6 +71,17 @@ void set_flag(flags_t* flags, flag_bit_t flag);
 #define set_N(X) set_flag(X, FLAG_N)
 #define set_Z(X) set_flag(X, FLAG_Z)
 
+/**
+ * @brief Z, H and C flags of an 8-bit addition or subtraction (N is left to the caller),
+ *        looked up with ALU_FLAGS_INDEX of its operands and of its result
+ *        (r = x + y + carry or x - y - borrow, computed as unsigned)
+ */
+#define ALU_FLAGS_TABLE_SIZE 1024
+extern const flags_t alu_flags_table[ALU_FLAGS_TABLE_SIZE];
+
+#define ALU_FLAGS_INDEX(x, y, r) \
+	(((((unsigned) (x) ^ (unsigned) (y) ^ (unsigned) (r)) & 0x10u) << 5) | ((unsigned) (r) & 0x1FFu))
+
 /**
  * @brief adds two uint8 and writes the results and flags into an alu_output_t structure
  *
@@ -162,6 +173,17 @@ int alu_rotate(alu_output_t* result, uint8_t x, rot_dir_t dir);
  */
 int alu_carry_rotate(alu_output_t* result, uint8_t x, rot_dir_t dir, flags_t flags);
 
+
+/**
+ * @brief decimal adjust of the result of a BCD addition or subtraction (DAA)
+ *
+ * @param result alu_output_t pointer to write into (H is cleared, N is kept from flags)
+ * @param x value to adjust
+ * @param flags N, H and C flags of the operation which produced x
+ * @return error code
+ */
+int alu_daa(alu_output_t* result, uint8_t x, flags_t flags);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,71 @@
+/**
+ * @file alu_ext.c
+ * @brief ALU for GameBoy Emulator, logic and BCD operations
+ *
+ * @date 2020
+ */
+
+#include "alu_ext.h"
+#include "bit.h"
+#include "error.h"
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Writes a logic result and its flags (Z from the table, H as given)
+ *
+ * @param result alu_output_t to write into
+ * @param value 8-bit result of the operation
+ * @param h H flag to set (FLAG_H or 0)
+ */
+static inline void alu_logic_output(alu_output_t* result, uint8_t value, flags_t h)
+{
+	result->value = value;
+	// entries of alu_flags_table below 0x100 only hold the Z flag
+	result->flags = alu_flags_table[value] | h;
+}
+
+// ==== see alu_ext.h ========================================
+int alu_bcd_adjust(alu_output_t* result) {
+	// check argument validity
+	M_REQUIRE_NON_NULL(result);
+
+	// same adjustment as DAA, driven by the flags of the previous operation
+	return alu_daa(result, lsb8(result->value), (flags_t) (result->flags & (FLAG_N | FLAG_H | FLAG_C)));
+}
+
+// ==== see alu_ext.h ========================================
+int alu_and(alu_output_t* result, uint8_t x, uint8_t y) {
+	// check argument validity
+	M_REQUIRE_NON_NULL(result);
+
+	alu_logic_output(result, x & y, FLAG_H);
+	return ERR_NONE;
+}
+
+// ==== see alu_ext.h ========================================
+int alu_or(alu_output_t* result, uint8_t x, uint8_t y) {
+	// check argument validity
+	M_REQUIRE_NON_NULL(result);
+
+	alu_logic_output(result, x | y, 0);
+	return ERR_NONE;
+}
+
+// ==== see alu_ext.h ========================================
+int alu_xor(alu_output_t* result, uint8_t x, uint8_t y) {
+	// check argument validity
+	M_REQUIRE_NON_NULL(result);
+
+	alu_logic_output(result, x ^ y, 0);
+	return ERR_NONE;
+}
+
+// ==== see alu_ext.h ========================================
+int alu_swap4(alu_output_t* result, uint8_t x) {
+	// check argument validity
+	M_REQUIRE_NON_NULL(result);
+
+	alu_logic_output(result, (uint8_t) ((x << 4) | (x >> 4)), 0);
+	return ERR_NONE;
+}
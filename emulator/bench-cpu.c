@@ -0,0 +1,62 @@
+/**
+ * @file bench-cpu.c
+ * @brief Measures the instruction throughput of the cpu interpreter core
+ *        (build bench-cpu for the switch core, bench-cpu-threaded for the threaded one)
+ *
+ * @author S. Horvath-Mikulas & R. Gerber
+ * @date 2020
+ */
+
+#define _POSIX_C_SOURCE 199309L // clock_gettime
+
+#include "gameboy.h"
+#include "util.h"  // for zero_init_var()
+#include "error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <time.h>
+#include <inttypes.h>
+
+#ifdef CPU_THREADED
+	#define CPU_CORE "threaded"
+#else
+	#define CPU_CORE "switch"
+#endif
+
+#define BENCH_DEFAULT_CYCLES 10000000
+
+// ======================================================================
+int main(int argc, char* argv[])
+{
+    if (argc < 2) {
+        fprintf(stderr, "usage:    %s input_file [cycles]\n", argv[0]);
+        fprintf(stderr, "example:  %s rom.gb %d\n", argv[0], BENCH_DEFAULT_CYCLES);
+        return 1;
+    }
+
+    gameboy_t gb;
+    zero_init_var(gb);
+    int err = gameboy_create(&gb, argv[1]);
+    if (err != ERR_NONE) {
+        gameboy_free(&gb);
+        return err;
+    }
+
+    const uint64_t cycles = argc > 2 ? (uint64_t) atoll(argv[2]) : BENCH_DEFAULT_CYCLES;
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    err = gameboy_run_until(&gb, cycles);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    const double seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) * 1e-9;
+    if (err == ERR_NONE) {
+        printf("\n%-8s core: %" PRIu64 " instructions in %.3f s, %.2f Minstr/s\n", CPU_CORE,
+               gb.cpu.instructions, seconds, seconds > 0 ? (double) gb.cpu.instructions / seconds * 1e-6 : 0.0);
+    }
+
+    gameboy_free(&gb);
+
+    return err;
+}
@@ -12,38 +12,178 @@ extern "C" {
 
 #include <stdio.h>
 #include <math.h>
+#include <pthread.h>
 
 #include "bit_vector.h"
-#include "image.h"
 
-#define ROUND32(x) (x % IMAGE_LINE_WORD_BITS == 0 ? x : (x + (IMAGE_LINE_WORD_BITS - x%IMAGE_LINE_WORD_BITS)))
-#define WORD_NB(size) ROUND32(size)/IMAGE_LINE_WORD_BITS
-#define MOD32(index) index % IMAGE_LINE_WORD_BITS
-#define QUOTIENT32(index) index / IMAGE_LINE_WORD_BITS
+#define WORD_NB(size) bit_vector_words(size)
+#define MOD32(index) ((index) % BIT_VECTOR_WORD_BITS)
+#define QUOTIENT32(index) ((index) / BIT_VECTOR_WORD_BITS)
+#define ROUND32(x) (WORD_NB(x) * BIT_VECTOR_WORD_BITS)
+// bits of the last word of a vector which are within its size
+#define LAST_WORD_MASK(size) (MOD32(size) == 0 ? UINT32_MAX : UINT32_MAX >> (BIT_VECTOR_WORD_BITS - MOD32(size)))
 #define MAX(x, y) (((x) > (y)) ? (x) : (y))
 #define MIN(x, y) (((x) < (y)) ? (x) : (y))
 
+// SSE2/AVX2 kernels for GCC/clang on x86, selected at runtime (see bit_vector_select_backend())
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__)) && !defined(BIT_VECTOR_NO_SIMD)
+#define BIT_VECTOR_SIMD
+#include <immintrin.h>
+#endif
+
+//=========================================================================
+/**
+ * @brief Bulk logical operations, done by the kernels below
+ */
+typedef enum {
+	op_and, op_or, op_xor, op_not
+} logic_op;
+
+/**
+ * @brief Applies a logical operation (b is not used by op_not)
+ */
+#define LOGIC(op, a, b) ((op) == op_and ? (a) & (b) : (op) == op_or ? (a) | (b) : (op) == op_xor ? (a) ^ (b) : ~(a))
+
+typedef void (*logic_kernel)(uint32_t* dst, const uint32_t* a, const uint32_t* b, size_t nb_words, logic_op op);
+
+/**
+ * @brief Scalar kernel: 64 bits at a time (the operations are bitwise: how the 32-bit words
+ *        are paired does not matter). dst may be a or b, word i being read before being written.
+ */
+static void logic_scalar(uint32_t* dst, const uint32_t* a, const uint32_t* b, size_t nb_words, logic_op op) {
+	size_t i = 0;
+	for (; i + 2 <= nb_words; i += 2) {
+		uint64_t x, y;
+		memcpy(&x, a + i, sizeof(x));
+		memcpy(&y, b + i, sizeof(y));
+		x = LOGIC(op, x, y);
+		memcpy(dst + i, &x, sizeof(x));
+	}
+	if (i < nb_words) {
+		dst[i] = LOGIC(op, a[i], b[i]);
+	}
+}
+
+#ifdef BIT_VECTOR_SIMD
+/**
+ * @brief SSE2 kernel: 128 bits at a time, the rest with the scalar kernel
+ */
+__attribute__((target("sse2")))
+static void logic_sse2(uint32_t* dst, const uint32_t* a, const uint32_t* b, size_t nb_words, logic_op op) {
+	const __m128i ones = _mm_set1_epi32(-1);
+	size_t i = 0;
+	for (; i + 4 <= nb_words; i += 4) {
+		const __m128i x = _mm_loadu_si128((const __m128i*) (a + i));
+		const __m128i y = _mm_loadu_si128((const __m128i*) (b + i));
+		_mm_storeu_si128((__m128i*) (dst + i), op == op_and ? _mm_and_si128(x, y) : op == op_or ? _mm_or_si128(x, y)
+		                                       : _mm_xor_si128(x, op == op_xor ? y : ones));
+	}
+	logic_scalar(dst + i, a + i, b + i, nb_words - i, op);
+}
+
+/**
+ * @brief AVX2 kernel: 256 bits (a whole tile map line) at a time, the rest with the SSE2 kernel
+ */
+__attribute__((target("avx2")))
+static void logic_avx2(uint32_t* dst, const uint32_t* a, const uint32_t* b, size_t nb_words, logic_op op) {
+	const __m256i ones = _mm256_set1_epi32(-1);
+	size_t i = 0;
+	for (; i + 8 <= nb_words; i += 8) {
+		const __m256i x = _mm256_loadu_si256((const __m256i*) (a + i));
+		const __m256i y = _mm256_loadu_si256((const __m256i*) (b + i));
+		_mm256_storeu_si256((__m256i*) (dst + i), op == op_and ? _mm256_and_si256(x, y) : op == op_or ? _mm256_or_si256(x, y)
+		                                          : _mm256_xor_si256(x, op == op_xor ? y : ones));
+	}
+	logic_sse2(dst + i, a + i, b + i, nb_words - i, op);
+}
+#endif
+
+static const logic_kernel logic_kernels[] = {
+	[BIT_VECTOR_SCALAR] = logic_scalar,
+#ifdef BIT_VECTOR_SIMD
+	[BIT_VECTOR_SSE2] = logic_sse2,
+	[BIT_VECTOR_AVX2] = logic_avx2,
+#endif
+};
+
+// kernel in use: selected once, on first use, and never changed afterwards (the bit vectors may be used by several threads)
+static pthread_once_t logic_once = PTHREAD_ONCE_INIT;
+static bit_vector_backend_t logic_backend = BIT_VECTOR_SCALAR;
+static logic_kernel logic = logic_scalar;
+// backend asked for by bit_vector_select_backend() before the selection
+static pthread_mutex_t logic_lock = PTHREAD_MUTEX_INITIALIZER;
+static bit_vector_backend_t logic_wanted = BIT_VECTOR_AVX2;
+
+/**
+ * @brief Selects the kernel in use (run once): the one wanted, or the best one the CPU supports below it
+ */
+static void logic_select(void) {
+	bit_vector_backend_t best = BIT_VECTOR_SCALAR;
+#ifdef BIT_VECTOR_SIMD
+	__builtin_cpu_init();
+	if (__builtin_cpu_supports("avx2")) {
+		best = BIT_VECTOR_AVX2;
+	} else if (__builtin_cpu_supports("sse2")) {
+		best = BIT_VECTOR_SSE2;
+	}
+#endif
+	pthread_mutex_lock(&logic_lock);
+	const bit_vector_backend_t wanted = logic_wanted;
+	pthread_mutex_unlock(&logic_lock);
+
+	logic_backend = wanted > best ? best : wanted;
+	logic = logic_kernels[logic_backend];
+}
+
+//=========================================================================
+bit_vector_backend_t bit_vector_select_backend(bit_vector_backend_t backend) {
+	pthread_mutex_lock(&logic_lock);
+	logic_wanted = backend;
+	pthread_mutex_unlock(&logic_lock);
+	pthread_once(&logic_once, logic_select);
+	return logic_backend;
+}
+
+/**
+ * @brief Runs the bulk logical operation op on nb_words words
+ */
+static void bit_vector_logic(uint32_t* dst, const uint32_t* a, const uint32_t* b, size_t nb_words, logic_op op) {
+	pthread_once(&logic_once, logic_select);
+	logic(dst, a, b, nb_words, op);
+}
+
+//=========================================================================
+bit_vector_t* bit_vector_init(bit_vector_t* pbv, size_t size, bit_t value) {
+	// check arguments validity
+	if (pbv == NULL || size == 0) {return NULL;}
+	if (value != 0 && value != 1) {return NULL;}
+
+	pbv->size = size;
+	memset(pbv->content, value == 1 ? 0xFF : 0, sizeof(uint32_t) * WORD_NB(size));
+	pbv->content[WORD_NB(size) - 1] &= LAST_WORD_MASK(size);
+	return pbv;
+}
+
 //=========================================================================
 bit_vector_t* bit_vector_create(size_t size, bit_t value) {
 	// check arguments validity
 	if (size <= 0) {return NULL;}
 	if (size > SIZE_MAX / sizeof(uint32_t)) {return NULL;}
 	if (value != 0 && value != 1) {return NULL;}
-	
-	bit_vector_t* result = malloc(sizeof(bit_vector_t) + sizeof(uint32_t) * (WORD_NB(size) - 1));
 
 	// if the malloc was successful, set-up the vector according to the parameters
-	if (result != NULL) {
-		result->size = size;
-		memset(result->content, 0, sizeof(uint32_t) * (WORD_NB(size)));
-		if (value == 1) {
-			for (size_t i = 0; i < WORD_NB(size) - 1; i++) {
-				result->content[i] = UINT32_MAX;
-			}
-			result->content[WORD_NB(size) - 1] = (MOD32(size) == 0) ? UINT32_MAX :(uint32_t) ((1 << (MOD32(size))) - 1);
-		} 
-  	}
-	return result;
+	bit_vector_t* result = malloc(bit_vector_sizeof(size));
+	return result == NULL ? NULL : bit_vector_init(result, size, value);
+}
+
+//=========================================================================
+bit_vector_t* bit_vector_cpy_to(bit_vector_t* dst, const bit_vector_t* src) {
+	// check arguments validity
+	if (dst == NULL || src == NULL || dst->size != src->size) {
+		return NULL;
+	}
+	memmove(dst->content, src->content, sizeof(uint32_t) * WORD_NB(src->size));
+	return dst;
 }
 
 //=========================================================================
@@ -51,23 +191,15 @@ bit_vector_t* bit_vector_cpy(const bit_vector_t* pbv) {
 	// check arguments validity
 	if(pbv == NULL) {
 		return NULL;
-	} else {
-		// init a new vector
-		bit_vector_t* result = bit_vector_create(pbv->size, 0);
-		// if successful, fill it with the argument content 
-		if(result != NULL) {
-			for(size_t i = 0; i < WORD_NB(pbv->size); ++i) {
-				result->content[i] = pbv->content[i];
-			}
-		}
-		return result;
 	}
+	// init a new vector and, if successful, fill it with the argument content
+	return bit_vector_cpy_to(bit_vector_create(pbv->size, 0), pbv);
 }
 
 //=========================================================================
 bit_t bit_vector_get(const bit_vector_t* pbv, size_t index) {
 	// check arguments validity
-	if(pbv == NULL || pbv->content == NULL || index >= pbv->size) {
+	if(pbv == NULL || index >= pbv->size) {
 		return 0;
 	} else {
 		// Get the right word, shift it by the modulo of the index and mask it
@@ -78,156 +210,190 @@ bit_t bit_vector_get(const bit_vector_t* pbv, size_t index) {
 }
 
 //=========================================================================
-bit_vector_t* bit_vector_not(bit_vector_t* pbv) {
+bit_vector_t* bit_vector_not_to(bit_vector_t* dst, const bit_vector_t* pbv) {
 	// check arguments validity
-	if(pbv == NULL || pbv->content == NULL) {
+	if(dst == NULL || pbv == NULL || dst->size != pbv->size) {
 		return NULL;
-	} 
-	// do the negation
-	for(size_t i = 0; i < WORD_NB(pbv->size); ++i) {
-		pbv->content[i] = ~pbv->content[i];
 	}
-	
+	// do the negation
+	bit_vector_logic(dst->content, pbv->content, pbv->content, WORD_NB(pbv->size), op_not);
+
 	// put to 0 the msbs of the top word in case the size is not a multiple of 32
-	if (MOD32(pbv->size) != 0) {
-		pbv->content[WORD_NB(pbv->size) - 1] &= (uint32_t) ((1 << MOD32(pbv->size)) - 1); 
+	dst->content[WORD_NB(dst->size) - 1] &= LAST_WORD_MASK(dst->size);
+	return dst;
+}
+
+//=========================================================================
+bit_vector_t* bit_vector_not(bit_vector_t* pbv) {
+	return bit_vector_not_to(pbv, pbv);
+}
+
+//=========================================================================
+bit_vector_t* bit_vector_and_to(bit_vector_t* dst, const bit_vector_t* pbv1, const bit_vector_t* pbv2) {
+	// check arguments validity
+	if(dst == NULL || pbv1 == NULL || pbv2 == NULL || pbv1->size != pbv2->size || dst->size != pbv1->size) {
+		return NULL;
 	}
-	return pbv;
+
+	bit_vector_logic(dst->content, pbv1->content, pbv2->content, WORD_NB(dst->size), op_and);
+	return dst;
 }
 
 //=========================================================================
 bit_vector_t* bit_vector_and(bit_vector_t* pbv1, const bit_vector_t* pbv2) {
+	return bit_vector_and_to(pbv1, pbv1, pbv2);
+}
+
+//=========================================================================
+bit_vector_t* bit_vector_or_to(bit_vector_t* dst, const bit_vector_t* pbv1, const bit_vector_t* pbv2) {
 	// check arguments validity
-	if(pbv1 == NULL || pbv1->content == NULL || pbv2 == NULL || pbv2->content == NULL || pbv1->size != pbv2->size) {
+	if(dst == NULL || pbv1 == NULL || pbv2 == NULL || pbv1->size != pbv2->size || dst->size != pbv1->size) {
 		return NULL;
 	}
-	
-	for(size_t i = 0; i < WORD_NB(pbv1->size); ++i) {
-		pbv1->content[i] &= pbv2->content[i];
-	}
-	return pbv1;
+
+	bit_vector_logic(dst->content, pbv1->content, pbv2->content, WORD_NB(dst->size), op_or);
+	return dst;
 }
 
 //=========================================================================
 bit_vector_t* bit_vector_or(bit_vector_t* pbv1, const bit_vector_t* pbv2) {
+	return bit_vector_or_to(pbv1, pbv1, pbv2);
+}
+
+//=========================================================================
+bit_vector_t* bit_vector_xor_to(bit_vector_t* dst, const bit_vector_t* pbv1, const bit_vector_t* pbv2) {
 	// check arguments validity
-	if(pbv1 == NULL || pbv1->content == NULL || pbv2 == NULL || pbv2->content == NULL || pbv1->size != pbv2->size) {
+	if(dst == NULL || pbv1 == NULL || pbv2 == NULL || pbv1->size != pbv2->size || dst->size != pbv1->size) {
 		return NULL;
 	}
 
-	for(size_t i = 0; i < WORD_NB(pbv1->size); ++i) {
-		pbv1->content[i] |= pbv2->content[i];
-	}
-	return pbv1;
+	bit_vector_logic(dst->content, pbv1->content, pbv2->content, WORD_NB(dst->size), op_xor);
+	return dst;
 }
 
 //=========================================================================
 bit_vector_t* bit_vector_xor(bit_vector_t* pbv1, const bit_vector_t* pbv2) {
-	// check arguments validity
-	if(pbv1 == NULL || pbv1->content == NULL || pbv2 == NULL || pbv2->content == NULL || pbv1->size != pbv2->size) {
-		return NULL;
-	}
-	
-	for(size_t i = 0; i < WORD_NB(pbv1->size); ++i) {
-		pbv1->content[i] ^= pbv2->content[i];
-	}
-	return pbv1;
+	return bit_vector_xor_to(pbv1, pbv1, pbv2);
 }
 
 //=========================================================================
 /**
- * @brief Helper enum type for the extract functions
+ * @brief Extracts the bits index to index + 31 of a pair of words of a bit vector,
+ *        lo being the word of bit index - r and hi the next one (funnel shift)
  */
-typedef enum {
-    zero = 0, 
-	wrap = 1
-} extract_type;
+#define FUNNEL(lo, hi, r) ((uint32_t) ((((uint64_t) (hi) << BIT_VECTOR_WORD_BITS) | (lo)) >> (r)))
 
 /**
- * @brief Extract only the group of 32 bits of the pbv containing the index passed as argument
- * @param pbv pointer to bit vector
- * @param typ type of the extraction (zero = 0 or wrap = 1)
- * @param index index from where to start extraction
- * @return uint32_t of the pbv containing the given index
+ * @brief Splits index into word q and bit r (0 to 31) within that word, rounding down
  */
-static uint32_t bit_vector_contains_index(const bit_vector_t* pbv, extract_type typ, int64_t index) {
-	
-	if(typ == zero && (index < 0 || index >= (int64_t) ROUND32(pbv->size)))		{ return 0; }
-	if(typ == wrap && index >= (int64_t) ROUND32(pbv->size))					{ index = (index % (int64_t) pbv->size); }
-	if(typ == wrap && index < 0) 												{ index = (((index % (int64_t) pbv->size) + (int64_t) pbv->size) % (int64_t) pbv->size); }
+#define SPLIT_INDEX(index, q, r) \
+	const int64_t r = (((index) % BIT_VECTOR_WORD_BITS) + BIT_VECTOR_WORD_BITS) % BIT_VECTOR_WORD_BITS; \
+	const int64_t q = ((index) - r) / BIT_VECTOR_WORD_BITS
+
+/**
+ * @brief Word i of a wrap extraction from a bit vector whose size is not a multiple of 32
+ *        (its words do not simply follow one another)
+ */
+static uint32_t bit_vector_wrap_word(const bit_vector_t* pbv, int64_t index, size_t size, size_t i) {
+	// bit index of the vector, wrapped
+	#define WRAP(index) (pbv->content[QUOTIENT32(((index) % (int64_t) pbv->size + (int64_t) pbv->size) % (int64_t) pbv->size)])
+
+	//special case if multiple of 32: a vector smaller than a word is repeated along the word
+	if(MOD32(index) == 0) {
+		uint32_t word = 0;
+		for(size_t j = 0; j < size/pbv->size && j*pbv->size < BIT_VECTOR_WORD_BITS; ++j) {
+			word |= WRAP(index + (int64_t)i*BIT_VECTOR_WORD_BITS) << j*pbv->size;
+		}
+		return word;
+	}
+
+	// recreate the resulting vector by merging two adjacent words shifted as required
+	const int64_t r = (MOD32(index) + BIT_VECTOR_WORD_BITS) % BIT_VECTOR_WORD_BITS;
+	return FUNNEL(WRAP(index + (int64_t)i*BIT_VECTOR_WORD_BITS), WRAP(index + ((int64_t)i+1)*BIT_VECTOR_WORD_BITS), r);
+	#undef WRAP
+}
+
+//=========================================================================
+bit_vector_t* bit_vector_extract_zero_ext_to(bit_vector_t* dst, const bit_vector_t* pbv, int64_t index) {
+	// check the arguments: if pbv is NULL the result is all zeros
+	if(dst == NULL) {
+		return NULL;
+	}
+	if(pbv == NULL) {
+		return bit_vector_init(dst, dst->size, 0);
+	}
 
-	return pbv->content[QUOTIENT32(index)];
+	// word i is made of words q + i and q + i + 1 of pbv (zero outside of it): going down from
+	// the last word when they are below i lets dst be pbv
+	SPLIT_INDEX(index, q, r);
+	const int64_t nb = (int64_t) WORD_NB(pbv->size);
+	const size_t words = WORD_NB(dst->size);
+	for(size_t k = 0; k < words; ++k) {
+		const size_t i = index < 0 ? words - 1 - k : k;
+		const int64_t w = q + (int64_t) i;
+		const uint32_t lo = w >= 0 && w < nb ? pbv->content[w] : 0;
+		const uint32_t hi = w + 1 >= 0 && w + 1 < nb ? pbv->content[w + 1] : 0;
+		dst->content[i] = FUNNEL(lo, hi, r);
+	}
+	dst->content[words - 1] &= LAST_WORD_MASK(dst->size);
+	return dst;
 }
 
 //=========================================================================
 bit_vector_t* bit_vector_extract_zero_ext(const bit_vector_t* pbv, int64_t index, size_t size) {
-	
 	// check the arguments: if size is 0 it returns the NULL vector
 	if(size == 0) {
 		return NULL;
 	}
-	// create a vector of zeros with size of bit-length
-	bit_vector_t* result = bit_vector_create(size, 0);
-	
-	// check the arguments: if pbv is NULL it returns a vector with zeros
-	if(pbv == NULL || pbv->content == NULL) {
-		return result;
+	// create a vector of zeros with size of bit-length, and extract into it
+	return bit_vector_extract_zero_ext_to(bit_vector_create(size, 0), pbv, index);
+}
+
+//=========================================================================
+bit_vector_t* bit_vector_extract_wrap_ext_to(bit_vector_t* dst, const bit_vector_t* pbv, int64_t index) {
+	// check the arguments: the words of pbv are read all around, dst cannot be pbv
+	if(dst == NULL || pbv == NULL || dst == pbv) {
+		return NULL;
 	}
-	
-	//special case if multiple of 32
-	if(MOD32(index) == 0) {
-		for(size_t i = 0; i < WORD_NB(size); ++i) {
-			result->content[i] = bit_vector_contains_index(pbv, zero, index + (int64_t)i*IMAGE_LINE_WORD_BITS);
-		}
 
+	const size_t words = WORD_NB(dst->size);
+	if(MOD32(pbv->size) != 0) {
+		for(size_t i = 0; i < words; ++i) {
+			dst->content[i] = bit_vector_wrap_word(pbv, index, dst->size, i);
+		}
 	} else {
-		// recreate the resulting vector by merging two adjacent words shifted as required
-		int64_t shift_right = index > 0 ? MOD32(index) : (IMAGE_LINE_WORD_BITS + (MOD32(index)));
-		int64_t shift_left = IMAGE_LINE_WORD_BITS - shift_right;
-		for(size_t i = 0; i < WORD_NB(size); ++i) {
-			result->content[i] = (bit_vector_contains_index(pbv, zero, index + (int64_t)i*IMAGE_LINE_WORD_BITS) >> shift_right) | (bit_vector_contains_index(pbv, zero, index + ((int64_t)i+1)*IMAGE_LINE_WORD_BITS) << shift_left);
-		}		
+		// the words of pbv follow one another, going back to the first one after the last one
+		SPLIT_INDEX(index, q, r);
+		const int64_t nb = (int64_t) WORD_NB(pbv->size);
+		int64_t w = (q % nb + nb) % nb;
+		for(size_t i = 0; i < words; ++i) {
+			const int64_t next = w + 1 == nb ? 0 : w + 1;
+			dst->content[i] = FUNNEL(pbv->content[w], pbv->content[next], r);
+			w = next;
+		}
 	}
-
-	return result;
+	dst->content[words - 1] &= LAST_WORD_MASK(dst->size);
+	return dst;
 }
 
 //=========================================================================
 bit_vector_t* bit_vector_extract_wrap_ext(const bit_vector_t* pbv, int64_t index, size_t size) {
-	
 	// check the arguments: if size is 0 it returns the NULL vector
 	// check the arguments: if pbv is NULL it returns the NULL vector
-	if(size == 0 || pbv == NULL || pbv->content == NULL) {
+	if(size == 0 || pbv == NULL) {
 		return NULL;
 	}
+	// create a vector of zeros with size of bit-length, and extract into it
+	return bit_vector_extract_wrap_ext_to(bit_vector_create(size, 0), pbv, index);
+}
 
-	// create a vector of zeros with size of bit-length
-	bit_vector_t* result = bit_vector_create(size, 0);
-	
-
-	//special case if multiple of 32
-	if(MOD32(index) == 0) {
-		for(size_t i = 0; i < WORD_NB(size); ++i) {
-			// if regular params
-			if(size <= 32 && pbv->size >= size && MOD32(pbv->size) == 0 && MOD32(size) == 0) {
-				result->content[i] = bit_vector_contains_index(pbv, wrap, index + (int64_t)i*IMAGE_LINE_WORD_BITS);
-			} else { // with irregular params
-				for(size_t j = 0; j < size/pbv->size; ++j) {
-					result->content[i] = result->content[i] | bit_vector_contains_index(pbv, wrap, index + (int64_t)i*IMAGE_LINE_WORD_BITS) << j*pbv->size;
-				}
-			}
-		}
-	
-	} else {
-		// recreate the resulting vector by merging two adjacent words shifted as required
-		int64_t shift_right = index > 0 ? MOD32(index) : (IMAGE_LINE_WORD_BITS + (MOD32(index)));
-		int64_t shift_left = IMAGE_LINE_WORD_BITS - shift_right;
-		for(size_t i = 0; i < WORD_NB(size); ++i) {
-			result->content[i] = (bit_vector_contains_index(pbv, wrap, index + (int64_t)i*IMAGE_LINE_WORD_BITS) >> shift_right) | (bit_vector_contains_index(pbv, wrap, index + ((int64_t)i+1)*IMAGE_LINE_WORD_BITS) << shift_left);
-		}		
+//=========================================================================
+bit_vector_t* bit_vector_shift_to(bit_vector_t* dst, const bit_vector_t* pbv, int64_t shift) {
+	// check arguments validity
+	if(dst == NULL || pbv == NULL || dst->size != pbv->size) {
+		return NULL;
 	}
-	
-	return result;
+	return bit_vector_extract_zero_ext_to(dst, pbv, -shift);
 }
 
 //=========================================================================
@@ -239,31 +405,37 @@ bit_vector_t* bit_vector_shift(const bit_vector_t* pbv, int64_t shift) {
 	return bit_vector_extract_zero_ext(pbv, -shift, pbv->size);
 }
 
+//=========================================================================
+bit_vector_t* bit_vector_join_to(bit_vector_t* dst, const bit_vector_t* pbv1, const bit_vector_t* pbv2, int64_t shift) {
+	// check arguments validity
+	if(dst == NULL || pbv1 == NULL || pbv2 == NULL || pbv1->size != pbv2->size || dst->size != pbv1->size
+	   || shift < 0 || shift > (int64_t)pbv1->size) {
+		return NULL;
+	}
+
+	// words below q from pbv1, above q from pbv2, and word q merged from both vectors
+	// (computed first: dst may be one of them)
+	const size_t q = (size_t) QUOTIENT32(shift);
+	const size_t words = WORD_NB(dst->size);
+	if(q < words) {
+		const uint32_t low = MOD32(shift) == 0 ? 0 : UINT32_MAX >> (BIT_VECTOR_WORD_BITS - MOD32(shift));
+		const uint32_t middle = (pbv1->content[q] & low) | (pbv2->content[q] & ~low);
+		memmove(dst->content + q + 1, pbv2->content + q + 1, sizeof(uint32_t) * (words - q - 1));
+		dst->content[q] = middle;
+	}
+	memmove(dst->content, pbv1->content, sizeof(uint32_t) * MIN(q, words));
+	return dst;
+}
+
 //=========================================================================
 bit_vector_t* bit_vector_join(const bit_vector_t* pbv1, const bit_vector_t* pbv2, int64_t shift) {
 	// check arguments validity
-	if(pbv1 == NULL || pbv1->content == NULL || pbv2 == NULL || pbv2->content == NULL || pbv1->size != pbv2->size || shift < 0 || shift > (int64_t)pbv1->size) {
+	if(pbv1 == NULL || pbv2 == NULL || pbv1->size != pbv2->size || shift < 0 || shift > (int64_t)pbv1->size) {
 		return NULL;
 	}
 	
-	// init a new vector and only proceed if successful
-	bit_vector_t* result = bit_vector_create(pbv1->size, 0);
-	if(result == NULL) { return NULL; }
-
-	for(int i = 0; i < (int64_t) WORD_NB(pbv1->size); ++i) {
-		if (i < QUOTIENT32(shift))  {
-			// words entirely taken from pbv1
-			result->content[i] = pbv1->content[i];
-		} else if (i > QUOTIENT32(shift) || MOD32(shift) == 0)  {
-			// words entirely taken from pbv2 (the second condition is tested only when i = QUOTIENT32(shift))
-			result->content[i] = pbv2->content[i];
-		} else {
-			// middle word merged from both vectors (when i = QUOTIENT32(shift), but MOD32(shift) != 0)
-			result->content[i] |= (pbv1->content[i] & (uint32_t) ((1 << MOD32(shift)) - 1));
-			result->content[i] |= (pbv2->content[i] & ~(uint32_t)((1 << ((MOD32(shift)) -1)) - 1));
-		}
-	}
-	return result;
+	// init a new vector and join into it
+	return bit_vector_join_to(bit_vector_create(pbv1->size, 0), pbv1, pbv2, shift);
 }
 
 //=========================================================================
@@ -28,6 +28,42 @@ typedef struct {
 	uint32_t content[1];    // tableau de contenu (alloc. dyn.)
 } bit_vector_t;
 
+#define BIT_VECTOR_WORD_BITS 32
+
+/**
+ * @brief Number of words, and number of bytes, needed by a bit vector of size bits
+ *        (e.g. to carve bit vectors from some other memory, see bit_vector_init())
+ */
+#define bit_vector_words(size) (((size) + BIT_VECTOR_WORD_BITS - 1) / BIT_VECTOR_WORD_BITS)
+#define bit_vector_sizeof(size) (sizeof(bit_vector_t) + sizeof(uint32_t) * (bit_vector_words(size) - 1))
+
+//=========================================================================
+/**
+ * @brief Fixed-width bit vectors, for the lines of the LCD (160 pixels) and of
+ *        the tile maps (256 pixels). Same layout as bit_vector_t but with their
+ *        content inline: they live on the stack (or in another struct), and are
+ *        used through bit_vector_fixed() by the in-place and *_to functions,
+ *        which never allocate.
+ */
+typedef struct {
+	size_t size;
+	uint32_t content[bit_vector_words(160)];
+} bit_vector_160_t;
+
+typedef struct {
+	size_t size;
+	uint32_t content[bit_vector_words(256)];
+} bit_vector_256_t;
+
+#define bit_vector_fixed(pfbv) ((bit_vector_t*) (pfbv))
+
+/**
+ * @brief Initializes a fixed-width bit vector to its whole width, filled with value
+ * @return pointer to the bit vector, as a bit_vector_t*
+ */
+#define bit_vector_fixed_init(pfbv, value) \
+	bit_vector_init(bit_vector_fixed(pfbv), sizeof((pfbv)->content) * 8, value)
+
 
 //=========================================================================
 /**
@@ -38,6 +74,16 @@ typedef struct {
  */
 bit_vector_t* bit_vector_create(size_t size, bit_t value);
 
+//=========================================================================
+/**
+ * @brief Initialize a bit vector in place, in memory provided by the caller
+ * @param pbv pointer to the bit vector, of bit_vector_sizeof(size) bytes at least
+ * @param size, size in bits of the vector
+ * @param value, bit value
+ * @return pointer to the bit vector (NULL in case of error)
+ */
+bit_vector_t* bit_vector_init(bit_vector_t* pbv, size_t size, bit_t value);
+
 //=========================================================================
 /**
  * @brief Create a copy of a bit vector
@@ -46,6 +92,15 @@ bit_vector_t* bit_vector_create(size_t size, bit_t value);
  */
 bit_vector_t* bit_vector_cpy(const bit_vector_t* pbv);
 
+//=========================================================================
+/**
+ * @brief Copy a bit vector into another one of the same size
+ * @param dst pointer to the destination bit vector
+ * @param src pointer to the bit vector to copy
+ * @return pointer to the destination bit vector (NULL in case of error)
+ */
+bit_vector_t* bit_vector_cpy_to(bit_vector_t* dst, const bit_vector_t* src);
+
 //=========================================================================
 /**
  * @brief Get the value of a given bit in a bit vector
@@ -90,6 +145,89 @@ bit_vector_t* bit_vector_or(bit_vector_t* pbv1, const bit_vector_t* pbv2);
  */
 bit_vector_t* bit_vector_xor(bit_vector_t* pbv1, const bit_vector_t* pbv2);
 
+//=========================================================================
+/**
+ * @brief Kernels of the bulk logical operations (not, and, or, xor): SSE2 and
+ *        AVX2 ones are only built with GCC/clang on x86 (unless BIT_VECTOR_NO_SIMD
+ *        is defined), the scalar one works on 64 bits at a time
+ */
+typedef enum {
+	BIT_VECTOR_SCALAR,
+	BIT_VECTOR_SSE2,
+	BIT_VECTOR_AVX2
+} bit_vector_backend_t;
+
+//=========================================================================
+/**
+ * @brief Select the kernels of the bulk logical operations, once for all:
+ *        only the first call made before any bulk operation has an effect.
+ *        Otherwise, the best kernels the CPU supports are selected on first use.
+ * @param backend wanted backend
+ * @return backend in use: the wanted one, or the best one supported below it, if the
+ *         selection is made by this call; the one selected before otherwise
+ */
+bit_vector_backend_t bit_vector_select_backend(bit_vector_backend_t backend);
+
+//=========================================================================
+/*
+ * Destination-parameter variants: the result goes to dst, which must already
+ * be initialized (see bit_vector_init()) and whose size is the size of the
+ * result. They return dst, or NULL in case of error, and never allocate.
+ * dst may be one of the operands, except for bit_vector_extract_wrap_ext_to().
+ */
+
+//=========================================================================
+/**
+ * @brief Compute logical NOT of a bit vector into dst
+ */
+bit_vector_t* bit_vector_not_to(bit_vector_t* dst, const bit_vector_t* pbv);
+
+//=========================================================================
+/**
+ * @brief Compute logical AND of two bit vectors into dst
+ */
+bit_vector_t* bit_vector_and_to(bit_vector_t* dst, const bit_vector_t* pbv1, const bit_vector_t* pbv2);
+
+//=========================================================================
+/**
+ * @brief Compute logical OR of two bit vectors into dst
+ */
+bit_vector_t* bit_vector_or_to(bit_vector_t* dst, const bit_vector_t* pbv1, const bit_vector_t* pbv2);
+
+//=========================================================================
+/**
+ * @brief Compute logical XOR of two bit vectors into dst
+ */
+bit_vector_t* bit_vector_xor_to(bit_vector_t* dst, const bit_vector_t* pbv1, const bit_vector_t* pbv2);
+
+//=========================================================================
+/**
+ * @brief Extract dst->size bits of a bit vector into dst (zero extended)
+ * @param index index from where to start extraction
+ */
+bit_vector_t* bit_vector_extract_zero_ext_to(bit_vector_t* dst, const bit_vector_t* pbv, int64_t index);
+
+//=========================================================================
+/**
+ * @brief Extract dst->size bits of a bit vector into dst (wrap extended)
+ * @param index index from where to start extraction
+ */
+bit_vector_t* bit_vector_extract_wrap_ext_to(bit_vector_t* dst, const bit_vector_t* pbv, int64_t index);
+
+//=========================================================================
+/**
+ * @brief Shift a bit vector into dst (of the same size)
+ * @param shift bit shift count
+ */
+bit_vector_t* bit_vector_shift_to(bit_vector_t* dst, const bit_vector_t* pbv, int64_t shift);
+
+//=========================================================================
+/**
+ * @brief Join two bit vectors into dst (all of the same size)
+ * @param shift bit shift count: values of pbv1 until shift (excluded), then values from pbv2
+ */
+bit_vector_t* bit_vector_join_to(bit_vector_t* dst, const bit_vector_t* pbv1, const bit_vector_t* pbv2, int64_t shift);
+
 //=========================================================================
 /**
  * @brief Create a new bit vector extracted from another bit vector (zero extended)
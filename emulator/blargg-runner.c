@@ -0,0 +1,318 @@
+/**
+ * @file blargg-runner.c
+ * @brief Runs the blargg test ROMs in parallel, each on its own gameboy, and reports
+ *        PASSED/FAILED for each of them from the text they send on the serial port.
+ *        A ROM is stopped as soon as it reports its result (or gets stuck in a loop
+ *        no interrupt can leave) instead of being run for a fixed number of cycles.
+ *        The boot ROM is skipped unless asked for (see bootrom_skip()).
+ *
+ * @date 2020
+ */
+
+#define _XOPEN_SOURCE 700 // clock_gettime, sysconf, opendir
+
+#include "gameboy.h"
+#include "bootrom.h"
+#include "util.h"  // for zero_init_var()
+#include "error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#define BLARGG_DEFAULT_DIR        "tests/data/blargg_roms"
+#define BLARGG_DEFAULT_MAX_CYCLES 30000000 // above the longest of the ROMs (11-op a,(hl): ~25M)
+#define BLARGG_MAX_ROMS           64
+#define BLARGG_MAX_OUTPUT         1024
+#define BLARGG_CHECK_PERIOD       FRAME_TOTAL_CYCLES // how often the output and the cpu are looked at
+
+#define OPCODE_JR_E8  0x18
+#define OPCODE_JP_N16 0xC3
+#define JR_SELF       0xFE // -2: back to the JR itself
+
+/**
+ * @brief One ROM to run, with its result
+ */
+typedef struct {
+    const char* rom;
+    int error;
+    bit_t passed;
+    bit_t stuck;
+    uint64_t cycles;
+    double seconds;
+    char output[BLARGG_MAX_OUTPUT];
+    size_t output_len;
+} blargg_job_t;
+
+/**
+ * @brief Work queue shared by the threads: each of them takes the next ROM not run yet
+ */
+typedef struct {
+    blargg_job_t* jobs;
+    size_t count;
+    size_t next;
+    uint64_t max_cycles;
+    bit_t boot;             // whether the ROMs go through the boot ROM
+    pthread_mutex_t lock;
+} blargg_queue_t;
+
+// ======================================================================
+static void usage(const char* pgm)
+{
+    fprintf(stderr, "usage:    %s [-j threads] [-c max_cycles] [-b] [rom ...]\n", pgm);
+    fprintf(stderr, "          -b: runs the boot ROM instead of skipping it\n");
+    fprintf(stderr, "          without rom, runs the ROMs of %s/\n", BLARGG_DEFAULT_DIR);
+    fprintf(stderr, "example:  %s -j 4\n", pgm);
+}
+
+// ======================================================================
+static int cmp_names(const void* a, const void* b)
+{
+    return strcmp(*(const char* const*) a, *(const char* const*) b);
+}
+
+/**
+ * Auxiliary function
+ * @brief Adds the .gb files of a directory to the list, sorted by name
+ *
+ * @return number of ROMs added
+ */
+static size_t list_roms(const char* dir_name, char** roms, size_t max)
+{
+    DIR* dir = opendir(dir_name);
+    if (dir == NULL) return 0;
+
+    size_t count = 0;
+    const struct dirent* entry = NULL;
+    while (count < max && (entry = readdir(dir)) != NULL) {
+        const char* ext = strrchr(entry->d_name, '.');
+        if (ext == NULL || strcmp(ext, ".gb") != 0) continue;
+
+        const size_t size = strlen(dir_name) + 1 + strlen(entry->d_name) + 1;
+        roms[count] = malloc(size);
+        if (roms[count] == NULL) break;
+        snprintf(roms[count], size, "%s/%s", dir_name, entry->d_name);
+        ++count;
+    }
+    closedir(dir);
+
+    qsort(roms, count, sizeof(*roms), cmp_names);
+    return count;
+}
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Serial receiver: keeps the text sent by the ROM (see gameboy_set_serial_output())
+ */
+static void capture_serial(void* ctx, data_t byte)
+{
+    blargg_job_t* job = ctx;
+    if (job->output_len + 1 < BLARGG_MAX_OUTPUT) {
+        job->output[job->output_len++] = (char) byte;
+        job->output[job->output_len] = '\0';
+    }
+}
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Tells whether the cpu is in a state it cannot leave anymore:
+ *        halted or jumping onto itself with no interrupt able to wake it up
+ */
+static bit_t cpu_stuck(const cpu_t* cpu)
+{
+    if (cpu->IE == 0 || !cpu->IME) {
+        if (cpu->HALT) return cpu->IE == 0;
+
+        data_t opcode = 0, arg1 = 0, arg2 = 0;
+        if (bus_read(*cpu->bus, cpu->PC, &opcode) != ERR_NONE
+            || bus_read(*cpu->bus, (addr_t) (cpu->PC + 1), &arg1) != ERR_NONE
+            || bus_read(*cpu->bus, (addr_t) (cpu->PC + 2), &arg2) != ERR_NONE) {
+            return 0;
+        }
+        if (opcode == OPCODE_JR_E8 && arg1 == JR_SELF) return 1;
+        if (opcode == OPCODE_JP_N16 && merge8(arg1, arg2) == cpu->PC) return 1;
+    }
+    return 0;
+}
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Runs one ROM until it reports its result, gets stuck or reaches max_cycles
+ *        (counted from the start of the cartridge when the boot is skipped)
+ */
+static void run_job(blargg_job_t* job, uint64_t max_cycles, bit_t boot)
+{
+    gameboy_t* gb = calloc(1, sizeof(gameboy_t));
+    if (gb == NULL) {
+        job->error = ERR_MEM;
+        return;
+    }
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    job->error = gameboy_create(gb, job->rom);
+    if (job->error == ERR_NONE && !boot) {
+        job->error = bootrom_skip(gb);
+    }
+    if (job->error == ERR_NONE) {
+        job->error = gameboy_set_serial_output(gb, capture_serial, job);
+    }
+
+    const uint64_t first = gb->cycles;
+    while (job->error == ERR_NONE && gb->cycles - first < max_cycles) {
+        uint64_t until = gb->cycles + BLARGG_CHECK_PERIOD;
+        if (until > first + max_cycles) until = first + max_cycles;
+        job->error = gameboy_run_until(gb, until);
+        if (strstr(job->output, "Passed") != NULL) {
+            job->passed = strstr(job->output, "Failed") == NULL;
+            break;
+        }
+        // a failing ROM ends in a loop too, after having printed the details of the failure
+        if (cpu_stuck(&gb->cpu)) {
+            job->stuck = 1;
+            break;
+        }
+    }
+    job->cycles = gb->cycles - first;
+
+    gameboy_free(gb);
+    free(gb);
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    job->seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) * 1e-9;
+}
+
+// ======================================================================
+static void* worker(void* arg)
+{
+    blargg_queue_t* queue = arg;
+    for (;;) {
+        pthread_mutex_lock(&queue->lock);
+        const size_t i = queue->next;
+        if (i < queue->count) ++queue->next;
+        pthread_mutex_unlock(&queue->lock);
+
+        if (i >= queue->count) return NULL;
+        run_job(&queue->jobs[i], queue->max_cycles, queue->boot);
+    }
+}
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Prints the result of each ROM (with its serial output when it failed)
+ *
+ * @return number of ROMs that failed
+ */
+static size_t print_report(const blargg_job_t* jobs, size_t count, double seconds, size_t nb_threads)
+{
+    size_t failed = 0;
+    for (size_t i = 0; i < count; ++i) {
+        const blargg_job_t* job = &jobs[i];
+        const char* name = strrchr(job->rom, '/') != NULL ? strrchr(job->rom, '/') + 1 : job->rom;
+        if (job->passed) {
+            printf("%-32s PASSED  %10" PRIu64 " cycles %8.1f ms\n", name, job->cycles, job->seconds * 1e3);
+            continue;
+        }
+
+        ++failed;
+        if (job->error != ERR_NONE) {
+            printf("%-32s FAILED  error: %s\n", name, ERR_MESSAGES[job->error - ERR_NONE]);
+        } else {
+            printf("%-32s FAILED  %10" PRIu64 " cycles (%s)\n", name, job->cycles,
+                   job->stuck ? "stopped in a loop" : "cycle limit reached");
+        }
+        printf("    output: \"%s\"\n", job->output);
+    }
+    printf("%zu/%zu passed in %.3f s with %zu thread(s)\n", count - failed, count, seconds, nb_threads);
+    return failed;
+}
+
+// ======================================================================
+int main(int argc, char* argv[])
+{
+    long nb_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    uint64_t max_cycles = BLARGG_DEFAULT_MAX_CYCLES;
+    bit_t boot = 0;
+
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "j:c:bh")) != -1) {
+        switch (opt) {
+        case 'j':
+            nb_threads = strtol(optarg, NULL, 10);
+            break;
+        case 'c':
+            max_cycles = strtoull(optarg, NULL, 10);
+            break;
+        case 'b':
+            boot = 1;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (nb_threads < 1) nb_threads = 1;
+    if (max_cycles == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    char* listed[BLARGG_MAX_ROMS];
+    size_t nb_listed = 0;
+    static blargg_job_t jobs[BLARGG_MAX_ROMS];
+    size_t count = 0;
+
+    if (optind < argc) {
+        for (int i = optind; i < argc && count < BLARGG_MAX_ROMS; ++i) {
+            jobs[count++].rom = argv[i];
+        }
+    } else {
+        nb_listed = list_roms(BLARGG_DEFAULT_DIR, listed, BLARGG_MAX_ROMS);
+        for (size_t i = 0; i < nb_listed; ++i) {
+            jobs[count++].rom = listed[i];
+        }
+    }
+    if (count == 0) {
+        fprintf(stderr, "no ROM to run\n");
+        usage(argv[0]);
+        return 1;
+    }
+    if ((size_t) nb_threads > count) nb_threads = (long) count;
+
+    blargg_queue_t queue = { jobs, count, 0, max_cycles, boot, PTHREAD_MUTEX_INITIALIZER };
+    pthread_t threads[BLARGG_MAX_ROMS];
+
+    struct timespec start, end;
+    clock_gettime(CLOCK_MONOTONIC, &start);
+
+    long started = 0;
+    for (; started < nb_threads; ++started) {
+        if (pthread_create(&threads[started], NULL, worker, &queue) != 0) break;
+    }
+    // without any thread at all, the main one does the work
+    if (started == 0) worker(&queue);
+    for (long t = 0; t < started; ++t) {
+        pthread_join(threads[t], NULL);
+    }
+
+    clock_gettime(CLOCK_MONOTONIC, &end);
+    const double seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) * 1e-9;
+
+    const size_t failed = print_report(jobs, count, seconds, started == 0 ? 1 : (size_t) started);
+
+    for (size_t i = 0; i < nb_listed; ++i) {
+        free(listed[i]);
+    }
+
+    return failed == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
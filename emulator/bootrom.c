@@ -11,11 +11,16 @@
 
 // ==== see bootrom.h ========================================
 int bootrom_init(component_t* c) {
+	return bootrom_init_in(c, NULL);
+}
+
+// ==== see bootrom.h ========================================
+int bootrom_init_in(component_t* c, mem_arena_t* arena) {
 	// check arguments validity
 	M_REQUIRE_NON_NULL(c);
 
 	// create a component for the bootrom
-	M_EXIT_IF_ERR(component_create(c, MEM_SIZE(BOOT_ROM)));
+	M_EXIT_IF_ERR(component_create_in(c, arena, MEM_SIZE(BOOT_ROM)));
 	// feed the memory array allocated for the bootrom by its predefined content
 	data_t data[MEM_SIZE(BOOT_ROM)] = GAMEBOY_BOOT_ROM_CONTENT;
 	
@@ -35,16 +40,158 @@ int bootrom_bus_listener(gameboy_t* gameboy, addr_t addr) {
 	// unplug the bus, delete the bootrom component and change the gameboy boot state
 	if(gameboy->boot && (addr == REG_BOOT_ROM_DISABLE)) {
 		M_EXIT_IF_ERR(cartridge_plug(&(gameboy->cartridge), gameboy->bus));
+		// the code predecoded from the bootrom is no longer valid
+		cpu_decode_cache_invalidate(&gameboy->cpu, CPU_DECODE_CACHE_START, CPU_DECODE_CACHE_END);
 		gameboy->boot = 0;
+	}
+
+	return ERR_NONE;
+}
+
+
+/*
+ * State of the gameboy when the boot ROM above writes to REG_BOOT_ROM_DISABLE, whatever the
+ * cartridge (it only reads the logo from it): the boot always takes the same number of cycles.
+ * The artificial VBLANK interrupts of BLARGG_EARLY end its waits for the VBLANK sooner.
+ */
+#ifdef BLARGG_EARLY
+#define BOOT_END_CYCLE          1119152
+#define BOOT_END_INSTRUCTIONS    379241
+#define BOOT_END_TIMER_COUNTER   0x4EBC
+#define BOOT_END_LCD_NEXT_CYCLE 1119220
+#else
+#define BOOT_END_CYCLE          2172512
+#define BOOT_END_INSTRUCTIONS    730361
+#define BOOT_END_TIMER_COUNTER   0x997C
+#define BOOT_END_LCD_NEXT_CYCLE 2172580
+#endif
+#define BOOT_END_LCD_ON_CYCLE     66886
+// cycles left of the instruction that disabled the boot ROM (LDH (n8), A)
+#define BOOT_END_IDLE_TIME            2
+
+// logo copied from the cartridge, each of its pixels doubled, then the (R) from the boot ROM
+#define BOOT_LOGO_START        0x0104
+#define BOOT_LOGO_SIZE         48
+#define BOOT_LOGO_TILES        0x8010
+#define BOOT_REGISTERED_START  0x00B1
+#define BOOT_REGISTERED_SIZE   8
+#define BOOT_REGISTERED_TILE   0x19
+// the logo is 2 rows of 12 tiles in the middle of the background, the (R) on the right of the first one
+#define BOOT_MAP_ROW_1         0x9904
+#define BOOT_MAP_ROW_2         0x9924
+#define BOOT_MAP_ROW_TILES     12
+
+/**
+ * @brief Bus bytes different from the ones of a gameboy just created once the boot is over
+ */
+static const struct {
+	addr_t addr;
+	data_t value;
+} boot_end_bytes[] = {
+	{ REG_DIV, BOOT_END_TIMER_COUNTER >> 8 },
+	{ REG_IF, 0x01 },    // VBLANK
+	{ 0xFF11, 0x80 },    // sound
+	{ 0xFF12, 0xF3 },
+	{ 0xFF13, 0xC1 },
+	{ 0xFF14, 0x87 },
+	{ 0xFF24, 0x77 },
+	{ 0xFF25, 0xF3 },
+	{ 0xFF26, 0x80 },
+	{ REG_LCDC, 0x91 },
+	{ REG_STAT, 0x01 },
+	{ REG_LY, 0x90 },
+	{ REG_BGP, 0xFC },
+	{ REG_BOOT_ROM_DISABLE, 0x01 },
+	{ 0xFFF8, 0x03 },    // leftovers of the stack
+	{ 0xFFF9, 0x99 },
+	{ 0xFFFA, 0xA6 },
+	{ 0xFFFC, 0xB0 },
+	{ 0xFFFD, 0x01 },
+};
+
+/**
+ * Auxiliary function
+ * @brief Doubles each of the 4 bits of a nibble, as the boot ROM does to enlarge the logo
+ */
+static data_t bootrom_double_bits(data_t nibble)
+{
+	data_t doubled = 0;
+	for (int i = 3; i >= 0; --i) {
+		const data_t bit = (nibble >> i) & 1;
+		doubled = (data_t) ((doubled << 2) | (bit << 1) | bit);
+	}
+	return doubled;
+}
 
-		int j = 0;
-		for (size_t i = 0; i <= 0xFFFF; i++)
-		{
-    		if (gameboy->bus[i] == NULL) j++;
+/**
+ * Auxiliary function
+ * @brief Draws the logo of the cartridge into the video RAM as the boot ROM does
+ *
+ * @return error code
+ */
+static int bootrom_draw_logo(gameboy_t* gameboy)
+{
+	addr_t tile = BOOT_LOGO_TILES;
+	for (addr_t i = 0; i < BOOT_LOGO_SIZE; ++i) {
+		data_t byte = 0;
+		M_EXIT_IF_ERR(bus_read(gameboy->bus, (addr_t) (BOOT_LOGO_START + i), &byte));
+		// one line of one color plane out of two, each line twice
+		const data_t lines[2] = { bootrom_double_bits(byte >> 4), bootrom_double_bits(byte & 0x0F) };
+		for (int l = 0; l < 2; ++l, tile += 4) {
+			M_EXIT_IF_ERR(bus_write(gameboy->bus, tile, lines[l]));
+			M_EXIT_IF_ERR(bus_write(gameboy->bus, (addr_t) (tile + 2), lines[l]));
 		}
+	}
 
+	for (addr_t i = 0; i < BOOT_REGISTERED_SIZE; ++i, tile += 2) {
+		M_EXIT_IF_ERR(bus_write(gameboy->bus, tile, gameboy->bootrom.mem->memory[BOOT_REGISTERED_START + i]));
 	}
 
-	return ERR_NONE;
+	for (addr_t i = 0; i < BOOT_MAP_ROW_TILES; ++i) {
+		M_EXIT_IF_ERR(bus_write(gameboy->bus, (addr_t) (BOOT_MAP_ROW_1 + i), (data_t) (1 + i)));
+		M_EXIT_IF_ERR(bus_write(gameboy->bus, (addr_t) (BOOT_MAP_ROW_2 + i), (data_t) (1 + BOOT_MAP_ROW_TILES + i)));
+	}
+	return bus_write(gameboy->bus, BOOT_MAP_ROW_1 + BOOT_MAP_ROW_TILES, BOOT_REGISTERED_TILE);
 }
 
+// ==== see bootrom.h ========================================
+int bootrom_skip(gameboy_t* gameboy) {
+	// check arguments validity
+	M_REQUIRE_NON_NULL(gameboy);
+	M_REQUIRE(gameboy->boot && gameboy->cycles == 1, ERR_BAD_PARAMETER,
+	          "the boot can only be skipped before running the gameboy%s", "");
+
+	// the cartridge is at 0x0000 right away; the bootrom component is kept for the save states
+	M_EXIT_IF_ERR(cartridge_plug(&(gameboy->cartridge), gameboy->bus));
+	cpu_decode_cache_invalidate(&gameboy->cpu, CPU_DECODE_CACHE_START, CPU_DECODE_CACHE_END);
+	gameboy->boot = 0;
+	gameboy->cycles = BOOT_END_CYCLE;
+
+	for (size_t i = 0; i < sizeof(boot_end_bytes) / sizeof(boot_end_bytes[0]); ++i) {
+		M_EXIT_IF_ERR(bus_write(gameboy->bus, boot_end_bytes[i].addr, boot_end_bytes[i].value));
+	}
+	M_EXIT_IF_ERR(bootrom_draw_logo(gameboy));
+
+	cpu_t* cpu = &gameboy->cpu;
+	cpu->AF = 0x01B0;
+	cpu->BC = 0x0013;
+	cpu->DE = 0x00D8;
+	cpu->HL = 0x014D;
+	cpu->SP = 0xFFFE;
+	cpu->PC = CARTRIDGE_ENTRY_POINT;
+	cpu->IME = 0;
+	cpu->IE = 0;
+	cpu->HALT = 0;
+	cpu->idle_time = BOOT_END_IDLE_TIME;
+	cpu->instructions = BOOT_END_INSTRUCTIONS;
+
+	gameboy->timer.counter = BOOT_END_TIMER_COUNTER;
+	M_EXIT_IF_ERR(timer_resync(&gameboy->timer, gameboy->cycles));
+
+	lcdc_t* lcd = &gameboy->screen;
+	lcd->on = 1;
+	lcd->on_cycle = BOOT_END_LCD_ON_CYCLE;
+	lcd->next_cycle = BOOT_END_LCD_NEXT_CYCLE;
+
+	return ERR_NONE;
+}
@@ -65,6 +65,15 @@ extern "C" {
  */
 int bootrom_init(component_t* c);
 
+/**
+ * @brief Same as bootrom_init(), the memory of the component being allocated in an arena
+ *
+ * @param c component to write the bootrom content to
+ * @param arena arena to allocate from (NULL: heap)
+ * @return error code
+ */
+int bootrom_init_in(component_t* c, mem_arena_t* arena);
+
 
 /**
  * @brief Macro to plug bootrom onto the bus
@@ -81,6 +90,17 @@ int bootrom_init(component_t* c);
  */
 int bootrom_bus_listener(gameboy_t* gameboy, addr_t addr);
 
+
+/**
+ * @brief Skips the boot of a gameboy just created: puts it in the state the boot ROM leaves it in
+ *        (cpu, IO registers, timer, LCDC, logo in video RAM, number of cycles), with the cartridge
+ *        plugged at 0x0000. The gameboy then runs exactly as if it had gone through the boot.
+ *
+ * @param gameboy gameboy to start, not run yet
+ * @return error code
+ */
+int bootrom_skip(gameboy_t* gameboy);
+
 #ifdef __cplusplus
 }
 #endif
@@ -8,6 +8,91 @@
 
 #include "bus.h"
 
+/**
+ * Auxiliary function
+ * @brief Gives the byte mapped at a given address of a page
+ *
+ * @param page page containing the address
+ * @param address address to look at
+ * @return pointer to the byte, NULL if nothing is plugged there
+ */
+static inline data_t* bus_page_lookup(const bus_page_t* page, addr_t address)
+{
+	if (page->flags & BUS_PAGE_SPLIT) {
+		return page->bytes[BUS_PAGE_OFFSET(address)];
+	}
+	return page->base == NULL ? NULL : page->base + BUS_PAGE_OFFSET(address);
+}
+
+/**
+ * Auxiliary function
+ * @brief Switches a page to a byte per byte mapping, keeping its current content
+ *
+ * @param bus bus containing the page
+ * @param page page to split
+ * @return error code
+ */
+static int bus_split_page(bus_t bus, bus_page_t* page)
+{
+	if (page->flags & BUS_PAGE_SPLIT) {
+		return ERR_NONE;
+	}
+
+	uint8_t slot = 0;
+	while (slot < BUS_MAX_SPLIT_PAGES && (bus->split_used >> slot) & 1) {
+		++slot;
+	}
+	M_REQUIRE(slot < BUS_MAX_SPLIT_PAGES, ERR_MEM, "more than %d bus pages are shared between components", BUS_MAX_SPLIT_PAGES);
+
+	data_t** bytes = bus->split[slot];
+	for (size_t i = 0; i < BUS_PAGE_SIZE; ++i) {
+		bytes[i] = page->base == NULL ? NULL : page->base + i;
+	}
+	bus->split_used = (uint8_t) (bus->split_used | (1 << slot));
+	page->bytes = bytes;
+	page->split = slot;
+	page->flags |= BUS_PAGE_SPLIT;
+
+	return ERR_NONE;
+}
+
+/**
+ * Auxiliary function
+ * @brief Maps consecutive bytes to an address range, touching only the entries of the concerned pages
+ *
+ * @param bus bus to map onto
+ * @param start first address (included)
+ * @param end last address (included)
+ * @param first byte to map at start, the following ones being mapped at the following addresses (NULL to unmap)
+ * @return error code
+ */
+static int bus_map_range(bus_t bus, addr_t start, addr_t end, data_t* first)
+{
+	for (size_t index = BUS_PAGE(start); index <= BUS_PAGE(end); ++index) {
+		bus_page_t* page = &bus->pages[index];
+		const size_t page_start = index << BUS_PAGE_BITS;
+		const size_t page_end = page_start + BUS_PAGE_SIZE - 1;
+		const size_t from = start > page_start ? start : page_start;
+		const size_t to = end < page_end ? end : page_end;
+
+		if (from == page_start && to == page_end) {
+			// the whole page belongs to the same memory: a single base pointer
+			if (page->flags & BUS_PAGE_SPLIT) {
+				bus->split_used = (uint8_t) (bus->split_used & ~(1 << page->split));
+				page->flags &= (uint8_t) ~BUS_PAGE_SPLIT;
+			}
+			page->base = first == NULL ? NULL : first + (page_start - start);
+		} else {
+			M_EXIT_IF_ERR(bus_split_page(bus, page));
+			for (size_t addr = from; addr <= to; ++addr) {
+				page->bytes[addr - page_start] = first == NULL ? NULL : first + (addr - start);
+			}
+		}
+	}
+
+	return ERR_NONE;
+}
+
 // ==== see bus.h ========================================
 int bus_plug (bus_t bus, component_t* c, addr_t start, addr_t end) {
 	// check argument validity
@@ -16,7 +101,7 @@ int bus_plug (bus_t bus, component_t* c, addr_t start, addr_t end) {
 	M_REQUIRE(start <= end, ERR_ADDRESS ,"end address %u is smaller than start address %u", start, end);
 	// check whether there is any component plugged to the predefined interval
 	for (int i = start; i <= end; i++) {
-		M_REQUIRE(bus[i] == NULL, ERR_ADDRESS, "one part of memory already occupied at address %u to %u", start, end);
+		M_REQUIRE(bus_lookup(bus, (addr_t) i) == NULL, ERR_ADDRESS, "one part of memory already occupied at address %u to %u", start, end);
 	}
 	
 	// if no error occured, plug the component to the bus wo any offset
@@ -53,11 +138,7 @@ int bus_remap(bus_t bus, component_t* c, addr_t offset) {
 	M_REQUIRE(c->end + offset < c->mem->size + c->start, ERR_ADDRESS, "end - start + offset is bigger or equal than memory size %d", c->mem->size);
 
 	// map part of the memory of the component (shifted by an offset) to the corresponding bus address (memory map)
-	for (int i = 0; i < c->end - c->start + 1; i++) {
-		bus[c->start + i] = &(c->mem->memory[offset + i]);
-	}
-	
-	return ERR_NONE;
+	return bus_map_range(bus, c->start, c->end, &(c->mem->memory[offset]));
 }
 
 // ==== see bus.h ========================================
@@ -67,9 +148,7 @@ int bus_unplug(bus_t bus, component_t* c) {
 	M_REQUIRE_NON_NULL(c);
 	
 	// deconnect the component from the bus
-	for(int i = c->start; i <= c->end; ++i) {
-		bus[i] = NULL;
-	}
+	M_EXIT_IF_ERR(bus_map_range(bus, c->start, c->end, NULL));
 
 	// update the bus related fields of the component
 	// start and end being 0 indicates the disconnection
@@ -85,24 +164,75 @@ int bus_read(const bus_t bus, addr_t address, data_t* data) {
 	M_REQUIRE_NON_NULL(bus);
 	M_REQUIRE_NON_NULL(data);
 	
-	if (bus[address] == NULL) {
+	const data_t* byte = bus_page_lookup(&bus->pages[BUS_PAGE(address)], address);
+	if (byte == NULL) {
 		// if no component is pluged to this address, put 0xFF to data
 		*data = 0xFF;
 	} else {
-		*data = *bus[address];
+		*data = *byte;
+	}
+
+	return ERR_NONE;
+}
+
+
+// ==== see bus.h ========================================
+int bus_sync_register(bus_t bus, addr_t start, addr_t end, bus_hook_fn fn, void* owner) {
+	// check argument validity
+	M_REQUIRE_NON_NULL(bus);
+	M_REQUIRE_NON_NULL(fn);
+	M_REQUIRE(start <= end, ERR_ADDRESS, "start address %d is after end address %d", start, end);
+
+	for (size_t page = 0; page < BUS_NB_PAGES; ++page) {
+		bus->pages[page].flags &= (uint8_t) ~BUS_PAGE_SYNCED;
+	}
+	for (size_t page = BUS_PAGE(start); page <= BUS_PAGE(end); ++page) {
+		bus->pages[page].flags |= BUS_PAGE_SYNCED;
 	}
+	bus_hook_t sync = {start, end, fn, owner};
+	bus->sync = sync;
 
 	return ERR_NONE;
 }
 
+// ==== see bus.h ========================================
+int bus_sync_dispatch(bus_t bus, addr_t address) {
+	// most accesses go to plain memory: a single flag test
+	if (bus == NULL || bus->in_hook || !(bus->pages[BUS_PAGE(address)].flags & BUS_PAGE_SYNCED)
+	    || address < bus->sync.start || address > bus->sync.end) {
+		return ERR_NONE;
+	}
+
+	bus->in_hook = 1;
+	int err = bus->sync.fn(bus->sync.owner, address);
+	bus->in_hook = 0;
+	return err;
+}
+
+/**
+ * Auxiliary function
+ * @brief Passes a write to the divert handler
+ *
+ * @return error code (of the handler)
+ */
+static int bus_divert(bus_t bus, addr_t address, data_t data)
+{
+	const bus_divert_t* divert = &bus->divert;
+	return divert->fn == NULL ? ERR_NONE : divert->fn(divert->owner, address, data);
+}
 
 // ==== see bus.h ========================================
 int bus_write(bus_t bus, addr_t address, data_t data) {
 	// check argument validity
 	M_REQUIRE_NON_NULL(bus);
-	M_REQUIRE(bus[address] != NULL, ERR_BAD_PARAMETER, "address %d non-valide", address);
+	const bus_page_t* page = &bus->pages[BUS_PAGE(address)];
+	if (page->flags & BUS_PAGE_DIVERTED) {
+		return bus_divert(bus, address, data);
+	}
+	data_t* byte = bus_page_lookup(page, address);
+	M_REQUIRE(byte != NULL, ERR_BAD_PARAMETER, "address %d non-valide", address);
 	
-	*bus[address] = data;
+	*byte = data;
 	
 	return ERR_NONE;
 }
@@ -114,11 +244,13 @@ int bus_read16(const bus_t bus, addr_t address, addr_t* data16) {
 	M_REQUIRE_NON_NULL(data16);
 	M_REQUIRE(address != 0xFFFF, ERR_ADDRESS, "address %d can't be 0xFFFF, because there's only 8bits left read to then", address);
 	
-	if (bus[address] == NULL || bus[address+1] == NULL) {
+	const data_t* low = bus_page_lookup(&bus->pages[BUS_PAGE(address)], address);
+	const data_t* high = bus_page_lookup(&bus->pages[BUS_PAGE(address + 1)], (addr_t) (address + 1));
+	if (low == NULL || high == NULL) {
 		// if no component is pluged to this address, put 0xFF to data
 		*data16 = 0xFF;
 	} else {
-		*data16 = (*bus[address] | (*bus[address+1] << 8));
+		*data16 = (addr_t) (*low | (*high << 8));
 	}
 
 	return ERR_NONE;
@@ -128,11 +260,138 @@ int bus_read16(const bus_t bus, addr_t address, addr_t* data16) {
 int bus_write16(bus_t bus, addr_t address, addr_t data16) {
 	// check argument validity
 	M_REQUIRE_NON_NULL(bus);
-	M_REQUIRE(bus[address] != NULL, ERR_ADDRESS, "address %d non-valide", address);
-	M_REQUIRE(bus[address+1] != NULL, ERR_ADDRESS, "address %d non-valide", address);
+	const addr_t next = (addr_t) (address + 1);
+	if ((bus->pages[BUS_PAGE(address)].flags | bus->pages[BUS_PAGE(next)].flags) & BUS_PAGE_DIVERTED) {
+		// rare enough (a ROM write) to be done byte per byte
+		M_EXIT_IF_ERR(bus_write(bus, address, lsb8(data16)));
+		return bus_write(bus, next, msb8(data16));
+	}
+	data_t* low = bus_page_lookup(&bus->pages[BUS_PAGE(address)], address);
+	data_t* high = bus_page_lookup(&bus->pages[BUS_PAGE(next)], next);
+	M_REQUIRE(low != NULL, ERR_ADDRESS, "address %d non-valide", address);
+	M_REQUIRE(high != NULL, ERR_ADDRESS, "address %d non-valide", address);
 	
-	*bus[address] = lsb8(data16);
-	*bus[address+1] = msb8(data16);
+	*low = lsb8(data16);
+	*high = msb8(data16);
 	
 	return ERR_NONE;
 }
+
+// ==== see bus.h ========================================
+data_t* bus_lookup(const bus_t bus, addr_t address) {
+	return bus == NULL ? NULL : bus_page_lookup(&bus->pages[BUS_PAGE(address)], address);
+}
+
+// ==== see bus.h ========================================
+int bus_map_byte(bus_t bus, addr_t address, data_t* byte) {
+	// check argument validity
+	M_REQUIRE_NON_NULL(bus);
+
+	return bus_map_range(bus, address, address, byte);
+}
+
+// ==== see bus.h ========================================
+int bus_hook_register(bus_t bus, addr_t start, addr_t end, bus_hook_fn fn, void* owner) {
+	// check argument validity
+	M_REQUIRE_NON_NULL(bus);
+	M_REQUIRE_NON_NULL(fn);
+	M_REQUIRE(start <= end, ERR_ADDRESS, "start address %d is after end address %d", start, end);
+	M_REQUIRE(bus->nb_hooks < BUS_MAX_HOOKS, ERR_MEM, "too many write hooks (max %d)", BUS_MAX_HOOKS);
+
+	// an address has a single owner
+	for (size_t i = 0; i < bus->nb_hooks; ++i) {
+		M_REQUIRE(end < bus->hooks[i].start || start > bus->hooks[i].end, ERR_ADDRESS,
+		          "hooked range %04X-%04X overlaps %04X-%04X", start, end, bus->hooks[i].start, bus->hooks[i].end);
+	}
+
+	bus_hook_t hook = {start, end, fn, owner};
+	bus->hooks[bus->nb_hooks++] = hook;
+
+	// flag every page touched by the range
+	for (size_t page = BUS_PAGE(start); page <= BUS_PAGE(end); ++page) {
+		bus->pages[page].flags |= BUS_PAGE_HOOKED;
+	}
+
+	return ERR_NONE;
+}
+
+// ==== see bus.h ========================================
+int bus_hook_dispatch(bus_t bus, addr_t address) {
+	// most writes go to plain memory: a single flag test
+	if (bus == NULL || bus->in_hook || !(bus->pages[BUS_PAGE(address)].flags & BUS_PAGE_HOOKED)) {
+		return ERR_NONE;
+	}
+
+	for (size_t i = 0; i < bus->nb_hooks; ++i) {
+		const bus_hook_t* hook = &bus->hooks[i];
+		if (address >= hook->start && address <= hook->end) {
+			// ranges do not overlap (see bus_hook_register()): no other hook owns the address
+			bus->in_hook = 1;
+			int err = hook->fn(hook->owner, address);
+			bus->in_hook = 0;
+			return err;
+		}
+	}
+
+	return ERR_NONE;
+}
+
+/**
+ * Auxiliary function
+ * @brief Sets or clears the diverted flag of the pages of a range
+ *
+ * @return error code
+ */
+static int bus_divert_pages(bus_t bus, addr_t start, addr_t end, bit_t diverted)
+{
+	M_REQUIRE(start <= end, ERR_ADDRESS, "start address %d is after end address %d", start, end);
+	M_REQUIRE(BUS_PAGE_OFFSET(start) == 0 && BUS_PAGE_OFFSET(end) == BUS_PAGE_SIZE - 1, ERR_ADDRESS,
+	          "diverted range %04X-%04X is not made of whole pages", start, end);
+
+	for (size_t page = BUS_PAGE(start); page <= BUS_PAGE(end); ++page) {
+		if (diverted) {
+			bus->pages[page].flags |= BUS_PAGE_DIVERTED;
+		} else {
+			bus->pages[page].flags &= (uint8_t) ~BUS_PAGE_DIVERTED;
+		}
+	}
+	return ERR_NONE;
+}
+
+// ==== see bus.h ========================================
+int bus_divert_register(bus_t bus, addr_t start, addr_t end, bus_divert_fn fn, void* owner) {
+	// check argument validity
+	M_REQUIRE_NON_NULL(bus);
+	M_REQUIRE_NON_NULL(fn);
+
+	// the pages of a former handler are written to again
+	M_EXIT_IF_ERR(bus_divert_pages(bus, start, end, 1));
+	for (size_t page = 0; page < BUS_NB_PAGES; ++page) {
+		if (page < BUS_PAGE(start) || page > BUS_PAGE(end)) {
+			bus->pages[page].flags &= (uint8_t) ~BUS_PAGE_DIVERTED;
+		}
+	}
+
+	bus_divert_t divert = {fn, owner};
+	bus->divert = divert;
+
+	return ERR_NONE;
+}
+
+// ==== see bus.h ========================================
+int bus_divert_set(bus_t bus, addr_t start, addr_t end, bit_t diverted) {
+	// check argument validity
+	M_REQUIRE_NON_NULL(bus);
+	M_REQUIRE(bus->divert.fn != NULL, ERR_BAD_PARAMETER, "no divert handler registered%s", "");
+
+	return bus_divert_pages(bus, start, end, diverted);
+}
+
+// ==== see bus.h ========================================
+int bus_map_memory(bus_t bus, addr_t start, addr_t end, data_t* first) {
+	// check argument validity
+	M_REQUIRE_NON_NULL(bus);
+	M_REQUIRE(start <= end, ERR_ADDRESS, "start address %d is after end address %d", start, end);
+
+	return bus_map_range(bus, start, end, first);
+}
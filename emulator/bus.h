@@ -23,10 +23,89 @@ extern "C" {
 
 #define BUS_SIZE 65536
 
+#define BUS_PAGE_BITS  8
+#define BUS_PAGE_SIZE  (1 << BUS_PAGE_BITS)
+#define BUS_NB_PAGES   (BUS_SIZE / BUS_PAGE_SIZE)
+#define BUS_PAGE(addr) ((addr) >> BUS_PAGE_BITS)
+#define BUS_PAGE_OFFSET(addr) ((addr) & (BUS_PAGE_SIZE - 1))
+
+// Number of pages that may be shared by several components (or single bytes), see bus_page_t
+#define BUS_MAX_SPLIT_PAGES 4
+
+#define BUS_MAX_HOOKS  8
+
+/**
+ * @brief Flags of a bus page
+ */
+#define BUS_PAGE_SPLIT  0x01 // the page is mapped byte per byte
+#define BUS_PAGE_HOOKED 0x02 // at least one address of the page has a write hook
+#define BUS_PAGE_DIVERTED 0x04 // writes go to the divert handler instead of the memory (e.g. a read-only ROM)
+#define BUS_PAGE_SYNCED 0x08 // at least one address of the page has a sync hook
+
+/**
+ * @brief Bus page: 256 consecutive addresses.
+ *        A page mapped to a single component memory only keeps a base pointer, the byte of address a being base[a & 0xFF]
+ *        (NULL base: nothing plugged); a page shared by several components (BUS_PAGE_SPLIT) points to 256 byte pointers.
+ */
+typedef struct {
+	union {
+		data_t* base;
+		data_t** bytes;
+	};
+	uint8_t flags;
+	uint8_t split;
+} bus_page_t;
+
+/**
+ * @brief Write hook: callback of the component owning an MMIO range,
+ *        called synchronously after each write in that range
+ */
+typedef int (*bus_hook_fn)(void* owner, addr_t addr);
+
+/**
+ * @brief Registered write hook
+ */
+typedef struct {
+	addr_t start;
+	addr_t end;
+	bus_hook_fn fn;
+	void* owner;
+} bus_hook_t;
+
+/**
+ * @brief Divert handler: callback of the component owning a range whose memory cannot be written
+ *        (the cartridge ROM, whose writes control its mapper), called instead of storing the byte
+ */
+typedef int (*bus_divert_fn)(void* owner, addr_t addr, data_t data);
+
 /**
- * @ brief Bus Type, a table of memory pointer pointing to the various component memories
+ * @brief Registered divert handler (the pages it handles are flagged BUS_PAGE_DIVERTED)
  */
-typedef data_t* bus_t[BUS_SIZE];
+typedef struct {
+	bus_divert_fn fn;
+	void* owner;
+} bus_divert_t;
+
+/**
+ * @brief Bus content: the page table, the byte tables of the split pages,
+ *        the table of the registered write hooks, the divert handler and the sync hook
+ */
+typedef struct {
+	bus_page_t pages[BUS_NB_PAGES];
+	data_t* split[BUS_MAX_SPLIT_PAGES][BUS_PAGE_SIZE];
+	uint8_t split_used;
+	bus_hook_t hooks[BUS_MAX_HOOKS];
+	size_t nb_hooks;
+	bit_t in_hook;
+	bus_divert_t divert;
+	bus_hook_t sync;
+} bus_table_t;
+
+/**
+ * @ brief Bus Type, a page table mapping the addresses to the various component memories
+ *         (array of one element, so that a bus is passed by reference as the former table of pointers was)
+ */
+typedef bus_table_t bus_t[1];
 
 /**
  * @brief Plug a component into the bus
@@ -87,7 +166,7 @@ int bus_read(const bus_t bus, addr_t address, data_t* data);
 
 
 /**
- * @brief Write to the bus at a given address
+ * @brief Write to the bus at a given address (or pass the byte to the divert handler of the address)
  *
  * @param bus bus to write to
  * @param address address to write at
@@ -116,6 +195,119 @@ int bus_read16(const bus_t bus, addr_t address, addr_t* data16);
  */
 int bus_write16(bus_t bus, addr_t address, addr_t data16);
 
+/**
+ * @brief Gives the byte mapped at a given address
+ *
+ * @param bus bus to look into
+ * @param address address to look at
+ * @return pointer to the byte, NULL if nothing is plugged there (or if bus is NULL)
+ */
+data_t* bus_lookup(const bus_t bus, addr_t address);
+
+
+/**
+ * @brief Maps a single byte (not owned by a component, e.g. a register of the cpu) at a given address
+ *
+ * @param bus bus to map onto
+ * @param address address to map at
+ * @param byte byte to map (NULL to unmap the address)
+ * @return error code
+ */
+int bus_map_byte(bus_t bus, addr_t address, data_t* byte);
+
+
+/**
+ * @brief Registers a write hook for an address range.
+ *        Ranges may not overlap: each hooked address has a single owner.
+ *
+ * @param bus bus to register into
+ * @param start first hooked address (included)
+ * @param end last hooked address (included)
+ * @param fn callback of the owner
+ * @param owner component passed to the callback
+ * @return error code (ERR_ADDRESS if the range overlaps the one of a registered hook)
+ */
+int bus_hook_register(bus_t bus, addr_t start, addr_t end, bus_hook_fn fn, void* owner);
+
+
+/**
+ * @brief Calls the hook owning an address, if any (there is at most one, see bus_hook_register()).
+ *        Writes made by the hook itself do not trigger hooks again.
+ *
+ * @param bus bus that was written to (may be NULL: no hook)
+ * @param address address that was written
+ * @return error code (of the hook)
+ */
+int bus_hook_dispatch(bus_t bus, addr_t address);
+
+
+/**
+ * @brief Registers the sync hook of an address range: a callback of a component whose registers are
+ *        only brought up to date when needed, called before each access of the cpu to the range
+ *        (see bus_sync_dispatch()). There is a single sync hook per bus, registering again replaces it.
+ *
+ * @param bus bus to register into
+ * @param start first address (included)
+ * @param end last address (included)
+ * @param fn callback of the owner
+ * @param owner component passed to the callback
+ * @return error code
+ */
+int bus_sync_register(bus_t bus, addr_t start, addr_t end, bus_hook_fn fn, void* owner);
+
+
+/**
+ * @brief Calls the sync hook of an address, if any, before it is read or written.
+ *        Not called from within a hook.
+ *
+ * @param bus bus about to be accessed (may be NULL: no hook)
+ * @param address address about to be accessed
+ * @return error code (of the hook)
+ */
+int bus_sync_dispatch(bus_t bus, addr_t address);
+
+
+/**
+ * @brief Registers the divert handler of an address range (whole pages): the writes in the range
+ *        are passed to the handler and never reach the memory plugged there.
+ *        There is a single handler per bus, registering again replaces it (and its pages).
+ *
+ * @param bus bus to register into
+ * @param start first diverted address (included), at the start of a page
+ * @param end last diverted address (included), at the end of a page
+ * @param fn callback of the owner
+ * @param owner component passed to the callback
+ * @return error code
+ */
+int bus_divert_register(bus_t bus, addr_t start, addr_t end, bus_divert_fn fn, void* owner);
+
+
+/**
+ * @brief Diverts the writes of more pages to the registered handler, or gives them back to their memory
+ *        (e.g. a cartridge RAM that is disabled and then enabled)
+ *
+ * @param bus bus
+ * @param start first address (included), at the start of a page
+ * @param end last address (included), at the end of a page
+ * @param diverted whether the writes go to the handler
+ * @return error code (ERR_BAD_PARAMETER without any handler registered)
+ */
+int bus_divert_set(bus_t bus, addr_t start, addr_t end, bit_t diverted);
+
+
+/**
+ * @brief Maps consecutive bytes (not a whole component, e.g. one of its banks) onto an address range,
+ *        in place of whatever was mapped there. Costs one entry per page of the range.
+ *
+ * @param bus bus to map onto
+ * @param start first address (included)
+ * @param end last address (included)
+ * @param first byte mapped at start, the following ones being mapped at the following addresses
+ *        (end - start + 1 bytes are needed); NULL to unmap the range
+ * @return error code
+ */
+int bus_map_memory(bus_t bus, addr_t start, addr_t end, data_t* first);
+
 #ifdef __cplusplus
 }
 #endif
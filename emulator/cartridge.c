@@ -6,12 +6,507 @@
  * @date 2020
  */
 
+#define _XOPEN_SOURCE 700 // fstat, mmap, pread
+#define _DEFAULT_SOURCE    // flock
+
 #ifdef __cplusplus
 extern "C" {
 #endif
 
+#include <stdio.h>  // snprintf
+#include <stdlib.h>
+#include <string.h> // memcpy
+#include <fcntl.h>
+#include <pthread.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
 #include "cartridge.h"
 
+/**
+ * @brief ROM file mapped in memory. The mappings are kept in a process-wide list
+ *        (gameboys may be created by several threads at once), each of them
+ *        as long as a cartridge uses it.
+ */
+struct cartridge_rom {
+    dev_t dev;        // the file is identified by its inode...
+    ino_t ino;
+    off_t size;       // ...as long as it is not modified
+    time_t mtime;
+    data_t* data;     // read-only mapping of the whole file
+    size_t users;
+    cartridge_rom_t* next;
+};
+
+static cartridge_rom_t* rom_cache = NULL;
+static pthread_mutex_t rom_cache_lock = PTHREAD_MUTEX_INITIALIZER;
+
+/**
+ * Auxiliary function
+ * @brief Gives the mapping of a ROM file, mapping it if no other cartridge did
+ *
+ * @param filename ROM file
+ * @param rom (modified) mapping of the file, NULL when it cannot be mapped (not a regular file,
+ *        smaller than the two banks or mmap failure): the file is then to be read into a copy
+ * @return error code
+ */
+static int cartridge_rom_acquire(const char* filename, cartridge_rom_t** rom)
+{
+    *rom = NULL;
+    const int fd = open(filename, O_RDONLY);
+    M_REQUIRE(fd >= 0, ERR_IO, "cannot open %s", filename);
+
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode) || st.st_size < BANK_ROM_SIZE) {
+        close(fd);
+        return ERR_NONE;
+    }
+
+    int err = ERR_NONE;
+    pthread_mutex_lock(&rom_cache_lock);
+    for (cartridge_rom_t* r = rom_cache; r != NULL && *rom == NULL; r = r->next) {
+        if (r->dev == st.st_dev && r->ino == st.st_ino && r->size == st.st_size && r->mtime == st.st_mtime) {
+            ++r->users;
+            *rom = r;
+        }
+    }
+
+    if (*rom == NULL) {
+        data_t* data = mmap(NULL, (size_t) st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+        if (data != MAP_FAILED) {
+            cartridge_rom_t* r = calloc(1, sizeof(cartridge_rom_t));
+            if (r == NULL) {
+                munmap(data, (size_t) st.st_size);
+                err = ERR_MEM;
+            } else {
+                r->dev = st.st_dev;
+                r->ino = st.st_ino;
+                r->size = st.st_size;
+                r->mtime = st.st_mtime;
+                r->data = data;
+                r->users = 1;
+                r->next = rom_cache;
+                rom_cache = r;
+                *rom = r;
+            }
+        }
+    }
+    pthread_mutex_unlock(&rom_cache_lock);
+
+    close(fd);
+    return err;
+}
+
+/**
+ * Auxiliary function
+ * @brief Stops using a mapping, unmapping it when no other cartridge uses it
+ */
+static void cartridge_rom_release(cartridge_rom_t* rom)
+{
+    pthread_mutex_lock(&rom_cache_lock);
+    if (--rom->users == 0) {
+        cartridge_rom_t** link = &rom_cache;
+        while (*link != rom) link = &(*link)->next;
+        *link = rom->next;
+        munmap(rom->data, (size_t) rom->size);
+        free(rom);
+    }
+    pthread_mutex_unlock(&rom_cache_lock);
+}
+
+/**
+ * @brief Cartridge types supported (header byte at CARTRIDGE_TYPE_ADDR)
+ */
+static const struct {
+    data_t type;
+    mbc_t mbc;
+    bit_t ram;
+    bit_t battery;
+    bit_t rtc;
+    bit_t rumble;
+} cartridge_types[] = {
+    { 0x00, MBC_NONE, 0, 0, 0, 0 }, // ROM only
+    { 0x01, MBC1,     0, 0, 0, 0 },
+    { 0x02, MBC1,     1, 0, 0, 0 },
+    { 0x03, MBC1,     1, 1, 0, 0 },
+    { 0x08, MBC_NONE, 1, 0, 0, 0 }, // ROM + RAM
+    { 0x09, MBC_NONE, 1, 1, 0, 0 },
+    { 0x0F, MBC3,     0, 1, 1, 0 },
+    { 0x10, MBC3,     1, 1, 1, 0 },
+    { 0x11, MBC3,     0, 0, 0, 0 },
+    { 0x12, MBC3,     1, 0, 0, 0 },
+    { 0x13, MBC3,     1, 1, 0, 0 },
+    { 0x19, MBC5,     0, 0, 0, 0 },
+    { 0x1A, MBC5,     1, 0, 0, 0 },
+    { 0x1B, MBC5,     1, 1, 0, 0 },
+    { 0x1C, MBC5,     0, 0, 0, 1 },
+    { 0x1D, MBC5,     1, 0, 0, 1 },
+    { 0x1E, MBC5,     1, 1, 0, 1 },
+};
+#define NB_CARTRIDGE_TYPES (sizeof(cartridge_types) / sizeof(cartridge_types[0]))
+
+// RAM sizes, indexed by the header byte at CARTRIDGE_RAM_SIZE_ADDR
+static const size_t cartridge_ram_sizes[] = { 0, 0x800, 0x2000, 0x8000, 0x20000, 0x10000 };
+#define NB_CARTRIDGE_RAM_SIZES (sizeof(cartridge_ram_sizes) / sizeof(cartridge_ram_sizes[0]))
+
+// the ROM is 32 KiB << (header byte at CARTRIDGE_ROM_SIZE_ADDR)
+#define CARTRIDGE_ROM_SIZE_MAX_CODE 8
+
+// bank controller registers, selected by the bits 13-14 of the address written
+#define MBC_REG(addr)     (((addr) >> 13) & 0x3)
+#define MBC_RAM_ENABLE    0
+#define MBC_ROM_BANK      1
+#define MBC_RAM_BANK      2
+#define MBC_MODE          3
+#define MBC_RAM_ENABLED   0x0A
+#define MBC5_ROM_BANK_MSB 0x3000 // MBC5 writes the 9th bit of the ROM bank from here on
+
+// RTC registers, selected as RAM banks (S, M, H, DL, DH)
+#define RTC_REG_FIRST     0x08
+#define RTC_REG_LAST      0x0C
+#define RTC_NB_REGS       (RTC_REG_LAST - RTC_REG_FIRST + 1)
+#define RTC_DH_DAY_MSB    0x01
+#define RTC_DH_HALT       0x40
+#define RTC_DH_CARRY      0x80
+#define RTC_NB_DAYS       512
+#define SECONDS_PER_DAY   86400
+// cycles per second of the clock given to cartridge_connect() (GB_CYCLES_PER_S)
+#define RTC_CYCLES_PER_S  (((uint64_t) 1) << 20)
+
+/**
+ * Auxiliary function
+ * @brief Finds the description of a cartridge type
+ *
+ * @return index in cartridge_types, NB_CARTRIDGE_TYPES when the type is not supported
+ */
+static size_t cartridge_find_type(data_t type)
+{
+    size_t i = 0;
+    while (i < NB_CARTRIDGE_TYPES && cartridge_types[i].type != type) ++i;
+    return i;
+}
+
+/**
+ * Auxiliary function
+ * @brief Checks that the cartridge type of a loaded content is supported
+ *
+ * @param c component holding the cartridge content
+ * @return error code
+ */
+static int cartridge_check_type(const component_t* c)
+{
+    const data_t type = c->mem->memory[CARTRIDGE_TYPE_ADDR];
+    M_REQUIRE(cartridge_find_type(type) < NB_CARTRIDGE_TYPES, ERR_NOT_IMPLEMENTED,
+              "cartridge type read at address 0x147 is 0x%02X, which is not supported", type);
+    return ERR_NONE;
+}
+
+/**
+ * Auxiliary function
+ * @brief Reads the bank controller, the ROM banks and the RAM of a cartridge from its header
+ *        and starts its registers as at power on
+ *
+ * @return error code
+ */
+static int cartridge_read_header(cartridge_t* ct)
+{
+    M_EXIT_IF_ERR(cartridge_check_type(&ct->c));
+    const data_t* header = ct->c.mem->memory;
+    const size_t t = cartridge_find_type(header[CARTRIDGE_TYPE_ADDR]);
+    ct->mbc = cartridge_types[t].mbc;
+    ct->has_battery = cartridge_types[t].battery;
+    ct->has_rtc = cartridge_types[t].rtc;
+    ct->has_rumble = cartridge_types[t].rumble;
+
+    // banks beyond the size given by the header are the first ones again (unconnected address lines)
+    ct->nb_rom_banks = ct->c.mem->size / BANK_ROM0_SIZE;
+    const data_t rom_code = header[CARTRIDGE_ROM_SIZE_ADDR];
+    if (rom_code <= CARTRIDGE_ROM_SIZE_MAX_CODE && ((size_t) 2 << rom_code) < ct->nb_rom_banks) {
+        ct->nb_rom_banks = (size_t) 2 << rom_code;
+    }
+
+    ct->ram_size = 0;
+    if (cartridge_types[t].ram) {
+        const data_t ram_code = header[CARTRIDGE_RAM_SIZE_ADDR];
+        M_REQUIRE(ram_code < NB_CARTRIDGE_RAM_SIZES, ERR_NOT_IMPLEMENTED, "RAM size code 0x%02X is not supported", ram_code);
+        ct->ram_size = cartridge_ram_sizes[ram_code];
+    }
+
+    memset(&ct->regs, 0, sizeof(ct->regs));
+    ct->bus = NULL;
+    ct->cpu = NULL;
+    ct->ram = NULL;
+    ct->clock = NULL;
+    ct->ram_mapped = NULL;
+    ct->save = NULL;
+    ct->save_size = 0;
+    ct->save_fd = -1;
+    return ERR_NONE;
+}
+
+/**
+ * Auxiliary function
+ * @brief Current cycle of the clock of the RTC
+ */
+static uint64_t rtc_now(const cartridge_t* ct)
+{
+    return ct->clock == NULL ? 0 : *ct->clock;
+}
+
+/**
+ * Auxiliary function
+ * @brief Brings the seconds counted by the RTC up to date
+ */
+static void rtc_update(cartridge_t* ct)
+{
+    rtc_t* rtc = &ct->regs.rtc;
+    const uint64_t now = rtc_now(ct);
+    if (rtc->halted || now < rtc->cycle) {
+        rtc->cycle = now;
+        return;
+    }
+
+    const uint64_t elapsed = (now - rtc->cycle) / RTC_CYCLES_PER_S;
+    rtc->seconds += elapsed;
+    rtc->cycle += elapsed * RTC_CYCLES_PER_S;
+    if (rtc->seconds >= RTC_NB_DAYS * SECONDS_PER_DAY) {
+        rtc->day_carry = 1;
+        rtc->seconds %= RTC_NB_DAYS * SECONDS_PER_DAY;
+    }
+}
+
+/**
+ * Auxiliary function
+ * @brief Splits the seconds counted by the RTC into its registers
+ */
+static void rtc_registers(const rtc_t* rtc, uint8_t regs[RTC_NB_REGS])
+{
+    const uint64_t days = rtc->seconds / SECONDS_PER_DAY;
+    regs[0] = (uint8_t) (rtc->seconds % 60);
+    regs[1] = (uint8_t) (rtc->seconds / 60 % 60);
+    regs[2] = (uint8_t) (rtc->seconds / 3600 % 24);
+    regs[3] = (uint8_t) (days & 0xFF);
+    regs[4] = (uint8_t) (((days >> 8) & RTC_DH_DAY_MSB) | (rtc->halted ? RTC_DH_HALT : 0) | (rtc->day_carry ? RTC_DH_CARRY : 0));
+}
+
+/**
+ * Auxiliary function
+ * @brief Shows the latched RTC register selected at every address of the RAM
+ */
+static void rtc_refresh_view(cartridge_t* ct)
+{
+    memset(ct->rtc_view, ct->regs.rtc.latched[ct->regs.ram_bank - RTC_REG_FIRST], sizeof(ct->rtc_view));
+}
+
+/**
+ * Auxiliary function
+ * @brief Writes the RTC register selected
+ */
+static void rtc_write(cartridge_t* ct, data_t data)
+{
+    rtc_t* rtc = &ct->regs.rtc;
+    rtc_update(ct);
+    uint8_t regs[RTC_NB_REGS];
+    rtc_registers(rtc, regs);
+
+    const size_t reg = ct->regs.ram_bank - RTC_REG_FIRST;
+    regs[reg] = data;
+    // writing the seconds starts a new second
+    if (reg == 0) rtc->cycle = rtc_now(ct);
+
+    const uint64_t days = regs[3] | ((uint64_t) (regs[4] & RTC_DH_DAY_MSB) << 8);
+    rtc->seconds = ((days * 24 + regs[2] % 24) * 60 + regs[1] % 60) * 60 + regs[0] % 60;
+    rtc->halted = (regs[4] & RTC_DH_HALT) != 0;
+    rtc->day_carry = (regs[4] & RTC_DH_CARRY) != 0;
+
+    rtc->latched[reg] = data;
+    rtc_refresh_view(ct);
+}
+
+/**
+ * Auxiliary function
+ * @brief Maps a ROM bank at 0x0000 (window 0) or 0x4000 (window 1)
+ *
+ * @param force whether to map it even if it is the bank already mapped
+ * @return error code
+ */
+static int cartridge_map_rom(cartridge_t* ct, size_t window, size_t bank, bit_t force)
+{
+    bank %= ct->nb_rom_banks;
+    if (bank == ct->mapped[window] && !force) {
+        return ERR_NONE;
+    }
+
+    const addr_t start = window == 0 ? BANK_ROM0_START : BANK_ROM1_START;
+    M_EXIT_IF_ERR(bus_map_memory(ct->bus, start, (addr_t) (start + BANK_ROM0_SIZE - 1), ct->c.mem->memory + bank * BANK_ROM0_SIZE));
+    ct->mapped[window] = bank;
+    if (ct->cpu != NULL) {
+        M_EXIT_IF_ERR(cpu_decode_cache_map(ct->cpu, start, bank));
+    }
+    return ERR_NONE;
+}
+
+/**
+ * Auxiliary function
+ * @brief Maps the RAM bank selected, or the RTC register selected, or nothing when the RAM is disabled
+ *        (the writes are then diverted to the cartridge)
+ *
+ * @param force whether to map it even if it is already mapped
+ * @return error code
+ */
+static int cartridge_map_ram(cartridge_t* ct, bit_t force)
+{
+    // without a bank controller, the RAM is always there
+    if (ct->ram == NULL || ct->mbc == MBC_NONE) {
+        return ERR_NONE;
+    }
+
+    const mbc_regs_t* r = &ct->regs;
+    data_t* target = NULL;
+    if (r->ram_enabled) {
+        if (ct->mbc == MBC3 && r->ram_bank >= RTC_REG_FIRST) {
+            if (ct->has_rtc && r->ram_bank <= RTC_REG_LAST) {
+                target = ct->rtc_view;
+                rtc_refresh_view(ct);
+            }
+        } else if (ct->ram_size > 0) {
+            size_t bank = r->ram_bank;
+            if (ct->mbc == MBC1 && !r->mode) bank = 0;
+            // the 4th bit drives the motor of a rumble cartridge
+            if (ct->mbc == MBC5 && ct->has_rumble) bank &= 0x07;
+            const size_t nb_banks = ct->ram_size > BANK_RAM_SIZE ? ct->ram_size / BANK_RAM_SIZE : 1;
+            target = ct->ram->mem->memory + (bank % nb_banks) * BANK_RAM_SIZE;
+        }
+    }
+    if (target == ct->ram_mapped && !force) {
+        return ERR_NONE;
+    }
+
+    if (target == ct->rtc_view) {
+        // the same register at every address
+        for (size_t page = BANK_RAM_START; page < BANK_RAM_END; page += BUS_PAGE_SIZE) {
+            M_EXIT_IF_ERR(bus_map_memory(ct->bus, (addr_t) page, (addr_t) (page + BUS_PAGE_SIZE - 1), ct->rtc_view));
+        }
+    } else {
+        M_EXIT_IF_ERR(bus_map_memory(ct->bus, BANK_RAM_START, BANK_RAM_END, target));
+    }
+    M_EXIT_IF_ERR(bus_divert_set(ct->bus, BANK_RAM_START, BANK_RAM_END, target == NULL || target == ct->rtc_view));
+    ct->ram_mapped = target;
+    return ERR_NONE;
+}
+
+/**
+ * Auxiliary function
+ * @brief Maps the banks selected by the registers of the bank controller,
+ *        only touching the windows whose bank changed (unless forced)
+ *
+ * @return error code
+ */
+static int cartridge_map(cartridge_t* ct, bit_t force)
+{
+    const mbc_regs_t* r = &ct->regs;
+    size_t low = 0;
+    size_t high = 1;
+    switch (ct->mbc) {
+    case MBC1: {
+        // bank 0 of the 5 lower bits is bank 1 (and 0x20 is 0x21...)
+        const size_t upper = (size_t) r->ram_bank << 5;
+        low = r->mode ? upper : 0;
+        high = upper | (r->rom_bank == 0 ? 1 : r->rom_bank);
+    } break;
+
+    case MBC3:
+        high = r->rom_bank == 0 ? 1 : r->rom_bank;
+        break;
+
+    case MBC5:
+        high = r->rom_bank;
+        break;
+
+    default:
+        break;
+    }
+
+    M_EXIT_IF_ERR(cartridge_map_rom(ct, 0, low, force));
+    M_EXIT_IF_ERR(cartridge_map_rom(ct, 1, high, force));
+    return cartridge_map_ram(ct, force);
+}
+
+/**
+ * Auxiliary function
+ * @brief Divert handler of the ROM addresses (see bus_divert_register()), and of the RAM ones while
+ *        no RAM is mapped there: the writes set the registers of the bank controller
+ *        (they are ignored by a cartridge without any)
+ */
+static int cartridge_write(void* owner, addr_t addr, data_t data)
+{
+    cartridge_t* ct = owner;
+    mbc_regs_t* r = &ct->regs;
+
+    if (addr >= BANK_RAM_START && addr <= BANK_RAM_END) {
+        // RAM disabled, unless the RTC is selected
+        if (ct->ram_mapped == ct->rtc_view) rtc_write(ct, data);
+        return ERR_NONE;
+    }
+
+    switch (ct->mbc) {
+    case MBC1:
+    case MBC3:
+        switch (MBC_REG(addr)) {
+        case MBC_RAM_ENABLE:
+            r->ram_enabled = (data & 0x0F) == MBC_RAM_ENABLED;
+            break;
+        case MBC_ROM_BANK:
+            r->rom_bank = (uint16_t) (data & (ct->mbc == MBC1 ? 0x1F : 0x7F));
+            break;
+        case MBC_RAM_BANK:
+            r->ram_bank = ct->mbc == MBC1 ? (data & 0x03) : data;
+            break;
+        default:
+            if (ct->mbc == MBC1) {
+                r->mode = data & 0x01;
+            } else {
+                // the clock is latched by writing 0 then 1
+                if (r->latch == 0 && data == 1) {
+                    rtc_update(ct);
+                    rtc_registers(&r->rtc, r->rtc.latched);
+                    if (ct->ram_mapped == ct->rtc_view) rtc_refresh_view(ct);
+                }
+                r->latch = data;
+            }
+            break;
+        }
+        break;
+
+    case MBC5:
+        switch (MBC_REG(addr)) {
+        case MBC_RAM_ENABLE:
+            r->ram_enabled = data == MBC_RAM_ENABLED;
+            break;
+        case MBC_ROM_BANK:
+            if (addr < MBC5_ROM_BANK_MSB) {
+                r->rom_bank = (uint16_t) ((r->rom_bank & 0x100) | data);
+            } else {
+                r->rom_bank = (uint16_t) ((r->rom_bank & 0xFF) | ((data & 0x01) << 8));
+            }
+            break;
+        case MBC_RAM_BANK:
+            r->ram_bank = data & 0x0F;
+            break;
+        default:
+            break;
+        }
+        break;
+
+    default:
+        return ERR_NONE;
+    }
+
+    return cartridge_map(ct, 0);
+}
+
 // ==== see cartridge.h ========================================
 int cartridge_init_from_file(component_t* c, const char* filename) {
     // check arguments validity
@@ -28,10 +523,11 @@ int cartridge_init_from_file(component_t* c, const char* filename) {
     size_t amount_bytes = fread(c->mem->memory, c->mem->size, sizeof(data_t), input);
 	M_REQUIRE(amount_bytes > 0, ERR_IO, "the amount of bytes read should be strictly positive, but was %i", amount_bytes);
 	M_REQUIRE(amount_bytes <= c->mem->size, ERR_IO, "the amount of bytes read should be <= than bank_ROM_size(%i), but was %i", c->mem->size, amount_bytes);
-    M_REQUIRE(c->mem->memory[147] == 0, ERR_NOT_IMPLEMENTED, "cartridge type read at address 0x147 is %i, but only 0 is accepted ", i);
 
     fclose(input);
 
+    M_EXIT_IF_ERR(cartridge_check_type(c));
+
     return ERR_NONE;
 }
 
@@ -41,13 +537,48 @@ int cartridge_init(cartridge_t* ct, const char* filename) {
     M_REQUIRE_NON_NULL(ct);
     M_REQUIRE_NON_NULL(filename);
 
-    // create the component and
-    // initialize its memory field with its content loaded from a file
     component_t* bank_ROM = &ct->c;
-	M_EXIT_IF_ERR(component_create(bank_ROM, BANK_ROM_SIZE));
-    M_EXIT_IF_ERR(cartridge_init_from_file(bank_ROM, filename));
+    M_EXIT_IF_ERR(cartridge_rom_acquire(filename, &ct->rom));
+    if (ct->rom == NULL) {
+        // create the component and
+        // initialize its memory field with its content loaded from a file
+        M_EXIT_IF_ERR(component_create(bank_ROM, BANK_ROM_SIZE));
+        M_EXIT_IF_ERR(cartridge_init_from_file(bank_ROM, filename));
+        return cartridge_read_header(ct);
+    }
 
-    return ERR_NONE;
+    // the component borrows the memory of the mapping
+    M_EXIT_IF_ERR(component_create(bank_ROM, 0));
+    bank_ROM->mem = calloc(1, sizeof(memory_t));
+    if (bank_ROM->mem == NULL) {
+        cartridge_free(ct);
+        return ERR_MEM;
+    }
+    bank_ROM->mem->memory = ct->rom->data;
+    bank_ROM->mem->size = (size_t) ct->rom->size;
+
+    const int err = cartridge_read_header(ct);
+    if (err != ERR_NONE) {
+        cartridge_free(ct);
+    }
+    return err;
+}
+
+// ==== see cartridge.h ========================================
+int cartridge_init_from_memory(cartridge_t* ct, const data_t* rom, size_t size) {
+    // check arguments validity
+    M_REQUIRE_NON_NULL(ct);
+    M_REQUIRE_NON_NULL(rom);
+    M_REQUIRE(size > 0, ERR_BAD_PARAMETER, "the ROM size should be strictly positive, but was %zu", size);
+
+    // whole banks, at least the two that are mapped at once
+    ct->rom = NULL;
+    component_t* bank_ROM = &ct->c;
+    const size_t banks_size = (size + BANK_ROM0_SIZE - 1) / BANK_ROM0_SIZE * BANK_ROM0_SIZE;
+    M_EXIT_IF_ERR(component_create(bank_ROM, banks_size > BANK_ROM_SIZE ? banks_size : BANK_ROM_SIZE));
+    memcpy(bank_ROM->mem->memory, rom, size);
+
+    return cartridge_read_header(ct);
 }
 
 // ==== see cartridge.h ========================================
@@ -57,15 +588,184 @@ int cartridge_plug(cartridge_t* ct, bus_t bus) {
 
     // force the bus plug (bootrom is present at the lower address space)
     M_EXIT_IF_ERR(bus_forced_plug(bus, &(ct->c), BANK_ROM0_START, BANK_ROM1_END, 0));
+    // the ROM cannot be written (it may be shared with other cartridges): the writes go to the bank controller
+    M_EXIT_IF_ERR(bus_divert_register(bus, BANK_ROM0_START, BANK_ROM1_END, cartridge_write, ct));
+
+    // then the banks its registers select
+    ct->bus = bus;
+    return cartridge_map(ct, 1);
+}
 
+// ==== see cartridge.h ========================================
+int cartridge_connect(cartridge_t* ct, cpu_t* cpu, component_t* ram, const uint64_t* clock) {
+    // check arguments validity
+    M_REQUIRE_NON_NULL(ct);
+    M_REQUIRE(ram == NULL || (ram->mem != NULL && ram->mem->size >= ct->ram_size && ram->mem->size >= BANK_RAM_SIZE),
+              ERR_BAD_PARAMETER, "the RAM component is smaller than the %zu bytes of the cartridge", ct->ram_size);
+
+    ct->cpu = cpu;
+    ct->ram = ram;
+    ct->clock = clock;
+    ct->regs.rtc.cycle = rtc_now(ct);
     return ERR_NONE;
 }
 
+// ==== see cartridge.h ========================================
+size_t cartridge_ram_size(const cartridge_t* ct) {
+    return ct == NULL ? 0 : ct->ram_size;
+}
+
+/**
+ * Auxiliary function
+ * @brief Maps the save file of a battery-backed RAM, creating or extending it as needed.
+ *        The file is locked as long as it is mapped: when another gameboy (of this process or
+ *        of another one) already maps it, nothing is mapped and the file is only opened,
+ *        for its content to be read into a private RAM.
+ *
+ * @param filename ROM file
+ * @param size size of the RAM
+ * @param save (modified) shared mapping of size bytes of the save file, NULL if it is locked by another gameboy
+ * @param fd (modified) file descriptor of the save file, holding its lock while it is mapped
+ * @return error code
+ */
+static int cartridge_save_map(const char* filename, size_t size, data_t** save, int* fd)
+{
+    // the extension of the ROM file (if any) is replaced
+    const char* dir = strrchr(filename, '/');
+    const char* ext = strrchr(dir == NULL ? filename : dir, '.');
+    const size_t base = ext == NULL ? strlen(filename) : (size_t) (ext - filename);
+    char path[FILENAME_MAX];
+    M_REQUIRE(base + sizeof(CARTRIDGE_SAVE_EXT) <= sizeof(path), ERR_BAD_PARAMETER, "file name too long: %s", filename);
+    snprintf(path, sizeof(path), "%.*s%s", (int) base, filename, CARTRIDGE_SAVE_EXT);
+
+    *save = NULL;
+    *fd = open(path, O_RDWR | O_CREAT, 0644);
+    M_REQUIRE(*fd >= 0, ERR_IO, "cannot open %s", path);
+
+    // two writable mappings of the same file would overwrite each other's saves
+    int err = ERR_NONE;
+    if (flock(*fd, LOCK_EX | LOCK_NB) != 0) {
+        if (errno == EWOULDBLOCK) {
+            return ERR_NONE;
+        }
+        err = ERR_IO;
+    }
+
+    // a new (or shorter) file reads as zeros; a longer one is left as it is
+    struct stat st;
+    if (err == ERR_NONE && (fstat(*fd, &st) != 0 || !S_ISREG(st.st_mode))) {
+        err = ERR_IO;
+    }
+    if (err == ERR_NONE && st.st_size < (off_t) size && ftruncate(*fd, (off_t) size) != 0) {
+        err = ERR_IO;
+    }
+    if (err == ERR_NONE) {
+        *save = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, *fd, 0);
+        if (*save == MAP_FAILED) {
+            *save = NULL;
+            err = ERR_IO;
+        }
+    }
+    if (err != ERR_NONE) {
+        // also releases the lock
+        close(*fd);
+        *fd = -1;
+    }
+    M_REQUIRE(err == ERR_NONE, err, "cannot map %s", path);
+    return ERR_NONE;
+}
+
+// ==== see cartridge.h ========================================
+size_t cartridge_ram_alloc_size(const cartridge_t* ct, const char* filename) {
+    if (ct == NULL || (ct->has_battery && ct->ram_size > 0 && filename != NULL)) {
+        return 0;
+    }
+    // whole banks, even for a RAM of 2 KiB
+    return ct->ram_size > BANK_RAM_SIZE ? ct->ram_size : BANK_RAM_SIZE;
+}
+
+// ==== see cartridge.h ========================================
+int cartridge_ram_create(cartridge_t* ct, component_t* ram, const char* filename, mem_arena_t* arena) {
+    // check arguments validity
+    M_REQUIRE_NON_NULL(ct);
+    M_REQUIRE_NON_NULL(ram);
+
+    const size_t size = ct->ram_size > BANK_RAM_SIZE ? ct->ram_size : BANK_RAM_SIZE;
+    if (cartridge_ram_alloc_size(ct, filename) > 0) {
+        return component_create_in(ram, arena, size);
+    }
+
+    int fd = -1;
+    M_EXIT_IF_ERR(cartridge_save_map(filename, size, &ct->save, &fd));
+    if (ct->save == NULL) {
+        // the save file is in use by another gameboy: this one plays on a private copy of it
+        // (in the heap, the arena has no room for it), never written back
+        int err = component_create(ram, size);
+        if (err == ERR_NONE && pread(fd, ram->mem->memory, size, 0) < 0) {
+            component_free(ram);
+            err = ERR_IO;
+        }
+        close(fd);
+        return err;
+    }
+
+    // the component borrows the memory of the mapping
+    int err = component_create(ram, 0);
+    if (err == ERR_NONE && (ram->mem = calloc(1, sizeof(memory_t))) == NULL) {
+        err = ERR_MEM;
+    }
+    if (err != ERR_NONE) {
+        munmap(ct->save, size);
+        ct->save = NULL;
+        close(fd);
+        return err;
+    }
+    ct->save_size = size;
+    ct->save_fd = fd;
+    ram->mem->memory = ct->save;
+    ram->mem->size = size;
+    return ERR_NONE;
+}
+
+// ==== see cartridge.h ========================================
+void cartridge_ram_sync(cartridge_t* ct, bit_t wait) {
+    if (ct != NULL && ct->save != NULL) {
+        msync(ct->save, ct->save_size, wait ? MS_SYNC : MS_ASYNC);
+    }
+}
+
+// ==== see cartridge.h ========================================
+void cartridge_ram_free(cartridge_t* ct, component_t* ram) {
+    if (ct == NULL || ram == NULL) {
+        return;
+    }
+    if (ct->save != NULL && ram->mem != NULL && ram->mem->memory == ct->save) {
+        cartridge_ram_sync(ct, 1);
+        munmap(ct->save, ct->save_size);
+        // lets another gameboy map the save file
+        close(ct->save_fd);
+        ct->save = NULL;
+        ct->save_size = 0;
+        ct->save_fd = -1;
+        ram->mem->memory = NULL;
+        ram->mem->size = 0;
+    }
+    component_free(ram);
+}
+
 // ==== see cartridge.h ========================================
 void cartridge_free(cartridge_t* ct) {
     // check arguments validity
     if (ct != NULL) {
-        component_free(&(ct->c));
+        if (ct->rom != NULL) {
+            // only the memory structure belongs to the component
+            free(ct->c.mem);
+            ct->c.mem = NULL;
+            cartridge_rom_release(ct->rom);
+            ct->rom = NULL;
+        } else {
+            component_free(&(ct->c));
+        }
     }
 }
 
@@ -12,6 +12,7 @@
 
 #include "component.h"
 #include "bus.h"
+#include "cpu.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -27,17 +28,91 @@ extern "C" {
 
 #define BANK_ROM_SIZE    (BANK_ROM0_SIZE + BANK_ROM1_SIZE)
 
+// external RAM of the cartridge, when it has one (8 KiB banks)
+#define BANK_RAM_START   0xA000
+#define BANK_RAM_END     0xBFFF
+#define BANK_RAM_SIZE    ((BANK_RAM_END - BANK_RAM_START) + 1)
+
+// the largest RAM of a cartridge (MBC5)
+#define CARTRIDGE_RAM_MAX_SIZE 0x20000
+
+#define CARTRIDGE_ENTRY_POINT      0x0100
 #define CARTRIDGE_GAME_TITLE_START 0x0134
 #define CARTRIDGE_GAME_TITLE_END   0x0143
 #define CARTRIDGE_TYPE_ADDR        0x0147
+#define CARTRIDGE_ROM_SIZE_ADDR    0x0148
+#define CARTRIDGE_RAM_SIZE_ADDR    0x0149
+
+/**
+ * @brief Memory bank controllers supported
+ */
+typedef enum {
+    MBC_NONE, MBC1, MBC3, MBC5
+} mbc_t;
+
+/**
+ * @brief Real time clock of a MBC3: the time it counts, in seconds, and its latched registers.
+ *        It counts the emulated time (the cycles of the gameboy), so that runs stay reproducible.
+ */
+typedef struct {
+    uint64_t seconds;     // since day 0, at cycle
+    uint64_t cycle;       // cycle at which seconds was up to date
+    bit_t halted;
+    bit_t day_carry;      // the day counter went over 511 days
+    uint8_t latched[5];   // S, M, H, DL, DH as of the last latch
+} rtc_t;
+
+/**
+ * @brief Registers of a memory bank controller (written through the ROM addresses)
+ */
+typedef struct {
+    bit_t ram_enabled;
+    uint16_t rom_bank;    // MBC1: 5 bits, MBC3: 7 bits, MBC5: 9 bits
+    uint8_t ram_bank;     // MBC1: 2 bits (also the upper ROM bank bits), MBC3: RAM bank or RTC register, MBC5: 4 bits
+    bit_t mode;           // MBC1 banking mode (1: ram_bank applies to the RAM and to the ROM at 0x0000)
+    uint8_t latch;        // MBC3: last byte written to 0x6000-0x7FFF, the clock is latched by 0 then 1
+    rtc_t rtc;
+} mbc_regs_t;
+
+/**
+ * @brief ROM file mapped read-only in memory, shared by all the cartridges loaded from it (see cartridge.c)
+ */
+typedef struct cartridge_rom cartridge_rom_t;
 
 /**
  * @brief Cartridge type
  */
 typedef struct {
     component_t c;
+    cartridge_rom_t* rom; // mapping c borrows its memory from, NULL when c owns a copy of the ROM
+
+    // read from the header
+    mbc_t mbc;
+    bit_t has_rtc;
+    bit_t has_battery;
+    bit_t has_rumble;
+    size_t nb_rom_banks;  // of BANK_ROM0_SIZE bytes
+    size_t ram_size;      // 0: no RAM
+
+    // set by cartridge_plug() and cartridge_connect()
+    mbc_regs_t regs;
+    bus_table_t* bus;
+    cpu_t* cpu;
+    component_t* ram;
+    const uint64_t* clock;
+    size_t mapped[2];     // ROM banks currently mapped at 0x0000 and 0x4000
+    data_t* ram_mapped;   // what is mapped at BANK_RAM_START (NULL: nothing)
+    data_t rtc_view[BUS_PAGE_SIZE]; // register of the RTC selected, mapped on every page of the RAM
+
+    // set by cartridge_ram_create()
+    data_t* save;         // shared mapping of the save file the RAM borrows its memory from, NULL if none
+    size_t save_size;
+    int save_fd;          // descriptor of the save file, holding its lock as long as it is mapped (-1: none)
 } cartridge_t;
 
+// extension of the save file of a battery-backed RAM, in place of the one of the ROM file
+#define CARTRIDGE_SAVE_EXT ".sav"
+
 /**
  * @brief Reads a file into the memory of a component
  *
@@ -49,7 +124,10 @@ int cartridge_init_from_file(component_t* c, const char* filename);
 
 
 /**
- * @brief Initiates a cartridge given a filename
+ * @brief Initiates a cartridge given a filename.
+ *        The file is mapped read-only once per process and shared by all the cartridges loaded from it
+ *        (the same file being recognized by its inode, whatever the path used); a file that cannot be
+ *        mapped, or smaller than the two banks, is read into a copy of its own.
  *
  * @param ct cartridge to initiate
  * @param filename file to read from
@@ -57,9 +135,22 @@ int cartridge_init_from_file(component_t* c, const char* filename);
  */
 int cartridge_init(cartridge_t* ct, const char* filename);
 
+/**
+ * @brief Initiates a cartridge from a ROM image already in memory (copied, the buffer can be freed afterwards)
+ *
+ * @param ct cartridge to initiate
+ * @param rom content of the ROM
+ * @param size size of the ROM, in bytes
+ * @return error code
+ */
+int cartridge_init_from_memory(cartridge_t* ct, const data_t* rom, size_t size);
+
 
 /**
- * @brief Plugs a cartridge to the bus
+ * @brief Plugs a cartridge to the bus, mapping the ROM banks (and RAM) selected by its registers.
+ *        The writes to the ROM addresses are diverted to the cartridge (they never reach its memory):
+ *        they select the banks of its memory bank controller, each switch remapping one bus page per
+ *        256 bytes of the bank and selecting the predecoded instructions of the bank.
  *
  * @param ct cartridge to plug
  * @param bus bus to plug into
@@ -68,6 +159,74 @@ int cartridge_init(cartridge_t* ct, const char* filename);
 int cartridge_plug(cartridge_t* ct, bus_t bus);
 
 
+/**
+ * @brief Connects a cartridge to the parts of the gameboy its memory bank controller acts upon
+ *        (before cartridge_plug())
+ *
+ * @param ct cartridge
+ * @param cpu cpu whose predecoded instructions follow the ROM banks mapped (NULL: none)
+ * @param ram component holding the external RAM, of cartridge_ram_size() bytes at least,
+ *        plugged at BANK_RAM_START (NULL: no RAM)
+ * @param clock cycle counter the RTC counts the time from (NULL: stopped clock)
+ * @return error code
+ */
+int cartridge_connect(cartridge_t* ct, cpu_t* cpu, component_t* ram, const uint64_t* clock);
+
+
+/**
+ * @brief Size of the external RAM of a cartridge, as given by its header
+ *
+ * @param ct cartridge
+ * @return size in bytes (0: no RAM)
+ */
+size_t cartridge_ram_size(const cartridge_t* ct);
+
+
+/**
+ * @brief Creates the component holding the external RAM of a cartridge, of cartridge_ram_size() bytes
+ *        (BANK_RAM_SIZE at least). The RAM of a battery-backed cartridge loaded from a file is a shared
+ *        mapping of the save file next to it (same name, CARTRIDGE_SAVE_EXT extension), created if needed:
+ *        the writes go straight to the file, see cartridge_ram_sync(). The save file is locked as long as it is
+ *        mapped: a gameboy loading the same cartridge in the meantime (in this process or in another one) gets
+ *        a private copy of the save file in the heap instead, whose writes are lost when it is freed.
+ *
+ * @param ct cartridge
+ * @param ram (modified) component to create
+ * @param filename ROM file of the cartridge (NULL: no save file)
+ * @param arena arena to allocate a RAM that is not mapped from a save file (NULL: heap)
+ * @return error code
+ */
+int cartridge_ram_create(cartridge_t* ct, component_t* ram, const char* filename, mem_arena_t* arena);
+
+
+/**
+ * @brief Number of bytes of the external RAM that cartridge_ram_create() allocates
+ *
+ * @param ct cartridge
+ * @param filename ROM file of the cartridge (NULL: no save file)
+ * @return size in bytes (0 when the RAM is mapped from a save file, or copied from it in the heap)
+ */
+size_t cartridge_ram_alloc_size(const cartridge_t* ct, const char* filename);
+
+
+/**
+ * @brief Schedules the write back of the save file of a cartridge (nothing if there is none)
+ *
+ * @param ct cartridge
+ * @param wait whether to wait until it is written
+ */
+void cartridge_ram_sync(cartridge_t* ct, bit_t wait);
+
+
+/**
+ * @brief Frees the external RAM component created by cartridge_ram_create(), writing back the save file
+ *
+ * @param ct cartridge
+ * @param ram component to free
+ */
+void cartridge_ram_free(cartridge_t* ct, component_t* ram);
+
+
 /**
  * @brief Frees a cartridge
  *
@@ -36,6 +36,23 @@ int component_create(component_t* c, size_t mem_size) {
 	return ERR_NONE;
 }
 
+// ==== see component.h ========================================
+int component_create_in(component_t* c, mem_arena_t* arena, size_t mem_size) {
+	if (arena == NULL) {
+		return component_create(c, mem_size);
+	}
+	// check argument validity
+	M_REQUIRE_NON_NULL(c);
+
+	component_t result = {NULL, 0, 0};
+	if (mem_size != 0) {
+		M_EXIT_IF_ERR(mem_arena_alloc(arena, &result.mem, mem_size));
+	}
+	*c = result;
+
+	return ERR_NONE;
+}
+
 // ==== see component.h ========================================
 int component_shared(component_t* c, component_t* c_old) {
 	// check argument validity
@@ -60,8 +77,8 @@ void component_free(component_t* c) {
 		c->end = 0;
 		// free up the memory (space in heap for memory and its size to 0)
 		mem_free(c->mem);
-		// free up the component
-		free(c->mem);
+		// free up the component (the structure of a memory of an arena is freed with the arena)
+		if (c->mem != NULL && !c->mem->in_arena) free(c->mem);
 		c->mem = NULL;
 	}
 }
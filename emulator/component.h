@@ -40,6 +40,16 @@ extern "C" {
  */
 int component_create(component_t* c, size_t mem_size);
 
+/**
+ * @brief Creates a component whose memory is allocated in an arena (and freed with it)
+ *
+ * @param c component pointer to initialize
+ * @param arena arena to allocate the memory from (NULL: same as component_create())
+ * @param mem_size size of the memory of the component
+ * @return error code
+ */
+int component_create_in(component_t* c, mem_arena_t* arena, size_t mem_size);
+
 /**
  * @brief Shares memory between two components
  *
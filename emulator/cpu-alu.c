@@ -8,47 +8,35 @@
 #include "error.h"
 #include "bit.h"
 #include "alu.h"
+#include "alu_ext.h"
 #include "cpu-alu.h"
 #include "cpu-storage.h" // cpu_read_at_HL
 #include "cpu-registers.h" // cpu_HL_get
-
-// external library provided later to lower workload
-extern int cpu_dispatch_alu_ext(const instruction_t* lu, cpu_t* cpu);
+#include "util.h" // LUT_256
 
 #include <assert.h>
 #include <stdbool.h>
+#include <stdio.h> // fprintf
+#include <inttypes.h> // PRIX8
 
 // ======================================================================
 /**
- * @brief Returns flag bit value based on source preferences
- *
- * @param src source to select
- * @param cpu_f flags from cpu
- * @param alu_f flags from alu
- *
- * @return resulting flag bit value
+ * @brief Masks selecting, for each flag source, the flags taken from it
  */
-static bool flags_src_value(flag_src_t src, flag_bit_t cpu_f, flag_bit_t alu_f)
-{
-    switch (src) {
-    case CLEAR:
-        return false;
-
-    case SET:
-        return true;
-
-    case ALU:
-        return alu_f;
-
-    case CPU:
-        return cpu_f;
+typedef struct {
+    flags_t set;
+    flags_t alu;
+    flags_t cpu;
+} flags_src_masks_t;
 
-    default:
-        return false;
-    }
+// index of flags_src_table: Z << 6 | N << 4 | H << 2 | C (flag_src_t values fit in 2 bits)
+#define FLAG_SRC_BIT(i, shift, src, bit) ((((i) >> (shift)) & 0x3) == (src) ? (bit) : 0)
+#define FLAG_SRC_MASK(i, src) \
+    (flags_t) (FLAG_SRC_BIT(i, 6, src, FLAG_Z) | FLAG_SRC_BIT(i, 4, src, FLAG_N) \
+             | FLAG_SRC_BIT(i, 2, src, FLAG_H) | FLAG_SRC_BIT(i, 0, src, FLAG_C))
+#define FLAG_SRC_ENTRY(i) { FLAG_SRC_MASK(i, SET), FLAG_SRC_MASK(i, ALU), FLAG_SRC_MASK(i, CPU) }
 
-    return false;
-}
+static const flags_src_masks_t flags_src_table[256] = { LUT_256(FLAG_SRC_ENTRY, 0) };
 
 // ======================================================================
 /**
@@ -69,21 +57,9 @@ int cpu_combine_alu_flags(cpu_t* cpu,
     CHECK_FLAG_SRC(H);
     CHECK_FLAG_SRC(C);
 
-    flags_t res_f = 0;
-
-    if (flags_src_value(Z, get_Z(cpu->F), get_Z(cpu->alu.flags)))
-        set_Z(&res_f);
-
-    if (flags_src_value(N, get_N(cpu->F), get_N(cpu->alu.flags)))
-        set_N(&res_f);
-
-    if (flags_src_value(H, get_H(cpu->F), get_H(cpu->alu.flags)))
-        set_H(&res_f);
-
-    if (flags_src_value(C, get_C(cpu->F), get_C(cpu->alu.flags)))
-        set_C(&res_f);
-
-    cpu->F = res_f;
+    const flags_src_masks_t* masks = &flags_src_table[Z << 6 | N << 4 | H << 2 | C];
+    cpu->F = masks->set | (cpu->alu.flags & masks->alu) | (cpu_F_get(cpu) & masks->cpu);
+    cpu->lazy.op = LAZY_NONE;
 
     return ERR_NONE;
 }
@@ -111,6 +87,9 @@ static void do_set_or_res(const instruction_t* lu, data_t* data)
 #pragma GCC diagnostic pop
 }
 
+// LD_HLSP_S8 family: ADD SP, e8 (bit clear) or LD HL, SP+e8 (bit set)
+#define OPCODE_HLSP_DEST_IDX 4
+
 // ==== see cpu-alu.h ========================================
 int cpu_dispatch_alu(const instruction_t* lu, cpu_t* cpu)
 {
@@ -120,33 +99,27 @@ int cpu_dispatch_alu(const instruction_t* lu, cpu_t* cpu)
 
     // ADD
     case ADD_A_HLR: {
-		do_cpu_arithm(cpu, alu_add8, cpu_read_at_HL(cpu), ADD_FLAGS_SRC);		
+		do_cpu_arithm_lazy(cpu, LAZY_ADD, cpu_read_at_HL(cpu));
     } break;
 
     case ADD_A_N8: {
-		do_cpu_arithm(cpu, alu_add8, cpu_read_data_after_opcode(cpu), ADD_FLAGS_SRC);
+		do_cpu_arithm_lazy(cpu, LAZY_ADD, cpu_read_data_after_opcode(cpu));
     } break;
 
     case ADD_A_R8: {
-		do_cpu_arithm(cpu, alu_add8, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), ADD_FLAGS_SRC);
+		do_cpu_arithm_lazy(cpu, LAZY_ADD, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)));
     } break;
 
     case INC_HLR: {
-		M_EXIT_IF_ERR(alu_add8(&cpu->alu, cpu_read_at_HL(cpu), 1, 0));
-        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, INC_FLAGS_SRC));
-        cpu_write_at_HL(cpu, lsb8(cpu->alu.value));
+		const uint8_t x = cpu_read_at_HL(cpu);
+		cpu_F_defer(cpu, LAZY_INC, x, 1, get_C(cpu_F_get(cpu)) != 0);
+        cpu_write_at_HL(cpu, (uint8_t) (x + 1));
     } break;
 
     case INC_R8: {
-		M_EXIT_IF_ERR(alu_add8(&cpu->alu, cpu_reg_get(cpu, extract_reg(lu->opcode, 3)), 1, 0));
-        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, INC_FLAGS_SRC));
-        cpu_reg_set_from_alu8(cpu, extract_reg(lu->opcode, 3));
-    } break;
-
-    case DEC_R8: {
-		M_EXIT_IF_ERR(alu_sub8(&cpu->alu, cpu_reg_get(cpu, extract_reg(lu->opcode, 3)), 1, 0));
-        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, DEC_FLAGS_SRC));
-        cpu_reg_set_from_alu8(cpu, extract_reg(lu->opcode, 3));
+		const uint8_t x = cpu_reg_get(cpu, extract_reg(lu->opcode, 3));
+		cpu_F_defer(cpu, LAZY_INC, x, 1, get_C(cpu_F_get(cpu)) != 0);
+        cpu_reg_set(cpu, extract_reg(lu->opcode, 3), (uint8_t) (x + 1));
     } break;
 
     case ADD_HL_R16SP: {
@@ -161,42 +134,232 @@ int cpu_dispatch_alu(const instruction_t* lu, cpu_t* cpu)
 		cpu_reg_pair_SP_set(cpu, extract_reg_pair(lu->opcode), (cpu)->alu.value);
     } break;
 
+    case LD_HLSP_S8: {
+		// the signed offset is sign-extended, flags come from the low byte addition
+		M_EXIT_IF_ERR(alu_add16_low(&cpu->alu, cpu->SP, (uint16_t) (int8_t) cpu_read_data_after_opcode(cpu)));
+		M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, CLEAR, CLEAR, ALU, ALU));
+		if (bit_get(lu->opcode, OPCODE_HLSP_DEST_IDX)) {
+			cpu_HL_set(cpu, cpu->alu.value);
+		} else {
+			cpu->SP = cpu->alu.value;
+		}
+    } break;
+
+
+    // SUB
+    case SUB_A_HLR: {
+		do_cpu_arithm_lazy(cpu, LAZY_SUB, cpu_read_at_HL(cpu));
+    } break;
+
+    case SUB_A_N8: {
+		do_cpu_arithm_lazy(cpu, LAZY_SUB, cpu_read_data_after_opcode(cpu));
+    } break;
+
+    case SUB_A_R8: {
+		do_cpu_arithm_lazy(cpu, LAZY_SUB, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)));
+    } break;
+
+    case DEC_HLR: {
+		const uint8_t x = cpu_read_at_HL(cpu);
+		cpu_F_defer(cpu, LAZY_DEC, x, 1, get_C(cpu_F_get(cpu)) != 0);
+        cpu_write_at_HL(cpu, (uint8_t) (x - 1));
+    } break;
+
+    case DEC_R8: {
+		const uint8_t x = cpu_reg_get(cpu, extract_reg(lu->opcode, 3));
+		cpu_F_defer(cpu, LAZY_DEC, x, 1, get_C(cpu_F_get(cpu)) != 0);
+        cpu_reg_set(cpu, extract_reg(lu->opcode, 3), (uint8_t) (x - 1));
+    } break;
+
+    case DEC_R16SP: {
+		// no updates to flags
+		const reg_pair_kind pair = extract_reg_pair(lu->opcode);
+		cpu_reg_pair_SP_set(cpu, pair, (uint16_t) (cpu_reg_pair_SP_get(cpu, pair) - 1));
+    } break;
+
+
+    // AND, OR, XOR
+    case AND_A_HLR: {
+		do_cpu_logic(cpu, alu_and, cpu_read_at_HL(cpu), AND_FLAGS_SRC);
+    } break;
+
+    case AND_A_N8: {
+		do_cpu_logic(cpu, alu_and, cpu_read_data_after_opcode(cpu), AND_FLAGS_SRC);
+    } break;
+
+    case AND_A_R8: {
+		do_cpu_logic(cpu, alu_and, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), AND_FLAGS_SRC);
+    } break;
+
+    case OR_A_HLR: {
+		do_cpu_logic(cpu, alu_or, cpu_read_at_HL(cpu), OR_FLAGS_SRC);
+    } break;
+
+    case OR_A_N8: {
+		do_cpu_logic(cpu, alu_or, cpu_read_data_after_opcode(cpu), OR_FLAGS_SRC);
+    } break;
+
+    case OR_A_R8: {
+		do_cpu_logic(cpu, alu_or, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), OR_FLAGS_SRC);
+    } break;
+
+    case XOR_A_HLR: {
+		do_cpu_logic(cpu, alu_xor, cpu_read_at_HL(cpu), OR_FLAGS_SRC);
+    } break;
+
+    case XOR_A_N8: {
+		do_cpu_logic(cpu, alu_xor, cpu_read_data_after_opcode(cpu), OR_FLAGS_SRC);
+    } break;
+
+    case XOR_A_R8: {
+		do_cpu_logic(cpu, alu_xor, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), OR_FLAGS_SRC);
+    } break;
+
+    case CPL: {
+		cpu->A = (uint8_t) ~cpu->A;
+		M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, CPU, SET, SET, CPU));
+    } break;
+
 
     // COMPARISONS
+    case CP_A_HLR: {
+        cpu_F_defer(cpu, LAZY_SUB, cpu->A, cpu_read_at_HL(cpu), 0);
+        // No updates to the initial register
+    } break;
+
     case CP_A_R8: {
-        M_EXIT_IF_ERR(alu_sub8(&cpu->alu, cpu->A, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), 0));
-        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SUB_FLAGS_SRC));
+        cpu_F_defer(cpu, LAZY_SUB, cpu->A, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), 0);
         // No updates to the initial register
     } break;
 
     case CP_A_N8: {
-        M_EXIT_IF_ERR(alu_sub8(&cpu->alu, cpu->A,  cpu_read_data_after_opcode(cpu), 0));
-        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SUB_FLAGS_SRC));
+        cpu_F_defer(cpu, LAZY_SUB, cpu->A, cpu_read_data_after_opcode(cpu), 0);
         // No updates to the initial register
     } break;
 
 
     // BIT MOVE (rotate, shift)
+    case SLA_HLR: {
+		M_EXIT_IF_ERR(alu_shift(&cpu->alu, cpu_read_at_HL(cpu), LEFT));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SHIFT_FLAGS_SRC));
+        M_EXIT_IF_ERR(cpu_write_at_HL(cpu, lsb8(cpu->alu.value)));
+    } break;
+
     case SLA_R8: {
 		M_EXIT_IF_ERR(alu_shift(&cpu->alu, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), LEFT));
         M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SHIFT_FLAGS_SRC));
         cpu_reg_set_from_alu8(cpu, extract_reg(lu->opcode, 0));
     } break;
 
+    case SRA_HLR: {
+		M_EXIT_IF_ERR(alu_shiftR_A(&cpu->alu, cpu_read_at_HL(cpu)));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SHIFT_FLAGS_SRC));
+        M_EXIT_IF_ERR(cpu_write_at_HL(cpu, lsb8(cpu->alu.value)));
+    } break;
+
+    case SRA_R8: {
+		M_EXIT_IF_ERR(alu_shiftR_A(&cpu->alu, cpu_reg_get(cpu, extract_reg(lu->opcode, 0))));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SHIFT_FLAGS_SRC));
+        cpu_reg_set_from_alu8(cpu, extract_reg(lu->opcode, 0));
+    } break;
+
+    case SRL_HLR: {
+		M_EXIT_IF_ERR(alu_shift(&cpu->alu, cpu_read_at_HL(cpu), RIGHT));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SHIFT_FLAGS_SRC));
+        M_EXIT_IF_ERR(cpu_write_at_HL(cpu, lsb8(cpu->alu.value)));
+    } break;
+
+    case SRL_R8: {
+		M_EXIT_IF_ERR(alu_shift(&cpu->alu, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), RIGHT));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SHIFT_FLAGS_SRC));
+        cpu_reg_set_from_alu8(cpu, extract_reg(lu->opcode, 0));
+    } break;
+
+    case ROTCA: {
+		M_EXIT_IF_ERR(alu_rotate(&cpu->alu, cpu->A, extract_rot_dir(lu->opcode)));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, ROT_FLAGS_SRC));
+        cpu_reg_set_from_alu8(cpu, REG_A_CODE);
+    } break;
+
+    case ROTA: {
+		M_EXIT_IF_ERR(alu_carry_rotate(&cpu->alu, cpu->A, extract_rot_dir(lu->opcode), cpu_F_get(cpu)));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, ROT_FLAGS_SRC));
+        cpu_reg_set_from_alu8(cpu, REG_A_CODE);
+    } break;
+
+    case ROTC_HLR: {
+		M_EXIT_IF_ERR(alu_rotate(&cpu->alu, cpu_read_at_HL(cpu), extract_rot_dir(lu->opcode)));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SHIFT_FLAGS_SRC));
+        M_EXIT_IF_ERR(cpu_write_at_HL(cpu, lsb8(cpu->alu.value)));
+    } break;
+
+    case ROTC_R8: {
+		M_EXIT_IF_ERR(alu_rotate(&cpu->alu, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), extract_rot_dir(lu->opcode)));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SHIFT_FLAGS_SRC));
+        cpu_reg_set_from_alu8(cpu, extract_reg(lu->opcode, 0));
+    } break;
+
+    case ROT_HLR: {
+		M_EXIT_IF_ERR(alu_carry_rotate(&cpu->alu, cpu_read_at_HL(cpu), extract_rot_dir(lu->opcode), cpu_F_get(cpu)));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SHIFT_FLAGS_SRC));
+        M_EXIT_IF_ERR(cpu_write_at_HL(cpu, lsb8(cpu->alu.value)));
+    } break;
+
     case ROT_R8: {
-		M_EXIT_IF_ERR(alu_carry_rotate(&cpu->alu, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), extract_rot_dir(lu->opcode), cpu->F));
+		M_EXIT_IF_ERR(alu_carry_rotate(&cpu->alu, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), extract_rot_dir(lu->opcode), cpu_F_get(cpu)));
         M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SHIFT_FLAGS_SRC));
         cpu_reg_set_from_alu8(cpu, extract_reg(lu->opcode, 0));
     } break;
 
+    case SWAP_HLR: {
+		M_EXIT_IF_ERR(alu_swap4(&cpu->alu, cpu_read_at_HL(cpu)));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, OR_FLAGS_SRC));
+        M_EXIT_IF_ERR(cpu_write_at_HL(cpu, lsb8(cpu->alu.value)));
+    } break;
+
+    case SWAP_R8: {
+		M_EXIT_IF_ERR(alu_swap4(&cpu->alu, cpu_reg_get(cpu, extract_reg(lu->opcode, 0))));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, OR_FLAGS_SRC));
+        cpu_reg_set_from_alu8(cpu, extract_reg(lu->opcode, 0));
+    } break;
+
+
+    // DECIMAL ADJUST
+    case DAA: {
+        M_EXIT_IF_ERR(alu_daa(&cpu->alu, cpu_A_get(cpu), cpu_F_get(cpu)));
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, DAA_FLAGS_SRC));
+        cpu_reg_set_from_alu8(cpu, REG_A_CODE);
+    } break;
+
+
+    // CARRY FLAG (set, complement)
+    case SCCF: {
+		// SCF sets the carry, CCF complements it
+		const flag_src_t carry = extract_sccf(lu->opcode) && get_C(cpu_F_get(cpu)) ? CLEAR : SET;
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, CPU, CLEAR, CLEAR, carry));
+    } break;
+
 
     // BIT TESTS (and set)
+    case BIT_U3_HLR: {
+		flag_src_t res = bit_get(cpu_read_at_HL(cpu), extract_n3(lu->opcode)) ? CLEAR : SET;
+        M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, res, CLEAR, SET, CPU));
+        // No updates to memory
+    } break;
+
     case BIT_U3_R8: {
 		flag_src_t res = bit_get(cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), extract_n3(lu->opcode)) ? CLEAR : SET;
         M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, res, CLEAR, SET, CPU));
         // No updates to the initial register
     } break;
 
+    case CHG_U3_HLR: {
+		uint8_t data = cpu_read_at_HL(cpu);
+		do_set_or_res(lu, &data);
+		M_EXIT_IF_ERR(cpu_write_at_HL(cpu, data));
+		// No updates to flag
+    } break;
+
     case CHG_U3_R8: {
 		reg_kind reg = extract_reg(lu->opcode, 0);
 		uint8_t data = cpu_reg_get(cpu, reg);
@@ -206,12 +369,9 @@ int cpu_dispatch_alu(const instruction_t* lu, cpu_t* cpu)
     } break;
 
     // ---------------------------------------------------------
-    // All the others are handled elsewhere by provided library
     default:
-        // use BLARGG flag if you have the cs212gbcpuext library
-        #ifdef BLARGG
-			M_EXIT_IF_ERR(cpu_dispatch_alu_ext(lu, cpu));
-        #endif
+        fprintf(stderr, "Unknown ALU instruction, Code: 0x%" PRIX8 "\n", cpu_read_at_idx(cpu, cpu->PC));
+        return ERR_INSTR;
         break;
     } // switch
 
@@ -68,7 +68,20 @@ typedef enum {
 
 #define OPCODE_CARRY_IDX 3
 #define extract_carry(cpu, op) \
-    (bit_get(op, OPCODE_CARRY_IDX) && get_C((cpu)->F))
+    (bit_get(op, OPCODE_CARRY_IDX) && get_C(cpu_F_get(cpu)))
+
+/*
+*        + do_cpu_arithm_lazy:
+*             same as do_cpu_arithm for ADD/ADC (KIND = LAZY_ADD) and SUB/SBC (KIND = LAZY_SUB)
+*             but the flags are only computed when F is read (see cpu_F_get)
+*/
+#define do_cpu_arithm_lazy(cpu, kind, arg) \
+    do { \
+        const uint8_t y_ = (arg); \
+        const bit_t c_ = extract_carry(cpu, lu->opcode); \
+        cpu_F_defer(cpu, kind, cpu->A, y_, c_); \
+        cpu->A = (uint8_t) (kind == LAZY_ADD ? cpu->A + y_ + c_ : cpu->A - y_ - c_); \
+    } while(0)
 
 #define do_cpu_arithm(cpu, op, arg, flags_src)  \
     do { \
@@ -76,6 +89,16 @@ typedef enum {
         combine_flags_set_A(cpu, flags_src); \
     } while(0)
 
+/*
+*        + do_cpu_logic:
+*             same as do_cpu_arithm for the logic operations (AND, OR, XOR), which take no carry
+*/
+#define do_cpu_logic(cpu, op, arg, flags_src)  \
+    do { \
+        M_EXIT_IF_ERR(op(&cpu->alu, cpu->A, (arg))); \
+        combine_flags_set_A(cpu, flags_src); \
+    } while(0)
+
 
 // ======================================================================
 /**
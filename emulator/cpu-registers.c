@@ -58,7 +58,7 @@ uint16_t cpu_reg_pair_get(const cpu_t* cpu, reg_pair_kind reg) {
 			break;
 		case REG_HL_CODE: return cpu->HL;
 			break;
-		case REG_AF_CODE: return cpu->AF;
+		case REG_AF_CODE: return (uint16_t) ((cpu->A << 8) | cpu_F_get(cpu));
 			break;
 		default: return 0;
 	} // switch
@@ -75,9 +75,30 @@ void cpu_reg_pair_set(cpu_t* cpu, reg_pair_kind reg, uint16_t value) {
 			break;
 			//force the 4 LSB of F to 0
 		case REG_AF_CODE: cpu->AF = value & 0xFFF0;
+			cpu->lazy.op = LAZY_NONE;
 			break;
 	} // switch
 }
 
+// ==== see cpu-registers.h ========================================
+flags_t cpu_F_get(const cpu_t* cpu) {
+	const lazy_flags_t* lazy = &cpu->lazy;
+	unsigned result = 0;
 
-
+	switch (lazy->op) {
+		case LAZY_ADD:
+			result = (unsigned) lazy->x + lazy->y + lazy->c;
+			return alu_flags_table[ALU_FLAGS_INDEX(lazy->x, lazy->y, result)];
+		case LAZY_SUB:
+			result = (unsigned) lazy->x - lazy->y - lazy->c;
+			return alu_flags_table[ALU_FLAGS_INDEX(lazy->x, lazy->y, result)] | FLAG_N;
+		// INC and DEC keep the carry flag
+		case LAZY_INC:
+			result = (unsigned) lazy->x + 1;
+			return (alu_flags_table[ALU_FLAGS_INDEX(lazy->x, 1, result)] & ~FLAG_C) | (lazy->c ? FLAG_C : 0);
+		case LAZY_DEC:
+			result = (unsigned) lazy->x - 1;
+			return (alu_flags_table[ALU_FLAGS_INDEX(lazy->x, 1, result)] & ~FLAG_C) | (lazy->c ? FLAG_C : 0) | FLAG_N;
+		default: return cpu->F;
+	} // switch
+}
@@ -169,6 +169,41 @@ void cpu_reg_pair_set(cpu_t* cpu, reg_pair_kind reg, uint16_t value);
   (reg == REG_AF_CODE ? (void)((cpu)->SP = value) : cpu_reg_pair_set(cpu,reg,value))
 
 
+
+/**
+ * @brief returns the flags register, computing the flags of the last
+ *        ALU operation if they are still pending (see lazy_flags_t)
+ *
+ * @params cpu pointer to the cpu
+ *
+ * @return value of F
+ */
+flags_t cpu_F_get(const cpu_t* cpu);
+
+/**
+ * @brief writes the pending flags (if any) to F
+ *
+ * @params cpu pointer to the cpu
+ */
+#define cpu_F_sync(cpu) \
+  do { \
+    if ((cpu)->lazy.op != LAZY_NONE) { \
+      (cpu)->F = cpu_F_get(cpu); \
+      (cpu)->lazy.op = LAZY_NONE; \
+    } \
+  } while (0)
+
+/**
+ * @brief records an ALU operation whose flags will be computed when F is read
+ *        (the operands are evaluated first: they may read the flags still pending)
+ */
+#define cpu_F_defer(cpu, kind, a, b, carry) \
+  do { \
+    const lazy_flags_t lazy_ = { (kind), (a), (b), (carry) }; \
+    (cpu)->lazy = lazy_; \
+  } while (0)
+
+
 #ifdef __cplusplus
 }
 #endif
@@ -14,6 +14,8 @@
 data_t cpu_read_at_idx(const cpu_t* cpu, addr_t addr)
 {
 	data_t data = 0;
+	// the component owning this address may have to bring it up to date first
+	bus_sync_dispatch(*(cpu->bus), addr);
 	bus_read(*(cpu->bus), addr, &data);
 	return data;
 }
@@ -22,6 +24,8 @@ data_t cpu_read_at_idx(const cpu_t* cpu, addr_t addr)
 addr_t cpu_read16_at_idx(const cpu_t* cpu, addr_t addr)
 {
 	addr_t data16 = 0; 
+	bus_sync_dispatch(*(cpu->bus), addr);
+	bus_sync_dispatch(*(cpu->bus), (addr_t) (addr + 1));
 	bus_read16(*(cpu->bus), addr, &data16);
 	return data16;
 }
@@ -30,9 +34,12 @@ addr_t cpu_read16_at_idx(const cpu_t* cpu, addr_t addr)
 int cpu_write_at_idx(cpu_t* cpu, addr_t addr, data_t data)
 {
 	M_REQUIRE_NON_NULL(cpu);
+	// the component owning this address may have to bring it up to date first
+	M_EXIT_IF_ERR(bus_sync_dispatch(*(cpu->bus), addr));
 	//write but propagate error message if there's one
 	M_EXIT_IF_ERR(bus_write(*(cpu->bus), addr, data));
-	cpu->write_listener = addr;
+	// let the component owning this address react to the write
+	M_EXIT_IF_ERR(bus_hook_dispatch(*(cpu->bus), addr));
     return ERR_NONE;
 }
 
@@ -40,9 +47,13 @@ int cpu_write_at_idx(cpu_t* cpu, addr_t addr, data_t data)
 int cpu_write16_at_idx(cpu_t* cpu, addr_t addr, addr_t data16)
 {
 	M_REQUIRE_NON_NULL(cpu);
+	M_EXIT_IF_ERR(bus_sync_dispatch(*(cpu->bus), addr));
+	M_EXIT_IF_ERR(bus_sync_dispatch(*(cpu->bus), (addr_t) (addr + 1)));
 	//write but propagate error message if there's one
 	M_EXIT_IF_ERR(bus_write16(*(cpu->bus), addr, data16));
-	cpu->write_listener = addr;
+	// both bytes may belong to a component that listens to writes
+	M_EXIT_IF_ERR(bus_hook_dispatch(*(cpu->bus), addr));
+	M_EXIT_IF_ERR(bus_hook_dispatch(*(cpu->bus), (addr_t) (addr + 1)));
     return ERR_NONE;
 }
 
@@ -77,10 +77,10 @@ data_t cpu_read_at_idx(const cpu_t* cpu, addr_t addr);
     
 
 /**
- * @brief Reads data after opcode from bus
+ * @brief Reads data after opcode from bus (or from the decode cache when the instruction was predecoded)
  */
 #define cpu_read_data_after_opcode(cpu)\
-    cpu_read_at_idx(cpu,(addr_t)((cpu)->PC + 1))
+    ((cpu)->operand_cached ? (data_t) (cpu)->operand : cpu_read_at_idx(cpu,(addr_t)((cpu)->PC + 1)))
 
 /**
  * @brief Reads 16bit data from the bus at a given adress
@@ -93,10 +93,10 @@ data_t cpu_read_at_idx(const cpu_t* cpu, addr_t addr);
 addr_t cpu_read16_at_idx(const cpu_t* cpu, addr_t addr);
 
 /**
- * @brief Reads 16bit data after opcode from bus
+ * @brief Reads 16bit data after opcode from bus (or from the decode cache when the instruction was predecoded)
  */
 #define cpu_read_addr_after_opcode(cpu) \
-    FROM_GameBoy_16(cpu_read16_at_idx(cpu, (addr_t)((cpu)->PC + 1)))
+    ((cpu)->operand_cached ? (cpu)->operand : FROM_GameBoy_16(cpu_read16_at_idx(cpu, (addr_t)((cpu)->PC + 1))))
 
 /**
  * @brief Write data to the bus at a given adress
@@ -10,6 +10,7 @@
 
 #include "error.h"
 #include "opcode.h"
+#include "alu_ext.h" // alu_and, alu_or, alu_xor (threaded core)
 #include "cpu-alu.h"
 #include "cpu-registers.h"
 #include "cpu-storage.h"
@@ -18,11 +19,19 @@
 
 #include <inttypes.h> // PRIX8
 #include <stdio.h> // fprintf
+#include <stdlib.h> // calloc, free
+#include <string.h> // memset
 
 bit_t check_cc(const instruction_t* lu, cpu_t* cpu);
 
 // ==== see cpu.h =======================================================
 int cpu_init(cpu_t* cpu)
+{
+	return cpu_init_in(cpu, NULL);
+}
+
+// ==== see cpu.h =======================================================
+int cpu_init_in(cpu_t* cpu, mem_arena_t* arena)
 {
 	// check argument validity
 	M_REQUIRE_NON_NULL(cpu);
@@ -40,11 +49,17 @@ int cpu_init(cpu_t* cpu)
 	cpu->HALT = 0;
 	cpu->idle_time = 0;
 	cpu->bus = NULL;
-	cpu->write_listener = 0;
+	cpu->operand = 0;
+	cpu->operand_cached = 0;
+	memset(cpu->decoded, 0, sizeof(cpu->decoded));
+	cpu->decoded_banks = NULL;
+	cpu->nb_decoded_banks = 0;
+	cpu->instructions = 0;
+	cpu->lazy.op = LAZY_NONE;
 	
 	component_t* high_ram = &cpu->high_ram;
 	// Contrary to what was written in the feedback, we do need the +1 here because we want to include REG_IE within the high_ram space
-	M_EXIT_IF_ERR(component_create(high_ram, HIGH_RAM_SIZE+1));
+	M_EXIT_IF_ERR(component_create_in(high_ram, arena, HIGH_RAM_SIZE+1));
     return ERR_NONE;
 }
 
@@ -56,8 +71,8 @@ int cpu_plug(cpu_t* cpu, bus_t* bus)
 	M_REQUIRE_NON_NULL(bus);
 	cpu->bus = bus;
     M_EXIT_IF_ERR(bus_plug(*(cpu->bus), &(cpu->high_ram), HIGH_RAM_START, HIGH_RAM_END+1));
-    (*(cpu->bus))[REG_IE] = &cpu->IE;
-    (*(cpu->bus))[REG_IF] = &cpu->IF;
+    M_EXIT_IF_ERR(bus_map_byte(*(cpu->bus), REG_IE, &cpu->IE));
+    M_EXIT_IF_ERR(bus_map_byte(*(cpu->bus), REG_IF, &cpu->IF));
     return ERR_NONE;
 }
 
@@ -68,6 +83,13 @@ void cpu_free(cpu_t* cpu)
 	if(cpu != NULL) {
 		bus_unplug(*(cpu->bus), &(cpu->high_ram));
 		component_free(&(cpu->high_ram));
+		for (size_t i = 0; i < cpu->nb_decoded_banks; ++i) {
+			free(cpu->decoded_banks[i]);
+		}
+		free(cpu->decoded_banks);
+		cpu->decoded_banks = NULL;
+		cpu->nb_decoded_banks = 0;
+		memset(cpu->decoded, 0, sizeof(cpu->decoded));
 		cpu->bus = NULL;
 	}
 }
@@ -75,42 +97,44 @@ void cpu_free(cpu_t* cpu)
 // ---------------------------------------------------------------------
 bit_t check_cc(const instruction_t* lu, cpu_t* cpu) {
 		data_t cc = extract_cc(lu->opcode);
+		const flags_t F = cpu_F_get(cpu);
 		bit_t act = 0;
 
 		switch (cc) {
-			case 0: if(get_Z(cpu->F) == 0) act = 1;
+			case 0: if(get_Z(F) == 0) act = 1;
 			break;
-			case 1: if(get_Z(cpu->F) != 0) act = 1;
+			case 1: if(get_Z(F) != 0) act = 1;
 			break;
-			case 2: if(get_C(cpu->F) == 0) act = 1;
+			case 2: if(get_C(F) == 0) act = 1;
 			break;
-			case 3: if(get_C(cpu->F) != 0) act = 1;
+			case 3: if(get_C(F) != 0) act = 1;
 			break;
 		} // switch
 		return act;
 }
 
-//=========================================================================
 /**
- * @brief Executes an instruction
- * @param lu instruction
- * @param cpu, the CPU which shall execute
- * @return error code
+ * @brief Type of the functions executing the instructions of a group of families
+ */
+typedef int (*cpu_handler_t)(const instruction_t* lu, cpu_t* cpu);
+
+/**
+ * @brief Groups of instruction families, each executed by its own handler
+ */
+typedef enum {
+	CPU_HANDLER_CONTROL, CPU_HANDLER_ALU, CPU_HANDLER_STORAGE, CPU_NB_HANDLERS
+} cpu_handler_kind_t;
+
+/**
+ * Auxiliary function
+ * @brief Gives the handler group of an instruction family
  *
- * See opcode.h and cpu.h
+ * @param family family of the instruction
+ * @return handler group
  */
-static int cpu_dispatch(const instruction_t* lu, cpu_t* cpu)
+static cpu_handler_kind_t cpu_handler_kind(opcode_family family)
 {
-	// check arguments validity
-    M_REQUIRE_NON_NULL(lu);
-    M_REQUIRE_NON_NULL(cpu);
-    
-	//reset to 0 the ALU of the CPU (flags and value)
-	cpu->alu.flags = 0;
-	cpu->alu.value = 0;
-	
-	// execute the instruction lu based on the switch
-    switch (lu->family) {
+	switch (family) {
 
     // ALU
     case ADD_A_HLR:
@@ -160,10 +184,7 @@ static int cpu_dispatch(const instruction_t* lu, cpu_t* cpu)
     case LD_HLSP_S8:
     case DAA:
     case SCCF:
-        M_EXIT_IF_ERR(cpu_dispatch_alu(lu, cpu));
-        // update cpu->PC with lu->bytes 
-		cpu->PC = (uint16_t) (cpu->PC + lu->bytes);
-        break;
+        return CPU_HANDLER_ALU;
 
     // STORAGE
     case LD_A_BCR:
@@ -188,11 +209,518 @@ static int cpu_dispatch(const instruction_t* lu, cpu_t* cpu)
     case LD_SP_HL:
     case POP_R16:
     case PUSH_R16:
-        M_EXIT_IF_ERR(cpu_dispatch_storage(lu, cpu));
-        // update cpu->PC with lu->bytes 
-		cpu->PC = (uint16_t) (cpu->PC + lu->bytes);
-        break;
+        return CPU_HANDLER_STORAGE;
+
+    default:
+        return CPU_HANDLER_CONTROL;
+	} // end of switch
+}
+
+#ifdef CPU_THREADED
+/*
+ * Labels of the threaded core specialized on their 8-bit register operands:
+ * one label per register (the name of its field in cpu_t), so that the
+ * handler neither extracts the register from the opcode nor goes through
+ * cpu_reg_get/cpu_reg_set
+ */
+#define CPU_LD_ROW(D) \
+	&&do_LD_##D##_B, &&do_LD_##D##_C, &&do_LD_##D##_D, &&do_LD_##D##_E, \
+	&&do_LD_##D##_H, &&do_LD_##D##_L, &&do_LD_##D##_HLR, &&do_LD_##D##_A
+
+#define CPU_ALU_ROW(OP, HLR) \
+	&&do_##OP##_B, &&do_##OP##_C, &&do_##OP##_D, &&do_##OP##_E, \
+	&&do_##OP##_H, &&do_##OP##_L, &&do_##HLR, &&do_##OP##_A
+
+// logic operations: Z from the result, H given, N and C cleared (same flags as AND_FLAGS_SRC and OR_FLAGS_SRC)
+#define cpu_logic_A_set(cpu, value, h) \
+	do { \
+		(cpu)->A = (uint8_t) (value); \
+		(cpu)->F = (flags_t) (alu_flags_table[(cpu)->A] | (h)); \
+		(cpu)->lazy.op = LAZY_NONE; \
+	} while (0)
+
+// instructions whose source operand is register R
+#define CPU_R8_SRC_HANDLERS(R) \
+do_LD_B_##R: cpu->B = cpu->R; goto next; \
+do_LD_C_##R: cpu->C = cpu->R; goto next; \
+do_LD_D_##R: cpu->D = cpu->R; goto next; \
+do_LD_E_##R: cpu->E = cpu->R; goto next; \
+do_LD_H_##R: cpu->H = cpu->R; goto next; \
+do_LD_L_##R: cpu->L = cpu->R; goto next; \
+do_LD_A_##R: cpu->A = cpu->R; goto next; \
+do_LD_HLR_##R: cpu_write_at_HL(cpu, cpu->R); goto next; \
+do_ADD_##R: \
+	cpu_F_defer(cpu, LAZY_ADD, cpu->A, cpu->R, 0); \
+	cpu->A = (uint8_t) (cpu->A + cpu->R); \
+	goto next; \
+do_ADC_##R: { \
+	const bit_t c = get_C(cpu_F_get(cpu)) ? 1 : 0; \
+	cpu_F_defer(cpu, LAZY_ADD, cpu->A, cpu->R, c); \
+	cpu->A = (uint8_t) (cpu->A + cpu->R + c); \
+	goto next; \
+} \
+do_SUB_##R: \
+	cpu_F_defer(cpu, LAZY_SUB, cpu->A, cpu->R, 0); \
+	cpu->A = (uint8_t) (cpu->A - cpu->R); \
+	goto next; \
+do_SBC_##R: { \
+	const bit_t c = get_C(cpu_F_get(cpu)) ? 1 : 0; \
+	cpu_F_defer(cpu, LAZY_SUB, cpu->A, cpu->R, c); \
+	cpu->A = (uint8_t) (cpu->A - cpu->R - c); \
+	goto next; \
+} \
+do_CP_##R: cpu_F_defer(cpu, LAZY_SUB, cpu->A, cpu->R, 0); goto next; \
+do_AND_##R: cpu_logic_A_set(cpu, cpu->A & cpu->R, FLAG_H); goto next; \
+do_OR_##R: cpu_logic_A_set(cpu, cpu->A | cpu->R, 0); goto next; \
+do_XOR_##R: cpu_logic_A_set(cpu, cpu->A ^ cpu->R, 0); goto next;
+
+// instructions whose destination operand is register R
+#define CPU_R8_DST_HANDLERS(R) \
+do_LD_##R##_HLR: cpu->R = cpu_read_at_HL(cpu); goto next; \
+do_INC_##R: \
+	cpu_F_defer(cpu, LAZY_INC, cpu->R, 1, get_C(cpu_F_get(cpu)) != 0); \
+	cpu->R = (uint8_t) (cpu->R + 1); \
+	goto next; \
+do_DEC_##R: \
+	cpu_F_defer(cpu, LAZY_DEC, cpu->R, 1, get_C(cpu_F_get(cpu)) != 0); \
+	cpu->R = (uint8_t) (cpu->R - 1); \
+	goto next;
+
+//=========================================================================
+/**
+ * @brief Executes an instruction with the threaded core:
+ *        a single indirect jump through a table of labels indexed like the opcode tables
+ *        (256 direct then 256 CB-prefixed opcodes), one handler per instruction family,
+ *        or per register operand for the 8-bit loads and ALU operations on registers.
+ *        Uses the "labels as values" extension of GCC (and clang).
+ *
+ * @param lu instruction
+ * @param cpu, the CPU which shall execute
+ * @return error code
+ */
+static int cpu_execute(const instruction_t* lu, cpu_t* cpu)
+{
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wpedantic"
+	static const void* const labels[512] = {
+		// direct
+		&&do_NOP, &&do_LD_R16SP_N16, &&do_LD_BCR_A, &&do_INC_R16SP, &&do_INC_B, &&do_DEC_B, &&do_LD_R8_N8, &&do_ROTCA,  // 0x00
+		&&do_LD_N16R_SP, &&do_ADD_HL_R16SP, &&do_LD_A_BCR, &&do_DEC_R16SP, &&do_INC_C, &&do_DEC_C, &&do_LD_R8_N8, &&do_ROTCA,  // 0x08
+		&&do_STOP, &&do_LD_R16SP_N16, &&do_LD_DER_A, &&do_INC_R16SP, &&do_INC_D, &&do_DEC_D, &&do_LD_R8_N8, &&do_ROTA,  // 0x10
+		&&do_JR_E8, &&do_ADD_HL_R16SP, &&do_LD_A_DER, &&do_DEC_R16SP, &&do_INC_E, &&do_DEC_E, &&do_LD_R8_N8, &&do_ROTA,  // 0x18
+		&&do_JR_CC_E8, &&do_LD_R16SP_N16, &&do_LD_HLRU_A, &&do_INC_R16SP, &&do_INC_H, &&do_DEC_H, &&do_LD_R8_N8, &&do_DAA,  // 0x20
+		&&do_JR_CC_E8, &&do_ADD_HL_R16SP, &&do_LD_A_HLRU, &&do_DEC_R16SP, &&do_INC_L, &&do_DEC_L, &&do_LD_R8_N8, &&do_CPL,  // 0x28
+		&&do_JR_CC_E8, &&do_LD_R16SP_N16, &&do_LD_HLRU_A, &&do_INC_R16SP, &&do_INC_HLR, &&do_DEC_HLR, &&do_LD_HLR_N8, &&do_SCCF,  // 0x30
+		&&do_JR_CC_E8, &&do_ADD_HL_R16SP, &&do_LD_A_HLRU, &&do_DEC_R16SP, &&do_INC_A, &&do_DEC_A, &&do_LD_R8_N8, &&do_SCCF,  // 0x38
+		CPU_LD_ROW(B),  // 0x40
+		CPU_LD_ROW(C),  // 0x48
+		CPU_LD_ROW(D),  // 0x50
+		CPU_LD_ROW(E),  // 0x58
+		CPU_LD_ROW(H),  // 0x60
+		CPU_LD_ROW(L),  // 0x68
+		&&do_LD_HLR_B, &&do_LD_HLR_C, &&do_LD_HLR_D, &&do_LD_HLR_E, &&do_LD_HLR_H, &&do_LD_HLR_L, &&do_HALT, &&do_LD_HLR_A,  // 0x70
+		CPU_LD_ROW(A),  // 0x78
+		CPU_ALU_ROW(ADD, ADD_A_HLR),  // 0x80
+		CPU_ALU_ROW(ADC, ADD_A_HLR),  // 0x88
+		CPU_ALU_ROW(SUB, SUB_A_HLR),  // 0x90
+		CPU_ALU_ROW(SBC, SUB_A_HLR),  // 0x98
+		CPU_ALU_ROW(AND, AND_A_HLR),  // 0xA0
+		CPU_ALU_ROW(XOR, XOR_A_HLR),  // 0xA8
+		CPU_ALU_ROW(OR, OR_A_HLR),  // 0xB0
+		CPU_ALU_ROW(CP, CP_A_HLR),  // 0xB8
+		&&do_RET_CC, &&do_POP_R16, &&do_JP_CC_N16, &&do_JP_N16, &&do_CALL_CC_N16, &&do_PUSH_R16, &&do_ADD_A_N8, &&do_RST_U3,  // 0xC0
+		&&do_RET_CC, &&do_RET, &&do_JP_CC_N16, &&do_UNKN, &&do_CALL_CC_N16, &&do_CALL_N16, &&do_ADD_A_N8, &&do_RST_U3,  // 0xC8
+		&&do_RET_CC, &&do_POP_R16, &&do_JP_CC_N16, &&do_UNKN, &&do_CALL_CC_N16, &&do_PUSH_R16, &&do_SUB_A_N8, &&do_RST_U3,  // 0xD0
+		&&do_RET_CC, &&do_RETI, &&do_JP_CC_N16, &&do_UNKN, &&do_CALL_CC_N16, &&do_UNKN, &&do_SUB_A_N8, &&do_RST_U3,  // 0xD8
+		&&do_LD_N8R_A, &&do_POP_R16, &&do_LD_CR_A, &&do_UNKN, &&do_UNKN, &&do_PUSH_R16, &&do_AND_A_N8, &&do_RST_U3,  // 0xE0
+		&&do_LD_HLSP_S8, &&do_JP_HL, &&do_LD_N16R_A, &&do_UNKN, &&do_UNKN, &&do_UNKN, &&do_XOR_A_N8, &&do_RST_U3,  // 0xE8
+		&&do_LD_A_N8R, &&do_POP_R16, &&do_LD_A_CR, &&do_EDI, &&do_UNKN, &&do_PUSH_R16, &&do_OR_A_N8, &&do_RST_U3,  // 0xF0
+		&&do_LD_HLSP_S8, &&do_LD_SP_HL, &&do_LD_A_N16R, &&do_EDI, &&do_UNKN, &&do_UNKN, &&do_CP_A_N8, &&do_RST_U3,  // 0xF8
+		// CB-prefixed
+		&&do_ROTC_R8, &&do_ROTC_R8, &&do_ROTC_R8, &&do_ROTC_R8, &&do_ROTC_R8, &&do_ROTC_R8, &&do_ROTC_HLR, &&do_ROTC_R8,  // 0x00
+		&&do_ROTC_R8, &&do_ROTC_R8, &&do_ROTC_R8, &&do_ROTC_R8, &&do_ROTC_R8, &&do_ROTC_R8, &&do_ROTC_HLR, &&do_ROTC_R8,  // 0x08
+		&&do_ROT_R8, &&do_ROT_R8, &&do_ROT_R8, &&do_ROT_R8, &&do_ROT_R8, &&do_ROT_R8, &&do_ROT_HLR, &&do_ROT_R8,  // 0x10
+		&&do_ROT_R8, &&do_ROT_R8, &&do_ROT_R8, &&do_ROT_R8, &&do_ROT_R8, &&do_ROT_R8, &&do_ROT_HLR, &&do_ROT_R8,  // 0x18
+		&&do_SLA_R8, &&do_SLA_R8, &&do_SLA_R8, &&do_SLA_R8, &&do_SLA_R8, &&do_SLA_R8, &&do_SLA_HLR, &&do_SLA_R8,  // 0x20
+		&&do_SRA_R8, &&do_SRA_R8, &&do_SRA_R8, &&do_SRA_R8, &&do_SRA_R8, &&do_SRA_R8, &&do_SRA_HLR, &&do_SRA_R8,  // 0x28
+		&&do_SWAP_R8, &&do_SWAP_R8, &&do_SWAP_R8, &&do_SWAP_R8, &&do_SWAP_R8, &&do_SWAP_R8, &&do_SWAP_HLR, &&do_SWAP_R8,  // 0x30
+		&&do_SRL_R8, &&do_SRL_R8, &&do_SRL_R8, &&do_SRL_R8, &&do_SRL_R8, &&do_SRL_R8, &&do_SRL_HLR, &&do_SRL_R8,  // 0x38
+		&&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_HLR, &&do_BIT_U3_R8,  // 0x40
+		&&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_HLR, &&do_BIT_U3_R8,  // 0x48
+		&&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_HLR, &&do_BIT_U3_R8,  // 0x50
+		&&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_HLR, &&do_BIT_U3_R8,  // 0x58
+		&&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_HLR, &&do_BIT_U3_R8,  // 0x60
+		&&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_HLR, &&do_BIT_U3_R8,  // 0x68
+		&&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_HLR, &&do_BIT_U3_R8,  // 0x70
+		&&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_R8, &&do_BIT_U3_HLR, &&do_BIT_U3_R8,  // 0x78
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0x80
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0x88
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0x90
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0x98
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0xA0
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0xA8
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0xB0
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0xB8
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0xC0
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0xC8
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0xD0
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0xD8
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0xE0
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0xE8
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0xF0
+		&&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_R8, &&do_CHG_U3_HLR, &&do_CHG_U3_R8,  // 0xF8
+	};
+
+	goto *labels[(lu->kind == PREFIXED ? 256 : 0) + lu->opcode];
+
+	// ALU
+do_ADD_A_HLR:
+	do_cpu_arithm_lazy(cpu, LAZY_ADD, cpu_read_at_HL(cpu));
+	goto next;
+
+do_ADD_A_N8:
+	do_cpu_arithm_lazy(cpu, LAZY_ADD, cpu_read_data_after_opcode(cpu));
+	goto next;
+
+do_INC_HLR: {
+	const uint8_t x = cpu_read_at_HL(cpu);
+	cpu_F_defer(cpu, LAZY_INC, x, 1, get_C(cpu_F_get(cpu)) != 0);
+	cpu_write_at_HL(cpu, (uint8_t) (x + 1));
+	goto next;
+}
+
+do_ADD_HL_R16SP:
+	M_EXIT_IF_ERR(alu_add16_high(&cpu->alu, cpu_HL_get(cpu), cpu_reg_pair_SP_get(cpu, extract_reg_pair(lu->opcode))));
+	M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, CPU, CLEAR, ALU, ALU));
+	cpu_HL_set(cpu, cpu->alu.value);
+	goto next;
+
+do_INC_R16SP:
+	M_EXIT_IF_ERR(alu_add16_high(&cpu->alu, cpu_reg_pair_SP_get(cpu, extract_reg_pair(lu->opcode)), 1));
+	cpu_reg_pair_SP_set(cpu, extract_reg_pair(lu->opcode), cpu->alu.value);
+	goto next;
+
+do_CP_A_N8:
+	cpu_F_defer(cpu, LAZY_SUB, cpu->A, cpu_read_data_after_opcode(cpu), 0);
+	goto next;
+
+do_SLA_R8:
+	M_EXIT_IF_ERR(alu_shift(&cpu->alu, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), LEFT));
+	M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SHIFT_FLAGS_SRC));
+	cpu_reg_set_from_alu8(cpu, extract_reg(lu->opcode, 0));
+	goto next;
+
+do_ROT_R8:
+	M_EXIT_IF_ERR(alu_carry_rotate(&cpu->alu, cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), extract_rot_dir(lu->opcode), cpu_F_get(cpu)));
+	M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, SHIFT_FLAGS_SRC));
+	cpu_reg_set_from_alu8(cpu, extract_reg(lu->opcode, 0));
+	goto next;
+
+do_DAA:
+	M_EXIT_IF_ERR(alu_daa(&cpu->alu, cpu_A_get(cpu), cpu_F_get(cpu)));
+	M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, DAA_FLAGS_SRC));
+	cpu_reg_set_from_alu8(cpu, REG_A_CODE);
+	goto next;
+
+do_BIT_U3_R8:
+	M_EXIT_IF_ERR(cpu_combine_alu_flags(cpu, bit_get(cpu_reg_get(cpu, extract_reg(lu->opcode, 0)), extract_n3(lu->opcode)) ? CLEAR : SET,
+	                                    CLEAR, SET, CPU));
+	goto next;
+
+do_CHG_U3_R8: {
+	const reg_kind reg = extract_reg(lu->opcode, 0);
+	const data_t mask = (data_t) (1 << extract_n3(lu->opcode));
+	cpu_reg_set(cpu, reg, (data_t) (extract_sr_bit(lu->opcode) ? cpu_reg_get(cpu, reg) | mask : cpu_reg_get(cpu, reg) & ~mask));
+	goto next;
+}
+
+do_SUB_A_HLR:
+	do_cpu_arithm_lazy(cpu, LAZY_SUB, cpu_read_at_HL(cpu));
+	goto next;
+
+do_SUB_A_N8:
+	do_cpu_arithm_lazy(cpu, LAZY_SUB, cpu_read_data_after_opcode(cpu));
+	goto next;
+
+do_DEC_HLR: {
+	const uint8_t x = cpu_read_at_HL(cpu);
+	cpu_F_defer(cpu, LAZY_DEC, x, 1, get_C(cpu_F_get(cpu)) != 0);
+	cpu_write_at_HL(cpu, (uint8_t) (x - 1));
+	goto next;
+}
+
+do_DEC_R16SP:
+	cpu_reg_pair_SP_set(cpu, extract_reg_pair(lu->opcode), (uint16_t) (cpu_reg_pair_SP_get(cpu, extract_reg_pair(lu->opcode)) - 1));
+	goto next;
+
+do_AND_A_HLR:
+	do_cpu_logic(cpu, alu_and, cpu_read_at_HL(cpu), AND_FLAGS_SRC);
+	goto next;
+
+do_AND_A_N8:
+	do_cpu_logic(cpu, alu_and, cpu_read_data_after_opcode(cpu), AND_FLAGS_SRC);
+	goto next;
+
+do_OR_A_HLR:
+	do_cpu_logic(cpu, alu_or, cpu_read_at_HL(cpu), OR_FLAGS_SRC);
+	goto next;
+
+do_OR_A_N8:
+	do_cpu_logic(cpu, alu_or, cpu_read_data_after_opcode(cpu), OR_FLAGS_SRC);
+	goto next;
+
+do_XOR_A_HLR:
+	do_cpu_logic(cpu, alu_xor, cpu_read_at_HL(cpu), OR_FLAGS_SRC);
+	goto next;
+
+do_XOR_A_N8:
+	do_cpu_logic(cpu, alu_xor, cpu_read_data_after_opcode(cpu), OR_FLAGS_SRC);
+	goto next;
+
+do_CP_A_HLR:
+	cpu_F_defer(cpu, LAZY_SUB, cpu->A, cpu_read_at_HL(cpu), 0);
+	goto next;
+
+	// 8-bit registers
+	CPU_R8_SRC_HANDLERS(B)
+	CPU_R8_SRC_HANDLERS(C)
+	CPU_R8_SRC_HANDLERS(D)
+	CPU_R8_SRC_HANDLERS(E)
+	CPU_R8_SRC_HANDLERS(H)
+	CPU_R8_SRC_HANDLERS(L)
+	CPU_R8_SRC_HANDLERS(A)
+	CPU_R8_DST_HANDLERS(B)
+	CPU_R8_DST_HANDLERS(C)
+	CPU_R8_DST_HANDLERS(D)
+	CPU_R8_DST_HANDLERS(E)
+	CPU_R8_DST_HANDLERS(H)
+	CPU_R8_DST_HANDLERS(L)
+	CPU_R8_DST_HANDLERS(A)
+
+	// the less frequent ALU families keep their generic implementation (see cpu-alu.c)
+do_CPL:
+do_SLA_HLR:
+do_SRA_HLR:
+do_SRA_R8:
+do_SRL_HLR:
+do_SRL_R8:
+do_ROTCA:
+do_ROTA:
+do_ROTC_HLR:
+do_ROT_HLR:
+do_ROTC_R8:
+do_SWAP_HLR:
+do_SWAP_R8:
+do_BIT_U3_HLR:
+do_CHG_U3_HLR:
+do_LD_HLSP_S8:
+do_SCCF:
+	M_EXIT_IF_ERR(cpu_dispatch_alu(lu, cpu));
+	goto next;
+
+	// STORAGE
+do_LD_A_BCR:
+	cpu_A_set(cpu, cpu_read_at_BC(cpu));
+	goto next;
+
+do_LD_A_CR:
+	cpu_A_set(cpu, cpu_read_at_idx(cpu, (uint16_t) (cpu_C_get(cpu) + REGISTERS_START)));
+	goto next;
+
+do_LD_A_DER:
+	cpu_A_set(cpu, cpu_read_at_DE(cpu));
+	goto next;
+
+do_LD_A_HLRU:
+	cpu_A_set(cpu, cpu_read_at_HL(cpu));
+	cpu_HL_set(cpu, (uint16_t) (cpu_HL_get(cpu) + extract_HL_increment(lu->opcode)));
+	goto next;
+
+do_LD_A_N16R:
+	cpu_A_set(cpu, cpu_read_at_idx(cpu, cpu_read_addr_after_opcode(cpu)));
+	goto next;
+
+do_LD_A_N8R:
+	cpu_A_set(cpu, cpu_read_at_idx(cpu, (addr_t) (cpu_read_data_after_opcode(cpu) + REGISTERS_START)));
+	goto next;
+
+do_LD_BCR_A:
+	cpu_write_at_BC(cpu, cpu_A_get(cpu));
+	goto next;
+
+do_LD_CR_A:
+	cpu_write_at_idx(cpu, (addr_t) (cpu_C_get(cpu) + REGISTERS_START), cpu_A_get(cpu));
+	goto next;
+
+do_LD_DER_A:
+	cpu_write_at_DE(cpu, cpu_A_get(cpu));
+	goto next;
+
+do_LD_HLRU_A:
+	cpu_write_at_HL(cpu, cpu_A_get(cpu));
+	cpu_HL_set(cpu, (uint16_t) (cpu_HL_get(cpu) + extract_HL_increment(lu->opcode)));
+	goto next;
+
+do_LD_HLR_N8:
+	cpu_write_at_HL(cpu, cpu_read_data_after_opcode(cpu));
+	goto next;
+
+do_LD_N16R_A:
+	cpu_write_at_idx(cpu, cpu_read_addr_after_opcode(cpu), cpu_A_get(cpu));
+	goto next;
+
+do_LD_N16R_SP:
+	cpu_write16_at_idx(cpu, cpu_read_addr_after_opcode(cpu), cpu->SP);
+	goto next;
+
+do_LD_N8R_A:
+	cpu_write_at_idx(cpu, (addr_t) ((addr_t) cpu_read_data_after_opcode(cpu) + (addr_t) REGISTERS_START), cpu_A_get(cpu));
+	goto next;
+
+do_LD_R16SP_N16:
+	cpu_reg_pair_SP_set(cpu, extract_reg_pair(lu->opcode), cpu_read_addr_after_opcode(cpu));
+	goto next;
+
+do_LD_R8_N8:
+	cpu_reg_set(cpu, extract_reg(lu->opcode, 3), cpu_read_data_after_opcode(cpu));
+	goto next;
+
+do_LD_SP_HL:
+	cpu->SP = cpu_HL_get(cpu);
+	goto next;
+
+do_POP_R16:
+	cpu_reg_pair_set(cpu, extract_reg_pair(lu->opcode), cpu_SP_pop(cpu));
+	goto next;
+
+do_PUSH_R16:
+	cpu_SP_push(cpu, cpu_reg_pair_get(cpu, extract_reg_pair(lu->opcode)));
+	goto next;
+
+	// JUMP
+do_JP_CC_N16:
+	if (!check_cc(lu, cpu)) goto next;
+	cpu->idle_time = (uint8_t) (cpu->idle_time + lu->xtra_cycles);
+	// fall through
+do_JP_N16:
+	cpu->PC = cpu_read_addr_after_opcode(cpu);
+	goto done;
+
+do_JP_HL:
+	cpu->PC = cpu_HL_get(cpu);
+	goto done;
+
+do_JR_CC_E8:
+	if (!check_cc(lu, cpu)) goto next;
+	cpu->idle_time = (uint8_t) (cpu->idle_time + lu->xtra_cycles);
+	// fall through
+do_JR_E8:
+	// cast to int because interpreted in 2-complement
+	cpu->PC = (uint16_t) (cpu->PC + lu->bytes + (int8_t) cpu_read_data_after_opcode(cpu));
+	goto done;
+
+	// CALLS
+do_CALL_CC_N16:
+	if (!check_cc(lu, cpu)) goto next;
+	cpu->idle_time = (uint8_t) (cpu->idle_time + lu->xtra_cycles);
+	// fall through
+do_CALL_N16:
+	cpu_SP_push(cpu, (uint16_t) (cpu->PC + lu->bytes));
+	cpu->PC = cpu_read_addr_after_opcode(cpu);
+	goto done;
+
+	// RETURN (from call)
+do_RET_CC:
+	if (!check_cc(lu, cpu)) goto next;
+	cpu->idle_time = (uint8_t) (cpu->idle_time + lu->xtra_cycles);
+	// fall through
+do_RET:
+	cpu->PC = cpu_SP_pop(cpu);
+	goto done;
+
+do_RST_U3:
+	cpu_SP_push(cpu, (uint16_t) (cpu->PC + lu->bytes));
+	cpu->PC = (uint16_t) (extract_reg(lu->opcode, 3) << 3);
+	goto done;
+
+	// INTERRUPT & MISC.
+do_EDI:
+	cpu->IME = extract_ime(lu->opcode);
+	goto next;
+
+do_RETI:
+	cpu->IME = 1;
+	cpu->PC = cpu_SP_pop(cpu);
+	goto done;
+
+do_HALT:
+	cpu->HALT = 1;
+	goto next;
+
+do_STOP:
+do_NOP:
+	goto next;
+
+do_UNKN:
+	fprintf(stderr, "Unknown instruction, Code: 0x%" PRIX8 "\n", cpu_read_at_idx(cpu, cpu->PC));
+	return ERR_INSTR;
+
+next:
+	// update cpu->PC with lu->bytes
+	cpu->PC = (uint16_t) (cpu->PC + lu->bytes);
+done:
+	// update cpu->idle_time with lu->cycles
+	cpu->idle_time = (uint8_t) (cpu->idle_time + lu->cycles);
+	return ERR_NONE;
+#pragma GCC diagnostic pop
+}
+
+#else
+/**
+ * Auxiliary function
+ * @brief Executes an ALU instruction
+ *
+ * @param lu instruction
+ * @param cpu, the CPU which shall execute
+ * @return error code
+ */
+static int cpu_exec_alu(const instruction_t* lu, cpu_t* cpu)
+{
+	M_EXIT_IF_ERR(cpu_dispatch_alu(lu, cpu));
+	// update cpu->PC with lu->bytes and cpu->idle_time with lu->cycles
+	cpu->PC = (uint16_t) (cpu->PC + lu->bytes);
+	cpu->idle_time = (uint8_t) (cpu->idle_time + lu->cycles);
+	return ERR_NONE;
+}
+
+/**
+ * Auxiliary function
+ * @brief Executes a storage instruction
+ *
+ * @param lu instruction
+ * @param cpu, the CPU which shall execute
+ * @return error code
+ */
+static int cpu_exec_storage(const instruction_t* lu, cpu_t* cpu)
+{
+	M_EXIT_IF_ERR(cpu_dispatch_storage(lu, cpu));
+	// update cpu->PC with lu->bytes and cpu->idle_time with lu->cycles
+	cpu->PC = (uint16_t) (cpu->PC + lu->bytes);
+	cpu->idle_time = (uint8_t) (cpu->idle_time + lu->cycles);
+	return ERR_NONE;
+}
 
+/**
+ * Auxiliary function
+ * @brief Executes a control instruction (jumps, calls, returns, interrupts & misc.)
+ *
+ * @param lu instruction
+ * @param cpu, the CPU which shall execute
+ * @return error code
+ */
+static int cpu_exec_control(const instruction_t* lu, cpu_t* cpu)
+{
+    switch (lu->family) {
 
 	// Most of the control instructions substract lu->bytes only because 
     // JUMP
@@ -296,14 +824,171 @@ static int cpu_dispatch(const instruction_t* lu, cpu_t* cpu)
     } break;
 
     } // end of switch
-    
+
     // update cpu->idle_time with lu->cycles
     cpu->idle_time = (uint8_t) (cpu->idle_time + lu->cycles);
 
     return ERR_NONE;
 }
 
+static const cpu_handler_t cpu_handlers[CPU_NB_HANDLERS] = {
+	cpu_exec_control, cpu_exec_alu, cpu_exec_storage
+};
 
+/**
+ * Auxiliary function
+ * @brief Executes an instruction with the switch core: the handler of its family group
+ *
+ * @param lu instruction
+ * @param cpu, the CPU which shall execute
+ * @return error code
+ */
+static int cpu_execute(const instruction_t* lu, cpu_t* cpu)
+{
+	return cpu_handlers[cpu_handler_kind(lu->family)](lu, cpu);
+}
+#endif // CPU_THREADED
+
+
+//=========================================================================
+/**
+ * @brief Executes an instruction
+ * @param lu instruction
+ * @param cpu, the CPU which shall execute
+ * @return error code
+ *
+ * See opcode.h and cpu.h
+ */
+static int cpu_dispatch(const instruction_t* lu, cpu_t* cpu)
+{
+	// check arguments validity
+    M_REQUIRE_NON_NULL(lu);
+    M_REQUIRE_NON_NULL(cpu);
+    
+	// the flags stay pending until F is read (see cpu_F_sync())
+	return cpu_execute(lu, cpu);
+}
+
+// layout of cpu_decoded_t.op: validity bit, handler group and index in the opcode tables
+#define DECODED_VALID        0x8000
+#define DECODED_KIND_SHIFT   9
+#define DECODED_INDEX_MASK   0x01FF
+#define decoded_kind(d)      (((d)->op >> DECODED_KIND_SHIFT) & 0x3)
+#define decoded_instruction(d) \
+	(((d)->op & DECODED_INDEX_MASK) < 256 ? &instruction_direct[(d)->op & DECODED_INDEX_MASK] \
+	                                      : &instruction_prefixed[((d)->op & DECODED_INDEX_MASK) - 256])
+
+/**
+ * Auxiliary function
+ * @brief Decodes the instruction at a given address of the cached region
+ *        (the entry stays invalid if the instruction ends outside the window of its bank:
+ *        its last bytes would depend on the bank mapped next to it)
+ *
+ * @param cpu the CPU
+ * @param addr address of the opcode
+ * @param d (modified) decoded instruction
+ */
+static void cpu_decode(const cpu_t* cpu, addr_t addr, cpu_decoded_t* d)
+{
+	const data_t first_byte = cpu_read_at_idx(cpu, addr);
+	uint16_t index = first_byte;
+	if (first_byte == PREFIXED) {
+		index = (uint16_t) (256 + cpu_read_at_idx(cpu, (addr_t) (addr + 1)));
+	}
+	const instruction_t* lu = index < 256 ? &instruction_direct[index] : &instruction_prefixed[index - 256];
+
+	if (CPU_DECODE_OFFSET(addr) + lu->bytes > CPU_DECODE_BANK_SIZE) {
+		d->op = 0;
+		return;
+	}
+
+	switch (lu->bytes) {
+	case 2:
+		d->operand = cpu_read_at_idx(cpu, (addr_t) (addr + 1));
+		break;
+	case 3:
+		d->operand = FROM_GameBoy_16(cpu_read16_at_idx(cpu, (addr_t) (addr + 1)));
+		break;
+	default:
+		d->operand = 0;
+		break;
+	}
+	d->op = (uint16_t) (DECODED_VALID | (cpu_handler_kind(lu->family) << DECODED_KIND_SHIFT) | index);
+}
+
+// ==== see cpu.h =======================================================
+void cpu_decode_cache_invalidate(cpu_t* cpu, addr_t start, addr_t end)
+{
+	if (cpu == NULL || cpu->decoded[0] == NULL || start > CPU_DECODE_CACHE_END) {
+		return;
+	}
+	if (end > CPU_DECODE_CACHE_END) {
+		end = CPU_DECODE_CACHE_END;
+	}
+	for (size_t addr = start; addr <= end; ++addr) {
+		cpu->decoded[CPU_DECODE_WINDOW(addr)][CPU_DECODE_OFFSET(addr)].op = 0;
+	}
+}
+
+// ==== see cpu.h =======================================================
+int cpu_decode_cache_map(cpu_t* cpu, addr_t start, size_t bank)
+{
+	// check arguments validity
+	M_REQUIRE_NON_NULL(cpu);
+	M_REQUIRE(start <= CPU_DECODE_CACHE_END && CPU_DECODE_OFFSET(start) == 0, ERR_ADDRESS,
+	          "%04X is not the start of a window of the decode cache", start);
+	if (cpu->decoded_banks == NULL) {
+		// no cache at all
+		return ERR_NONE;
+	}
+
+	if (bank >= cpu->nb_decoded_banks) {
+		cpu_decoded_t** banks = realloc(cpu->decoded_banks, (bank + 1) * sizeof(cpu_decoded_t*));
+		M_REQUIRE_NON_NULL_CUSTOM_ERR(banks, ERR_MEM);
+		memset(banks + cpu->nb_decoded_banks, 0, (bank + 1 - cpu->nb_decoded_banks) * sizeof(cpu_decoded_t*));
+		cpu->decoded_banks = banks;
+		cpu->nb_decoded_banks = bank + 1;
+	}
+	if (cpu->decoded_banks[bank] == NULL) {
+		M_EXIT_IF_NULL(cpu->decoded_banks[bank] = calloc(CPU_DECODE_BANK_SIZE, sizeof(cpu_decoded_t)), CPU_DECODE_BANK_SIZE * sizeof(cpu_decoded_t));
+	}
+
+	cpu->decoded[CPU_DECODE_WINDOW(start)] = cpu->decoded_banks[bank];
+	return ERR_NONE;
+}
+
+/**
+ * Auxiliary function
+ * @brief Bus write hook of the cached region: forgets the instructions whose bytes were overwritten
+ *
+ * @param owner the CPU
+ * @param addr address written to
+ * @return error code
+ */
+static int cpu_decode_cache_hook(void* owner, addr_t addr)
+{
+	// an instruction is at most 3 bytes long
+	cpu_decode_cache_invalidate((cpu_t*) owner, addr >= 2 ? (addr_t) (addr - 2) : 0, addr);
+	return ERR_NONE;
+}
+
+// ==== see cpu.h =======================================================
+int cpu_decode_cache_create(cpu_t* cpu)
+{
+	// check arguments validity
+	M_REQUIRE_NON_NULL(cpu);
+	M_REQUIRE_NON_NULL(cpu->bus);
+
+	if (cpu->decoded_banks == NULL) {
+		M_EXIT_IF_NULL(cpu->decoded_banks = calloc(CPU_DECODE_WINDOWS, sizeof(cpu_decoded_t*)), CPU_DECODE_WINDOWS * sizeof(cpu_decoded_t*));
+		cpu->nb_decoded_banks = CPU_DECODE_WINDOWS;
+		for (addr_t w = 0; w < CPU_DECODE_WINDOWS; ++w) {
+			M_EXIT_IF_ERR(cpu_decode_cache_map(cpu, (addr_t) (CPU_DECODE_CACHE_START + w * CPU_DECODE_BANK_SIZE), w));
+		}
+		M_EXIT_IF_ERR(bus_hook_register(*(cpu->bus), CPU_DECODE_CACHE_START, CPU_DECODE_CACHE_END, cpu_decode_cache_hook, cpu));
+	}
+	return ERR_NONE;
+}
 
 
 
@@ -327,7 +1012,7 @@ static int cpu_do_cycle(cpu_t* cpu)
 		for(uint8_t i = 0; i < INTERRUPT_COUNT; ++i) {
 			if(bit_get((cpu->IE & cpu->IF), i)) {
 				upcoming_interrupt = i;
-				// We decided to use cpu_write here instead of CPU->IF because cpu_write directly updates the write_listener as needed.
+				// We decided to use cpu_write here instead of CPU->IF because cpu_write also notifies the bus write hooks as needed.
 				uint8_t old_reg_IF = (cpu_read_at_idx(cpu, REG_IF));
 				bit_unset(&old_reg_IF, i);
 				M_EXIT_IF_ERR(cpu_write_at_idx(cpu, REG_IF, old_reg_IF));
@@ -340,6 +1025,27 @@ static int cpu_do_cycle(cpu_t* cpu)
 		
 		// Otherwise, do the normal procedure
 	} else {
+		cpu->instructions++;
+
+		// code in ROM is predecoded: execute it straight from the cache, with its operand
+		if (cpu->PC <= CPU_DECODE_CACHE_END && cpu->decoded[CPU_DECODE_WINDOW(cpu->PC)] != NULL) {
+			cpu_decoded_t* d = &cpu->decoded[CPU_DECODE_WINDOW(cpu->PC)][CPU_DECODE_OFFSET(cpu->PC)];
+			if (!(d->op & DECODED_VALID)) {
+				cpu_decode(cpu, cpu->PC, d);
+			}
+			if (d->op & DECODED_VALID) {
+				cpu->operand = d->operand;
+				cpu->operand_cached = 1;
+#ifdef CPU_THREADED
+				const int err = cpu_execute(decoded_instruction(d), cpu);
+#else
+				const int err = cpu_handlers[decoded_kind(d)](decoded_instruction(d), cpu);
+#endif
+				cpu->operand_cached = 0;
+				return err;
+			}
+		}
+
 		// read the opcode and transform it into an instruction to pass it as an argument
 		data_t first_byte = cpu_read_at_idx(cpu, cpu->PC);
 		if(first_byte != PREFIXED) {
@@ -363,9 +1069,6 @@ int cpu_cycle(cpu_t* cpu)
     M_REQUIRE_NON_NULL(cpu);
     M_REQUIRE_NON_NULL(cpu->bus);
     
-	// reset the write_listener to only listen once to each write
-	cpu->write_listener = 0;
-	
 	if(cpu->idle_time > 0) {
 		cpu->idle_time = (uint8_t) (cpu->idle_time - 1);
 		return ERR_NONE;
@@ -384,12 +1087,43 @@ int cpu_cycle(cpu_t* cpu)
     return ERR_NONE;
 }
 
+// ======================================================================
+/**
+ * See cpu.h
+ */
+uint64_t cpu_cycles_to_event(const cpu_t* cpu)
+{
+	if (cpu == NULL) {
+		return 0;
+	}
+	// a paused cpu only wakes up when an interrupt it listens to is raised,
+	// i.e. after an event of another component
+	if (cpu->HALT == 1 && cpu->idle_time == 0 && (cpu->IE & cpu->IF) == 0) {
+		return UINT64_MAX;
+	}
+	return cpu->idle_time;
+}
+
+// ======================================================================
+/**
+ * See cpu.h
+ */
+int cpu_skip(cpu_t* cpu, uint64_t cycles)
+{
+	// check arguments validity
+	M_REQUIRE_NON_NULL(cpu);
+
+	cpu->idle_time = (uint8_t) (cycles < cpu->idle_time ? cpu->idle_time - cycles : 0);
+
+	return ERR_NONE;
+}
+
 // ======================================================================
 /**
  * See cpu.h
  */
 void cpu_request_interrupt(cpu_t* cpu, interrupt_t i) {
-	// We decided to use cpu_write here instead of CPU->IF because cpu_write directly updates the write_listener as needed.
+	// We decided to use cpu_write here instead of CPU->IF because cpu_write also notifies the bus write hooks as needed.
 	// However, as the timer unit-test do not call cpu_plug, this particular unit-test doesn't link bus[REG_IF] with CPU->IF, 
 	// so the unit-test fails when checking for CPU.IF
 	// We then added the cpu->IF line because it do no harm to the regular operation but still allows to pass the unit-test-timer
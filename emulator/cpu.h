@@ -33,6 +33,16 @@ typedef enum {
 
 #define numbers_of_reg_pairs	4
 
+// region whose code is predecoded (boot ROM and cartridge ROM banks)
+#define CPU_DECODE_CACHE_START 0x0000
+#define CPU_DECODE_CACHE_END   0x7FFF
+#define CPU_DECODE_CACHE_SIZE ((CPU_DECODE_CACHE_END - CPU_DECODE_CACHE_START)+1)
+// the region is made of windows (one per ROM bank mapped), each of them predecoded in the cache of its bank
+#define CPU_DECODE_BANK_SIZE   0x4000
+#define CPU_DECODE_WINDOWS     (CPU_DECODE_CACHE_SIZE / CPU_DECODE_BANK_SIZE)
+#define CPU_DECODE_WINDOW(addr)  (((addr) - CPU_DECODE_CACHE_START) / CPU_DECODE_BANK_SIZE)
+#define CPU_DECODE_OFFSET(addr)  (((addr) - CPU_DECODE_CACHE_START) % CPU_DECODE_BANK_SIZE)
+
 #define registers_union(X, Y, XY) \
 	union { \
 		struct { \
@@ -44,6 +54,36 @@ typedef enum {
 
 
 
+//=========================================================================
+/**
+ * @brief Type to represent a predecoded instruction (see cpu_decode_cache_create)
+ *        op packs a validity bit, the handler of the instruction family and the index of the
+ *        instruction in the opcode tables; operand holds its immediate (n8, e8 or n16)
+ */
+typedef struct {
+	uint16_t op;
+	uint16_t operand;
+} cpu_decoded_t;
+
+//=========================================================================
+/**
+ * @brief Kinds of ALU operations whose flags are only computed when F is read
+ */
+typedef enum {
+	LAZY_NONE, LAZY_ADD, LAZY_SUB, LAZY_INC, LAZY_DEC
+} lazy_op_t;
+
+/**
+ * @brief Type to represent the last flag-setting operation not yet written to F
+ *        (x and y are its operands, c its input carry, or the carry flag kept by INC/DEC)
+ */
+typedef struct {
+	uint8_t op;
+	uint8_t x;
+	uint8_t y;
+	bit_t c;
+} lazy_flags_t;
+
 //=========================================================================
 /**
  * @brief Type to represent CPU
@@ -61,9 +101,15 @@ typedef struct {
 	uint8_t IE;
 	uint8_t IF;
 	bit_t HALT;
-	component_t high_ram;
-	addr_t write_listener;
 	uint8_t idle_time;
+	component_t high_ram;
+	uint16_t operand;
+	bit_t operand_cached;
+	cpu_decoded_t* decoded[CPU_DECODE_WINDOWS]; // cache of the bank mapped in each window (NULL: no cache)
+	cpu_decoded_t** decoded_banks;              // caches of the banks seen so far, allocated on first use
+	size_t nb_decoded_banks;
+	uint64_t instructions; // number of instructions retired
+	lazy_flags_t lazy; // pending flags, F is only valid when lazy.op == LAZY_NONE (see cpu_F_get)
 } cpu_t;
 
 //=========================================================================
@@ -76,6 +122,28 @@ typedef struct {
 int cpu_cycle(cpu_t* cpu);
 
 
+/**
+ * @brief Number of cycles before the CPU has to be cycled again
+ *        (0 if it must be cycled on the very next cycle)
+ *
+ * @param cpu the CPU
+ * @return number of cycles during which cpu_cycle would only wait,
+ *         UINT64_MAX if the cpu is paused until an interrupt
+ */
+uint64_t cpu_cycles_to_event(const cpu_t* cpu);
+
+
+/**
+ * @brief Runs several waiting CPU cycles at once
+ *        (cycles for which cpu_cycles_to_event tells that nothing happens)
+ *
+ * @param cpu (modified), the CPU which shall wait
+ * @param cycles number of cycles to skip
+ * @return error code
+ */
+int cpu_skip(cpu_t* cpu, uint64_t cycles);
+
+
 /**
  * @brief Plugs a bus into the cpu
  *
@@ -96,6 +164,16 @@ int cpu_plug(cpu_t* cpu, bus_t* bus);
  */
 int cpu_init(cpu_t* cpu);
 
+/**
+ * @brief Same as cpu_init(), the high RAM being allocated in an arena
+ *
+ * @param cpu cpu to start
+ * @param arena arena to allocate the high RAM from (NULL: heap)
+ *
+ * @return error code
+ */
+int cpu_init_in(cpu_t* cpu, mem_arena_t* arena);
+
 
 /**
  * @brief Frees a cpu
@@ -105,6 +183,45 @@ int cpu_init(cpu_t* cpu);
 void cpu_free(cpu_t* cpu);
 
 
+/**
+ * @brief Creates the predecoded instruction cache of the cpu
+ *        Instructions fetched from [CPU_DECODE_CACHE_START, CPU_DECODE_CACHE_END] are decoded once
+ *        and then executed from the cache; code in RAM is still decoded at each fetch
+ *        (as are the instructions that end in another window, see cpu_decode_cache_map()).
+ *        Writes to the region invalidate the instructions they hit (the cpu registers a bus write hook).
+ *
+ * @param cpu cpu, already plugged to its bus
+ * @return error code
+ */
+int cpu_decode_cache_create(cpu_t* cpu);
+
+
+/**
+ * @brief Selects the predecoded instructions of a window of the cached region, when a memory bank
+ *        is mapped there: each bank keeps its own cache, so a bank switch forgets nothing
+ *        (at the cost of CPU_DECODE_BANK_SIZE entries per bank ever mapped).
+ *        The windows start with banks 0 and 1.
+ *
+ * @param cpu cpu
+ * @param start first address of the window (CPU_DECODE_BANK_SIZE aligned)
+ * @param bank number of the bank now mapped in the window
+ * @return error code
+ */
+int cpu_decode_cache_map(cpu_t* cpu, addr_t start, size_t bank);
+
+
+/**
+ * @brief Forgets the predecoded instructions starting in a range of addresses
+ *        (to be called whenever the memory mapped on the cached region changes otherwise than
+ *        by a bank switch, e.g. the bootrom)
+ *
+ * @param cpu cpu
+ * @param start first address to invalidate
+ * @param end last address to invalidate
+ */
+void cpu_decode_cache_invalidate(cpu_t* cpu, addr_t start, addr_t end);
+
+
 /**
  * @brief Set an interruption
  */
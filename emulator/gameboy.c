@@ -8,10 +8,14 @@
 
 #include "gameboy.h"
 #include "bootrom.h"
+#include "cpu-registers.h" // cpu_F_sync
+
+#include <inttypes.h> // PRIu64
 
 /**
  * Auxiliary function
- * @brief Prints out the characters sent to the serial port of the gameboy
+ * @brief Prints out the characters sent to the serial port of the gameboy,
+ *        or hands them to the receiver set by gameboy_set_serial_output()
  *
  * @param gameboy pointer to gameboy
  * @param addr address to listen to whether there has been a writing to
@@ -22,24 +26,83 @@
 	static int blargg_bus_listener(gameboy_t* gameboy, addr_t addr);
 #endif
 
+/**
+ * @brief Defines a write hook (see bus.h) forwarding to the bus listener of a component
+ */
+#define bus_hook_adapter(name, type, listener) \
+	static int name(void* owner, addr_t addr) { \
+		return listener((type*) owner, addr); \
+	}
+
+bus_hook_adapter(timer_hook, gbtimer_t, timer_bus_listener)
+bus_hook_adapter(bootrom_hook, gameboy_t, bootrom_bus_listener)
+#ifdef BLARGG
+	bus_hook_adapter(blargg_hook, gameboy_t, blargg_bus_listener)
+#endif
+bus_hook_adapter(lcdc_hook, lcdc_t, lcdc_bus_listener)
+bus_hook_adapter(joypad_hook, joypad_t, joypad_bus_listener)
+
+/**
+ * Auxiliary function
+ * @brief Sync hook (see bus.h) of the timer: the cpu accesses its registers during the current cycle,
+ *        after the timer has run it
+ */
+static int timer_sync_hook(void* owner, addr_t addr)
+{
+	(void) addr;
+	gameboy_t* gameboy = owner;
+	return timer_sync(&gameboy->timer, gameboy->cycles + 1);
+}
+
 
 #define component_setup(index, name) \
-	M_EXIT_IF_ERR(component_create( &(gameboy->components[index]), MEM_SIZE(name))); \
+	M_EXIT_IF_ERR(component_create_in( &(gameboy->components[index]), &gameboy->arena, MEM_SIZE(name))); \
 	M_EXIT_IF_ERR(bus_plug(gameboy->bus, &(gameboy->components[index]), name ## _START, name ## _END))
 
-// ==== see gameboy.h ========================================
-int gameboy_create(gameboy_t* gameboy, const char* filename) {
-	// check arguments validity
-	M_REQUIRE_NON_NULL(gameboy);
-	M_REQUIRE_NON_NULL(filename);
-	
-	// start the booting state of the gameboy, i.e. activate the bootrom
-	gameboy->boot = 1;
-	// initialize its components, bus and cycle fields to null
-	memset(gameboy->components, 0, GB_NB_COMPONENTS*sizeof(component_t));
-	memset(gameboy->bus, 0, BUS_SIZE*sizeof(data_t*));
-	gameboy->cycles = 1;
-	
+/**
+ * Auxiliary function
+ * @brief Size of the arena holding the memories of a gameboy
+ *
+ * @param ram_size size of the external RAM allocated with them (0 if none)
+ * @return size in bytes
+ */
+static size_t gameboy_arena_size(size_t ram_size)
+{
+	const size_t blocks = mem_arena_block(MEM_SIZE(BOOT_ROM)) + mem_arena_block(MEM_SIZE(VIDEO_RAM))
+	                      + mem_arena_block(ram_size) + mem_arena_block(MEM_SIZE(WORK_RAM))
+	                      + mem_arena_block(MEM_SIZE(GRAPH_RAM)) + mem_arena_block(MEM_SIZE(USELESS))
+	                      + mem_arena_block(MEM_SIZE(REGISTERS)) + mem_arena_block(HIGH_RAM_SIZE + 1);
+	// the components, the boot ROM and the high RAM
+	return mem_arena_size(blocks, GB_NB_COMPONENTS + 2);
+}
+
+/**
+ * Auxiliary function
+ * @brief Creates all the parts of a gameboy but its cartridge. On error, what was created is
+ *        left for gameboy_setup() to free.
+ *
+ * @param gameboy pointer to gameboy to create, its cartridge being initialized
+ * @param filename file of the cartridge, NULL if it was read from memory
+ * @return error code
+ */
+static int gameboy_assemble(gameboy_t* gameboy, const char* filename) {
+	cartridge_t* cartridge = &(gameboy->cartridge);
+
+	// all its memories (but the ROM and a RAM kept in a save file) are in one block, in the order of their addresses
+	M_EXIT_IF_ERR(mem_arena_create(&gameboy->arena, gameboy_arena_size(cartridge_ram_alloc_size(cartridge, filename))));
+
+	// create its bootrom component (plugged over the cartridge below)
+	component_t* bootrom = &(gameboy->bootrom);
+	M_EXIT_IF_ERR(bootrom_init_in(bootrom, &gameboy->arena));
+
+	// create and plug its video_RAM component
+	component_setup(1, VIDEO_RAM);
+
+	// create and plug its extern_RAM component, holding all the RAM banks of the cartridge
+	// (kept in the save file of a battery-backed cartridge)
+	M_EXIT_IF_ERR(cartridge_ram_create(cartridge, &(gameboy->components[2]), filename, &gameboy->arena));
+	M_EXIT_IF_ERR(bus_plug(gameboy->bus, &(gameboy->components[2]), EXTERN_RAM_START, EXTERN_RAM_END));
+
 	// create and plug its work_RAM component
 	component_setup(0, WORK_RAM);
 	
@@ -48,39 +111,31 @@ int gameboy_create(gameboy_t* gameboy, const char* filename) {
 	M_EXIT_IF_ERR(component_shared(&echo_RAM, &(gameboy->components[0])));
 	M_EXIT_IF_ERR(bus_plug(gameboy->bus, &echo_RAM, ECHO_RAM_START, ECHO_RAM_END));
 
-	// create and plug its video_RAM component
-	component_setup(1, VIDEO_RAM);
-
-	// create and plug its extern_RAM component
-	component_setup(2, EXTERN_RAM);
-
 	// create and plug its graph_RAM component
 	component_setup(3, GRAPH_RAM);
 
-	// create and plug its registers component
-	component_setup(4, REGISTERS);
-
 	// create and plug its useless component
 	component_setup(5, USELESS);
+
+	// create and plug its registers component
+	component_setup(4, REGISTERS);
 	
 	//create and plug its cpu component
 	cpu_t* cpu = &(gameboy->cpu);
-	M_EXIT_IF_ERR(cpu_init(cpu));
+	M_EXIT_IF_ERR(cpu_init_in(cpu, &gameboy->arena));
 	M_EXIT_IF_ERR(cpu_plug(cpu, &gameboy->bus));
+	M_EXIT_IF_ERR(cpu_decode_cache_create(cpu));
 	
 	//initialize its timer
 	gbtimer_t* timer = &(gameboy->timer);
 	M_EXIT_IF_ERR(timer_init(timer, &gameboy->cpu));
-	
-	// create its cartridge component
-	// It will be replugged at the same time the bootrom is disabled (see bootrom_bus_listener in bootrom.c).
-	cartridge_t* cartridge = &(gameboy->cartridge);
-	M_EXIT_IF_ERR(cartridge_init(cartridge, filename));
+	M_EXIT_IF_ERR(timer_resync(timer, gameboy->cycles));
+
+	// the cartridge maps the banks it selects
+	M_EXIT_IF_ERR(cartridge_connect(cartridge, cpu, &(gameboy->components[2]), &gameboy->cycles));
 	M_EXIT_IF_ERR(cartridge_plug(&(gameboy->cartridge), gameboy->bus));
 
-	// create and plug its bootrom component
-	component_t* bootrom = &(gameboy->bootrom);
-	M_EXIT_IF_ERR(bootrom_init(bootrom));
+	// plug its bootrom component
 	M_EXIT_IF_ERR(bootrom_plug(bootrom, gameboy->bus));
 	
 	//init and plug its screen
@@ -90,9 +145,87 @@ int gameboy_create(gameboy_t* gameboy, const char* filename) {
 	//init and plug its joypad
 	M_EXIT_IF_ERR(joypad_init_and_plug(&(gameboy->pad), cpu));
 
+	// register the components that react to writes on their registers
+	M_EXIT_IF_ERR(bus_hook_register(gameboy->bus, TIMER_START, TIMER_END, timer_hook, timer));
+	M_EXIT_IF_ERR(bus_sync_register(gameboy->bus, TIMER_START, TIMER_END, timer_sync_hook, gameboy));
+	M_EXIT_IF_ERR(bus_hook_register(gameboy->bus, REG_BOOT_ROM_DISABLE, REG_BOOT_ROM_DISABLE, bootrom_hook, gameboy));
+	#ifdef BLARGG
+		M_EXIT_IF_ERR(bus_hook_register(gameboy->bus, BLARGG_REG, BLARGG_REG, blargg_hook, gameboy));
+	#endif
+	M_EXIT_IF_ERR(bus_hook_register(gameboy->bus, REGS_LCDC_START, REGS_LCDC_END, lcdc_hook, &gameboy->screen));
+	M_EXIT_IF_ERR(bus_hook_register(gameboy->bus, REG_P1, REG_P1, joypad_hook, &gameboy->pad));
+
 	return ERR_NONE;
 }
 
+/**
+ * Auxiliary function
+ * @brief Creates a gameboy, its cartridge being read either from a file or from a ROM image in memory
+ *
+ * @param gameboy pointer to gameboy to create
+ * @param filename file of the cartridge, NULL to use rom instead
+ * @param rom content of the cartridge (when filename is NULL)
+ * @param rom_size size of rom
+ * @return error code
+ */
+static int gameboy_setup(gameboy_t* gameboy, const char* filename, const data_t* rom, size_t rom_size) {
+	// start the booting state of the gameboy, i.e. activate the bootrom
+	gameboy->boot = 1;
+	// initialize its components, bus and cycle fields to null
+	// (and the parts that own memory, for an error to free only what was created)
+	memset(gameboy->components, 0, GB_NB_COMPONENTS*sizeof(component_t));
+	memset(&gameboy->arena, 0, sizeof(gameboy->arena));
+	memset(gameboy->bus, 0, sizeof(bus_t));
+	memset(&gameboy->cpu, 0, sizeof(gameboy->cpu));
+	memset(&gameboy->screen, 0, sizeof(gameboy->screen));
+	gameboy->cycles = 1;
+	gameboy->serial_out = NULL;
+	gameboy->serial_ctx = NULL;
+	M_EXIT_IF_ERR(scheduler_init(&gameboy->sched));
+	
+	// create its cartridge component
+	// It will be replugged at the same time the bootrom is disabled (see bootrom_bus_listener in bootrom.c).
+	cartridge_t* cartridge = &(gameboy->cartridge);
+	if (filename != NULL) {
+		M_EXIT_IF_ERR(cartridge_init(cartridge, filename));
+	} else {
+		M_EXIT_IF_ERR(cartridge_init_from_memory(cartridge, rom, rom_size));
+	}
+
+	const int err = gameboy_assemble(gameboy, filename);
+	if (err != ERR_NONE) {
+		// in the reverse order of their creation; the other memories all belong to the arena
+		lcdc_free(&gameboy->screen);
+		if (gameboy->cpu.bus != NULL) {
+			cpu_free(&gameboy->cpu);
+		}
+		// unmaps and unlocks the save file, if any
+		cartridge_ram_free(cartridge, &(gameboy->components[2]));
+		// releases the ROM shared with the other gameboys
+		cartridge_free(cartridge);
+		mem_arena_free(&gameboy->arena);
+	}
+	return err;
+}
+
+// ==== see gameboy.h ========================================
+int gameboy_create(gameboy_t* gameboy, const char* filename) {
+	// check arguments validity
+	M_REQUIRE_NON_NULL(gameboy);
+	M_REQUIRE_NON_NULL(filename);
+
+	return gameboy_setup(gameboy, filename, NULL, 0);
+}
+
+// ==== see gameboy.h ========================================
+int gameboy_create_from_memory(gameboy_t* gameboy, const data_t* rom, size_t size) {
+	// check arguments validity
+	M_REQUIRE_NON_NULL(gameboy);
+	M_REQUIRE_NON_NULL(rom);
+
+	return gameboy_setup(gameboy, NULL, rom, size);
+}
+
 // ==== see gameboy.h ========================================
 void gameboy_free(gameboy_t* gameboy) {
 	// check arguments validity
@@ -100,7 +233,12 @@ void gameboy_free(gameboy_t* gameboy) {
 		//free and unplug each of the 6 components of the gameboy
 		for(int i = 0; i < GB_NB_COMPONENTS; ++i) {
 			bus_unplug(gameboy->bus, &(gameboy->components[i]));
-			component_free(&(gameboy->components[i]));
+			if (i == 2) {
+				// the external RAM may be the mapping of a save file
+				cartridge_ram_free(&gameboy->cartridge, &(gameboy->components[i]));
+			} else {
+				component_free(&(gameboy->components[i]));
+			}
 		}
 		//free the cartridge and the cpu
 		bus_unplug(gameboy->bus, &gameboy->bootrom);
@@ -109,43 +247,336 @@ void gameboy_free(gameboy_t* gameboy) {
 		cartridge_free(&gameboy->cartridge);
 		cpu_free(&gameboy->cpu);
 		lcdc_free(&gameboy->screen);
+		// last, the memories of all the components above
+		mem_arena_free(&gameboy->arena);
 	} 
 }
 
+// ==== see gameboy.h ========================================
+int gameboy_set_serial_output(gameboy_t* gameboy, gameboy_serial_fn receiver, void* ctx) {
+	// check arguments validity
+	M_REQUIRE_NON_NULL(gameboy);
+
+	gameboy->serial_out = receiver;
+	gameboy->serial_ctx = ctx;
+	return ERR_NONE;
+}
+
+/**
+ * Auxiliary function
+ * @brief Computes the next cycle at which each component has something to do
+ *
+ * @param gameboy pointer to gameboy
+ * @return error code
+ */
+static int gameboy_schedule(gameboy_t* gameboy)
+{
+	const uint64_t now = gameboy->cycles;
+	scheduler_t* sched = &gameboy->sched;
+
+	// the cpu executes its next instruction (or checks the interrupts) once its idle time is over;
+	// when paused (HALT) it sleeps until another component raises an interrupt
+	const uint64_t cpu_wait = cpu_cycles_to_event(&gameboy->cpu);
+	M_EXIT_IF_ERR(scheduler_set(sched, SCHED_CPU, cpu_wait == UINT64_MAX ? SCHED_NEVER : now + cpu_wait));
+
+	// the timer only has to run when it raises its interrupt,
+	// TIMA and DIV are brought up to date when the cpu accesses them
+	M_EXIT_IF_ERR(scheduler_set(sched, SCHED_TIMER, gameboy->timer.event == UINT64_MAX ? SCHED_NEVER : gameboy->timer.event));
+
+	// the screen copies one byte per cycle during a DMA, otherwise it waits for its next mode change
+	// (next_cycle stays at UINT64_MAX while the screen is off, it is switched on by a write, i.e. by a cpu event)
+	const lcdc_t* lcdc = &gameboy->screen;
+	M_EXIT_IF_ERR(scheduler_set(sched, SCHED_LCDC, lcdc->DMA_to <= GRAPH_RAM_END ? now : lcdc->next_cycle));
+
+	#ifdef BLARGG_EARLY
+		// the artificial VBLANK is requested at the end of the cycles preceding a multiple of the period
+		M_EXIT_IF_ERR(scheduler_set(sched, SCHED_VBLANK, (now / BLARGG_VBLANK_PERIOD + 1) * BLARGG_VBLANK_PERIOD - 1));
+	#endif
+
+	return ERR_NONE;
+}
+
+/**
+ * Auxiliary function
+ * @brief Simulates one cycle of every component of the gameboy
+ *
+ * @param gameboy pointer to gameboy
+ * @return error code
+ */
+static int gameboy_cycle(gameboy_t* gameboy)
+{
+	if (gameboy->timer.event <= gameboy->cycles) {
+		M_EXIT_IF_ERR(timer_sync(&gameboy->timer, gameboy->cycles + 1));
+	}
+	M_EXIT_IF_ERR(cpu_cycle(&gameboy->cpu));
+	M_EXIT_IF_ERR(lcdc_cycle(&gameboy->screen, gameboy->cycles));
+
+	// the bus listeners are called by the write hooks, as soon as a write hits their registers
+	gameboy->cycles++;
+
+	#ifdef BLARGG_EARLY
+		if (((gameboy->cycles) % BLARGG_VBLANK_PERIOD) == 0) {
+			cpu_request_interrupt(&gameboy->cpu, VBLANK);
+		}
+	#endif
+
+	return ERR_NONE;
+}
 
 // ==== see gameboy.h ========================================
 int gameboy_run_until(gameboy_t* gameboy, uint64_t cycle) {
 	// check arguments validity
 	M_REQUIRE_NON_NULL(gameboy);
+	const uint64_t start_frame = gameboy->cycles / FRAME_TOTAL_CYCLES;
 
-	for (uint64_t i = gameboy->cycles; i < cycle; i++) {
+	while (gameboy->cycles < cycle) {
+		M_EXIT_IF_ERR(gameboy_schedule(gameboy));
+		uint64_t next = scheduler_next(&gameboy->sched);
+		if (next > cycle) {
+			next = cycle;
+		}
 
-		M_EXIT_IF_ERR(timer_cycle(&gameboy->timer));
-		M_EXIT_IF_ERR(cpu_cycle(&gameboy->cpu));
-		M_EXIT_IF_ERR(lcdc_cycle(&gameboy->screen, i));
+		// nothing happens until the next event: jump straight to it
+		if (next > gameboy->cycles) {
+			const uint64_t skipped = next - gameboy->cycles;
+			M_EXIT_IF_ERR(cpu_skip(&gameboy->cpu, skipped));
+			gameboy->cycles = next;
+		}
 
-		
-		//call each listener
-		M_EXIT_IF_ERR(timer_bus_listener(&gameboy->timer, gameboy->cpu.write_listener));
-		M_EXIT_IF_ERR(bootrom_bus_listener(gameboy, gameboy->cpu.write_listener));
-		#ifdef BLARGG
-			M_EXIT_IF_ERR(blargg_bus_listener(gameboy, gameboy->cpu.write_listener));
-		#endif
-		M_EXIT_IF_ERR(lcdc_bus_listener(&gameboy->screen, gameboy->cpu.write_listener));
-		M_EXIT_IF_ERR(joypad_bus_listener(&gameboy->pad, gameboy->cpu.write_listener));
+		if (gameboy->cycles < cycle) {
+			M_EXIT_IF_ERR(gameboy_cycle(gameboy));
+		}
+	}
 
+	// the flags of the last ALU operation are computed lazily: write them to F for whoever looks at the cpu,
+	// as are the registers of the timer
+	cpu_F_sync(&gameboy->cpu);
+	M_EXIT_IF_ERR(timer_sync(&gameboy->timer, gameboy->cycles));
 
-		
-		gameboy->cycles++;
+	// the battery-backed RAM is written back at most once per (emulated) frame
+	if (gameboy->cycles / FRAME_TOTAL_CYCLES != start_frame) {
+		cartridge_ram_sync(&gameboy->cartridge, 0);
+	}
 
-        #ifdef BLARGG_EARLY
-			if (((gameboy->cycles)%17556) == 0) {
-				cpu_request_interrupt(&gameboy->cpu, VBLANK);
-			}
-		#endif
-		
+	return ERR_NONE;
+}
+
+// "GBSS" read as a little-endian integer, first field of a save state
+#define GB_STATE_MAGIC 0x53534247u
+
+// cartridge header bytes identifying the game of a save state (header and global checksums)
+#define CARTRIDGE_CHECKSUMS_START 0x014D
+#define CARTRIDGE_CHECKSUMS_SIZE  3
+
+/**
+ * @brief Layout of a save state: plain values only, the pointers between the components
+ *        are those of the gameboy the state is restored into.
+ *        Only its external RAM varies in size with the cartridge: it comes last.
+ */
+typedef struct {
+	uint32_t magic;
+	uint32_t version;
+	uint64_t size;
+	data_t cartridge_checksums[CARTRIDGE_CHECKSUMS_SIZE];
+	bit_t boot;
+	uint64_t cycles;
+
+	// cpu
+	uint16_t AF, BC, DE, HL, PC, SP;
+	alu_output_t alu;
+	bit_t IME;
+	uint8_t IE;
+	uint8_t IF;
+	bit_t HALT;
+	uint8_t idle_time;
+	uint16_t operand;
+	bit_t operand_cached;
+	uint64_t instructions;
+	lazy_flags_t lazy;
+
+	// timer
+	uint16_t timer_counter;
+
+	// screen controller
+	bit_t lcd_on;
+	uint64_t lcd_next_cycle;
+	uint64_t lcd_on_cycle;
+	addr_t DMA_from;
+	addr_t DMA_to;
+	data_t window_y;
+
+	// joypad
+	data_t pad_intern;
+	uint8_t pad_old_state;
+	uint8_t keys_state[NB_GB_KEY_ROWS];
+
+	// memories, in the order of gameboy_t.components, then the high RAM of the cpu
+	data_t work_ram[MEM_SIZE(WORK_RAM)];
+	data_t video_ram[MEM_SIZE(VIDEO_RAM)];
+	mbc_regs_t mbc;
+	data_t graph_ram[MEM_SIZE(GRAPH_RAM)];
+	data_t registers[MEM_SIZE(REGISTERS)];
+	data_t useless[MEM_SIZE(USELESS)];
+	data_t high_ram[HIGH_RAM_SIZE + 1];
+
+	// external RAM: all the banks of the cartridge, of the size of its component (see gameboy_state_ram_size)
+	uint64_t extern_ram_size;
+	data_t extern_ram[];
+} gameboy_state_t;
+
+// copies between a component and the matching memory of a save state, both of the same size
+#define state_save_memory(state, field, c)  memcpy((state)->field, (c)->mem->memory, sizeof((state)->field))
+#define state_load_memory(state, field, c)  memcpy((c)->mem->memory, (state)->field, sizeof((state)->field))
+
+/**
+ * Auxiliary function
+ * @brief Size of the external RAM saved with a state: the cartridge_ram_size() bytes of the cartridge,
+ *        at least the one bank mapped on the bus (see cartridge_ram_create)
+ */
+static inline size_t gameboy_state_ram_size(const gameboy_t* gameboy)
+{
+	return gameboy->components[2].mem->size;
+}
+
+// ==== see gameboy.h ========================================
+size_t gameboy_state_size(const gameboy_t* gameboy) {
+	return gameboy == NULL ? 0 : sizeof(gameboy_state_t) + gameboy_state_ram_size(gameboy);
+}
+
+// ==== see gameboy.h ========================================
+int gameboy_save_state(const gameboy_t* gameboy, void* state, size_t size) {
+	// check arguments validity
+	M_REQUIRE_NON_NULL(gameboy);
+	M_REQUIRE_NON_NULL(state);
+	M_REQUIRE(size >= gameboy_state_size(gameboy), ERR_BAD_PARAMETER, "state buffer too small (%zu < %zu)", size, gameboy_state_size(gameboy));
+
+	gameboy_state_t* st = state;
+	memset(st, 0, sizeof(*st));
+	st->magic = GB_STATE_MAGIC;
+	st->version = GB_STATE_VERSION;
+	st->size = gameboy_state_size(gameboy);
+	memcpy(st->cartridge_checksums, gameboy->cartridge.c.mem->memory + CARTRIDGE_CHECKSUMS_START, CARTRIDGE_CHECKSUMS_SIZE);
+	st->boot = gameboy->boot;
+	st->cycles = gameboy->cycles;
+
+	const cpu_t* cpu = &gameboy->cpu;
+	st->AF = cpu->AF;
+	st->BC = cpu->BC;
+	st->DE = cpu->DE;
+	st->HL = cpu->HL;
+	st->PC = cpu->PC;
+	st->SP = cpu->SP;
+	st->alu = cpu->alu;
+	st->IME = cpu->IME;
+	st->IE = cpu->IE;
+	st->IF = cpu->IF;
+	st->HALT = cpu->HALT;
+	st->idle_time = cpu->idle_time;
+	st->operand = cpu->operand;
+	st->operand_cached = cpu->operand_cached;
+	st->instructions = cpu->instructions;
+	st->lazy = cpu->lazy;
+
+	st->timer_counter = gameboy->timer.counter;
+
+	const lcdc_t* lcd = &gameboy->screen;
+	st->lcd_on = lcd->on;
+	st->lcd_next_cycle = lcd->next_cycle;
+	st->lcd_on_cycle = lcd->on_cycle;
+	st->DMA_from = lcd->DMA_from;
+	st->DMA_to = lcd->DMA_to;
+	st->window_y = lcd->window_y;
+
+	const joypad_t* pad = &gameboy->pad;
+	st->pad_intern = pad->intern;
+	st->pad_old_state = pad->old_state;
+	memcpy(st->keys_state, pad->keys_state, sizeof(st->keys_state));
+
+	state_save_memory(st, work_ram, &gameboy->components[0]);
+	state_save_memory(st, video_ram, &gameboy->components[1]);
+	memcpy(&st->mbc, &gameboy->cartridge.regs, sizeof(st->mbc));
+	state_save_memory(st, graph_ram, &gameboy->components[3]);
+	state_save_memory(st, registers, &gameboy->components[4]);
+	state_save_memory(st, useless, &gameboy->components[5]);
+	state_save_memory(st, high_ram, &cpu->high_ram);
+	st->extern_ram_size = gameboy_state_ram_size(gameboy);
+	memcpy(st->extern_ram, gameboy->components[2].mem->memory, gameboy_state_ram_size(gameboy));
+
+	return ERR_NONE;
+}
+
+// ==== see gameboy.h ========================================
+int gameboy_load_state(gameboy_t* gameboy, const void* state, size_t size) {
+	// check arguments validity
+	M_REQUIRE_NON_NULL(gameboy);
+	M_REQUIRE_NON_NULL(state);
+	M_REQUIRE(size >= sizeof(gameboy_state_t), ERR_BAD_PARAMETER, "state too small (%zu < %zu)", size, sizeof(gameboy_state_t));
+
+	const gameboy_state_t* st = state;
+	M_REQUIRE(st->magic == GB_STATE_MAGIC && st->version == GB_STATE_VERSION,
+	          ERR_BAD_PARAMETER, "not a save state of version %d", GB_STATE_VERSION);
+	M_REQUIRE(st->extern_ram_size == gameboy_state_ram_size(gameboy) && st->size == gameboy_state_size(gameboy) && size >= st->size,
+	          ERR_BAD_PARAMETER, "save state of %" PRIu64 " bytes of external RAM, %zu expected", st->extern_ram_size, gameboy_state_ram_size(gameboy));
+	M_REQUIRE(memcmp(st->cartridge_checksums, gameboy->cartridge.c.mem->memory + CARTRIDGE_CHECKSUMS_START, CARTRIDGE_CHECKSUMS_SIZE) == 0,
+	          ERR_BAD_PARAMETER, "save state of another cartridge%s", "");
+
+	// the banks selected then are mapped again,
+	// and the boot ROM is mapped over the cartridge as long as the boot is not over
+	memcpy(&gameboy->cartridge.regs, &st->mbc, sizeof(st->mbc));
+	M_EXIT_IF_ERR(cartridge_plug(&gameboy->cartridge, gameboy->bus));
+	if (st->boot) {
+		M_EXIT_IF_ERR(bootrom_plug(&gameboy->bootrom, gameboy->bus));
 	}
-	
+	if (st->boot != gameboy->boot) {
+		cpu_decode_cache_invalidate(&gameboy->cpu, CPU_DECODE_CACHE_START, CPU_DECODE_CACHE_END);
+		gameboy->boot = st->boot;
+	}
+	gameboy->cycles = st->cycles;
+
+	cpu_t* cpu = &gameboy->cpu;
+	cpu->AF = st->AF;
+	cpu->BC = st->BC;
+	cpu->DE = st->DE;
+	cpu->HL = st->HL;
+	cpu->PC = st->PC;
+	cpu->SP = st->SP;
+	cpu->alu = st->alu;
+	cpu->IME = st->IME;
+	cpu->IE = st->IE;
+	cpu->IF = st->IF;
+	cpu->HALT = st->HALT;
+	cpu->idle_time = st->idle_time;
+	cpu->operand = st->operand;
+	cpu->operand_cached = st->operand_cached;
+	cpu->instructions = st->instructions;
+	cpu->lazy = st->lazy;
+
+	gameboy->timer.counter = st->timer_counter;
+
+	lcdc_t* lcd = &gameboy->screen;
+	lcd->on = st->lcd_on;
+	lcd->next_cycle = st->lcd_next_cycle;
+	lcd->on_cycle = st->lcd_on_cycle;
+	lcd->DMA_from = st->DMA_from;
+	lcd->DMA_to = st->DMA_to;
+	lcd->window_y = st->window_y;
+
+	joypad_t* pad = &gameboy->pad;
+	pad->intern = st->pad_intern;
+	pad->old_state = st->pad_old_state;
+	memcpy(pad->keys_state, st->keys_state, sizeof(pad->keys_state));
+
+	state_load_memory(st, work_ram, &gameboy->components[0]);
+	state_load_memory(st, video_ram, &gameboy->components[1]);
+	state_load_memory(st, graph_ram, &gameboy->components[3]);
+	state_load_memory(st, registers, &gameboy->components[4]);
+	state_load_memory(st, useless, &gameboy->components[5]);
+	state_load_memory(st, high_ram, &cpu->high_ram);
+	memcpy(gameboy->components[2].mem->memory, st->extern_ram, gameboy_state_ram_size(gameboy));
+
+	// the timer restarts from its registers
+	M_EXIT_IF_ERR(timer_resync(&gameboy->timer, gameboy->cycles));
+
 	return ERR_NONE;
 }
 
@@ -156,7 +587,12 @@ int gameboy_run_until(gameboy_t* gameboy, uint64_t cycle) {
 		M_REQUIRE_NON_NULL(gameboy);
 		
 		if(addr == BLARGG_REG) {
-			printf("%c", cpu_read_at_idx(&(gameboy->cpu), BLARGG_REG));
+			const data_t byte = cpu_read_at_idx(&(gameboy->cpu), BLARGG_REG);
+			if (gameboy->serial_out != NULL) {
+				gameboy->serial_out(gameboy->serial_ctx, byte);
+			} else {
+				printf("%c", byte);
+			}
 		}
 		return ERR_NONE;
 	}
@@ -18,6 +18,7 @@
 #include "timer.h"
 #include "lcdc.h"
 #include "joypad.h"
+#include "scheduler.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -25,9 +26,26 @@ extern "C" {
 
 #define GB_NB_COMPONENTS 6
 
+/**
+ * @brief Receiver of the bytes sent on the serial port (BLARGG_REG), see gameboy_set_serial_output()
+ *
+ * @param ctx context given at registration
+ * @param byte byte written by the game
+ */
+typedef void (*gameboy_serial_fn)(void* ctx, data_t byte);
+
 /**
  * @brief Game Boy data structure.
  *        Regroups everything needed to simulate the Game Boy.
+ *
+ *        A gameboy_t holds (or owns through pointers) all of its state. Besides constant lookup
+ *        tables, the emulator has only two process-wide objects, both synchronized:
+ *        - the list of the ROM files mapped in memory (cartridge.c), shared by the cartridges
+ *          of a same file, which is only used under its mutex;
+ *        - the kernels of the bulk bit vector operations (bit_vector.c), selected once under
+ *          pthread_once and never changed afterwards.
+ *        Any number of gameboys can thus be created, run and freed concurrently, each one
+ *        by a single thread at a time (a given gameboy is not meant to be shared unlocked).
  */
  typedef struct gameboy_ {
 	bus_t bus;
@@ -42,18 +60,36 @@ extern "C" {
 	bit_t boot;
 	lcdc_t screen;
 	joypad_t pad;
+	scheduler_t sched;
+	gameboy_serial_fn serial_out; // NULL: the serial output is printed on stdout (with BLARGG)
+	void* serial_ctx;
+	mem_arena_t arena; // memories of the components, in the order of their addresses (see gameboy_create())
 } gameboy_t;
 
 // Number of Game Boy cycles per second (= 2^20)
 #define GB_CYCLES_PER_S  (((uint64_t) 1) << 20)
 
 /**
- * @brief Creates a gameboy
+ * @brief Creates a gameboy.
+ *        The memories of its components are allocated at once, in one page-aligned block (gameboy->arena)
+ *        where they are in the order of their addresses: from the boot ROM to the high RAM,
+ *        without the ROM of the cartridge nor a RAM kept in a save file (which are file mappings).
  *
  * @param gameboy pointer to gameboy to create
  */
 int gameboy_create(gameboy_t* gameboy, const char* filename);
 
+/**
+ * @brief Creates a gameboy whose cartridge is a ROM image already in memory
+ *        (the image is copied: the buffer can be reused or freed afterwards, and shared between gameboys)
+ *
+ * @param gameboy pointer to gameboy to create
+ * @param rom content of the cartridge
+ * @param size size of rom, in bytes
+ * @return error code
+ */
+int gameboy_create_from_memory(gameboy_t* gameboy, const data_t* rom, size_t size);
+
 /**
  * @brief Destroys a gameboy
  *
@@ -61,11 +97,60 @@ int gameboy_create(gameboy_t* gameboy, const char* filename);
  */
 void gameboy_free(gameboy_t* gameboy);
 
+/**
+ * @brief Redirects the bytes sent on the serial port of a gameboy (only listened to with BLARGG).
+ *        Must be called after gameboy_create(); a NULL receiver restores the printing on stdout.
+ *
+ * @param gameboy pointer to gameboy
+ * @param receiver function called for each byte sent
+ * @param ctx context passed to the receiver
+ * @return error code
+ */
+int gameboy_set_serial_output(gameboy_t* gameboy, gameboy_serial_fn receiver, void* ctx);
+
 /**
  * @brief Runs a gamefor for/until a given cycle
+ *        Only the cycles at which some component has an event are simulated one by one,
+ *        components are brought up to date in one step over the cycles in between.
  */
 int gameboy_run_until(gameboy_t* gameboy, uint64_t cycle);
 
+// Version of the layout of the save states, to be bumped whenever it changes
+#define GB_STATE_VERSION 3
+
+/**
+ * @brief Size of the buffer needed to save the state of a gameboy,
+ *        which depends on the size of the external RAM of its cartridge
+ *
+ * @param gameboy pointer to gameboy
+ * @return size in bytes (0 if gameboy is NULL)
+ */
+size_t gameboy_state_size(const gameboy_t* gameboy);
+
+/**
+ * @brief Saves the whole machine state of a gameboy (registers, timer, screen controller, joypad,
+ *        boot flag, cycle count, bank controller of the cartridge and all the RAMs) into one contiguous, versioned, binary blob.
+ *        Neither the ROMs nor the displayed image are part of it; the blob is in native byte order,
+ *        meant to be restored by the same build of the emulator.
+ *
+ * @param gameboy pointer to gameboy to save
+ * @param state buffer to write the state into
+ * @param size size of the buffer, at least gameboy_state_size(gameboy)
+ * @return error code
+ */
+int gameboy_save_state(const gameboy_t* gameboy, void* state, size_t size);
+
+/**
+ * @brief Restores a state saved by gameboy_save_state() into a gameboy created with the same cartridge
+ *        (the image on screen is only updated by the lines drawn afterwards)
+ *
+ * @param gameboy pointer to gameboy to restore
+ * @param state blob written by gameboy_save_state()
+ * @param size size of the blob
+ * @return error code (ERR_BAD_PARAMETER for a blob of another version or of another cartridge)
+ */
+int gameboy_load_state(gameboy_t* gameboy, const void* state, size_t size);
+
 /**
  * @brief Adresses of the GameBoy
  *
@@ -105,6 +190,9 @@ int gameboy_run_until(gameboy_t* gameboy, uint64_t cycle);
 #define REGS_LCDC_END   0xFF4C
 #define REG_BOOT_ROM_DISABLE  0xFF50
 
+// Cycles between two artificial VBLANK interrupts with BLARGG_EARLY
+#define BLARGG_VBLANK_PERIOD 17556
+
 
 #ifdef __cplusplus
 }
@@ -0,0 +1,268 @@
+/**
+ * @file gb-bench.c
+ * @brief Headless benchmark: runs ROMs for a fixed number of frames and reports
+ *        the emulation speed of each of them (as a table and as JSON)
+ *
+ * @date 2020
+ */
+
+#define _XOPEN_SOURCE 700 // clock_gettime, getrusage, dup, opendir
+
+#include "gameboy.h"
+#include "util.h"  // for zero_init_var()
+#include "error.h"
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <inttypes.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/resource.h>
+
+#define BENCH_DEFAULT_FRAMES 600 // 10 s of Game Boy time
+#define BENCH_DEFAULT_JSON   "gb-bench.json"
+#define BENCH_MAX_ROMS       64
+
+// the ROMs run when none is given on the command line
+static const char* const default_rom_dirs[] = { "tests/data", "tests/data/blargg_roms" };
+
+/**
+ * @brief Measures of the run of one ROM
+ */
+typedef struct {
+    const char* rom;
+    bit_t loaded;
+    int error;
+    uint64_t cycles;
+    uint64_t instructions;
+    double seconds;
+    long peak_rss_kib;
+} bench_result_t;
+
+// ======================================================================
+static void usage(const char* pgm)
+{
+    fprintf(stderr, "usage:    %s [-f frames] [-j json_file] [rom ...]\n", pgm);
+    fprintf(stderr, "          without rom, runs the ROMs of");
+    for (size_t i = 0; i < sizeof(default_rom_dirs) / sizeof(*default_rom_dirs); ++i) {
+        fprintf(stderr, " %s/", default_rom_dirs[i]);
+    }
+    fprintf(stderr, "\nexample:  %s -f %d -j %s\n", pgm, BENCH_DEFAULT_FRAMES, BENCH_DEFAULT_JSON);
+}
+
+// ======================================================================
+static int cmp_names(const void* a, const void* b)
+{
+    return strcmp(*(const char* const*) a, *(const char* const*) b);
+}
+
+/**
+ * Auxiliary function
+ * @brief Adds the ROM files (.gb and .bin) of a directory to the list, sorted by name
+ *
+ * @return number of ROMs added
+ */
+static size_t list_roms(const char* dir_name, char** roms, size_t max)
+{
+    DIR* dir = opendir(dir_name);
+    if (dir == NULL) return 0;
+
+    size_t count = 0;
+    const struct dirent* entry = NULL;
+    while (count < max && (entry = readdir(dir)) != NULL) {
+        const char* ext = strrchr(entry->d_name, '.');
+        if (ext == NULL || (strcmp(ext, ".gb") != 0 && strcmp(ext, ".bin") != 0)) continue;
+
+        const size_t size = strlen(dir_name) + 1 + strlen(entry->d_name) + 1;
+        roms[count] = malloc(size);
+        if (roms[count] == NULL) break;
+        snprintf(roms[count], size, "%s/%s", dir_name, entry->d_name);
+        ++count;
+    }
+    closedir(dir);
+
+    qsort(roms, count, sizeof(*roms), cmp_names);
+    return count;
+}
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Runs one ROM for the given number of cycles; the serial output of the ROM is discarded
+ */
+static void bench_rom(bench_result_t* result, uint64_t cycles)
+{
+    gameboy_t gb;
+    zero_init_var(gb);
+
+    // with BLARGG the serial port is echoed on stdout: keep the report readable
+    fflush(stdout);
+    const int saved_stdout = dup(STDOUT_FILENO);
+    const int null_fd = open("/dev/null", O_WRONLY);
+    if (saved_stdout >= 0 && null_fd >= 0) dup2(null_fd, STDOUT_FILENO);
+
+    result->error = gameboy_create(&gb, result->rom);
+    result->loaded = result->error == ERR_NONE;
+    if (result->loaded) {
+        struct timespec start, end;
+        const uint64_t first = gb.cycles;
+        clock_gettime(CLOCK_MONOTONIC, &start);
+        result->error = gameboy_run_until(&gb, first + cycles);
+        clock_gettime(CLOCK_MONOTONIC, &end);
+
+        result->seconds = (double) (end.tv_sec - start.tv_sec) + (double) (end.tv_nsec - start.tv_nsec) * 1e-9;
+        result->cycles = gb.cycles - first;
+        result->instructions = gb.cpu.instructions;
+    }
+    gameboy_free(&gb);
+
+    fflush(stdout);
+    if (saved_stdout >= 0) {
+        dup2(saved_stdout, STDOUT_FILENO);
+        close(saved_stdout);
+    }
+    if (null_fd >= 0) close(null_fd);
+
+    // ROMs are run one after the other: this is the peak of the process so far
+    struct rusage usage;
+    result->peak_rss_kib = getrusage(RUSAGE_SELF, &usage) == 0 ? usage.ru_maxrss : -1;
+}
+
+#define cycles_per_s(r) ((r)->seconds > 0 ? (double) (r)->cycles / (r)->seconds : 0.0)
+
+// ======================================================================
+static void print_table(FILE* out, const bench_result_t* results, size_t count, unsigned frames)
+{
+    fprintf(out, "%-32s %7s %9s %12s %9s %14s %10s\n",
+            "ROM", "frames", "wall (s)", "Mcycles/s", "x real", "instructions", "RSS (KiB)");
+
+    for (size_t i = 0; i < count; ++i) {
+        const bench_result_t* r = &results[i];
+        const char* name = strrchr(r->rom, '/') != NULL ? strrchr(r->rom, '/') + 1 : r->rom;
+        if (r->error != ERR_NONE) {
+            fprintf(out, "%-32s %s: %s\n", name, r->loaded ? "error" : "cannot load",
+                    ERR_MESSAGES[r->error - ERR_NONE]);
+            continue;
+        }
+        fprintf(out, "%-32s %7u %9.3f %12.2f %9.1f %14" PRIu64 " %10ld\n",
+                name, frames, r->seconds, cycles_per_s(r) * 1e-6,
+                cycles_per_s(r) / (double) GB_CYCLES_PER_S, r->instructions, r->peak_rss_kib);
+    }
+}
+
+// ======================================================================
+static void print_json_string(FILE* out, const char* s)
+{
+    fputc('"', out);
+    for (; *s != '\0'; ++s) {
+        if (*s == '"' || *s == '\\') fputc('\\', out);
+        fputc(*s, out);
+    }
+    fputc('"', out);
+}
+
+static void print_json(FILE* out, const bench_result_t* results, size_t count, unsigned frames)
+{
+    fprintf(out, "{\n  \"frames\": %u,\n  \"cycles_per_frame\": %d,\n  \"gb_cycles_per_s\": %" PRIu64 ",\n  \"roms\": [",
+            frames, FRAME_TOTAL_CYCLES, GB_CYCLES_PER_S);
+
+    for (size_t i = 0; i < count; ++i) {
+        const bench_result_t* r = &results[i];
+        fprintf(out, "%s\n    { \"rom\": ", i == 0 ? "" : ",");
+        print_json_string(out, r->rom);
+        if (r->error != ERR_NONE) {
+            fprintf(out, ", \"loaded\": %s, \"error\": ", r->loaded ? "true" : "false");
+            print_json_string(out, ERR_MESSAGES[r->error - ERR_NONE]);
+            fprintf(out, " }");
+            continue;
+        }
+        fprintf(out, ", \"cycles\": %" PRIu64 ", \"wall_s\": %.6f, \"cycles_per_s\": %.0f"
+                ", \"realtime_multiple\": %.3f, \"instructions\": %" PRIu64 ", \"peak_rss_kib\": %ld }",
+                r->cycles, r->seconds, cycles_per_s(r), cycles_per_s(r) / (double) GB_CYCLES_PER_S,
+                r->instructions, r->peak_rss_kib);
+    }
+
+    fprintf(out, "\n  ]\n}\n");
+}
+
+// ======================================================================
+int main(int argc, char* argv[])
+{
+    unsigned frames = BENCH_DEFAULT_FRAMES;
+    const char* json_file = BENCH_DEFAULT_JSON;
+
+    int opt = 0;
+    while ((opt = getopt(argc, argv, "f:j:h")) != -1) {
+        switch (opt) {
+        case 'f':
+            frames = (unsigned) strtoul(optarg, NULL, 10);
+            break;
+        case 'j':
+            json_file = optarg;
+            break;
+        default:
+            usage(argv[0]);
+            return opt == 'h' ? 0 : 1;
+        }
+    }
+    if (frames == 0) {
+        usage(argv[0]);
+        return 1;
+    }
+
+    char* listed[BENCH_MAX_ROMS];
+    size_t nb_listed = 0;
+    const char* roms[BENCH_MAX_ROMS];
+    size_t count = 0;
+
+    if (optind < argc) {
+        for (int i = optind; i < argc && count < BENCH_MAX_ROMS; ++i) {
+            roms[count++] = argv[i];
+        }
+    } else {
+        for (size_t d = 0; d < sizeof(default_rom_dirs) / sizeof(*default_rom_dirs); ++d) {
+            nb_listed += list_roms(default_rom_dirs[d], listed + nb_listed, BENCH_MAX_ROMS - nb_listed);
+        }
+        for (size_t i = 0; i < nb_listed; ++i) {
+            roms[count++] = listed[i];
+        }
+    }
+    if (count == 0) {
+        fprintf(stderr, "no ROM to run\n");
+        usage(argv[0]);
+        return 1;
+    }
+
+    bench_result_t results[BENCH_MAX_ROMS];
+    memset(results, 0, sizeof(results));
+    const uint64_t cycles = (uint64_t) frames * FRAME_TOTAL_CYCLES;
+    int err = ERR_NONE;
+
+    for (size_t i = 0; i < count; ++i) {
+        results[i].rom = roms[i];
+        bench_rom(&results[i], cycles);
+        // a file that is not a cartridge we can load (e.g. sml.bin, a bare tile image) is only reported
+        if (results[i].loaded && results[i].error != ERR_NONE) err = results[i].error;
+    }
+
+    print_table(stdout, results, count, frames);
+
+    FILE* json = fopen(json_file, "w");
+    if (json == NULL) {
+        fprintf(stderr, "cannot open \"%s\" for writing\n", json_file);
+        err = ERR_IO;
+    } else {
+        print_json(json, results, count, frames);
+        fclose(json);
+        printf("JSON report written to %s\n", json_file);
+    }
+
+    for (size_t i = 0; i < nb_listed; ++i) {
+        free(listed[i]);
+    }
+
+    return err;
+}
@@ -15,6 +15,7 @@
 #include "sidlib.h"
 #include "lcdc.h"
 #include "gameboy.h"
+#include "rewind.h"
 
 // Key press bits
 #define MY_KEY_UP_BIT    0x01
@@ -27,11 +28,26 @@
 #define MY_KEY_SELECT_BIT	 0x80
 
 #define SCALING_FACTOR 	3
+#define REFRESH_MS      40
 
-// Global variables
-gameboy_t gb;
-struct timeval start;
-struct timeval paused;
+// the last minute is kept for rewinding (one snapshot per refresh, a keyframe every second)
+#define REWIND_SECONDS            60
+#define REWIND_SNAPSHOTS          (REWIND_SECONDS * 1000 / REFRESH_MS)
+#define REWIND_KEYFRAME_INTERVAL  (1000 / REFRESH_MS)
+#define REWIND_RING_SIZE          (4 << 20)
+
+/**
+ * @brief State of the simulation.
+ *        The image generator of sidlib takes no user data: the simulator shows a single
+ *        gameboy per process, kept private to this file (the emulator itself has no global).
+ */
+static struct {
+    gameboy_t gb;
+    struct timeval start;
+    struct timeval paused;
+    rewind_t rewind;
+    bit_t rewinding; // while the rewind key is held
+} sim;
 
 // ======================================================================
 /**
@@ -60,18 +76,18 @@ uint64_t get_time_in_GB_cyles_since(struct timeval* from)
 
 // ======================================================================
 /**
- * @brief Executes the conversion between the pixels of the graphical interface and the provided data
+ * @brief Moves the start time so that the gameboy is on time after having been rewound
  *
- * @param pixels pixels of the graphical interface
- * @param row number of rows of the screen
- * @param col number of cols of the screen
- * @param width width of the screen
- * @param grey the number to set the pixel to
+ * @param cycles cycle the gameboy is at
  */
-static void set_grey(guchar* pixels, int row, int col, int width, guchar grey)
+static void set_start_at_cycle(uint64_t cycles)
 {
-    const size_t i = (size_t) (3 * (row * width + col)); // 3 = RGB
-    pixels[i+2] = pixels[i+1] = pixels[i] = grey;
+    struct timeval time_now;
+    struct timeval elapsed;
+    gettimeofday(&time_now, NULL);
+    elapsed.tv_sec = (time_t) (cycles / GB_CYCLES_PER_S);
+    elapsed.tv_usec = (suseconds_t) ((cycles % GB_CYCLES_PER_S) * 1000000 / GB_CYCLES_PER_S);
+    timersub(&time_now, &elapsed, &sim.start);
 }
 
 // ======================================================================
@@ -84,21 +100,30 @@ static void set_grey(guchar* pixels, int row, int col, int width, guchar grey)
  */
 static void generate_image(guchar* pixels, int height, int width)
 {
-    // define a given amount of gameboy cycles
-    uint64_t cycle = get_time_in_GB_cyles_since(&start);
-    // run the gameboy until the predefined number of cycles
-	int err = gameboy_run_until(&gb, cycle);
-    if (err != ERR_NONE) fprintf(stderr, "gameboy_run_until() returns error: %i\n", err);
-    
-    // loop through the pixels, take the data and set the pixel accordingly
-    for (int h = 0; h < height; h++) {
-        for (int w = 0; w < width; w++) {
-            uint8_t pixel_gameboy = 0;
-            int err = image_get_pixel(&pixel_gameboy, &(gb.screen.display), w/SCALING_FACTOR, h/SCALING_FACTOR);
-            if (err != ERR_NONE) fprintf(stderr, "image_get_pixel() returns error: %i\n", err);
-            set_grey(pixels, h, w,  width, 255 - 85 * pixel_gameboy);
-        } 
+    if (sim.rewinding) {
+        // one snapshot back per refresh; the frame following it is run to be displayed
+        if (rewind_pop(&sim.rewind, &sim.gb) == ERR_NONE) {
+            int err = gameboy_run_until(&sim.gb, sim.gb.cycles + FRAME_TOTAL_CYCLES);
+            if (err != ERR_NONE) fprintf(stderr, "gameboy_run_until() returns error: %i\n", err);
+            set_start_at_cycle(sim.gb.cycles);
+        }
+    } else {
+        // define a given amount of gameboy cycles
+        uint64_t cycle = get_time_in_GB_cyles_since(&sim.start);
+        // run the gameboy until the predefined number of cycles
+        int err = gameboy_run_until(&sim.gb, cycle);
+        if (err != ERR_NONE) fprintf(stderr, "gameboy_run_until() returns error: %i\n", err);
+        err = rewind_push(&sim.rewind, &sim.gb);
+        if (err != ERR_NONE) fprintf(stderr, "rewind_push() returns error: %i\n", err);
     }
+    
+    // the whole frame at once, each pixel becoming a SCALING_FACTOR-wide square of grey
+    (void) height;
+    static const uint8_t greys[PALETTE_COLOR_COUNT][IMAGE_RGB_BYTES] = {
+        { 255, 255, 255 }, { 170, 170, 170 }, { 85, 85, 85 }, { 0, 0, 0 }
+    };
+    int err = image_to_rgb24_scaled(pixels, (size_t) (IMAGE_RGB_BYTES * width), &(sim.gb.screen.display), greys, SCALING_FACTOR);
+    if (err != ERR_NONE) fprintf(stderr, "image_to_rgb24_scaled() returns error: %i\n", err);
 }
 
 // ======================================================================
@@ -149,16 +174,21 @@ static gboolean keypress_handler(guint keyval, gpointer data)
     case GDK_KEY_Page_Down:
         do_key(START);
         return TRUE;
+
+    case 'R':
+    case 'r':
+        sim.rewinding = 1;
+        return TRUE;
         
 	case GDK_KEY_space: 
 		if(psd->timeout_id > 0) {
-		    gettimeofday(&paused, NULL);
+		    gettimeofday(&sim.paused, NULL);
 		} else {
 			struct timeval time_now;
 			gettimeofday(&time_now, NULL);
-			timersub(&time_now, &paused, &paused);
-			timeradd(&start, &paused, &start);
-			timerclear(&paused);
+			timersub(&time_now, &sim.paused, &sim.paused);
+			timeradd(&sim.start, &sim.paused, &sim.start);
+			timerclear(&sim.paused);
 		}
     }
 
@@ -214,6 +244,11 @@ static gboolean keyrelease_handler(guint keyval, gpointer data)
     case GDK_KEY_Page_Down:
         do_key(START);
         return TRUE;
+
+    case 'R':
+    case 'r':
+        sim.rewinding = 0;
+        return TRUE;
     }
 
     return FALSE;
@@ -230,32 +265,41 @@ int main(int argc, char *argv[])
 
     const char* const filename = argv[1];
     // create the gameboy
-    int err = gameboy_create(&gb, filename);
+    int err = gameboy_create(&sim.gb, filename);
     // in case of error return with error code
     if (err != ERR_NONE) {
-        gameboy_free(&gb);
+        gameboy_free(&sim.gb);
         fprintf(stderr, "Error while creating gameboy: %i\n", err);
         return err;
     }    
     
-    // initialize the global variable start
-    int errtime = gettimeofday(&start, NULL);
+    // initialize the start time of the simulation
+    int errtime = gettimeofday(&sim.start, NULL);
     // in case of error return with error code
     if (errtime != ERR_NONE) {
-        gameboy_free(&gb);
+        gameboy_free(&sim.gb);
         fprintf(stderr, "Error while init time: %i\n", errtime);
         return errtime;
     }
-    // initialize the global variable paused
-    timerclear(&paused);
+    // initialize the pause time of the simulation
+    timerclear(&sim.paused);
+
+    // keep the last states for rewinding
+    err = rewind_init(&sim.rewind, &sim.gb, REWIND_SNAPSHOTS, REWIND_RING_SIZE, REWIND_KEYFRAME_INTERVAL);
+    if (err != ERR_NONE) {
+        gameboy_free(&sim.gb);
+        fprintf(stderr, "Error while creating the rewind buffer: %i\n", err);
+        return err;
+    }
     
     // launch the program, generate image and run the gameboy cycle
     sd_launch(&argc, &argv,
-                  sd_init("Gameboy", LCD_WIDTH * SCALING_FACTOR, LCD_HEIGHT * SCALING_FACTOR, 40,
+                  sd_init("Gameboy", LCD_WIDTH * SCALING_FACTOR, LCD_HEIGHT * SCALING_FACTOR, REFRESH_MS,
                           generate_image, keypress_handler, keyrelease_handler));
 
     // free the gameboy at the end of execution
-    gameboy_free(&gb);
+    rewind_free(&sim.rewind);
+    gameboy_free(&sim.gb);
     
     return err;
 }
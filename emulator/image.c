@@ -18,6 +18,9 @@
 
 #define index_to_content_index(index) ((index)/ IMAGE_LINE_WORD_BITS)
 
+// bits of the last word of a line which are within its size
+#define last_word_mask(size) ((size) % IMAGE_LINE_WORD_BITS == 0 ? UINT32_MAX : UINT32_MAX >> (IMAGE_LINE_WORD_BITS - (size) % IMAGE_LINE_WORD_BITS))
+
 #define do_image_line(piml) do_imlc(piml, lsb); do_imlc(piml, msb); do_imlc(piml, opacity)
 
 // ======================================================================
@@ -114,6 +117,27 @@ int image_line_extract_wrap_ext(image_line_t* output, image_line_t iml, int64_t
     return valid(output);
 }
 
+// ======================================================================
+void image_word_map_colors(uint32_t* msb, uint32_t* lsb, palette_t map)
+{
+    // bit b of the color the palette maps color c to, on all the bits of a word
+#define COLOR_BIT(c, b) ((uint32_t) -(uint32_t) ((map >> (2 * (c) + (b))) & 1))
+    // selects per pixel the bit of its color: by lsb between colors 0/1 and 2/3, then by msb
+#define MAP_BIT(b) \
+    const uint32_t low_##b  = COLOR_BIT(0, b) ^ (l & (COLOR_BIT(0, b) ^ COLOR_BIT(1, b))); \
+    const uint32_t high_##b = COLOR_BIT(2, b) ^ (l & (COLOR_BIT(2, b) ^ COLOR_BIT(3, b))); \
+    const uint32_t out_##b  = low_##b ^ (m & (low_##b ^ high_##b))
+
+    const uint32_t m = *msb;
+    const uint32_t l = *lsb;
+    MAP_BIT(0);
+    MAP_BIT(1);
+    *lsb = out_0;
+    *msb = out_1;
+#undef MAP_BIT
+#undef COLOR_BIT
+}
+
 // ======================================================================
 int image_line_map_colors(image_line_t* output, image_line_t iml, palette_t map)
 {
@@ -129,69 +153,19 @@ int image_line_map_colors(image_line_t* output, image_line_t iml, palette_t map)
         return ERR_NONE;
     }
 
-    output->lsb = bit_vector_create(iml.lsb->size, 0);
-    output->msb = bit_vector_create(iml.msb->size, 0);
-    output->opacity = bit_vector_cpy(iml.opacity);
-
-    for (size_t i = 0; i < PALETTE_COLOR_COUNT; ++i) {
-        bit_vector_t* mask = NULL;
-
-        const bit_t color_bit_0 = (bit_t) (map & (1 << (i * 2    )));
-        const bit_t color_bit_1 = (bit_t) (map & (1 << (i * 2 + 1)));
-
-        if (color_bit_0 || color_bit_1) {
-            switch (i) {
-            case 0: {
-                bit_vector_t* tmp = bit_vector_not(bit_vector_cpy(iml.lsb));
-
-                if (tmp == NULL) {
-                    image_line_free(output);
-                    return ERR_MEM;
-                }
-
-                mask = bit_vector_and(bit_vector_not(bit_vector_cpy(iml.msb)), tmp);
-                bit_vector_free(&tmp);
-            } break;
-
-            case 1: {
-                mask = bit_vector_and(bit_vector_not(bit_vector_cpy(iml.msb)), iml.lsb);
-            } break;
-
-            case 2: {
-                mask = bit_vector_and(bit_vector_not(bit_vector_cpy(iml.lsb)), iml.msb);
-            } break;
-
-            case 3: {
-                mask = bit_vector_and(bit_vector_cpy(iml.lsb), iml.msb);
-            } break;
-            }
-
-            if (mask == NULL) {
-                image_line_free(output);
-                return ERR_MEM;
-            }
+    M_REQUIRE(iml.msb->size == iml.lsb->size, ERR_BAD_PARAMETER, "%s", "Sizes do not match");
 
-            if (color_bit_0) {
-                output->lsb = bit_vector_or(output->lsb, mask);
-
-                if (output->lsb == NULL) {
-                    image_line_free(output);
-                    return ERR_MEM;
-                }
-            }
-
-            if (color_bit_1) {
-                output->msb = bit_vector_or(output->msb, mask);
-
-                if (output->msb == NULL) {
-                    image_line_free(output);
-                    return ERR_MEM;
-                }
-            }
+    output->lsb = bit_vector_cpy(iml.lsb);
+    output->msb = bit_vector_cpy(iml.msb);
+    output->opacity = bit_vector_cpy(iml.opacity);
+    M_EXIT_IF_ERR(valid(output));
 
-            bit_vector_free(&mask);
-        }
+    for (size_t i = 0; i < size_to_content_size(iml.msb->size); ++i) {
+        image_word_map_colors(&output->msb->content[i], &output->lsb->content[i], map);
     }
+    // colors 0 mapped to others are out of the line
+    output->msb->content[size_to_content_size(iml.msb->size) - 1] &= last_word_mask(iml.msb->size);
+    output->lsb->content[size_to_content_size(iml.lsb->size) - 1] &= last_word_mask(iml.lsb->size);
 
     return ERR_NONE;
 }
@@ -203,32 +177,64 @@ int image_line_below_with_opacity(image_line_t* output, image_line_t iml1, image
     M_REQUIRE_NON_NULL_IMAGE_LINE(iml1);
     M_REQUIRE_NON_NULL_IMAGE_LINE(iml2);
     M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(iml1, iml2);
+    M_REQUIRE_NON_NULL(p_opacity);
+    M_REQUIRE(p_opacity->size == iml1.msb->size, ERR_BAD_PARAMETER, "%s", "Sizes do not match");
 
-    bit_vector_t* notopacity = bit_vector_not(bit_vector_cpy(p_opacity));
-
-    bit_vector_t* m_above_and_opacity    = bit_vector_and(bit_vector_cpy(iml2.msb), p_opacity );
-    bit_vector_t* l_above_and_opacity    = bit_vector_and(bit_vector_cpy(iml2.lsb), p_opacity );
-    bit_vector_t* m_below_and_notopacity = bit_vector_and(bit_vector_cpy(iml1.msb), notopacity);
-    bit_vector_t* l_below_and_notopacity = bit_vector_and(bit_vector_cpy(iml1.lsb), notopacity);
-
-    if (notopacity == NULL ||
-        m_above_and_opacity == NULL || m_below_and_notopacity == NULL ||
-        l_above_and_opacity == NULL || l_below_and_notopacity == NULL) {
-        bit_vector_free(&notopacity);
-        bit_vector_free(&m_above_and_opacity);
-        bit_vector_free(&m_below_and_notopacity);
-        bit_vector_free(&l_above_and_opacity);
-        bit_vector_free(&l_below_and_notopacity);
-        return ERR_MEM;
-    }
+    output->msb     = bit_vector_create(iml1.msb->size, 0);
+    output->lsb     = bit_vector_create(iml1.lsb->size, 0);
+    output->opacity = bit_vector_create(iml1.opacity->size, 0);
+    M_EXIT_IF_ERR(valid(output));
 
-    output->msb     = bit_vector_or(m_below_and_notopacity, m_above_and_opacity);
-    output->lsb     = bit_vector_or(l_below_and_notopacity, l_above_and_opacity);
-    output->opacity = bit_vector_or(bit_vector_cpy(iml1.opacity), p_opacity          );
+    // (below ^ above) & opacity ^ below: above where opaque, below elsewhere, without temporaries
+#define do_imlc(I, X) \
+    bit_vector_xor(bit_vector_and(bit_vector_xor_to(I->X, iml1.X, iml2.X), p_opacity), iml1.X)
 
-    bit_vector_free(&notopacity);
-    bit_vector_free(&m_above_and_opacity);
-    bit_vector_free(&l_above_and_opacity);
+    do_imlc(output, msb);
+    do_imlc(output, lsb);
+#undef do_imlc
+    bit_vector_or_to(output->opacity, iml1.opacity, p_opacity);
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+int image_line_map_below(image_line_t* output, image_line_t iml, palette_t map, const bit_vector_t* p_opacity, int64_t x)
+{
+    M_REQUIRE_NON_NULL(output);
+    M_REQUIRE_NON_NULL_IMAGE_LINE(*output);
+    M_REQUIRE_NON_NULL_IMAGE_LINE(iml);
+    M_REQUIRE(output->msb->size == output->lsb->size && output->lsb->size == output->opacity->size, ERR_BAD_PARAMETER,
+              "Incorrect sizes in output (%zu, %zu, %zu)", output->lsb->size, output->msb->size, output->opacity->size);
+    if (p_opacity == NULL) p_opacity = iml.opacity;
+    M_REQUIRE(iml.msb->size == iml.lsb->size && iml.lsb->size == p_opacity->size, ERR_BAD_PARAMETER,
+              "Incorrect sizes in image_line (%zu, %zu, %zu)", iml.lsb->size, iml.msb->size, p_opacity->size);
+
+    // pixel 32 w + j of output is pixel 32 (w + q) + r + j of iml
+    const int64_t r = ((-x % IMAGE_LINE_WORD_BITS) + IMAGE_LINE_WORD_BITS) % IMAGE_LINE_WORD_BITS;
+    const int64_t q = (-x - r) / IMAGE_LINE_WORD_BITS;
+    const int64_t nb = (int64_t) size_to_content_size(iml.msb->size);
+    const size_t words = size_to_content_size(output->msb->size);
+    uint32_t* const out_msb = output->msb->content;
+    uint32_t* const out_lsb = output->lsb->content;
+    uint32_t* const out_opacity = output->opacity->content;
+
+    // words q + w and q + w + 1 of the source planes (zero outside of them), as one 64-bit word
+#define PLANE_PAIR(plane) \
+    ((k >= 0 && k < nb ? (uint64_t) (plane)[k] : 0) | (k + 1 >= 0 && k + 1 < nb ? (uint64_t) (plane)[k + 1] << IMAGE_LINE_WORD_BITS : 0))
+
+    for (size_t w = 0; w < words; ++w) {
+        const int64_t k = q + (int64_t) w;
+        uint32_t msb = (uint32_t) (PLANE_PAIR(iml.msb->content) >> r);
+        uint32_t lsb = (uint32_t) (PLANE_PAIR(iml.lsb->content) >> r);
+        uint32_t opacity = (uint32_t) (PLANE_PAIR(p_opacity->content) >> r);
+        if (w == words - 1) opacity &= last_word_mask(output->msb->size);
+
+        image_word_map_colors(&msb, &lsb, map);
+        out_msb[w] = (out_msb[w] & ~opacity) | (msb & opacity);
+        out_lsb[w] = (out_lsb[w] & ~opacity) | (lsb & opacity);
+        out_opacity[w] |= opacity;
+    }
+#undef PLANE_PAIR
 
     return ERR_NONE;
 }
@@ -295,20 +301,33 @@ int image_create(image_t* pim, size_t width, size_t height)
     M_REQUIRE(width > 0, ERR_BAD_PARAMETER, "%s", "Parameter width is zero.");
     M_REQUIRE(height > 0, ERR_BAD_PARAMETER, "%s", "Parameter height is zero.");
 
-    pim->content = calloc(height, sizeof(image_line_t));
-    if (pim->content == NULL) return ERR_MEM;
-
+    // the bit vectors of the lines, each rounded up so that the next one is aligned
+    const size_t align = _Alignof(bit_vector_t);
+    const size_t stride = (bit_vector_sizeof(width) + align - 1) / align * align;
+    const size_t header = (height * sizeof(image_line_t) + align - 1) / align * align;
+    M_REQUIRE(height <= (SIZE_MAX - header) / (3 * stride), ERR_BAD_PARAMETER,
+              "Image too large (%zu x %zu)", width, height);
+
+    // zeroed: the padding of the planes is deterministic too
+    uint8_t* block = calloc(1, header + 3 * height * stride);
+    if (block == NULL) return ERR_MEM;
+
+    pim->content = (image_line_t*) block;
+    pim->planes = block + header;
+    pim->planes_size = 3 * height * stride;
+    pim->stride = stride;
     pim->height = height;
 
-    int error = ERR_NONE;
-    for (size_t i = 0; i < height && error == ERR_NONE; ++i) {
-        error = image_line_create(pim->content + i, width);
-    }
+#define do_imlc(I, X) \
+    I->X = bit_vector_init((bit_vector_t*) (pim->planes + (plane++ * height + y) * stride), width, 0)
 
-    if (error != ERR_NONE) {
-        image_free(pim);
-        return error;
+    for (size_t y = 0; y < height; ++y) {
+        size_t plane = 0;
+        image_line_t* line = pim->content + y;
+        // same order as do_image_line: lsb, msb, opacity
+        do_image_line(line);
     }
+#undef do_imlc
 
     return ERR_NONE;
 }
@@ -336,11 +355,15 @@ int image_get_pixel(uint8_t* output, image_t* pim, size_t x, size_t y)
     M_REQUIRE_NON_NULL(output);
     M_REQUIRE_NON_NULL(pim);
     M_REQUIRE(y < pim->height, ERR_BAD_PARAMETER, "Invalid Y parameter (%zu >= %zu)", y, pim->height);
-    M_REQUIRE(x < pim->content[y].msb->size, ERR_BAD_PARAMETER, "Invalid X parameter (%zu >= %zu)", x, pim->content[y].msb->size);
-    M_REQUIRE(x < pim->content[y].lsb->size, ERR_BAD_PARAMETER, "Invalid X parameter (%zu >= %zu)", x, pim->content[y].lsb->size);
 
-    *output = (uint8_t)((bit_vector_get(pim->content[y].msb, x) ? 0x2 : 0x0) |
-                        (bit_vector_get(pim->content[y].lsb, x) ? 0x1 : 0x0));
+    // straight from the planes: the lsb of line y, then its msb one plane further
+    const bit_vector_t* lsb = (const bit_vector_t*) (pim->planes + y * pim->stride);
+    const bit_vector_t* msb = (const bit_vector_t*) (pim->planes + (pim->height + y) * pim->stride);
+    M_REQUIRE(x < lsb->size, ERR_BAD_PARAMETER, "Invalid X parameter (%zu >= %zu)", x, lsb->size);
+
+    const uint32_t word = index_to_content_index(x);
+    const unsigned bit = x % IMAGE_LINE_WORD_BITS;
+    *output = (uint8_t) ((((msb->content[word] >> bit) & 1) << 1) | ((lsb->content[word] >> bit) & 1));
 
     return ERR_NONE;
 }
@@ -354,12 +377,60 @@ int image_own_line_content(image_t* pim, size_t y, image_line_t line)
     M_REQUIRE_NON_NULL_IMAGE_LINE(line);
     M_REQUIRE_MATCHING_IMAGE_LINE_SIZE(pim->content[y], line);
 
-#define do_imlc(I, X) \
-    bit_vector_free(&(I->content[y].X)); \
-    I->content[y].X = line.X
+    M_EXIT_IF_ERR(image_set_line(pim, y, line));
+    image_line_free(&line);
+    return ERR_NONE;
+}
+
+// ======================================================================
+int image_to_rgb24_scaled(uint8_t* rgb, size_t rowstride, const image_t* pim,
+                          const uint8_t colors[PALETTE_COLOR_COUNT][IMAGE_RGB_BYTES], size_t scale)
+{
+    M_REQUIRE_NON_NULL(rgb);
+    M_REQUIRE_NON_NULL(pim);
+    M_REQUIRE_NON_NULL(pim->planes);
+    M_REQUIRE_NON_NULL(colors);
+    M_REQUIRE(scale > 0 && scale <= IMAGE_RGB_MAX_SCALE, ERR_BAD_PARAMETER, "Invalid scale (%zu)", scale);
+
+    const size_t width = ((const bit_vector_t*) pim->planes)->size;
+    const size_t run = IMAGE_RGB_BYTES * scale;
+    M_REQUIRE(rowstride >= width * run, ERR_BAD_PARAMETER, "Rows too short (%zu < %zu)", rowstride, width * run);
+
+    // the scale RGB pixels each pixel value becomes, and those of two pixels in a row (value a + 4 b)
+    uint8_t runs[PALETTE_COLOR_COUNT * PALETTE_COLOR_COUNT][2 * IMAGE_RGB_BYTES * IMAGE_RGB_MAX_SCALE];
+    for (size_t v = 0; v < PALETTE_COLOR_COUNT * PALETTE_COLOR_COUNT; ++v) {
+        for (size_t i = 0; i < 2 * scale; ++i) {
+            memcpy(runs[v] + i * IMAGE_RGB_BYTES, colors[i < scale ? v % 4 : v / 4], IMAGE_RGB_BYTES);
+        }
+    }
+
+    for (size_t y = 0; y < pim->height; ++y) {
+        const uint32_t* lsb = ((const bit_vector_t*) (pim->planes + y * pim->stride))->content;
+        const uint32_t* msb = ((const bit_vector_t*) (pim->planes + (pim->height + y) * pim->stride))->content;
+        uint8_t* row = rgb + y * scale * rowstride;
+
+        // first row of the line, two pixels at a time
+        uint8_t* out = row;
+        size_t x = 0;
+        for (; x + 2 <= width; x += 2, out += 2 * run) {
+            const uint32_t shift = x % IMAGE_LINE_WORD_BITS;
+            const unsigned pair = ((lsb[x / IMAGE_LINE_WORD_BITS] >> shift) & 3) | (((msb[x / IMAGE_LINE_WORD_BITS] >> shift) & 3) << 2);
+            // pair is (l0, l1, m0, m1): values are m0 l0 and m1 l1
+            // copied in fixed-size chunks, which compilers turn into plain moves
+            const uint8_t* src = runs[(pair & 1) | ((pair >> 1) & 2) | ((pair << 1) & 4) | (pair & 8)];
+            for (size_t i = 0; i < 2 * run; i += 2 * IMAGE_RGB_BYTES) memcpy(out + i, src + i, 2 * IMAGE_RGB_BYTES);
+        }
+        if (x < width) {
+            const uint32_t shift = x % IMAGE_LINE_WORD_BITS;
+            memcpy(out, runs[((lsb[x / IMAGE_LINE_WORD_BITS] >> shift) & 1) | (((msb[x / IMAGE_LINE_WORD_BITS] >> shift) & 1) << 1)], run);
+        }
+
+        // the other rows are the same
+        for (size_t r = 1; r < scale; ++r) {
+            memcpy(row + r * rowstride, row, width * run);
+        }
+    }
 
-    do_image_line(pim);
-#undef do_imlc
     return ERR_NONE;
 }
 
@@ -368,11 +439,7 @@ void image_free(image_t* pim)
 {
     if (pim == NULL) return;
 
-    for (size_t i = 0; i < pim->height; ++i) {
-        image_line_free(pim->content + i);
-    }
-
-    pim->height = 0;
+    // the lines and their bit vectors all belong to the allocation of content
     free(pim->content);
-    pim->content = NULL;
+    memset(pim, 0, sizeof(*pim));
 }
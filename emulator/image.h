@@ -34,16 +34,24 @@ struct image_line_ {
 };
 typedef struct image_line_ image_line_t;
 
-#define IMAGE_LINE_WORD_BITS 32
+#define IMAGE_LINE_WORD_BITS BIT_VECTOR_WORD_BITS
 
 
 //=========================================================================
 /**
- * @brief Type to represent images
+ * @brief Type to represent images.
+ *        One allocation holds content, then the bit vectors of all the lines,
+ *        plane after plane (lsb of all the lines, then msb, then opacity), the
+ *        lines of a plane being stride bytes apart. planes[0..planes_size[ has
+ *        no pointer and no uninitialized byte: a frame can be copied (between
+ *        images of the same size) or hashed directly from there.
  */
 struct image_ {
     size_t height;
     image_line_t* content;
+    uint8_t* planes;
+    size_t planes_size;
+    size_t stride;
 };
 typedef struct image_ image_t;
 
@@ -98,6 +106,28 @@ int image_line_extract_wrap_ext(image_line_t* output, image_line_t iml, int64_t
  */
 int image_line_map_colors(image_line_t* output, image_line_t iml, palette_t map);
 
+//=========================================================================
+/**
+ * @brief Apply Palette to 32 pixels stored in their two bit planes
+ * @param msb, lsb words of the bit planes, mapped in place
+ * @param map palette to use
+ */
+void image_word_map_colors(uint32_t* msb, uint32_t* lsb, palette_t map);
+
+//=========================================================================
+/**
+ * @brief Apply Palette to image line and draw it over another one, in a single pass
+ *        (same as image_line_map_colors, image_line_shift and image_line_below_with_opacity
+ *        in a row, without any allocation)
+ * @param output pointer to image line to draw on (modified)
+ * @param iml image line to map and draw: its pixel i goes to pixel x + i of output
+ * @param map palette to use
+ * @param p_opacity pixels of iml to draw (NULL for iml.opacity)
+ * @param x offset of iml in output
+ * @return Error code
+ */
+int image_line_map_below(image_line_t* output, image_line_t iml, palette_t map, const bit_vector_t* p_opacity, int64_t x);
+
 //=========================================================================
 /**
  * @brief Combine two image lines using opacity
@@ -170,7 +200,8 @@ int image_get_pixel(uint8_t* output, image_t* pim, size_t x, size_t y);
 
 //=========================================================================
 /**
- * @brief Set line content of image (using provided bit vectors pointers)
+ * @brief Set line content of image, taking ownership of the line (its bit
+ *        vectors are copied, then freed)
  * @param pim pointer to image
  * @param y line index to set
  * @param line line to use bit vectors from
@@ -178,6 +209,23 @@ int image_get_pixel(uint8_t* output, image_t* pim, size_t x, size_t y);
  */
 int image_own_line_content(image_t* pim, size_t y, image_line_t line);
 
+//=========================================================================
+#define IMAGE_RGB_BYTES 3 // bytes of a 24-bit RGB pixel
+#define IMAGE_RGB_MAX_SCALE 16
+
+/**
+ * @brief Convert a whole image to 24-bit RGB pixels, each pixel of the image
+ *        becoming a square of scale x scale RGB pixels (nearest neighbour)
+ * @param rgb output pixels: (height * scale) rows of (width * scale) pixels
+ * @param rowstride bytes between two rows of rgb (at least 3 * width * scale)
+ * @param pim pointer to image
+ * @param colors RGB color of each of the 4 pixel values
+ * @param scale scaling factor (1 to IMAGE_RGB_MAX_SCALE)
+ * @return Error code
+ */
+int image_to_rgb24_scaled(uint8_t* rgb, size_t rowstride, const image_t* pim,
+                          const uint8_t colors[PALETTE_COLOR_COUNT][IMAGE_RGB_BYTES], size_t scale);
+
 //=========================================================================
 /**
  * @brief Free image
@@ -0,0 +1,119 @@
+/**
+ * @file joypad.c
+ * @brief Game Boy joypad simulation
+ *
+ * @date 2020
+ */
+
+#include <string.h> // memset
+
+#include "joypad.h"
+#include "bit.h"
+#include "error.h"
+
+// P1 register: bits 0-3 are the (active low) key lines, bits 4-5 select the key rows (active low),
+// bits 6-7 are unused and always read as 1
+#define P1_KEYS_MASK   0x0F
+#define P1_SELECT_MASK 0x30
+#define P1_UNUSED_BITS 0xC0
+#define P1_SELECT_ROW_BIT 4
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Computes the keys pressed in the rows selected by P1 (one bit per column, 1 = pressed)
+ */
+static uint8_t joypad_state(const joypad_t* pad)
+{
+    uint8_t state = 0;
+    for (int row = 0; row < NB_GB_KEY_ROWS; ++row) {
+        if (!bit_get(pad->intern, P1_SELECT_ROW_BIT + row)) {
+            state |= pad->keys_state[row];
+        }
+    }
+    return state & P1_KEYS_MASK;
+}
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Exposes a keys state on the bus (key lines of P1 are active low)
+ */
+static void joypad_write_P1(joypad_t* pad, uint8_t state)
+{
+    pad->intern = (data_t) (P1_UNUSED_BITS | (pad->intern & P1_SELECT_MASK) | (~state & P1_KEYS_MASK));
+    *pad->p_P1 = pad->intern;
+    pad->old_state = state;
+}
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Updates P1 after a change of the keys or of the selected rows;
+ *        a key line going low requests the JOYPAD interrupt
+ */
+static void joypad_update(joypad_t* pad)
+{
+    const uint8_t state = joypad_state(pad);
+    if (state & ~pad->old_state) {
+        cpu_request_interrupt(pad->cpu, JOYPAD);
+    }
+    joypad_write_P1(pad, state);
+}
+
+// ==== see joypad.h ========================================
+int joypad_init_and_plug(joypad_t* pad, cpu_t* cpu)
+{
+    M_REQUIRE_NON_NULL(pad);
+    M_REQUIRE_NON_NULL(cpu);
+
+    memset(pad, 0, sizeof(*pad));
+    pad->cpu = cpu;
+    pad->p_P1 = bus_lookup(*cpu->bus, REG_P1);
+    M_REQUIRE_NON_NULL(pad->p_P1);
+
+    // no row selected yet (the selection bits are active low)
+    pad->intern = P1_UNUSED_BITS | P1_SELECT_MASK;
+    joypad_write_P1(pad, joypad_state(pad));
+
+    return ERR_NONE;
+}
+
+// ==== see joypad.h ========================================
+int joypad_bus_listener(joypad_t* pad, addr_t addr)
+{
+    M_REQUIRE_NON_NULL(pad);
+
+    if (addr == REG_P1) {
+        // only the row selection bits can be written
+        pad->intern = (data_t) ((pad->intern & ~P1_SELECT_MASK) | (*pad->p_P1 & P1_SELECT_MASK));
+        joypad_update(pad);
+    }
+
+    return ERR_NONE;
+}
+
+// ==== see joypad.h ========================================
+int joypad_key_pressed(joypad_t* pad, gb_key_t key)
+{
+    M_REQUIRE_NON_NULL(pad);
+    M_REQUIRE(key < NB_GB_KEYS, ERR_BAD_PARAMETER, "Invalid key %d", key);
+
+    bit_set(&pad->keys_state[key / NB_GB_KEY_COLS], key % NB_GB_KEY_COLS);
+    joypad_update(pad);
+
+    return ERR_NONE;
+}
+
+// ==== see joypad.h ========================================
+int joypad_key_released(joypad_t* pad, gb_key_t key)
+{
+    M_REQUIRE_NON_NULL(pad);
+    M_REQUIRE(key < NB_GB_KEYS, ERR_BAD_PARAMETER, "Invalid key %d", key);
+
+    bit_unset(&pad->keys_state[key / NB_GB_KEY_COLS], key % NB_GB_KEY_COLS);
+    // releasing a key never raises the interrupt
+    joypad_write_P1(pad, joypad_state(pad));
+
+    return ERR_NONE;
+}
@@ -0,0 +1,462 @@
+/**
+ * @file lcdc.c
+ * @brief Game Boy LCD (liquid cristal display) controller simulation
+ *
+ * @date 2020
+ */
+
+#include <string.h> // memset
+#include <inttypes.h> // PRIu64
+
+#include "lcdc.h"
+#include "gameboy.h"
+#include "error.h"
+#include "util.h" // LUT_256
+
+// ======================================================================
+// Line rendering works on whole 32-bit words of pixels: pixel x of a line
+// is bit (x % 32) of word (x / 32), as in the bit vectors of image_t.
+
+#define LINE_WORDS    (LCD_WIDTH / IMAGE_LINE_WORD_BITS)          // 5 words for 160 pixels
+#define BG_LINE_WORDS (TILE_LINE_SIZE * 8 / IMAGE_LINE_WORD_BITS) // 8 words for the 256 pixels of a map line
+#define TILES_PER_WORD (IMAGE_LINE_WORD_BITS / 8)
+
+#define OAM_NB_SPRITES  40
+#define OAM_SPRITE_SIZE 4
+#define MAX_SPRITES_PER_LINE 10
+
+#define SPRITE_Y_OFFSET 16
+#define SPRITE_X_OFFSET 8
+#define SPRITE_ATTR_BEHIND_BG 0x80
+#define SPRITE_ATTR_Y_FLIP    0x40
+#define SPRITE_ATTR_X_FLIP    0x20
+#define SPRITE_ATTR_PALETTE   0x10
+
+#define STAT_REG_INT_MODE_BIT 3 // interrupt enable bit of mode m is bit (m + 3), for modes 0 to 2
+
+// the tile data uses signed indices from 0x9000 (i.e. index + 0x80 from TILE_SRC_ADDR_HIGH)
+#define TILE_SIGNED_BIAS 0x80
+
+/**
+ * @brief Access to an LCDC register through the pointer cached by lcdc_plug
+ */
+#define LCDC_REG(lcd, reg) ((lcd)->regs[(reg) - REG_LCDC])
+
+// Game Boy tiles store their leftmost pixel in bit 7: reverse each tile byte once for all
+#define REV8(x) (uint8_t) ((((x) & 0x01) << 7) | (((x) & 0x02) << 5) | (((x) & 0x04) << 3) | (((x) & 0x08) << 1) \
+                         | (((x) & 0x10) >> 1) | (((x) & 0x20) >> 3) | (((x) & 0x40) >> 5) | (((x) & 0x80) >> 7))
+static const uint8_t reversed_byte[256] = { LUT_256(REV8, 0) };
+
+/**
+ * @brief Pixels of a line, split in their two bit planes
+ */
+typedef struct {
+    uint32_t msb[LINE_WORDS];
+    uint32_t lsb[LINE_WORDS];
+} line_words_t;
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Decodes consecutive tiles of a tile map line into words of pixels
+ *
+ * @param lcd LCD controler (for its registers and video RAM)
+ * @param map first tile index to read in the video RAM
+ * @param row row of the tiles to decode (0 to 7)
+ * @param nb_words number of words to fill (TILES_PER_WORD tiles per word)
+ */
+static void decode_tiles(const lcdc_t* lcd, const data_t* map, unsigned row,
+                         uint32_t* msb, uint32_t* lsb, size_t nb_words)
+{
+    const bit_t unsigned_src = (LCDC_REG(lcd, REG_LCDC) & LCDC_REG_TILE_SOURCE_MASK) != 0;
+    const data_t* const tiles = lcd->vram + ((unsigned_src ? TILE_SRC_ADDR_LOW : TILE_SRC_ADDR_HIGH) - VIDEO_RAM_START) + row * 2;
+    const uint8_t bias = unsigned_src ? 0 : TILE_SIGNED_BIAS;
+
+    for (size_t w = 0; w < nb_words; ++w) {
+        uint32_t m = 0;
+        uint32_t l = 0;
+        for (unsigned t = 0; t < TILES_PER_WORD; ++t) {
+            const data_t* tile = tiles + (uint8_t) (*map++ + bias) * TILE_SIZE;
+            l |= (uint32_t) reversed_byte[tile[0]] << (8 * t);
+            m |= (uint32_t) reversed_byte[tile[1]] << (8 * t);
+        }
+        msb[w] = m;
+        lsb[w] = l;
+    }
+}
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Renders the background and window of a line, still unmapped (color indices)
+ */
+static void render_background(lcdc_t* lcd, uint8_t ly, line_words_t* bg)
+{
+    const data_t lcdc = LCDC_REG(lcd, REG_LCDC);
+
+    // background: one whole 256-pixel map line, seen through a 160-pixel window starting at SCX
+    const uint8_t y = (uint8_t) (LCDC_REG(lcd, REG_SCY) + ly);
+    const data_t* map = lcd->vram + ((lcdc & LCDC_REG_BG_AREA_MASK ? TILE_ADDR_BASE_HIGH : TILE_ADDR_BASE_LOW) - VIDEO_RAM_START)
+                        + (y / 8) * TILE_LINE_SIZE;
+    uint32_t msb[BG_LINE_WORDS];
+    uint32_t lsb[BG_LINE_WORDS];
+    decode_tiles(lcd, map, y % 8, msb, lsb, BG_LINE_WORDS);
+
+    const unsigned scx = LCDC_REG(lcd, REG_SCX);
+    const unsigned shift = scx % IMAGE_LINE_WORD_BITS;
+    for (unsigned w = 0; w < LINE_WORDS; ++w) {
+        const unsigned k = (scx / IMAGE_LINE_WORD_BITS + w) % BG_LINE_WORDS;
+        const unsigned next = (k + 1) % BG_LINE_WORDS;
+        bg->msb[w] = shift == 0 ? msb[k] : (msb[k] >> shift) | (msb[next] << (IMAGE_LINE_WORD_BITS - shift));
+        bg->lsb[w] = shift == 0 ? lsb[k] : (lsb[k] >> shift) | (lsb[next] << (IMAGE_LINE_WORD_BITS - shift));
+    }
+
+    // window: drawn over the background from x = WX - 7 on, its lines only advance when it is shown
+    const unsigned wx = LCDC_REG(lcd, REG_WX);
+    if (!(lcdc & LCDC_REG_WIN_MASK) || wx < WINDOW_OFFSET_X || wx - WINDOW_OFFSET_X >= LCD_WIDTH
+        || ly < LCDC_REG(lcd, REG_WY)) {
+        return;
+    }
+
+    map = lcd->vram + ((lcdc & LCDC_REG_WIN_AREA_MASK ? TILE_ADDR_BASE_HIGH : TILE_ADDR_BASE_LOW) - VIDEO_RAM_START)
+          + (lcd->window_y / 8) * TILE_LINE_SIZE;
+    line_words_t win;
+    decode_tiles(lcd, map, lcd->window_y % 8, win.msb, win.lsb, LINE_WORDS);
+    ++lcd->window_y;
+
+    // window pixel i goes to x = i + start
+    const unsigned start = wx - WINDOW_OFFSET_X;
+    const unsigned word_shift = start / IMAGE_LINE_WORD_BITS;
+    const unsigned bit_shift = start % IMAGE_LINE_WORD_BITS;
+    for (unsigned w = LINE_WORDS; w-- > word_shift; ) {
+        const unsigned k = w - word_shift;
+        uint32_t m = win.msb[k] << bit_shift;
+        uint32_t l = win.lsb[k] << bit_shift;
+        if (bit_shift != 0 && k > 0) {
+            m |= win.msb[k - 1] >> (IMAGE_LINE_WORD_BITS - bit_shift);
+            l |= win.lsb[k - 1] >> (IMAGE_LINE_WORD_BITS - bit_shift);
+        }
+        // only the part of the first word from start on belongs to the window
+        const uint32_t keep = k == 0 ? ~(UINT32_MAX << bit_shift) : 0;
+        bg->msb[w] = (bg->msb[w] & keep) | m;
+        bg->lsb[w] = (bg->lsb[w] & keep) | l;
+    }
+}
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Selects the sprites of a line, in drawing priority order (smallest X first, then OAM order)
+ *
+ * @param selected indices (in OAM) of the selected sprites
+ * @return number of selected sprites
+ */
+static size_t select_sprites(const lcdc_t* lcd, uint8_t ly, unsigned height, uint8_t selected[MAX_SPRITES_PER_LINE])
+{
+    size_t count = 0;
+
+    for (uint8_t i = 0; i < OAM_NB_SPRITES && count < MAX_SPRITES_PER_LINE; ++i) {
+        const int row = ly + SPRITE_Y_OFFSET - lcd->oam[i * OAM_SPRITE_SIZE];
+        if (row < 0 || row >= (int) height) continue;
+
+        // insertion sort on X, OAM order is kept for equal X
+        const data_t x = lcd->oam[i * OAM_SPRITE_SIZE + 1];
+        size_t j = count++;
+        for (; j > 0 && lcd->oam[selected[j - 1] * OAM_SPRITE_SIZE + 1] > x; --j) {
+            selected[j] = selected[j - 1];
+        }
+        selected[j] = i;
+    }
+
+    return count;
+}
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Renders the sprites of a line and composes them with the (already mapped) background
+ *
+ * @param bg_opacity pixels of the background with a color index other than 0
+ */
+static void render_sprites(const lcdc_t* lcd, uint8_t ly, line_words_t* line, const uint32_t bg_opacity[LINE_WORDS])
+{
+    const unsigned height = LCDC_REG(lcd, REG_LCDC) & LCDC_REG_OBJ_SIZE_MASK ? 16 : 8;
+    uint8_t selected[MAX_SPRITES_PER_LINE];
+    const size_t count = select_sprites(lcd, ly, height, selected);
+    if (count == 0) return;
+
+    // pixel x is stored at bit x + SPRITE_X_OFFSET, so that sprites partially on the left edge fit
+    enum { SPRITE_WORDS = LINE_WORDS + 1 };
+    uint32_t msb[SPRITE_WORDS] = { 0 };
+    uint32_t lsb[SPRITE_WORDS] = { 0 };
+    uint32_t opacity[SPRITE_WORDS] = { 0 };
+    uint32_t behind[SPRITE_WORDS] = { 0 };
+
+    for (size_t s = 0; s < count; ++s) {
+        const data_t* sprite = lcd->oam + selected[s] * OAM_SPRITE_SIZE;
+        const data_t attr = sprite[3];
+
+        unsigned row = (unsigned) (ly + SPRITE_Y_OFFSET - sprite[0]);
+        if (attr & SPRITE_ATTR_Y_FLIP) row = height - 1 - row;
+        const data_t tile_index = height == 16 ? (data_t) (sprite[2] & 0xFE) : sprite[2];
+        const data_t* tile = lcd->vram + (TILE_SRC_ADDR_LOW - VIDEO_RAM_START) + tile_index * TILE_SIZE + row * 2;
+
+        uint32_t l = attr & SPRITE_ATTR_X_FLIP ? tile[0] : reversed_byte[tile[0]];
+        uint32_t m = attr & SPRITE_ATTR_X_FLIP ? tile[1] : reversed_byte[tile[1]];
+        const uint32_t op = m | l;
+        image_word_map_colors(&m, &l, LCDC_REG(lcd, attr & SPRITE_ATTR_PALETTE ? REG_OBP1 : REG_OBP0));
+
+        // earlier sprites have priority: only the pixels still free are drawn
+        const unsigned pos = sprite[1];
+        const unsigned w = pos / IMAGE_LINE_WORD_BITS;
+        const unsigned b = pos % IMAGE_LINE_WORD_BITS;
+        for (unsigned k = 0; k < 2 && w + k < SPRITE_WORDS; ++k) {
+            const uint32_t place = k == 0 ? op << b : (b == 0 ? 0 : op >> (IMAGE_LINE_WORD_BITS - b));
+            const uint32_t free = place & ~opacity[w + k];
+            const uint32_t pm = k == 0 ? m << b : (b == 0 ? 0 : m >> (IMAGE_LINE_WORD_BITS - b));
+            const uint32_t pl = k == 0 ? l << b : (b == 0 ? 0 : l >> (IMAGE_LINE_WORD_BITS - b));
+            msb[w + k] |= pm & free;
+            lsb[w + k] |= pl & free;
+            opacity[w + k] |= free;
+            if (attr & SPRITE_ATTR_BEHIND_BG) behind[w + k] |= free;
+        }
+    }
+
+    // a sprite pixel shows unless it is behind a background pixel of color index other than 0
+    for (unsigned w = 0; w < LINE_WORDS; ++w) {
+#define SPRITE_WORD(a) (((a)[w] >> SPRITE_X_OFFSET) | ((a)[w + 1] << (IMAGE_LINE_WORD_BITS - SPRITE_X_OFFSET)))
+        const uint32_t show = SPRITE_WORD(opacity) & ~(SPRITE_WORD(behind) & bg_opacity[w]);
+        line->msb[w] = (line->msb[w] & ~show) | (SPRITE_WORD(msb) & show);
+        line->lsb[w] = (line->lsb[w] & ~show) | (SPRITE_WORD(lsb) & show);
+#undef SPRITE_WORD
+    }
+}
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Draws a whole line of the display
+ */
+static int render_line(lcdc_t* lcd, uint8_t ly)
+{
+    const data_t lcdc = LCDC_REG(lcd, REG_LCDC);
+    line_words_t line;
+    uint32_t bg_opacity[LINE_WORDS] = { 0 };
+
+    if (lcdc & LCDC_REG_BG_MASK) {
+        render_background(lcd, ly, &line);
+        for (unsigned w = 0; w < LINE_WORDS; ++w) {
+            bg_opacity[w] = line.msb[w] | line.lsb[w];
+            image_word_map_colors(&line.msb[w], &line.lsb[w], LCDC_REG(lcd, REG_BGP));
+        }
+    } else {
+        // background (and window) disabled: blank line, sprites are still drawn
+        memset(&line, 0, sizeof(line));
+    }
+
+    if (lcdc & LCDC_REG_OBJ_MASK) {
+        render_sprites(lcd, ly, &line, bg_opacity);
+    }
+
+    for (unsigned w = 0; w < LINE_WORDS; ++w) {
+        M_EXIT_IF_ERR(image_line_set_word(&lcd->display.content[ly], w, line.msb[w], line.lsb[w]));
+    }
+
+    return ERR_NONE;
+}
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Sets the mode bits of STAT, requests the LCD_STAT interrupt if enabled for this mode
+ */
+static void set_mode(lcdc_t* lcd, data_t mode)
+{
+    data_t* stat = &LCDC_REG(lcd, REG_STAT);
+    *stat = (data_t) ((*stat & ~STAT_REG_MODE_MASK) | mode);
+    if (mode <= 2 && bit_get(*stat, (int) (mode + STAT_REG_INT_MODE_BIT))) {
+        cpu_request_interrupt(lcd->cpu, LCD_STAT);
+    }
+}
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Updates the LYC=LY bit of STAT, requests the LCD_STAT interrupt if they match and it is enabled
+ */
+static void update_LYC(lcdc_t* lcd)
+{
+    data_t* stat = &LCDC_REG(lcd, REG_STAT);
+    if (LCDC_REG(lcd, REG_LY) == LCDC_REG(lcd, REG_LYC)) {
+        bit_set(stat, STAT_REG_LYC_EQ_LY_BIT);
+        if (bit_get(*stat, STAT_REG_INT_LYC_BIT)) {
+            cpu_request_interrupt(lcd->cpu, LCD_STAT);
+        }
+    } else {
+        bit_unset(stat, STAT_REG_LYC_EQ_LY_BIT);
+    }
+}
+
+// ======================================================================
+/**
+ * Auxiliary function
+ * @brief Performs the mode change due at the given cycle and computes the next one
+ */
+static int lcdc_step(lcdc_t* lcd, uint64_t cycle)
+{
+    const uint64_t frame_cycle = (cycle - lcd->on_cycle) % FRAME_TOTAL_CYCLES;
+    if (frame_cycle == 0) lcd->window_y = 0;
+
+    const uint8_t ly = (uint8_t) (frame_cycle / LINE_TOTAL_CYCLES);
+    const uint64_t line_cycle = frame_cycle % LINE_TOTAL_CYCLES;
+
+    if (ly < LCD_HEIGHT) {
+        switch (line_cycle) {
+        case LINE_MODE_2_START_CYCLE:
+            LCDC_REG(lcd, REG_LY) = ly;
+            update_LYC(lcd);
+            set_mode(lcd, 2);
+            lcd->next_cycle += LINE_MODE_2_CYCLES;
+            break;
+
+        case LINE_MODE_3_START_CYCLE:
+            set_mode(lcd, 3);
+            M_EXIT_IF_ERR(render_line(lcd, ly));
+            lcd->next_cycle += LINE_MODE_3_CYCLES;
+            break;
+
+        case LINE_MODE_0_START_CYCLE:
+            set_mode(lcd, 0);
+            lcd->next_cycle += LINE_MODE_0_CYCLES;
+            break;
+
+        default:
+            M_EXIT_ERR(ERR_BAD_PARAMETER, "Unexpected LCDC cycle %" PRIu64 " in line %u", line_cycle, ly);
+        }
+    } else {
+        M_REQUIRE(line_cycle == 0, ERR_BAD_PARAMETER, "Unexpected LCDC cycle %" PRIu64 " in VBLANK", line_cycle);
+        if (ly == LCD_HEIGHT) {
+            set_mode(lcd, 1);
+            cpu_request_interrupt(lcd->cpu, VBLANK);
+        }
+        LCDC_REG(lcd, REG_LY) = ly;
+        update_LYC(lcd);
+        lcd->next_cycle += LINE_TOTAL_CYCLES;
+    }
+
+    return ERR_NONE;
+}
+
+// ==== see lcdc.h ========================================
+int lcdc_init(gameboy_t* gb)
+{
+    M_REQUIRE_NON_NULL(gb);
+
+    lcdc_t* lcd = &gb->screen;
+    memset(lcd, 0, sizeof(*lcd));
+    lcd->cpu = &gb->cpu;
+
+    data_t lcdc = 0;
+    M_EXIT_IF_ERR(bus_read(gb->bus, REG_LCDC, &lcdc));
+    lcd->on = (lcdc & LCDC_REG_LCD_STATUS_MASK) != 0;
+    lcd->next_cycle = UINT64_MAX;
+    lcd->on_cycle = lcd->on ? 0 : UINT64_MAX;
+
+    // no DMA in progress
+    lcd->DMA_from = 0;
+    lcd->DMA_to = GRAPH_RAM_END + 1;
+    lcd->window_y = 0;
+
+    return image_create(&lcd->display, LCD_WIDTH, LCD_HEIGHT);
+}
+
+// ==== see lcdc.h ========================================
+void lcdc_free(lcdc_t* lcd)
+{
+    if (lcd != NULL) {
+        image_free(&lcd->display);
+        lcd->regs = NULL;
+        lcd->vram = NULL;
+        lcd->oam  = NULL;
+    }
+}
+
+// ==== see lcdc.h ========================================
+int lcdc_plug(lcdc_t* lcd, bus_t bus)
+{
+    M_REQUIRE_NON_NULL(lcd);
+    M_REQUIRE_NON_NULL(bus);
+
+    // the registers, video RAM and OAM are read on every line: keep direct pointers to them
+    lcd->regs = bus_lookup(bus, REG_LCDC);
+    lcd->vram = bus_lookup(bus, VIDEO_RAM_START);
+    lcd->oam  = bus_lookup(bus, GRAPH_RAM_START);
+    M_REQUIRE(lcd->regs != NULL && lcd->vram != NULL && lcd->oam != NULL, ERR_BAD_PARAMETER,
+              "%s", "LCDC registers, video RAM and OAM must be plugged before the LCDC");
+    M_REQUIRE(bus_lookup(bus, REG_WX) == lcd->regs + (REG_WX - REG_LCDC)
+              && bus_lookup(bus, VIDEO_RAM_END) == lcd->vram + (VIDEO_RAM_END - VIDEO_RAM_START)
+              && bus_lookup(bus, GRAPH_RAM_END) == lcd->oam + (GRAPH_RAM_END - GRAPH_RAM_START),
+              ERR_BAD_PARAMETER, "%s", "LCDC registers, video RAM and OAM must each be contiguous");
+
+    return ERR_NONE;
+}
+
+// ==== see lcdc.h ========================================
+int lcdc_cycle(lcdc_t* lcd, uint64_t cycle)
+{
+    M_REQUIRE_NON_NULL(lcd);
+    M_REQUIRE(cycle <= lcd->next_cycle, ERR_BAD_PARAMETER,
+              "LCDC missed its cycle %" PRIu64 " (now %" PRIu64 ")", lcd->next_cycle, cycle);
+
+    // the DMA copies one byte to the OAM per cycle
+    if (lcd->DMA_to <= GRAPH_RAM_END) {
+        M_EXIT_IF_ERR(bus_read(*lcd->cpu->bus, lcd->DMA_from++, &lcd->oam[lcd->DMA_to++ - GRAPH_RAM_START]));
+    }
+
+    if (cycle == lcd->next_cycle) {
+        return lcdc_step(lcd, cycle);
+    }
+
+    // switched on since last cycle: the first frame starts now
+    if (lcd->next_cycle == UINT64_MAX && (LCDC_REG(lcd, REG_LCDC) & LCDC_REG_LCD_STATUS_MASK)) {
+        lcd->next_cycle = cycle;
+        lcd->on_cycle = cycle;
+        return lcdc_step(lcd, cycle);
+    }
+
+    return ERR_NONE;
+}
+
+// ==== see lcdc.h ========================================
+int lcdc_bus_listener(lcdc_t* lcd, addr_t addr)
+{
+    M_REQUIRE_NON_NULL(lcd);
+
+    switch (addr) {
+    case REG_LCDC: {
+        const bit_t on = (LCDC_REG(lcd, REG_LCDC) & LCDC_REG_LCD_STATUS_MASK) != 0;
+        if (lcd->on && !on) {
+            // switched off: back to the top of the screen, waiting to be switched on again
+            set_mode(lcd, 0);
+            LCDC_REG(lcd, REG_LY) = 0;
+            update_LYC(lcd);
+            lcd->next_cycle = UINT64_MAX;
+        }
+        lcd->on = on;
+    } break;
+
+    case REG_LYC:
+        update_LYC(lcd);
+        break;
+
+    case REG_DMA:
+        lcd->DMA_from = (addr_t) (LCDC_REG(lcd, REG_DMA) << 8);
+        lcd->DMA_to = GRAPH_RAM_START;
+        break;
+
+    default:
+        break;
+    }
+
+    return ERR_NONE;
+}
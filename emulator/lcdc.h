@@ -107,6 +107,9 @@ typedef struct {
     addr_t   DMA_to;
     image_t  display;
     data_t   window_y;
+    data_t*  regs; // LCDC registers (REG_LCDC to REG_WX), bus exposed
+    data_t*  vram; // video RAM, bus exposed
+    data_t*  oam;  // sprite attributes (graphic RAM), bus exposed
 } lcdc_t;
 
 
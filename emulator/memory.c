@@ -6,6 +6,8 @@
  * @date 2020
  */
  
+#include <string.h> // memset
+
 #include "memory.h"
 
 // ==== see memory.h ========================================
@@ -17,7 +19,7 @@ int mem_create(memory_t* mem, size_t size) {
 	M_REQUIRE(size <= SIZE_MAX / sizeof(size_t), ERR_MEM, "size (%u) must be < than %u", , size, SIZE_MAX / sizeof(size_t));
 
 	// initialization of the memory structure
-	memory_t result = {NULL, 0};
+	memory_t result = {NULL, 0, false};
 	
 	// dynamic allocation in the heap for the memory
 	result.memory = calloc(size, sizeof(data_t));
@@ -33,9 +35,62 @@ int mem_create(memory_t* mem, size_t size) {
 void mem_free(memory_t* mem) {
 	// check argument validity
 	if (mem != NULL) {
-		// free up the space in the heap reserved for the memory
-		free(mem->memory);
+		// free up the space in the heap reserved for the memory (unless the arena owns it)
+		if (!mem->in_arena) free(mem->memory);
 		mem->memory = NULL;
 		mem->size = 0;
 	}
 }
+
+// ==== see memory.h ========================================
+int mem_arena_create(mem_arena_t* arena, size_t size) {
+	// check argument validity
+	M_REQUIRE_NON_NULL(arena);
+	M_REQUIRE(size > 0 && size <= SIZE_MAX - MEM_ARENA_PAGE, ERR_BAD_PARAMETER, "invalid arena size %zu", size);
+
+	// whole pages (as aligned_alloc requires)
+	const size_t pages = (size + MEM_ARENA_PAGE - 1) / MEM_ARENA_PAGE * MEM_ARENA_PAGE;
+	mem_arena_t result = {NULL, 0, 0, 0};
+	result.base = aligned_alloc(MEM_ARENA_PAGE, pages);
+	M_REQUIRE_NON_NULL_CUSTOM_ERR(result.base, ERR_MEM);
+	memset(result.base, 0, pages);
+	result.size = pages;
+	*arena = result;
+
+	return ERR_NONE;
+}
+
+// ==== see memory.h ========================================
+int mem_arena_alloc(mem_arena_t* arena, memory_t** mem, size_t size) {
+	// check arguments validity
+	M_REQUIRE_NON_NULL(arena);
+	M_REQUIRE_NON_NULL(arena->base);
+	M_REQUIRE_NON_NULL(mem);
+	M_REQUIRE(size > 0, ERR_BAD_PARAMETER, "size can't be %zu", size);
+
+	const size_t block = mem_arena_block(size);
+	const size_t top = arena->size - (arena->headers + 1) * sizeof(memory_t);
+	M_REQUIRE(arena->headers * sizeof(memory_t) < arena->size && block <= top && arena->used <= top - block, ERR_MEM,
+	          "arena of %zu bytes too small for %zu more bytes", arena->size, size);
+
+	memory_t* header = (memory_t*) (arena->base + top);
+	header->memory = arena->base + arena->used;
+	header->size = size;
+	header->in_arena = true;
+	arena->used += block;
+	++arena->headers;
+	*mem = header;
+
+	return ERR_NONE;
+}
+
+// ==== see memory.h ========================================
+void mem_arena_free(mem_arena_t* arena) {
+	if (arena != NULL) {
+		free(arena->base);
+		arena->base = NULL;
+		arena->size = 0;
+		arena->used = 0;
+		arena->headers = 0;
+	}
+}
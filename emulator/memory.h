@@ -32,8 +32,30 @@ extern "C" {
 typedef struct {
 	data_t* memory;
 	size_t size;
+	bool in_arena; // memory, and this structure, belong to a mem_arena_t: they are freed with it
 } memory_t;
 
+/**
+ * @brief Arena holding several memories in one page-aligned block: the memories, in the order
+ *        they are allocated, from the bottom of the block (each one aligned on MEM_ARENA_ALIGN bytes),
+ *        their memory_t structures from the top
+ */
+typedef struct {
+	data_t* base;
+	size_t size;
+	size_t used;    // by the memories, from base
+	size_t headers; // number of memory_t, at the end of the block
+} mem_arena_t;
+
+#define MEM_ARENA_PAGE  4096
+#define MEM_ARENA_ALIGN 64
+
+/**
+ * @brief Size of an arena holding memories of the given total size (each rounded up to MEM_ARENA_ALIGN)
+ */
+#define mem_arena_block(size) (((size) + MEM_ARENA_ALIGN - 1) / MEM_ARENA_ALIGN * MEM_ARENA_ALIGN)
+#define mem_arena_size(blocks, nb_mems) ((blocks) + (nb_mems) * sizeof(memory_t))
+
 /**
  * @brief Creates memory structure
  *
@@ -50,6 +72,32 @@ int mem_create(memory_t* mem, size_t size);
  */
 void mem_free(memory_t* mem);
 
+/**
+ * @brief Creates an arena: one zeroed, page-aligned, block
+ *
+ * @param arena arena to initialize
+ * @param size size of the block (rounded up to MEM_ARENA_PAGE), see mem_arena_size()
+ * @return error code
+ */
+int mem_arena_create(mem_arena_t* arena, size_t size);
+
+/**
+ * @brief Creates a memory structure in an arena, right after the last memory allocated in it
+ *
+ * @param arena arena to allocate from
+ * @param mem (modified) memory structure created
+ * @param size size of the memory to create
+ * @return error code (ERR_MEM when the arena is full)
+ */
+int mem_arena_alloc(mem_arena_t* arena, memory_t** mem, size_t size);
+
+/**
+ * @brief Frees an arena, and thus all the memories allocated in it
+ *
+ * @param arena arena to free
+ */
+void mem_arena_free(mem_arena_t* arena);
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,294 @@
+/**
+ * @file rewind.c
+ * @brief Rewind buffer for the GameBoy Emulator
+ *
+ * @author S. Horvath-Mikulas & R. Gerber
+ * @date 2020
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "rewind.h"
+#include "error.h"
+
+/*
+ * Snapshots are zero-run encoded: a sequence of (number of zero bytes, number of literal bytes,
+ * literal bytes), both numbers as LEB128 varints. A literal only ends before ZRLE_MIN_RUN zero
+ * bytes, so that short runs are not worth a new pair of numbers.
+ * A delta is the XOR of a state with its keyframe: as most of the RAMs do not change from one
+ * frame to the next, it is mostly zeros.
+ */
+#define ZRLE_MIN_RUN    4
+#define ZRLE_VARINT_MAX ((sizeof(size_t) * 8 + 6) / 7)
+#define zrle_max_size(size) ((size) + ((size) / ZRLE_MIN_RUN + 1) * 2 * ZRLE_VARINT_MAX)
+
+// byte of a state as encoded: itself for a keyframe, XORed with the keyframe for a delta
+#define zrle_byte(in, ref, i) ((ref) == NULL ? (in)[i] : (uint8_t) ((in)[i] ^ (ref)[i]))
+
+/**
+ * Auxiliary function
+ * @brief Writes a varint
+ *
+ * @return number of bytes written
+ */
+static size_t zrle_put(uint8_t* out, size_t n)
+{
+	size_t o = 0;
+	while (n >= 0x80) {
+		out[o++] = (uint8_t) (n | 0x80);
+		n >>= 7;
+	}
+	out[o++] = (uint8_t) n;
+	return o;
+}
+
+/**
+ * Auxiliary function
+ * @brief Reads a varint
+ *
+ * @return error code
+ */
+static int zrle_get(const uint8_t* in, size_t length, size_t* i, size_t* n)
+{
+	*n = 0;
+	for (unsigned shift = 0; *i < length && shift < 8 * sizeof(size_t); shift += 7) {
+		const uint8_t byte = in[(*i)++];
+		*n |= (size_t) (byte & 0x7F) << shift;
+		if (!(byte & 0x80)) return ERR_NONE;
+	}
+	return ERR_IO;
+}
+
+/**
+ * Auxiliary function
+ * @brief Zero-run encodes a state (ref == NULL) or its XOR with ref
+ *
+ * @param in state to encode
+ * @param ref keyframe a delta is computed against, NULL for a keyframe
+ * @param size size of in (and ref)
+ * @param out encoded bytes, zrle_max_size(size) at most
+ * @return number of encoded bytes
+ */
+static size_t zrle_encode(const uint8_t* in, const uint8_t* ref, size_t size, uint8_t* out)
+{
+	size_t o = 0;
+	size_t i = 0;
+	while (i < size) {
+		const size_t zeros_start = i;
+		while (i < size && zrle_byte(in, ref, i) == 0) ++i;
+
+		// the literal goes up to the next run worth encoding (or up to the end)
+		const size_t literal_start = i;
+		size_t run = 0;
+		while (i < size && run < ZRLE_MIN_RUN) {
+			run = zrle_byte(in, ref, i) == 0 ? run + 1 : 0;
+			++i;
+		}
+		if (run == ZRLE_MIN_RUN) i -= run;
+
+		o += zrle_put(out + o, literal_start - zeros_start);
+		o += zrle_put(out + o, i - literal_start);
+		for (size_t j = literal_start; j < i; ++j) {
+			out[o++] = zrle_byte(in, ref, j);
+		}
+	}
+	return o;
+}
+
+/**
+ * Auxiliary function
+ * @brief Decodes zero-run encoded bytes into a state, or XORs them into it for a delta
+ *
+ * @param in encoded bytes
+ * @param length number of encoded bytes
+ * @param out (modified) decoded state
+ * @param size size of out
+ * @param delta whether in is a delta to apply onto out
+ * @return error code
+ */
+static int zrle_decode(const uint8_t* in, size_t length, uint8_t* out, size_t size, bit_t delta)
+{
+	size_t i = 0;
+	size_t o = 0;
+	while (i < length) {
+		size_t zeros = 0, literal = 0;
+		M_EXIT_IF_ERR(zrle_get(in, length, &i, &zeros));
+		M_EXIT_IF_ERR(zrle_get(in, length, &i, &literal));
+		M_REQUIRE(zeros <= size - o && literal <= size - o - zeros && literal <= length - i,
+		          ERR_IO, "corrupted snapshot at byte %zu", i);
+
+		// XORing zeros leaves the state as it is
+		if (!delta) memset(out + o, 0, zeros);
+		o += zeros;
+		for (size_t j = 0; j < literal; ++j, ++o) {
+			out[o] = delta ? (uint8_t) (out[o] ^ in[i + j]) : in[i + j];
+		}
+		i += literal;
+	}
+	M_REQUIRE(o == size, ERR_IO, "truncated snapshot (%zu bytes of %zu)", o, size);
+	return ERR_NONE;
+}
+
+// ==== see rewind.h ========================================
+int rewind_init(rewind_t* rw, const gameboy_t* gameboy, size_t capacity, size_t ring_size, size_t keyframe_interval)
+{
+	// check arguments validity
+	M_REQUIRE_NON_NULL(rw);
+	M_REQUIRE_NON_NULL(gameboy);
+	M_REQUIRE(capacity > 0 && ring_size > 0 && keyframe_interval > 0, ERR_BAD_PARAMETER,
+	          "invalid rewind size (%zu snapshots, %zu bytes, keyframe every %zu)", capacity, ring_size, keyframe_interval);
+
+	memset(rw, 0, sizeof(*rw));
+	rw->state_size = gameboy_state_size(gameboy);
+	rw->keyframe_interval = keyframe_interval;
+	rw->ring_size = ring_size;
+	rw->capacity = capacity;
+
+	rw->ring = malloc(ring_size);
+	rw->entries = calloc(capacity, sizeof(rewind_entry_t));
+	rw->keyframe = calloc(1, rw->state_size);
+	rw->state = calloc(1, rw->state_size);
+	rw->encoded = malloc(zrle_max_size(rw->state_size));
+	if (rw->ring == NULL || rw->entries == NULL || rw->keyframe == NULL || rw->state == NULL || rw->encoded == NULL) {
+		rewind_free(rw);
+		return ERR_MEM;
+	}
+
+	return ERR_NONE;
+}
+
+// ==== see rewind.h ========================================
+void rewind_free(rewind_t* rw)
+{
+	if (rw != NULL) {
+		free(rw->ring);
+		free(rw->entries);
+		free(rw->keyframe);
+		free(rw->state);
+		free(rw->encoded);
+		memset(rw, 0, sizeof(*rw));
+	}
+}
+
+/**
+ * Auxiliary function
+ * @brief Drops the oldest keyframe and the deltas that depend on it
+ */
+static void rewind_drop_oldest(rewind_t* rw)
+{
+	do {
+		rw->first = (rw->first + 1) % rw->capacity;
+		--rw->count;
+	} while (rw->count > 0 && rw->entries[rw->first].keyframe != rw->first);
+
+	if (rw->count == 0) rw->tail = 0;
+}
+
+/**
+ * Auxiliary function
+ * @brief Finds room in the ring for some encoded bytes, after the latest snapshot
+ *
+ * @return whether there is room, at *offset
+ */
+static bit_t rewind_place(const rewind_t* rw, size_t length, size_t* offset)
+{
+	if (rw->count == 0) {
+		*offset = 0;
+		return length <= rw->ring_size;
+	}
+
+	const size_t head = rw->entries[rw->first].offset;
+	if (rw->tail > head) {
+		// free space at the end of the ring, then before the oldest snapshot
+		if (length <= rw->ring_size - rw->tail) {
+			*offset = rw->tail;
+			return 1;
+		}
+		*offset = 0;
+		return length <= head;
+	}
+	*offset = rw->tail;
+	return length <= head - rw->tail;
+}
+
+// ==== see rewind.h ========================================
+int rewind_push(rewind_t* rw, const gameboy_t* gameboy)
+{
+	// check arguments validity
+	M_REQUIRE_NON_NULL(rw);
+	M_REQUIRE_NON_NULL(rw->ring);
+	M_REQUIRE_NON_NULL(gameboy);
+
+	M_EXIT_IF_ERR(gameboy_save_state(gameboy, rw->state, rw->state_size));
+	if (rw->count == rw->capacity) rewind_drop_oldest(rw);
+
+	bit_t keyframe = rw->count == 0 || rw->since_keyframe + 1 >= rw->keyframe_interval;
+	size_t length = zrle_encode(rw->state, keyframe ? NULL : rw->keyframe, rw->state_size, rw->encoded);
+
+	size_t offset = 0;
+	while (!rewind_place(rw, length, &offset)) {
+		M_REQUIRE(rw->count > 0, ERR_MEM, "rewind ring of %zu bytes too small for a snapshot of %zu bytes", rw->ring_size, length);
+		rewind_drop_oldest(rw);
+		// the latest keyframe was dropped (along with all the deltas): start over from a keyframe
+		if (rw->count == 0 && !keyframe) {
+			keyframe = 1;
+			length = zrle_encode(rw->state, NULL, rw->state_size, rw->encoded);
+		}
+	}
+
+	const size_t last = (rw->first + rw->count + rw->capacity - 1) % rw->capacity;
+	const size_t index = (rw->first + rw->count) % rw->capacity;
+	rewind_entry_t* entry = &rw->entries[index];
+	entry->offset = offset;
+	entry->length = length;
+	entry->keyframe = keyframe ? index : rw->entries[last].keyframe;
+	memcpy(rw->ring + offset, rw->encoded, length);
+	rw->tail = offset + length;
+	++rw->count;
+
+	if (keyframe) {
+		memcpy(rw->keyframe, rw->state, rw->state_size);
+		rw->since_keyframe = 0;
+	} else {
+		++rw->since_keyframe;
+	}
+
+	return ERR_NONE;
+}
+
+// ==== see rewind.h ========================================
+int rewind_pop(rewind_t* rw, gameboy_t* gameboy)
+{
+	// check arguments validity
+	M_REQUIRE_NON_NULL(rw);
+	M_REQUIRE_NON_NULL(gameboy);
+	M_REQUIRE(rw->count > 0, ERR_BAD_PARAMETER, "no snapshot left to rewind to%s", "");
+
+	const rewind_entry_t* entry = &rw->entries[(rw->first + rw->count - 1) % rw->capacity];
+	const rewind_entry_t* key = &rw->entries[entry->keyframe];
+	M_EXIT_IF_ERR(zrle_decode(rw->ring + key->offset, key->length, rw->state, rw->state_size, 0));
+	if (entry != key) {
+		M_EXIT_IF_ERR(zrle_decode(rw->ring + entry->offset, entry->length, rw->state, rw->state_size, 1));
+	}
+	M_EXIT_IF_ERR(gameboy_load_state(gameboy, rw->state, rw->state_size));
+
+	--rw->count;
+	rw->tail = rw->count == 0 ? 0 : entry->offset;
+	// the next snapshot is a keyframe: rw->keyframe may be the one just removed
+	rw->since_keyframe = rw->keyframe_interval;
+
+	return ERR_NONE;
+}
+
+// ==== see rewind.h ========================================
+size_t rewind_used(const rewind_t* rw)
+{
+	size_t used = 0;
+	if (rw != NULL) {
+		for (size_t i = 0; i < rw->count; ++i) {
+			used += rw->entries[(rw->first + i) % rw->capacity].length;
+		}
+	}
+	return used;
+}
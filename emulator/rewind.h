@@ -0,0 +1,100 @@
+#pragma once
+
+/**
+ * @file rewind.h
+ * @brief Rewind buffer for the GameBoy Emulator: the last save states of a gameboy,
+ *        delta-compressed in a fixed-size ring
+ *
+ * @author S. Horvath-Mikulas & R. Gerber
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "gameboy.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief One snapshot of the ring: a keyframe (whole state) or the XOR delta of a state
+ *        against the keyframe it follows, both zero-run encoded (see rewind.c)
+ */
+typedef struct {
+	size_t offset;   // of the encoded bytes in the ring
+	size_t length;   // of the encoded bytes
+	size_t keyframe; // index (in entries) of the keyframe of a delta, its own index for a keyframe
+} rewind_entry_t;
+
+/**
+ * @brief Rewind buffer type.
+ *        entries[] is a circular list (oldest at first) of the snapshots whose encoded bytes
+ *        are stored one after the other, wrapping around, in ring[]; the oldest snapshots are
+ *        dropped to make room for new ones, along with the deltas that depend on a dropped keyframe.
+ */
+typedef struct {
+	size_t state_size;        // see gameboy_state_size(), the same for all the snapshots
+	size_t keyframe_interval; // number of snapshots between two keyframes
+	uint8_t* ring;
+	size_t ring_size;
+	size_t tail;              // where the next encoded bytes go in ring
+	rewind_entry_t* entries;
+	size_t capacity;          // max number of snapshots
+	size_t first;             // oldest snapshot
+	size_t count;
+	size_t since_keyframe;    // snapshots pushed since the last keyframe
+	uint8_t* keyframe;        // last keyframe pushed (decoded), the reference of the next deltas
+	uint8_t* state;           // work buffers
+	uint8_t* encoded;
+} rewind_t;
+
+/**
+ * @brief Initializes a rewind buffer
+ *
+ * @param rw rewind buffer to initialize
+ * @param gameboy gameboy whose snapshots the buffer keeps (it sets their size)
+ * @param capacity max number of snapshots kept
+ * @param ring_size size, in bytes, of the memory holding the encoded snapshots
+ * @param keyframe_interval number of snapshots between two keyframes (at least 1)
+ * @return error code
+ */
+int rewind_init(rewind_t* rw, const gameboy_t* gameboy, size_t capacity, size_t ring_size, size_t keyframe_interval);
+
+/**
+ * @brief Frees a rewind buffer
+ *
+ * @param rw rewind buffer to free
+ */
+void rewind_free(rewind_t* rw);
+
+/**
+ * @brief Adds a snapshot of the current state of a gameboy, dropping the oldest ones if needed
+ *
+ * @param rw rewind buffer
+ * @param gameboy gameboy to take a snapshot of
+ * @return error code
+ */
+int rewind_push(rewind_t* rw, const gameboy_t* gameboy);
+
+/**
+ * @brief Restores the latest snapshot into a gameboy and removes it from the buffer
+ *
+ * @param rw rewind buffer
+ * @param gameboy gameboy to restore
+ * @return error code (ERR_BAD_PARAMETER when there is no snapshot left)
+ */
+int rewind_pop(rewind_t* rw, gameboy_t* gameboy);
+
+/**
+ * @brief Number of bytes of the ring used by the snapshots kept
+ *
+ * @param rw rewind buffer
+ * @return bytes used
+ */
+size_t rewind_used(const rewind_t* rw);
+
+#ifdef __cplusplus
+}
+#endif
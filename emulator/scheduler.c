@@ -0,0 +1,94 @@
+/**
+ * @file scheduler.c
+ * @brief Event scheduler for the GameBoy Emulator
+ *
+ * @author S. Horvath-Mikulas & R. Gerber
+ * @date 2020
+ */
+
+#include "scheduler.h"
+#include "error.h"
+
+/**
+ * Auxiliary function
+ * @brief Swaps two entries of the heap and keeps the position table up to date
+ *
+ * @param sched scheduler
+ * @param i first heap position
+ * @param j second heap position
+ */
+static void scheduler_swap(scheduler_t* sched, size_t i, size_t j)
+{
+	uint8_t tmp = sched->heap[i];
+	sched->heap[i] = sched->heap[j];
+	sched->heap[j] = tmp;
+	sched->pos[sched->heap[i]] = (uint8_t) i;
+	sched->pos[sched->heap[j]] = (uint8_t) j;
+}
+
+#define heap_due(sched, i) ((sched)->due[(sched)->heap[i]])
+
+// ==== see scheduler.h ========================================
+int scheduler_init(scheduler_t* sched)
+{
+	// check arguments validity
+	M_REQUIRE_NON_NULL(sched);
+
+	// every due cycle is equal, so the identity is a valid heap
+	for (uint8_t i = 0; i < SCHED_NB_EVENTS; ++i) {
+		sched->due[i] = SCHED_NEVER;
+		sched->heap[i] = i;
+		sched->pos[i] = i;
+	}
+
+	return ERR_NONE;
+}
+
+// ==== see scheduler.h ========================================
+int scheduler_set(scheduler_t* sched, sched_event_t event, uint64_t cycle)
+{
+	// check arguments validity
+	M_REQUIRE_NON_NULL(sched);
+	M_REQUIRE(event < SCHED_NB_EVENTS, ERR_BAD_PARAMETER, "unknown event source %d", event);
+
+	uint64_t old = sched->due[event];
+	if (cycle == old) {
+		return ERR_NONE;
+	}
+	sched->due[event] = cycle;
+	size_t i = sched->pos[event];
+
+	if (cycle < old) {
+		// sift up: the event got earlier
+		while (i > 0 && heap_due(sched, (i - 1) / 2) > cycle) {
+			scheduler_swap(sched, i, (i - 1) / 2);
+			i = (i - 1) / 2;
+		}
+	} else {
+		// sift down: the event got later
+		for (;;) {
+			size_t min = i;
+			size_t left = 2 * i + 1;
+			size_t right = left + 1;
+			if (left < SCHED_NB_EVENTS && heap_due(sched, left) < heap_due(sched, min)) {
+				min = left;
+			}
+			if (right < SCHED_NB_EVENTS && heap_due(sched, right) < heap_due(sched, min)) {
+				min = right;
+			}
+			if (min == i) {
+				break;
+			}
+			scheduler_swap(sched, i, min);
+			i = min;
+		}
+	}
+
+	return ERR_NONE;
+}
+
+// ==== see scheduler.h ========================================
+uint64_t scheduler_next(const scheduler_t* sched)
+{
+	return sched == NULL ? SCHED_NEVER : heap_due(sched, 0);
+}
@@ -0,0 +1,77 @@
+#pragma once
+
+/**
+ * @file scheduler.h
+ * @brief Event scheduler for the GameBoy Emulator
+ *
+ * @author S. Horvath-Mikulas & R. Gerber
+ * @date 2020
+ */
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * @brief Cycle value of an event that is not scheduled
+ */
+#define SCHED_NEVER UINT64_MAX
+
+/**
+ * @brief Sources of events, one pending event per source
+ */
+typedef enum {
+	SCHED_CPU, SCHED_TIMER, SCHED_LCDC, SCHED_VBLANK, SCHED_NB_EVENTS
+} sched_event_t;
+
+/**
+ * @brief Scheduler type: indexed binary min-heap of the next cycle of each event source
+ *        heap[0] is always the source whose event comes first,
+ *        pos[] gives the heap position of each source so that it can be rescheduled in place.
+ */
+typedef struct {
+	uint64_t due[SCHED_NB_EVENTS];
+	uint8_t heap[SCHED_NB_EVENTS];
+	uint8_t pos[SCHED_NB_EVENTS];
+} scheduler_t;
+
+/**
+ * @brief Initializes a scheduler with no event scheduled
+ *
+ * @param sched scheduler to initialize
+ * @return error code
+ */
+int scheduler_init(scheduler_t* sched);
+
+/**
+ * @brief (Re)schedules the event of a source
+ *
+ * @param sched scheduler
+ * @param event source of the event
+ * @param cycle cycle at which the event occurs (SCHED_NEVER to unschedule it)
+ * @return error code
+ */
+int scheduler_set(scheduler_t* sched, sched_event_t event, uint64_t cycle);
+
+/**
+ * @brief Gives the cycle of the earliest scheduled event
+ *
+ * @param sched scheduler
+ * @return cycle of the next event, SCHED_NEVER if none (or if sched is NULL)
+ */
+uint64_t scheduler_next(const scheduler_t* sched);
+
+/**
+ * @brief Gives the source of the earliest scheduled event
+ *
+ * @param sched scheduler (non NULL)
+ * @return source of the next event
+ */
+#define scheduler_next_event(sched) ((sched_event_t) (sched)->heap[0])
+
+#ifdef __cplusplus
+}
+#endif
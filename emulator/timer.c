@@ -7,7 +7,6 @@
  */
 
 #include "timer.h"
-#include "cpu-storage.h"
 
 #ifdef __cplusplus
 extern "C" {
@@ -31,24 +30,53 @@ bit_t timer_state(gbtimer_t*timer);
  */
 void timer_incr_if_state_change(gbtimer_t* timer, bit_t old_state);
 
+/**
+ * Auxiliary function
+ * @brief Determines which bit of the primary counter drives the secondary counter
+ *
+ * @param reg_tac content of the TAC register
+ * @return index of the bit of the primary counter, -1 if none
+ */
+static int timer_counter_bit(data_t reg_tac);
+
+/**
+ * Auxiliary macro
+ * @brief Updates a timer register; the timer's own writes must not trigger the bus write hooks
+ */
+#define timer_write(timer, addr, data) bus_write(*((timer)->cpu->bus), addr, data)
+
+/**
+ * Auxiliary function
+ * @brief Reads a timer register; the timer's own reads must not trigger the bus sync hook
+ */
+static data_t timer_read(const gbtimer_t* timer, addr_t addr)
+{
+	data_t data = 0;
+	bus_read(*(timer->cpu->bus), addr, &data);
+	return data;
+}
+
+// =========================================================
+static int timer_counter_bit(data_t reg_tac) {
+	// based on the two least significant bit, determine which bit of the primary counter should we listen to
+	switch (reg_tac & 0x03) {
+		case 0: return 9;
+		case 1: return 3;
+		case 2: return 5;
+		case 3: return 7;
+		default: return -1;
+	}
+}
 
 // =========================================================
 bit_t timer_state(gbtimer_t* timer) {
 	// check arguments validity
 	if(timer != NULL && timer->cpu != NULL) {
 		// read the content of the TAC, configuration register for the secondary counter 
-		data_t reg_tac = cpu_read_at_idx(timer->cpu, REG_TAC);
-		int index = -1;
-		// based on the two least significant bit, determine which bit of the primary counter should we listen to
-		switch (reg_tac & 0x11) {
-			case 0: index = 9;
-					break;
-			case 1: index = 3;
-					break;
-			case 2: index = 5;
-					break;
-			case 3: index = 7;
-					break;
+		data_t reg_tac = timer_read(timer, REG_TAC);
+		int index = timer_counter_bit(reg_tac);
+		if (index < 0) {
+			return 0;
 		}
 		// check whether the secondary counter is activated (TAC 3rd lsb bit) and
 		// whether the corresponding bit of the primary counter is active
@@ -66,16 +94,27 @@ void timer_incr_if_state_change(gbtimer_t* timer, bit_t old_state) {
 		bit_t new_state = timer_state(timer);
 		// if the old state switches from 1 to 0 increment the counter
 		if ((old_state == 1) && (new_state == 0)) {
-			if (cpu_read_at_idx(timer->cpu, REG_TIMA) == 0xFF) {
-				cpu_write_at_idx(timer->cpu, REG_TIMA,  (cpu_read_at_idx(timer->cpu, REG_TMA)));
+			if (timer_read(timer, REG_TIMA) == 0xFF) {
+				timer_write(timer, REG_TIMA,  (timer_read(timer, REG_TMA)));
 				cpu_request_interrupt(timer->cpu, TIMER);
 			} else {
-				cpu_write_at_idx(timer->cpu, REG_TIMA,  (cpu_read_at_idx(timer->cpu, REG_TIMA) + 1));
+				timer_write(timer, REG_TIMA,  (timer_read(timer, REG_TIMA) + 1));
 			} 
 		}		
 	 }
 } 
 
+/**
+ * Auxiliary function
+ * @brief Computes the cycle of the next overflow from the registers, as of the last sync
+ */
+static void timer_schedule(gbtimer_t* timer)
+{
+	const uint64_t wait = timer_cycles_to_event(timer);
+	// the wait-th cycle from synced on is the one that overflows
+	timer->event = wait == UINT64_MAX ? UINT64_MAX : timer->synced + wait - 1;
+}
+
 // ==== see timer.h ========================================
 int timer_init(gbtimer_t* timer, cpu_t* cpu) {
 	// check arguments validity
@@ -85,6 +124,8 @@ int timer_init(gbtimer_t* timer, cpu_t* cpu) {
 	// initialize the timer fields
     timer->cpu = cpu;
     timer->counter = 0;
+    timer->synced = 0;
+    timer->event = UINT64_MAX;
 
 	//M_EXIT_IF_ERR(cpu_write_at_idx(timer->cpu, REG_TAC, 4));
 
@@ -100,12 +141,66 @@ int timer_cycle(gbtimer_t* timer){
 	// check whether the secondary counter should be incremented or TIMER interrupt should be raised
     bit_t state = timer_state(timer);
     timer->counter += 4;
-	M_EXIT_IF_ERR(cpu_write_at_idx(timer->cpu, REG_DIV,  msb8(timer->counter)));
+	M_EXIT_IF_ERR(timer_write(timer, REG_DIV,  msb8(timer->counter)));
     timer_incr_if_state_change(timer, state);
 
     return ERR_NONE;
 } 
 
+// ==== see timer.h ========================================
+int timer_advance(gbtimer_t* timer, uint64_t cycles){
+	// check arguments validity
+	M_REQUIRE_NON_NULL(timer);
+
+	data_t reg_tac = timer_read(timer, REG_TAC);
+	int index = timer_counter_bit(reg_tac);
+	const uint64_t start = timer->counter;
+	const uint64_t end = start + 4 * cycles;
+
+	timer->counter = (uint16_t) end;
+	M_EXIT_IF_ERR(timer_write(timer, REG_DIV, msb8(timer->counter)));
+
+	if (bit_get(reg_tac, 2) == 0 || index < 0) {
+		return ERR_NONE;
+	}
+
+	// the driving bit falls each time the counter crosses a multiple of period
+	const uint64_t period = 1u << (index + 1);
+	uint64_t edges = end / period - start / period;
+	data_t tima = timer_read(timer, REG_TIMA);
+	if (edges > (uint64_t) (0xFF - tima)) {
+		// at least one overflow: TIMA is reloaded with TMA, then overflows every 0x100 - TMA edges
+		data_t tma = timer_read(timer, REG_TMA);
+		edges -= (uint64_t) (0x100 - tima);
+		tima = (data_t) (tma + edges % (uint64_t) (0x100 - tma));
+		cpu_request_interrupt(timer->cpu, TIMER);
+	} else {
+		tima = (data_t) (tima + edges);
+	}
+	M_EXIT_IF_ERR(timer_write(timer, REG_TIMA, tima));
+
+	return ERR_NONE;
+}
+
+// ==== see timer.h ========================================
+uint64_t timer_cycles_to_event(gbtimer_t* timer){
+	if (timer == NULL || timer->cpu == NULL) {
+		return UINT64_MAX;
+	}
+
+	data_t reg_tac = timer_read(timer, REG_TAC);
+	int index = timer_counter_bit(reg_tac);
+	if (bit_get(reg_tac, 2) == 0 || index < 0) {
+		return UINT64_MAX;
+	}
+
+	// the driving bit falls each time the counter reaches a multiple of period,
+	// the counter moving by 4 each cycle; TIMA overflows on the (0x100 - TIMA)-th fall
+	const uint64_t period = 1u << (index + 1);
+	const uint64_t edges = (uint64_t) (0x100 - timer_read(timer, REG_TIMA));
+	return (period - timer->counter % period + 3) / 4 + (edges - 1) * period / 4;
+}
+
 // ==== see timer.h ========================================
 int timer_bus_listener(gbtimer_t* timer, addr_t addr) {
 	// check arguments validity
@@ -115,15 +210,43 @@ int timer_bus_listener(gbtimer_t* timer, addr_t addr) {
 	if(addr == REG_DIV) {
 		bit_t state = timer_state(timer);
 		timer->counter = 0;
-		M_EXIT_IF_ERR(cpu_write_at_idx(timer->cpu, REG_DIV, 0));
+		M_EXIT_IF_ERR(timer_write(timer, REG_DIV, 0));
 		timer_incr_if_state_change(timer, state);
 	} else if(addr == REG_TAC) {
 		timer_incr_if_state_change(timer, timer_state(timer));
 	}
+
+	// any of its registers may move the next overflow
+	timer_schedule(timer);
 	
 	return ERR_NONE;
 } 
 
+// ==== see timer.h ========================================
+int timer_sync(gbtimer_t* timer, uint64_t cycle) {
+	// check arguments validity
+	M_REQUIRE_NON_NULL(timer);
+
+	if (cycle > timer->synced) {
+		M_EXIT_IF_ERR(timer_advance(timer, cycle - timer->synced));
+		timer->synced = cycle;
+		timer_schedule(timer);
+	}
+
+	return ERR_NONE;
+}
+
+// ==== see timer.h ========================================
+int timer_resync(gbtimer_t* timer, uint64_t cycle) {
+	// check arguments validity
+	M_REQUIRE_NON_NULL(timer);
+
+	timer->synced = cycle;
+	timer_schedule(timer);
+
+	return ERR_NONE;
+}
+
 #ifdef __cplusplus
 }
 #endif
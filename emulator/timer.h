@@ -38,6 +38,8 @@ extern "C" {
  typedef struct {
     cpu_t* cpu;
     uint16_t counter;
+    uint64_t synced; // the counter and registers are those of the start of this cycle (see timer_sync())
+    uint64_t event;  // cycle of the next overflow of the secondary counter (UINT64_MAX: none)
  } gbtimer_t;
 
 /**
@@ -59,6 +61,50 @@ int timer_init(gbtimer_t* timer, cpu_t* cpu);
 int timer_cycle(gbtimer_t* timer);
 
 
+/**
+ * @brief Runs several Timer cycles at once (same result as calling timer_cycle that many times,
+ *        except that at most one TIMER interrupt is requested)
+ *
+ * @param timer timer to advance
+ * @param cycles number of cycles
+ * @return error code
+ */
+int timer_advance(gbtimer_t* timer, uint64_t cycles);
+
+
+/**
+ * @brief Number of cycles until the next overflow of the secondary counter,
+ *        i.e. until the next TIMER interrupt, computed from the counter, TAC and TIMA
+ *
+ * @param timer timer
+ * @return number of cycles (at least 1), UINT64_MAX if the secondary counter is disabled
+ */
+uint64_t timer_cycles_to_event(gbtimer_t* timer);
+
+
+/**
+ * @brief Brings a timer up to date: runs all its cycles since the last sync (see timer_advance()).
+ *        The timer does nothing on its own in between, its registers are only updated
+ *        when they are accessed (sync hook) or at its next overflow (timer->event).
+ *
+ * @param timer timer to sync
+ * @param cycle cycle at which the timer should be, i.e. its cycles before this one are run
+ * @return error code
+ */
+int timer_sync(gbtimer_t* timer, uint64_t cycle);
+
+
+/**
+ * @brief Sets the cycle a timer is at (its counter and registers having been set as of that cycle)
+ *        and computes its next overflow
+ *
+ * @param timer timer
+ * @param cycle cycle at which the timer is
+ * @return error code
+ */
+int timer_resync(gbtimer_t* timer, uint64_t cycle);
+
+
 /**
  * @brief Timer bus listening handler
  *
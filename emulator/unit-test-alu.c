@@ -549,6 +549,96 @@ START_TEST(alu_carryrotate_exec)
 }
 END_TEST
 
+START_TEST(alu_daa_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    ck_assert_int_eq(alu_daa(NULL, 0, 0), ERR_BAD_PARAMETER);
+    alu_output_t result = {0, 0};
+    ck_assert_int_eq(alu_daa(&result, 0, 0x01), ERR_BAD_PARAMETER);
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(alu_daa_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+
+    // results of 0x15 + 0x27, 0x99 + 0x01, 0x10 - 0x01, 0x00 - 0x01, 0x45 + 0x55 and 0x98 + 0x98
+    const uint8_t input_x[] = {0x3C, 0x9A, 0x0F, 0xFF, 0x9A, 0x30};
+    const uint8_t input_f[] = {0x00, 0x00, 0x60, 0x70, 0x00, 0x30};
+
+    const uint16_t expected_v[] = {0x42, 0x00, 0x09, 0x99, 0x00, 0x96};
+    const flags_t expected_f [] = {0x00, 0x90, 0x40, 0x50, 0x90, 0x10};
+
+    ASSERT_EQ_NB_EL(input_x, input_f);
+    ASSERT_EQ_NB_EL(input_f, expected_v);
+    ASSERT_EQ_NB_EL(expected_v, expected_f);
+
+    LOOP_ON(input_x) {
+        alu_output_t result = {0, 0};
+
+        ck_assert_int_eq(alu_daa(&result, input_x[i_], input_f[i_]), ERR_NONE);
+
+        ck_assert_msg(result.value == expected_v[i_],
+                      "alu_daa() failed on 0x%" PRIX8 " (flag = 0x%" PRIX8 ") : got value 0x%"
+                      PRIX8 " instead of 0x%" PRIX8,
+                      input_x[i_], input_f[i_], result.value, expected_v[i_]);
+
+        ck_assert_msg(result.flags == expected_f[i_],
+                      "alu_daa() failed on 0x%" PRIX8 " (flag = 0x%" PRIX8 ") : got flag 0x%"
+                      PRIX8 " instead of 0x%" PRIX8,
+                      input_x[i_], input_f[i_], result.flags, expected_f[i_]);
+    }
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(alu_add_sub8_all)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+
+    // the flag tables against a plain nibble by nibble computation, for every operand and carry
+    for (unsigned x = 0; x <= 0xFF; ++x) {
+        for (unsigned y = 0; y <= 0xFF; ++y) {
+            for (bit_t c = 0; c <= 1; ++c) {
+                alu_output_t result = {0, 0};
+                const uint8_t sum = (uint8_t) (x + y + c);
+                const flags_t add_f = (sum == 0 ? FLAG_Z : 0) | ((x & 0xF) + (y & 0xF) + c > 0xF ? FLAG_H : 0)
+                                      | (x + y + c > 0xFF ? FLAG_C : 0);
+                ck_assert_int_eq(alu_add8(&result, (uint8_t) x, (uint8_t) y, c), ERR_NONE);
+                ck_assert_msg(result.value == sum && result.flags == add_f,
+                              "alu_add8() failed on 0x%X + 0x%X + %u", x, y, c);
+
+                const uint8_t diff = (uint8_t) (x - y - c);
+                const flags_t sub_f = (diff == 0 ? FLAG_Z : 0) | FLAG_N | ((x & 0xF) < (y & 0xF) + c ? FLAG_H : 0)
+                                      | (x < y + c ? FLAG_C : 0);
+                ck_assert_int_eq(alu_sub8(&result, (uint8_t) x, (uint8_t) y, c), ERR_NONE);
+                ck_assert_msg(result.value == diff && result.flags == sub_f,
+                              "alu_sub8() failed on 0x%X - 0x%X - %u", x, y, c);
+            }
+        }
+    }
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
 // ================================================================================
 Suite* bus_test_suite()
 {
@@ -573,6 +663,7 @@ Suite* bus_test_suite()
     tcase_add_test(tc2, alu_shiftRA_err);
     tcase_add_test(tc2, alu_rotate_err);
     tcase_add_test(tc2, alu_carryrotate_err);
+    tcase_add_test(tc2, alu_daa_err);
 
     Add_Case(s, tc3, "ALU functions run tests");
     tcase_add_test(tc3, alu_add8_exec);
@@ -583,6 +674,8 @@ Suite* bus_test_suite()
     tcase_add_test(tc3, alu_shiftRA_exec);
     tcase_add_test(tc3, alu_rotate_exec);
     tcase_add_test(tc3, alu_carryrotate_exec);
+    tcase_add_test(tc3, alu_daa_exec);
+    tcase_add_test(tc3, alu_add_sub8_all);
 
     return s;
 }
@@ -6,10 +6,13 @@
  * @date 2020
  */
 
+#define _XOPEN_SOURCE 700 // fork, waitpid
+
 // for thread-safe randomization
 #include <time.h>
 #include <stdlib.h>
 #include <sys/types.h>
+#include <sys/wait.h>
 #include <unistd.h>
 #include <pthread.h>
 
@@ -895,6 +898,168 @@ START_TEST(bit_vector_deadboss)
 }
 END_TEST
 
+START_TEST(bit_vector_fixed_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    bit_vector_256_t a, b, d;
+    bit_vector_160_t line;
+    bit_vector_t* pa = bit_vector_fixed_init(&a, 0);
+    bit_vector_t* pb = bit_vector_fixed_init(&b, 0);
+    bit_vector_t* pd = bit_vector_fixed_init(&d, 1);
+    bit_vector_t* pl = bit_vector_fixed_init(&line, 1);
+    ck_assert_ptr_nonnull(pa);
+    ck_assert_ptr_nonnull(pd);
+    ck_assert_ptr_nonnull(pl);
+    ck_assert_int_eq(pa->size, 256);
+    ck_assert_int_eq(pl->size, 160);
+    vector_match_val(pd, UINT32_MAX, 8);
+    vector_match_val(pl, UINT32_MAX, 5);
+    ck_assert_ptr_null(bit_vector_init(NULL, 8, 0));
+    ck_assert_ptr_null(bit_vector_init(pd, 0, 0));
+
+    for (size_t i = 0; i < 8; ++i) {
+        a.content[i] = (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+        b.content[i] = (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+    }
+
+    // each destination variant gives the same as its allocating counterpart
+    bit_vector_t* expected = NULL;
+#define check_to(call, alloc) \
+    do { \
+        ck_assert_ptr_eq(call, pd); \
+        ck_assert_ptr_nonnull(expected = alloc); \
+        vector_match_vector(pd, expected); \
+        bit_vector_free(&expected); \
+    } while (0)
+
+    check_to(bit_vector_cpy_to(pd, pa), bit_vector_cpy(pa));
+    check_to(bit_vector_not_to(pd, pa), bit_vector_not(bit_vector_cpy(pa)));
+    check_to(bit_vector_and_to(pd, pa, pb), bit_vector_and(bit_vector_cpy(pa), pb));
+    check_to(bit_vector_or_to(pd, pa, pb), bit_vector_or(bit_vector_cpy(pa), pb));
+    check_to(bit_vector_xor_to(pd, pa, pb), bit_vector_xor(bit_vector_cpy(pa), pb));
+    check_to(bit_vector_join_to(pd, pa, pb, 77), bit_vector_join(pa, pb, 77));
+    for (int64_t shift = -300; shift <= 300; shift += 37) {
+        check_to(bit_vector_shift_to(pd, pa, shift), bit_vector_shift(pa, shift));
+        check_to(bit_vector_extract_zero_ext_to(pd, pa, shift), bit_vector_extract_zero_ext(pa, shift, 256));
+        check_to(bit_vector_extract_wrap_ext_to(pd, pa, shift), bit_vector_extract_wrap_ext(pa, shift, 256));
+
+        // in place
+        ck_assert_ptr_nonnull(expected = bit_vector_shift(pa, shift));
+        ck_assert_ptr_eq(bit_vector_shift_to(pd, bit_vector_cpy_to(pd, pa), shift), pd);
+        vector_match_vector(pd, expected);
+        bit_vector_free(&expected);
+
+        // a 160-pixel line seen through a 256-pixel one
+        ck_assert_ptr_eq(bit_vector_extract_wrap_ext_to(pl, pa, shift), pl);
+        ck_assert_ptr_nonnull(expected = bit_vector_extract_wrap_ext(pa, shift, 160));
+        vector_match_vector(pl, expected);
+        bit_vector_free(&expected);
+    }
+#undef check_to
+
+    // aligned on words, the line is made of words of the map line, wrapping around
+    ck_assert_ptr_eq(bit_vector_extract_wrap_ext_to(pl, pa, 4 * IMAGE_LINE_WORD_BITS), pl);
+    for (size_t i = 0; i < 5; ++i) {
+        ck_assert_int_eq(line.content[i], a.content[(i + 4) % 8]);
+    }
+
+    // sizes must match, wrapping cannot be done in place
+    ck_assert_ptr_null(bit_vector_and_to(pl, pa, pb));
+    ck_assert_ptr_null(bit_vector_cpy_to(pl, pa));
+    ck_assert_ptr_null(bit_vector_shift_to(pl, pa, 1));
+    ck_assert_ptr_null(bit_vector_join_to(pd, pa, pl, 1));
+    ck_assert_ptr_null(bit_vector_extract_wrap_ext_to(pd, pd, 1));
+    ck_assert_ptr_null(bit_vector_not_to(NULL, pa));
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+/**
+ * @brief Checks the bulk logical operations against their word by word result,
+ *        with the kernels in use
+ *
+ * @return number of words which differ
+ */
+static size_t backend_mismatches(void)
+{
+    const size_t sizes[] = { 1, 31, 64, 96, 160, 256, 300, 1000 };
+    size_t mismatches = 0;
+
+    for (size_t n = 0; n < sizeof(sizes) / sizeof(sizes[0]); ++n) {
+        const size_t size = sizes[n];
+        const size_t words = size / IMAGE_LINE_WORD_BITS + (size % IMAGE_LINE_WORD_BITS ? 1 : 0);
+        const uint32_t last = size % IMAGE_LINE_WORD_BITS ? (1u << size % IMAGE_LINE_WORD_BITS) - 1 : UINT32_MAX;
+        bit_vector_t* pa = bit_vector_create(size, 0);
+        bit_vector_t* pb = bit_vector_create(size, 0);
+        bit_vector_t* pd = bit_vector_create(size, 0);
+        if (pa == NULL || pb == NULL || pd == NULL) {
+            return SIZE_MAX;
+        }
+        for (size_t i = 0; i < words; ++i) {
+            pa->content[i] = ((uint32_t) rand() ^ ((uint32_t) rand() << 16)) & (i == words - 1 ? last : UINT32_MAX);
+            pb->content[i] = ((uint32_t) rand() ^ ((uint32_t) rand() << 16)) & (i == words - 1 ? last : UINT32_MAX);
+        }
+
+#define check_op(call, expr) \
+        do { \
+            mismatches += (call) != pd; \
+            for (size_t i = 0; i < words; ++i) { \
+                mismatches += pd->content[i] != ((expr) & (i == words - 1 ? last : UINT32_MAX)); \
+            } \
+        } while (0)
+
+        check_op(bit_vector_and_to(pd, pa, pb), pa->content[i] & pb->content[i]);
+        check_op(bit_vector_or_to(pd, pa, pb), pa->content[i] | pb->content[i]);
+        check_op(bit_vector_xor_to(pd, pa, pb), pa->content[i] ^ pb->content[i]);
+        check_op(bit_vector_not_to(pd, pa), ~pa->content[i]);
+        // in place
+        check_op(bit_vector_xor(bit_vector_cpy_to(pd, pa), pb), pa->content[i] ^ pb->content[i]);
+        check_op(bit_vector_and(pd, pa), (pa->content[i] ^ pb->content[i]) & pa->content[i]);
+#undef check_op
+
+        bit_vector_free(&pa);
+        bit_vector_free(&pb);
+        bit_vector_free(&pd);
+    }
+    return mismatches;
+}
+
+START_TEST(bit_vector_backend_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    const bit_vector_backend_t backends[] = { BIT_VECTOR_SCALAR, BIT_VECTOR_SSE2, BIT_VECTOR_AVX2 };
+
+    // the kernels are selected once per process: each backend is checked in a process of its own
+    for (size_t k = 0; k < sizeof(backends) / sizeof(backends[0]); ++k) {
+        const pid_t pid = fork();
+        ck_assert(pid >= 0);
+        if (pid == 0) {
+            _exit(bit_vector_select_backend(backends[k]) <= backends[k] && backend_mismatches() == 0 ? EXIT_SUCCESS : EXIT_FAILURE);
+        }
+        int status = 0;
+        ck_assert_int_eq(waitpid(pid, &status, 0), pid);
+        ck_assert(WIFEXITED(status) && WEXITSTATUS(status) == EXIT_SUCCESS);
+    }
+
+    // here, with the kernels selected on first use, which no later selection changes
+    ck_assert_int_eq(backend_mismatches(), 0);
+    const bit_vector_backend_t in_use = bit_vector_select_backend(BIT_VECTOR_AVX2);
+    ck_assert_int_eq(bit_vector_select_backend(BIT_VECTOR_SCALAR), in_use);
+    ck_assert_int_eq(backend_mismatches(), 0);
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
 Suite* cartridge_test_suite()
 {
 
@@ -907,6 +1072,8 @@ Suite* cartridge_test_suite()
     Suite* s = suite_create("bit_vector.c Tests");
 
     Add_Case(s, tc1, "BitVector Tests");
+    // first, for its forked processes to select the kernels even when the tests do not run in processes of their own
+    tcase_add_test(tc1, bit_vector_backend_exec);
     tcase_add_test(tc1, bit_vector_create_exec);
     tcase_add_test(tc1, bit_vector_cpy_exec);
     tcase_add_test(tc1, bit_vector_get_exec);
@@ -920,6 +1087,7 @@ Suite* cartridge_test_suite()
     tcase_add_test(tc1, bit_vector_join_exec);
     tcase_add_test(tc1, bit_vector_various);
     tcase_add_test(tc1, bit_vector_deadboss);
+    tcase_add_test(tc1, bit_vector_fixed_exec);
 
     return s;
 }
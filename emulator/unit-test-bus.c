@@ -74,9 +74,9 @@ START_TEST(bus_plug_exec)
     ck_assert(c.end == c_size);
 
     for (size_t i = 0; i < c_size; ++i) {
-        ck_assert(bus[i] == c.mem->memory + i);
-        ck_assert(*bus[i] == 0);
-        *bus[i] = data;
+        ck_assert(bus_lookup(bus, (addr_t) i) == c.mem->memory + i);
+        ck_assert(*bus_lookup(bus, (addr_t) i) == 0);
+        *bus_lookup(bus, (addr_t) i) = data;
         ck_assert(c.mem->memory[i] == data);
     }
 
@@ -85,7 +85,7 @@ START_TEST(bus_plug_exec)
     ck_assert(c.end == 0);
 
     for (size_t i = 0; i < c_size; ++i) {
-        ck_assert(bus[i] == NULL);
+        ck_assert(bus_lookup(bus, (addr_t) i) == NULL);
     }
 
     component_free(&c);
@@ -138,7 +138,7 @@ START_TEST(bus_read_exec)
     ck_assert_int_eq(bus_plug(bus, &c, 0, (addr_t)c_size), ERR_NONE);
 
     for (size_t i = 0; i < c_size; ++i) {
-        *bus[i] = (data_t)i;
+        *bus_lookup(bus, (addr_t) i) = (data_t)i;
     }
 
     for (size_t addr = 0; addr < c_size; ++addr) {
@@ -195,7 +195,7 @@ START_TEST(bus_write_exec)
     ck_assert_int_eq(bus_plug(bus, &c, 0, (addr_t)c_size), ERR_NONE);
 
     for (size_t i = 0; i < c_size; ++i) {
-        *bus[i] = (data_t) i;
+        *bus_lookup(bus, (addr_t) i) = (data_t) i;
     }
 
     for (size_t addr = 0; addr < c_size; ++addr) {
@@ -213,6 +213,240 @@ START_TEST(bus_write_exec)
 }
 END_TEST
 
+START_TEST(bus_page_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    component_t d = {NULL, 0, 0};
+    data_t byte = 0x42;
+    ck_assert_err_none(component_create(&c, 0x180));
+    ck_assert_err_none(component_create(&d, 0x80));
+
+    // c covers one full page and half of the next one, d the other half
+    ck_assert_err_none(bus_plug(bus, &c, 0xFE00, 0xFF7F));
+    ck_assert_err_none(bus_plug(bus, &d, 0xFF80, 0xFFFF));
+    ck_assert_int_eq(bus_plug(bus, &d, 0xFF7F, 0xFF80), ERR_ADDRESS);
+    ck_assert_err_none(bus_map_byte(bus, 0xFFFF, &byte));
+
+    for (size_t i = 0xFE00; i <= 0xFF7F; ++i) {
+        ck_assert_ptr_eq(bus_lookup(bus, (addr_t) i), c.mem->memory + (i - 0xFE00));
+    }
+    for (size_t i = 0xFF80; i < 0xFFFF; ++i) {
+        ck_assert_ptr_eq(bus_lookup(bus, (addr_t) i), d.mem->memory + (i - 0xFF80));
+    }
+    ck_assert_ptr_eq(bus_lookup(bus, 0xFFFF), &byte);
+    ck_assert_ptr_null(bus_lookup(bus, 0xFDFF));
+
+    // unplugging c leaves d untouched
+    ck_assert_err_none(bus_unplug(bus, &c));
+    ck_assert_ptr_null(bus_lookup(bus, 0xFE00));
+    ck_assert_ptr_null(bus_lookup(bus, 0xFF7F));
+    ck_assert_ptr_eq(bus_lookup(bus, 0xFF80), d.mem->memory);
+    ck_assert_ptr_eq(bus_lookup(bus, 0xFFFF), &byte);
+
+    component_free(&c);
+    component_free(&d);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+typedef struct {
+    size_t calls;
+    addr_t last;
+} hook_owner_t;
+
+static int test_hook(void* owner, addr_t addr)
+{
+    hook_owner_t* o = owner;
+    ++o->calls;
+    o->last = addr;
+    return ERR_NONE;
+}
+
+START_TEST(bus_hook_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    bus_t bus;
+    zero_init_var(bus);
+    hook_owner_t owner = {0, 0};
+
+    ck_assert_bad_param(bus_hook_register(NULL, 0, 1, test_hook, &owner));
+    ck_assert_bad_param(bus_hook_register(bus, 0, 1, NULL, &owner));
+    ck_assert_int_eq(bus_hook_register(bus, 2, 1, test_hook, &owner), ERR_ADDRESS);
+    for (size_t i = 0; i < BUS_MAX_HOOKS; ++i) {
+        ck_assert_err_none(bus_hook_register(bus, (addr_t) i, (addr_t) i, test_hook, &owner));
+    }
+    ck_assert_err_mem(bus_hook_register(bus, 0xFF00, 0xFF00, test_hook, &owner));
+    ck_assert_err_none(bus_hook_dispatch(NULL, 0));
+
+    // overlapping ranges, on either side or within
+    zero_init_var(bus);
+    ck_assert_err_none(bus_hook_register(bus, 0xFF04, 0xFF07, test_hook, &owner));
+    ck_assert_int_eq(bus_hook_register(bus, 0xFF00, 0xFF04, test_hook, &owner), ERR_ADDRESS);
+    ck_assert_int_eq(bus_hook_register(bus, 0xFF07, 0xFF0F, test_hook, &owner), ERR_ADDRESS);
+    ck_assert_int_eq(bus_hook_register(bus, 0xFF05, 0xFF05, test_hook, &owner), ERR_ADDRESS);
+    ck_assert_int_eq(bus_hook_register(bus, 0xFF00, 0xFFFF, test_hook, &owner), ERR_ADDRESS);
+    ck_assert_int_eq(bus->nb_hooks, 1);
+    // adjacent ones are fine
+    ck_assert_err_none(bus_hook_register(bus, 0xFF00, 0xFF03, test_hook, &owner));
+    ck_assert_err_none(bus_hook_register(bus, 0xFF08, 0xFF08, test_hook, &owner));
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(bus_hook_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    bus_t bus;
+    zero_init_var(bus);
+    hook_owner_t a = {0, 0};
+    hook_owner_t b = {0, 0};
+
+    ck_assert_err_none(bus_hook_register(bus, 0xFF04, 0xFF07, test_hook, &a));
+    ck_assert_err_none(bus_hook_register(bus, 0xFF40, 0xFF4B, test_hook, &b));
+
+    // unhooked addresses, in a hooked page or not
+    ck_assert_err_none(bus_hook_dispatch(bus, 0xC000));
+    ck_assert_err_none(bus_hook_dispatch(bus, 0xFF03));
+    ck_assert_err_none(bus_hook_dispatch(bus, 0xFF4C));
+    ck_assert_int_eq(a.calls, 0);
+    ck_assert_int_eq(b.calls, 0);
+
+    // only the owner is called
+    ck_assert_err_none(bus_hook_dispatch(bus, 0xFF07));
+    ck_assert_int_eq(a.calls, 1);
+    ck_assert_int_eq(a.last, 0xFF07);
+    ck_assert_int_eq(b.calls, 0);
+    ck_assert_err_none(bus_hook_dispatch(bus, 0xFF40));
+    ck_assert_int_eq(a.calls, 1);
+    ck_assert_int_eq(b.calls, 1);
+    ck_assert_int_eq(b.last, 0xFF40);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(bus_sync_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    bus_t bus;
+    zero_init_var(bus);
+    hook_owner_t a = {0, 0};
+    hook_owner_t b = {0, 0};
+
+    ck_assert_bad_param(bus_sync_register(NULL, 0xFF04, 0xFF07, test_hook, &a));
+    ck_assert_bad_param(bus_sync_register(bus, 0xFF04, 0xFF07, NULL, &a));
+    ck_assert_int_eq(bus_sync_register(bus, 0xFF07, 0xFF04, test_hook, &a), ERR_ADDRESS);
+    ck_assert_err_none(bus_sync_dispatch(NULL, 0xFF04));
+
+    ck_assert_err_none(bus_sync_register(bus, 0xFF04, 0xFF07, test_hook, &a));
+    ck_assert_err_none(bus_sync_dispatch(bus, 0xC000));
+    ck_assert_err_none(bus_sync_dispatch(bus, 0xFF08));
+    ck_assert_int_eq(a.calls, 0);
+    ck_assert_err_none(bus_sync_dispatch(bus, 0xFF05));
+    ck_assert_int_eq(a.calls, 1);
+    ck_assert_int_eq(a.last, 0xFF05);
+    // not from within a hook
+    bus->in_hook = 1;
+    ck_assert_err_none(bus_sync_dispatch(bus, 0xFF05));
+    ck_assert_int_eq(a.calls, 1);
+    bus->in_hook = 0;
+
+    // registering again replaces it
+    ck_assert_err_none(bus_sync_register(bus, 0xC000, 0xC0FF, test_hook, &b));
+    ck_assert_err_none(bus_sync_dispatch(bus, 0xFF05));
+    ck_assert_err_none(bus_sync_dispatch(bus, 0xC010));
+    ck_assert_int_eq(a.calls, 1);
+    ck_assert_int_eq(b.calls, 1);
+    ck_assert_int_eq(bus->pages[BUS_PAGE(0xFF05)].flags & BUS_PAGE_SYNCED, 0);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+typedef struct {
+    size_t calls;
+    addr_t addr;
+    data_t data;
+} divert_owner_t;
+
+static int test_divert(void* owner, addr_t addr, data_t data)
+{
+    divert_owner_t* o = owner;
+    ++o->calls;
+    o->addr = addr;
+    o->data = data;
+    return ERR_NONE;
+}
+
+START_TEST(bus_divert_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    divert_owner_t owner = {0, 0, 0};
+
+    ck_assert_bad_param(bus_divert_register(NULL, 0x0000, 0x7FFF, test_divert, &owner));
+    ck_assert_bad_param(bus_divert_register(bus, 0x0000, 0x7FFF, NULL, &owner));
+    ck_assert_int_eq(bus_divert_register(bus, 0x0000, 0x7FFE, test_divert, &owner), ERR_ADDRESS);
+    ck_assert_int_eq(bus_divert_register(bus, 0x0001, 0x7FFF, test_divert, &owner), ERR_ADDRESS);
+
+    ck_assert_err_none(component_create(&c, 0x8000));
+    ck_assert_err_none(bus_plug(bus, &c, 0x0000, 0x7FFF));
+    ck_assert_err_none(bus_divert_register(bus, 0x0000, 0x7FFF, test_divert, &owner));
+
+    // the writes reach the owner, not the memory
+    ck_assert_err_none(bus_write(bus, 0x2000, 0x42));
+    ck_assert_int_eq(owner.calls, 1);
+    ck_assert_int_eq(owner.addr, 0x2000);
+    ck_assert_int_eq(owner.data, 0x42);
+    ck_assert_int_eq(c.mem->memory[0x2000], 0);
+    // both bytes of a 16 bits write, the high one last
+    ck_assert_err_none(bus_write16(bus, 0x3FFF, 0x1234));
+    ck_assert_int_eq(owner.calls, 3);
+    ck_assert_int_eq(owner.addr, 0x4000);
+    ck_assert_int_eq(owner.data, 0x12);
+    ck_assert_int_eq(c.mem->memory[0x3FFF], 0);
+    ck_assert_int_eq(c.mem->memory[0x4000], 0);
+
+    // registering another range gives the former one back to its memory
+    ck_assert_err_none(bus_divert_register(bus, 0x4000, 0x7FFF, test_divert, &owner));
+    ck_assert_err_none(bus_write(bus, 0x2000, 0x42));
+    ck_assert_int_eq(owner.calls, 3);
+    ck_assert_int_eq(c.mem->memory[0x2000], 0x42);
+
+    component_free(&c);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
 
 Suite* bus_test_suite()
 {
@@ -235,6 +469,14 @@ Suite* bus_test_suite()
     tcase_add_test(tc3, bus_write_err);
     tcase_add_test(tc3, bus_write_exec);
 
+    tcase_add_test(tc3, bus_page_exec);
+
+    tcase_add_test(tc3, bus_hook_err);
+    tcase_add_test(tc3, bus_hook_exec);
+    tcase_add_test(tc3, bus_sync_exec);
+
+    tcase_add_test(tc3, bus_divert_exec);
+
     return s;
 }
 
@@ -9,6 +9,7 @@
 // for thread-safe randomization
 #include <time.h>
 #include <stdlib.h>
+#include <string.h>
 #include <sys/types.h>
 #include <unistd.h>
 #include <pthread.h>
@@ -117,10 +118,10 @@ START_TEST(cartridge_plug_exec)
     cartridge_t ct = {0};
     bus_t bus = {0};
     ck_assert_err_none(cartridge_init(&ct, FIBONACCI_ROM));
-    ck_assert_ptr_null(bus[0]);
+    ck_assert_ptr_null(bus_lookup(bus, 0));
     ck_assert_err_none(cartridge_plug(&ct, bus));
-    ck_assert_ptr_nonnull(bus[0]);
-    ck_assert_ptr_eq(bus[0], &(ct.c.mem->memory[0]));
+    ck_assert_ptr_nonnull(bus_lookup(bus, 0));
+    ck_assert_ptr_eq(bus_lookup(bus, 0), &(ct.c.mem->memory[0]));
 
     cartridge_free(&ct);
 #ifdef WITH_PRINT
@@ -130,6 +131,172 @@ START_TEST(cartridge_plug_exec)
 }
 END_TEST
 
+START_TEST(cartridge_shared_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    cartridge_t ct1 = {0};
+    cartridge_t ct2 = {0};
+    bus_t bus = {0};
+    uint16_t fb[FIB_BYTES_SIZE] = FIB_BYTES;
+
+    // the same file, whatever the path: the same (read-only) memory
+    ck_assert_err_none(cartridge_init(&ct1, FIBONACCI_ROM));
+    ck_assert_err_none(cartridge_init(&ct2, "./" FIBONACCI_ROM));
+    ck_assert_ptr_nonnull(ct1.rom);
+    ck_assert_ptr_eq(ct1.rom, ct2.rom);
+    ck_assert_ptr_eq(ct1.c.mem->memory, ct2.c.mem->memory);
+
+    // writes do not reach the ROM
+    ck_assert_err_none(cartridge_plug(&ct1, bus));
+    ck_assert_err_none(bus_write(bus, 0x0000, 0xAA));
+    ck_assert_err_none(bus_write16(bus, 0x2000, 0xAAAA));
+    ck_assert_int_eq(ct2.c.mem->memory[0], fb[0]);
+
+    // still there for the other cartridge
+    cartridge_free(&ct1);
+    for (size_t i = 0; i < FIB_BYTES_SIZE; ++i) {
+        ck_assert_int_eq(ct2.c.mem->memory[i], fb[i]);
+    }
+    cartridge_free(&ct2);
+    ck_assert_ptr_null(ct2.rom);
+    ck_assert_ptr_null(ct2.c.mem);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+
+}
+END_TEST
+
+
+#define MBC_MARK 0x10 // offset, in each bank, of its number
+
+/**
+ * @brief Creates a cartridge with a bank controller from a ROM image whose banks hold their number
+ */
+static void mbc_cartridge(cartridge_t* ct, data_t type, data_t rom_code, data_t ram_code, size_t nb_banks)
+{
+    data_t* rom = calloc(nb_banks, BANK_ROM0_SIZE);
+    ck_assert_ptr_nonnull(rom);
+    for (size_t b = 0; b < nb_banks; ++b) {
+        rom[b * BANK_ROM0_SIZE + MBC_MARK] = (data_t) b;
+    }
+    rom[CARTRIDGE_TYPE_ADDR] = type;
+    rom[CARTRIDGE_ROM_SIZE_ADDR] = rom_code;
+    rom[CARTRIDGE_RAM_SIZE_ADDR] = ram_code;
+    ck_assert_err_none(cartridge_init_from_memory(ct, rom, nb_banks * BANK_ROM0_SIZE));
+    free(rom);
+}
+
+#define ck_assert_bus_eq(bus, addr, value) \
+    do { \
+        data_t byte = 0; \
+        ck_assert_err_none(bus_read(bus, addr, &byte)); \
+        ck_assert_int_eq(byte, value); \
+    } while (0)
+
+START_TEST(cartridge_mbc_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    cartridge_t ct = {0};
+    component_t ram = {0};
+    bus_t bus = {0};
+
+    // MBC1 + RAM + battery, 128 KiB of ROM, 32 KiB of RAM
+    mbc_cartridge(&ct, 0x03, 0x02, 0x03, 8);
+    ck_assert_int_eq(ct.mbc, MBC1);
+    ck_assert_int_eq(ct.nb_rom_banks, 8);
+    ck_assert_int_eq(cartridge_ram_size(&ct), 0x8000);
+    ck_assert_err_none(component_create(&ram, cartridge_ram_size(&ct)));
+    ck_assert_err_none(bus_plug(bus, &ram, BANK_RAM_START, BANK_RAM_END));
+    ck_assert_err_none(cartridge_connect(&ct, NULL, &ram, NULL));
+    ck_assert_err_none(cartridge_plug(&ct, bus));
+
+    ck_assert_bus_eq(bus, BANK_ROM1_START + MBC_MARK, 1);
+    ck_assert_err_none(bus_write(bus, 0x2000, 3));
+    ck_assert_bus_eq(bus, BANK_ROM1_START + MBC_MARK, 3);
+    // bank 0 is bank 1, beyond the banks of the cartridge: the first ones again
+    ck_assert_err_none(bus_write(bus, 0x2000, 0));
+    ck_assert_bus_eq(bus, BANK_ROM1_START + MBC_MARK, 1);
+    ck_assert_err_none(bus_write(bus, 0x2000, 13));
+    ck_assert_bus_eq(bus, BANK_ROM1_START + MBC_MARK, 5);
+    ck_assert_bus_eq(bus, BANK_ROM0_START + MBC_MARK, 0);
+
+    // RAM disabled: nothing there
+    ck_assert_err_none(bus_write(bus, BANK_RAM_START, 0x42));
+    ck_assert_bus_eq(bus, BANK_RAM_START, 0xFF);
+    ck_assert_int_eq(ram.mem->memory[0], 0);
+    // enabled, then bank 2 in RAM banking mode
+    ck_assert_err_none(bus_write(bus, 0x0000, 0x0A));
+    ck_assert_err_none(bus_write(bus, 0x6000, 1));
+    ck_assert_err_none(bus_write(bus, 0x4000, 2));
+    ck_assert_err_none(bus_write(bus, BANK_RAM_START + 1, 0x42));
+    ck_assert_int_eq(ram.mem->memory[2 * BANK_RAM_SIZE + 1], 0x42);
+    ck_assert_bus_eq(bus, BANK_RAM_START + 1, 0x42);
+    ck_assert_err_none(bus_write(bus, 0x0000, 0x00));
+    ck_assert_bus_eq(bus, BANK_RAM_START + 1, 0xFF);
+
+    cartridge_free(&ct);
+    component_free(&ram);
+    memset(bus, 0, sizeof(bus_t));
+
+    // MBC5, 256 KiB of ROM: bank 0 can be mapped at 0x4000
+    mbc_cartridge(&ct, 0x19, 0x03, 0x00, 16);
+    ck_assert_int_eq(ct.mbc, MBC5);
+    ck_assert_err_none(cartridge_plug(&ct, bus));
+    ck_assert_err_none(bus_write(bus, 0x2000, 15));
+    ck_assert_bus_eq(bus, BANK_ROM1_START + MBC_MARK, 15);
+    ck_assert_err_none(bus_write(bus, 0x2000, 0));
+    ck_assert_bus_eq(bus, BANK_ROM1_START + MBC_MARK, 0);
+    cartridge_free(&ct);
+    memset(bus, 0, sizeof(bus_t));
+
+    // MBC3 + timer + RAM + battery: the clock runs on the cycles given
+    uint64_t cycles = 0;
+    mbc_cartridge(&ct, 0x10, 0x01, 0x02, 4);
+    ck_assert_int_eq(ct.mbc, MBC3);
+    ck_assert(ct.has_rtc && ct.has_battery);
+    ck_assert_err_none(component_create(&ram, cartridge_ram_size(&ct)));
+    ck_assert_err_none(bus_plug(bus, &ram, BANK_RAM_START, BANK_RAM_END));
+    ck_assert_err_none(cartridge_connect(&ct, NULL, &ram, &cycles));
+    ck_assert_err_none(cartridge_plug(&ct, bus));
+    ck_assert_err_none(bus_write(bus, 0x0000, 0x0A));
+
+    cycles = 65 * ((uint64_t) 1 << 20) + 1000;
+    ck_assert_err_none(bus_write(bus, 0x4000, 0x08));
+    ck_assert_bus_eq(bus, BANK_RAM_END, 0);
+    ck_assert_err_none(bus_write(bus, 0x6000, 0));
+    ck_assert_err_none(bus_write(bus, 0x6000, 1));
+    ck_assert_bus_eq(bus, BANK_RAM_END, 5);
+    ck_assert_err_none(bus_write(bus, 0x4000, 0x09));
+    ck_assert_bus_eq(bus, BANK_RAM_START, 1);
+    // the latched values do not move with the clock
+    cycles += 60 * ((uint64_t) 1 << 20);
+    ck_assert_bus_eq(bus, BANK_RAM_START, 1);
+    ck_assert_err_none(bus_write(bus, 0x6000, 0));
+    ck_assert_err_none(bus_write(bus, 0x6000, 1));
+    ck_assert_bus_eq(bus, BANK_RAM_START, 2);
+    // the RAM is back at bank 0
+    ck_assert_err_none(bus_write(bus, 0x4000, 0x00));
+    ck_assert_err_none(bus_write(bus, BANK_RAM_START, 0x24));
+    ck_assert_int_eq(ram.mem->memory[0], 0x24);
+
+    cartridge_free(&ct);
+    component_free(&ram);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+
+}
+END_TEST
+
 
 Suite* cartridge_test_suite()
 {
@@ -148,6 +315,8 @@ Suite* cartridge_test_suite()
     tcase_add_test(tc1, cartridge_free_exec);
     tcase_add_test(tc1, cartridge_plug_err);
     tcase_add_test(tc1, cartridge_plug_exec);
+    tcase_add_test(tc1, cartridge_shared_exec);
+    tcase_add_test(tc1, cartridge_mbc_exec);
 
     return s;
 }
@@ -13,7 +13,7 @@
     static_assert(sizeof(T1) / sizeof(*T1) == sizeof(T2) / sizeof(*T2), "Wrong Size in test tables")
 
 #define CPU_BUS_V_AT(cpu,idx) \
-    *((*(cpu).bus)[idx])
+    *bus_lookup(*(cpu).bus, idx)
 
 #define COMPONENT_FULL_BUS(bus,c)\
     ck_assert_int_eq(component_create(c, BUS_SIZE), ERR_NONE); \
@@ -31,9 +31,11 @@
     component_t c = {NULL, 0, 0};\
     INIT_CPU(&cpu, &c)
 
+// the flags are computed lazily: F is written before being checked
 #define DO_RUN(cpu, ...) \
     instruction_t lu = __VA_ARGS__; \
-    ck_assert_int_eq(cpu_dispatch(&lu, &cpu), ERR_NONE)
+    ck_assert_int_eq(cpu_dispatch(&lu, &cpu), ERR_NONE); \
+    cpu_F_sync(&cpu)
 
 #define RUN_FOR_REG(cpu, reg, ...) \
     cpu_reg_set(&cpu, reg, dt[i_]);\
@@ -37,7 +37,7 @@
     static_assert(sizeof(T1) / sizeof(*T1) == sizeof(T2) / sizeof(*T2), "Wrong Size in test tables")
 
 #define CPU_BUS_V_AT(cpu,idx) \
-        *((*(cpu).bus)[idx])
+        *bus_lookup(*(cpu).bus, idx)
 
 #define add_bus(cpu,size)\
     bus_t bus = {0}; \
@@ -294,16 +294,15 @@ START_TEST(test_cpu_plug_exec)
 #ifdef WITH_PRINT
     printf("=== %s:\n", __func__);
 #endif
-#pragma GCC diagnostic push
-#pragma GCC diagnostic ignored "-Wint-conversion"
     INIT;
     bus_t bus = {0};
+    data_t byte = 0xdd;
     cpu_init(&cpu);
     cpu_plug(&cpu, &bus);
-    ck_assert_int_eq(cpu.bus, &bus);
-    bus[0] = 0xdd;
-    ck_assert_int_eq((*cpu.bus)[0], bus[0]);
-#pragma GCC diagnostic pop
+    ck_assert_ptr_eq(cpu.bus, &bus);
+    bus_map_byte(bus, 0, &byte);
+    ck_assert_ptr_eq(bus_lookup(*cpu.bus, 0), bus_lookup(bus, 0));
+    ck_assert_int_eq(*bus_lookup(*cpu.bus, 0), 0xdd);
     cpu_free(&cpu);
 #ifdef WITH_PRINT
     printf("=== END of %s\n", __func__);
@@ -532,6 +531,123 @@ START_TEST(test_cpu_cycle_exec)
 END_TEST
 
 
+START_TEST(test_cpu_decode_cache)
+{
+    // ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    size_t size = 255;
+    add_bus(cpu, size);
+
+    ck_assert_int_eq(cpu_decode_cache_create(NULL), ERR_BAD_PARAMETER);
+    ck_assert_int_eq(cpu_decode_cache_create(&cpu), ERR_NONE);
+    ck_assert_ptr_nonnull(cpu.decoded[0]);
+
+    // LD A, 0x12 ; JP 0x0000
+    CPU_BUS_V_AT(cpu, 0) = 0x3E;
+    CPU_BUS_V_AT(cpu, 1) = 0x12;
+    CPU_BUS_V_AT(cpu, 2) = 0xC3;
+    CPU_BUS_V_AT(cpu, 3) = 0x00;
+    CPU_BUS_V_AT(cpu, 4) = 0x00;
+
+    ck_assert_int_eq(cpu_cycle(&cpu), ERR_NONE);
+    ck_assert_int_eq(cpu.A, 0x12);
+    ck_assert_int_eq(cpu.PC, 2);
+    ck_assert_int_eq(cpu.decoded[0][0].operand, 0x12);
+    ck_assert_int_eq(cpu.operand_cached, 0);
+
+    // a write through the bus forgets the predecoded instruction
+    ck_assert_int_eq(cpu_write_at_idx(&cpu, 1, 0x34), ERR_NONE);
+    ck_assert_int_eq(cpu.decoded[0][0].op, 0);
+    cpu.idle_time = 0;
+    ck_assert_int_eq(cpu_cycle(&cpu), ERR_NONE);
+    ck_assert_int_eq(cpu.PC, 0);
+    cpu.idle_time = 0;
+    ck_assert_int_eq(cpu_cycle(&cpu), ERR_NONE);
+    ck_assert_int_eq(cpu.A, 0x34);
+
+    // explicit invalidation (e.g. bootrom or bank switch): memory changed behind the bus' back
+    CPU_BUS_V_AT(cpu, 1) = 0x56;
+    cpu_decode_cache_invalidate(&cpu, CPU_DECODE_CACHE_START, CPU_DECODE_CACHE_END);
+    cpu.PC = 0;
+    cpu.idle_time = 0;
+    ck_assert_int_eq(cpu_cycle(&cpu), ERR_NONE);
+    ck_assert_int_eq(cpu.A, 0x56);
+
+    // each bank keeps its own predecoded instructions
+    cpu_decoded_t* bank0 = cpu.decoded[0];
+    ck_assert_int_eq(cpu_decode_cache_map(NULL, 0x0000, 2), ERR_BAD_PARAMETER);
+    ck_assert_int_eq(cpu_decode_cache_map(&cpu, 0x0001, 2), ERR_ADDRESS);
+    ck_assert_int_eq(cpu_decode_cache_map(&cpu, 0x0000, 2), ERR_NONE);
+    ck_assert_ptr_ne(cpu.decoded[0], bank0);
+    ck_assert_int_eq(cpu.decoded[0][0].op, 0);
+    ck_assert_int_eq(cpu_decode_cache_map(&cpu, 0x0000, 0), ERR_NONE);
+    ck_assert_ptr_eq(cpu.decoded[0], bank0);
+    ck_assert_int_ne(cpu.decoded[0][0].op, 0);
+
+    finish();
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+
+START_TEST(test_cpu_lazy_flags)
+{
+    // ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    ck_assert_int_eq(cpu_init(&cpu), ERR_NONE);
+    alu_output_t alu;
+
+    // the lazy flags must be the ones the ALU computes
+    for (unsigned x = 0; x <= 0xFF; ++x) {
+        for (unsigned y = 0; y <= 0xFF; ++y) {
+            for (bit_t c = 0; c <= 1; ++c) {
+                cpu_F_defer(&cpu, LAZY_ADD, (uint8_t) x, (uint8_t) y, c);
+                ck_assert_int_eq(alu_add8(&alu, (uint8_t) x, (uint8_t) y, c), ERR_NONE);
+                ck_assert_int_eq(cpu_F_get(&cpu), alu.flags);
+
+                cpu_F_defer(&cpu, LAZY_SUB, (uint8_t) x, (uint8_t) y, c);
+                ck_assert_int_eq(alu_sub8(&alu, (uint8_t) x, (uint8_t) y, c), ERR_NONE);
+                ck_assert_int_eq(cpu_F_get(&cpu), alu.flags);
+            }
+        }
+        // INC/DEC keep the carry flag of the cpu
+        cpu_F_defer(&cpu, LAZY_INC, (uint8_t) x, 1, 1);
+        ck_assert_int_eq(alu_add8(&alu, (uint8_t) x, 1, 0), ERR_NONE);
+        ck_assert_int_eq(cpu_F_get(&cpu), (alu.flags & 0xE0) | 0x10);
+
+        cpu_F_defer(&cpu, LAZY_DEC, (uint8_t) x, 1, 0);
+        ck_assert_int_eq(alu_sub8(&alu, (uint8_t) x, 1, 0), ERR_NONE);
+        ck_assert_int_eq(cpu_F_get(&cpu), alu.flags & 0xE0);
+    }
+
+    // reading AF gives the pending flags, writing it drops them
+    cpu.A = 0x12;
+    cpu_F_defer(&cpu, LAZY_SUB, 0x12, 0x12, 0);
+    ck_assert_int_eq(cpu_AF_get(&cpu), 0x12C0);
+    cpu_AF_set(&cpu, 0x3410);
+    ck_assert_int_eq(cpu_F_get(&cpu), 0x10);
+
+    cpu_F_defer(&cpu, LAZY_ADD, 0xFF, 0x01, 0);
+    cpu_F_sync(&cpu);
+    ck_assert_int_eq(cpu.F, 0xB0);
+    ck_assert_int_eq(cpu.lazy.op, LAZY_NONE);
+
+    cpu_free(&cpu);
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+
 Suite* cpu_test_suite()
 {
 
@@ -548,6 +664,7 @@ Suite* cpu_test_suite()
     tcase_add_test(tc1, test_reg_set);
     tcase_add_test(tc1, test_reg_pair_get);
     tcase_add_test(tc1, test_reg_pair_set);
+    tcase_add_test(tc1, test_cpu_lazy_flags);
 
     Add_Case(s, tc2, "Cpu Start Tests");
     tcase_add_test(tc2, test_cpu_init_err);
@@ -570,6 +687,7 @@ Suite* cpu_test_suite()
     Add_Case(s, tc5, "Cpu Cycle Tests");
     tcase_add_test(tc5, test_cpu_cycle_err);
     tcase_add_test(tc5, test_cpu_cycle_exec);
+    tcase_add_test(tc5, test_cpu_decode_cache);
 
     return s;
 }
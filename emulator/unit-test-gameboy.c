@@ -0,0 +1,548 @@
+/**
+ * @file unit-test-gameboy.c
+ * @brief Unit test code for the creation of gameboys, their independence, their save states
+ *        the skipping of their boot and the save files of battery-backed cartridges
+ *
+ * @author S. Horvath-Mikulas & R. Gerber
+ * @date 2020
+ */
+
+#define _XOPEN_SOURCE 700 // mkdtemp
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <pthread.h>
+#include <unistd.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "gameboy.h"
+#include "bootrom.h"
+
+#define TEST_ROM     "tests/data/blargg_roms/06-ld r,r.gb"
+#define TEST_CYCLES  2500000 // enough for the ROM to print its name
+#define NB_THREADS   4
+#define MAX_OUTPUT   256
+#define STATE_CYCLE  500000 // during the boot
+
+/**
+ * @brief What is compared between two runs of the same ROM
+ */
+typedef struct {
+    int error;
+    uint64_t cycles;
+    uint64_t instructions;
+    uint16_t AF, BC, DE, HL, PC, SP;
+    uint8_t IME, IE, IF, HALT;
+    data_t memories[GB_NB_COMPONENTS][MEM_SIZE(WORK_RAM)];
+    data_t oam[MEM_SIZE(GRAPH_RAM)];
+    data_t high_ram[HIGH_RAM_SIZE];
+    char output[MAX_OUTPUT];
+    size_t output_len;
+} gb_run_t;
+
+/**
+ * @brief ROM shared (read only) by all the runs
+ */
+typedef struct {
+    const data_t* rom;
+    size_t size;
+    gb_run_t* run;
+} gb_job_t;
+
+// ======================================================================
+static void capture_serial(void* ctx, data_t byte)
+{
+    gb_run_t* run = ctx;
+    if (run->output_len + 1 < MAX_OUTPUT) {
+        run->output[run->output_len++] = (char) byte;
+    }
+}
+
+// ======================================================================
+static data_t* read_rom(const char* filename, size_t* size)
+{
+    FILE* file = fopen(filename, "rb");
+    if (file == NULL) return NULL;
+
+    fseek(file, 0, SEEK_END);
+    const long length = ftell(file);
+    rewind(file);
+
+    data_t* rom = length > 0 ? malloc((size_t) length) : NULL;
+    if (rom != NULL && fread(rom, 1, (size_t) length, file) != (size_t) length) {
+        free(rom);
+        rom = NULL;
+    }
+    fclose(file);
+
+    *size = rom != NULL ? (size_t) length : 0;
+    return rom;
+}
+
+// ======================================================================
+static void snapshot(gb_run_t* run, const gameboy_t* gb)
+{
+    const cpu_t* cpu = &gb->cpu;
+    run->cycles = gb->cycles;
+    run->instructions = cpu->instructions;
+    run->AF = cpu->AF;
+    run->BC = cpu->BC;
+    run->DE = cpu->DE;
+    run->HL = cpu->HL;
+    run->PC = cpu->PC;
+    run->SP = cpu->SP;
+    run->IME = cpu->IME;
+    run->IE = cpu->IE;
+    run->IF = cpu->IF;
+    run->HALT = cpu->HALT;
+    for (int i = 0; i < GB_NB_COMPONENTS; ++i) {
+        const memory_t* mem = gb->components[i].mem;
+        memcpy(run->memories[i], mem->memory, mem->size < MEM_SIZE(WORK_RAM) ? mem->size : MEM_SIZE(WORK_RAM));
+    }
+    memcpy(run->oam, gb->screen.oam, sizeof(run->oam));
+    memcpy(run->high_ram, cpu->high_ram.mem->memory, sizeof(run->high_ram));
+}
+
+// ======================================================================
+/**
+ * @brief Runs the ROM of a job on a gameboy of its own and keeps its final state
+ */
+static void* run_job(void* arg)
+{
+    gb_job_t* job = arg;
+    gameboy_t* gb = calloc(1, sizeof(gameboy_t));
+    if (gb == NULL) {
+        job->run->error = ERR_MEM;
+        return NULL;
+    }
+
+    job->run->error = gameboy_create_from_memory(gb, job->rom, job->size);
+    if (job->run->error == ERR_NONE) {
+        gameboy_set_serial_output(gb, capture_serial, job->run);
+        job->run->error = gameboy_run_until(gb, TEST_CYCLES);
+        snapshot(job->run, gb);
+    }
+
+    gameboy_free(gb);
+    free(gb);
+    return NULL;
+}
+
+#define ck_assert_same_run(a, b) \
+    do { \
+        ck_assert_err_none((a)->error); \
+        ck_assert_err_none((b)->error); \
+        ck_assert(memcmp(a, b, sizeof(gb_run_t)) == 0); \
+    } while(0)
+
+START_TEST(gameboy_create_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    gameboy_t gb;
+    const data_t rom[1] = { 0 };
+    ck_assert_bad_param(gameboy_create(NULL, TEST_ROM));
+    ck_assert_bad_param(gameboy_create(&gb, NULL));
+    ck_assert_bad_param(gameboy_create_from_memory(NULL, rom, sizeof(rom)));
+    ck_assert_bad_param(gameboy_create_from_memory(&gb, NULL, sizeof(rom)));
+    ck_assert_bad_param(gameboy_set_serial_output(NULL, capture_serial, NULL));
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(gameboy_create_from_memory_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    size_t size = 0;
+    data_t* rom = read_rom(TEST_ROM, &size);
+    ck_assert_ptr_nonnull(rom);
+
+    // same state whether the cartridge comes from the file or from memory
+    gb_run_t* runs = calloc(2, sizeof(gb_run_t));
+    ck_assert_ptr_nonnull(runs);
+
+    gameboy_t* gb = calloc(1, sizeof(gameboy_t));
+    ck_assert_ptr_nonnull(gb);
+    ck_assert_err_none(gameboy_create(gb, TEST_ROM));
+    gameboy_set_serial_output(gb, capture_serial, &runs[0]);
+    runs[0].error = gameboy_run_until(gb, TEST_CYCLES);
+    snapshot(&runs[0], gb);
+    gameboy_free(gb);
+    free(gb);
+
+    gb_job_t job = { rom, size, &runs[1] };
+    run_job(&job);
+
+    ck_assert_same_run(&runs[0], &runs[1]);
+#ifdef BLARGG
+    // the ROM did run: it has printed its name on the serial port
+    ck_assert(strncmp(runs[0].output, "06-ld r,r", strlen("06-ld r,r")) == 0);
+#endif
+
+    free(runs);
+    free(rom);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(gameboy_threads_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    size_t size = 0;
+    data_t* rom = read_rom(TEST_ROM, &size);
+    ck_assert_ptr_nonnull(rom);
+
+    // runs[0] is the reference, run alone; the others run at the same time, sharing the ROM buffer
+    gb_run_t* runs = calloc(NB_THREADS + 1, sizeof(gb_run_t));
+    ck_assert_ptr_nonnull(runs);
+    gb_job_t jobs[NB_THREADS + 1];
+    for (int i = 0; i <= NB_THREADS; ++i) {
+        jobs[i] = (gb_job_t) { rom, size, &runs[i] };
+    }
+    run_job(&jobs[0]);
+
+    pthread_t threads[NB_THREADS];
+    for (int i = 0; i < NB_THREADS; ++i) {
+        ck_assert_int_eq(pthread_create(&threads[i], NULL, run_job, &jobs[i + 1]), 0);
+    }
+    for (int i = 0; i < NB_THREADS; ++i) {
+        ck_assert_int_eq(pthread_join(threads[i], NULL), 0);
+    }
+
+    for (int i = 1; i <= NB_THREADS; ++i) {
+        ck_assert_same_run(&runs[0], &runs[i]);
+    }
+
+    free(runs);
+    free(rom);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(gameboy_state_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    gameboy_t* gb = calloc(1, sizeof(gameboy_t));
+    ck_assert_ptr_nonnull(gb);
+    ck_assert_err_none(gameboy_create(gb, TEST_ROM));
+
+    ck_assert_int_eq(gameboy_state_size(NULL), 0);
+    const size_t size = gameboy_state_size(gb);
+    data_t* state = calloc(1, size);
+    ck_assert_ptr_nonnull(state);
+
+    ck_assert_bad_param(gameboy_save_state(NULL, state, size));
+    ck_assert_bad_param(gameboy_save_state(gb, NULL, size));
+    ck_assert_bad_param(gameboy_save_state(gb, state, size - 1));
+    ck_assert_bad_param(gameboy_load_state(NULL, state, size));
+    ck_assert_bad_param(gameboy_load_state(gb, NULL, size));
+
+    // not a state
+    ck_assert_bad_param(gameboy_load_state(gb, state, size));
+
+    ck_assert_err_none(gameboy_save_state(gb, state, size));
+    ck_assert_bad_param(gameboy_load_state(gb, state, size - 1));
+    ck_assert_err_none(gameboy_load_state(gb, state, size));
+
+    // state of another cartridge (a modified copy: the ROM mapped from the file is read-only)
+    size_t rom_size = 0;
+    data_t* rom = read_rom(TEST_ROM, &rom_size);
+    ck_assert_ptr_nonnull(rom);
+    rom[0x14E] ^= 0xFF;
+    gameboy_t* other = calloc(1, sizeof(gameboy_t));
+    ck_assert_ptr_nonnull(other);
+    ck_assert_err_none(gameboy_create_from_memory(other, rom, rom_size));
+    ck_assert_bad_param(gameboy_load_state(other, state, size));
+    gameboy_free(other);
+
+    // same game but with more external RAM (MBC1+RAM, 32 KiB instead of none): the states are larger
+    rom[0x14E] ^= 0xFF;
+    rom[0x147] = 0x02;
+    rom[0x149] = 0x03;
+    ck_assert_err_none(gameboy_create_from_memory(other, rom, rom_size));
+    ck_assert_int_eq(gameboy_state_size(other), size - BANK_RAM_SIZE + 0x8000);
+    ck_assert_bad_param(gameboy_load_state(other, state, size));
+    ck_assert_bad_param(gameboy_save_state(other, state, size));
+    data_t* large = calloc(1, gameboy_state_size(other));
+    ck_assert_ptr_nonnull(large);
+    ck_assert_err_none(gameboy_save_state(other, large, gameboy_state_size(other)));
+    ck_assert_err_none(gameboy_load_state(other, large, gameboy_state_size(other)));
+    ck_assert_bad_param(gameboy_load_state(gb, large, gameboy_state_size(other)));
+
+    free(large);
+    free(state);
+    free(rom);
+    gameboy_free(other);
+    free(other);
+    gameboy_free(gb);
+    free(gb);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(gameboy_state_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    gb_run_t* runs = calloc(3, sizeof(gb_run_t));
+    ck_assert_ptr_nonnull(runs);
+    gameboy_t* gbs = calloc(2, sizeof(gameboy_t));
+    ck_assert_ptr_nonnull(gbs);
+
+    // reference: saved during the boot, then run on
+    gameboy_t* gb = &gbs[0];
+    ck_assert_err_none(gameboy_create(gb, TEST_ROM));
+    const size_t size = gameboy_state_size(gb);
+    data_t* state = calloc(1, size);
+    ck_assert_ptr_nonnull(state);
+    ck_assert_err_none(gameboy_run_until(gb, STATE_CYCLE));
+    ck_assert_err_none(gameboy_save_state(gb, state, size));
+    gameboy_set_serial_output(gb, capture_serial, &runs[0]);
+    runs[0].error = gameboy_run_until(gb, TEST_CYCLES);
+    snapshot(&runs[0], gb);
+    ck_assert_int_eq(gb->boot, 0);
+
+    // back to the boot on the same gameboy (the boot ROM is mapped again)
+    ck_assert_err_none(gameboy_load_state(gb, state, size));
+    ck_assert_int_eq(gb->boot, 1);
+    gameboy_set_serial_output(gb, capture_serial, &runs[1]);
+    runs[1].error = gameboy_run_until(gb, TEST_CYCLES);
+    snapshot(&runs[1], gb);
+    ck_assert_same_run(&runs[0], &runs[1]);
+
+    // on a new gameboy
+    ck_assert_err_none(gameboy_create(&gbs[1], TEST_ROM));
+    ck_assert_err_none(gameboy_load_state(&gbs[1], state, size));
+    gameboy_set_serial_output(&gbs[1], capture_serial, &runs[2]);
+    runs[2].error = gameboy_run_until(&gbs[1], TEST_CYCLES);
+    snapshot(&runs[2], &gbs[1]);
+    ck_assert_same_run(&runs[0], &runs[2]);
+
+    gameboy_free(&gbs[0]);
+    gameboy_free(&gbs[1]);
+    free(gbs);
+    free(runs);
+    free(state);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(gameboy_skip_boot_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    gb_run_t* runs = calloc(2, sizeof(gb_run_t));
+    ck_assert_ptr_nonnull(runs);
+    gameboy_t* gbs = calloc(2, sizeof(gameboy_t));
+    ck_assert_ptr_nonnull(gbs);
+
+    ck_assert_bad_param(bootrom_skip(NULL));
+
+    // reference: through the boot ROM
+    ck_assert_err_none(gameboy_create(&gbs[0], TEST_ROM));
+    gameboy_set_serial_output(&gbs[0], capture_serial, &runs[0]);
+    runs[0].error = gameboy_run_until(&gbs[0], TEST_CYCLES);
+    snapshot(&runs[0], &gbs[0]);
+    // too late to skip the boot
+    ck_assert_bad_param(bootrom_skip(&gbs[0]));
+
+    ck_assert_err_none(gameboy_create(&gbs[1], TEST_ROM));
+    ck_assert_err_none(bootrom_skip(&gbs[1]));
+    ck_assert_int_eq(gbs[1].boot, 0);
+    ck_assert_bad_param(bootrom_skip(&gbs[1]));
+    gameboy_set_serial_output(&gbs[1], capture_serial, &runs[1]);
+    runs[1].error = gameboy_run_until(&gbs[1], TEST_CYCLES);
+    snapshot(&runs[1], &gbs[1]);
+    ck_assert_same_run(&runs[0], &runs[1]);
+
+    gameboy_free(&gbs[0]);
+    gameboy_free(&gbs[1]);
+    free(gbs);
+    free(runs);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(gameboy_arena_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    gameboy_t* gb = calloc(1, sizeof(gameboy_t));
+    ck_assert_ptr_nonnull(gb);
+    ck_assert_err_none(gameboy_create(gb, TEST_ROM));
+
+    // all the memories in one page-aligned block, in the order of their addresses
+    const memory_t* mems[] = {
+        gb->bootrom.mem, gb->components[1].mem, gb->components[2].mem, gb->components[0].mem,
+        gb->components[3].mem, gb->components[5].mem, gb->components[4].mem, gb->cpu.high_ram.mem
+    };
+    const size_t nb_mems = sizeof(mems) / sizeof(mems[0]);
+    ck_assert_int_eq((uintptr_t) gb->arena.base % MEM_ARENA_PAGE, 0);
+    ck_assert_ptr_eq(mems[0]->memory, gb->arena.base);
+    for (size_t i = 0; i < nb_mems; ++i) {
+        ck_assert(mems[i]->in_arena);
+        ck_assert(mems[i]->memory + mems[i]->size <= gb->arena.base + gb->arena.used);
+        if (i > 0) ck_assert(mems[i]->memory >= mems[i - 1]->memory + mems[i - 1]->size);
+    }
+    ck_assert_int_eq(gb->arena.headers, nb_mems);
+
+    gameboy_free(gb);
+    ck_assert_ptr_null(gb->arena.base);
+    free(gb);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(gameboy_battery_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    char dir[] = "/tmp/unit-test-gameboy-XXXXXX";
+    ck_assert_ptr_nonnull(mkdtemp(dir));
+    char rom_file[sizeof(dir) + 16];
+    char save_file[sizeof(dir) + 16];
+    snprintf(rom_file, sizeof(rom_file), "%s/battery.gb", dir);
+    snprintf(save_file, sizeof(save_file), "%s/battery.sav", dir);
+
+    // the test ROM as an MBC1 + RAM + battery cartridge, with 32 KiB of RAM
+    size_t rom_size = 0;
+    data_t* rom = read_rom(TEST_ROM, &rom_size);
+    ck_assert_ptr_nonnull(rom);
+    rom[CARTRIDGE_TYPE_ADDR] = 0x03;
+    rom[CARTRIDGE_RAM_SIZE_ADDR] = 0x03;
+    FILE* file = fopen(rom_file, "wb");
+    ck_assert_ptr_nonnull(file);
+    ck_assert_int_eq(fwrite(rom, 1, rom_size, file), rom_size);
+    fclose(file);
+    free(rom);
+
+    gameboy_t* gb = calloc(1, sizeof(gameboy_t));
+    ck_assert_ptr_nonnull(gb);
+    ck_assert_err_none(gameboy_create(gb, rom_file));
+    ck_assert_int_eq(gb->components[2].mem->size, 0x8000);
+    ck_assert(!gb->components[2].mem->in_arena);
+    ck_assert_err_none(bus_write(gb->bus, 0x0000, 0x0A));
+    ck_assert_err_none(bus_write(gb->bus, 0x6000, 0x01));
+    ck_assert_err_none(bus_write(gb->bus, 0x4000, 0x01));
+    ck_assert_err_none(bus_write(gb->bus, EXTERN_RAM_START + 3, 0x5A));
+    ck_assert_err_none(gameboy_run_until(gb, gb->cycles + FRAME_TOTAL_CYCLES));
+    gameboy_free(gb);
+
+    // written in the save file, as large as the RAM
+    file = fopen(save_file, "rb");
+    ck_assert_ptr_nonnull(file);
+    data_t* save = malloc(0x8000 + 1);
+    ck_assert_ptr_nonnull(save);
+    ck_assert_int_eq(fread(save, 1, 0x8000 + 1, file), 0x8000);
+    fclose(file);
+    ck_assert_int_eq(save[0x2000 + 3], 0x5A);
+    free(save);
+
+    // and back in the RAM of the next gameboy
+    ck_assert_err_none(gameboy_create(gb, rom_file));
+    ck_assert_int_eq(gb->components[2].mem->memory[0x2000 + 3], 0x5A);
+    ck_assert_ptr_nonnull(gb->cartridge.save);
+
+    // which keeps it to itself: another one on the same cartridge plays on a copy, never written back
+    gameboy_t* other = calloc(1, sizeof(gameboy_t));
+    ck_assert_ptr_nonnull(other);
+    ck_assert_err_none(gameboy_create(other, rom_file));
+    ck_assert_ptr_null(other->cartridge.save);
+    ck_assert_int_eq(other->components[2].mem->size, 0x8000);
+    ck_assert_int_eq(other->components[2].mem->memory[0x2000 + 3], 0x5A);
+    other->components[2].mem->memory[0x2000 + 3] = 0xA5;
+    gameboy_free(other);
+    ck_assert_int_eq(gb->components[2].mem->memory[0x2000 + 3], 0x5A);
+    gameboy_free(gb);
+
+    // until the first one frees it
+    ck_assert_err_none(gameboy_create(other, rom_file));
+    ck_assert_ptr_nonnull(other->cartridge.save);
+    ck_assert_int_eq(other->components[2].mem->memory[0x2000 + 3], 0x5A);
+    gameboy_free(other);
+    free(other);
+    free(gb);
+
+    // no save file for a cartridge without battery
+    ck_assert_int_eq(unlink(save_file), 0);
+    gb = calloc(1, sizeof(gameboy_t));
+    ck_assert_ptr_nonnull(gb);
+    ck_assert_err_none(gameboy_create(gb, TEST_ROM));
+    ck_assert_ptr_null(gb->cartridge.save);
+    gameboy_free(gb);
+    free(gb);
+
+    ck_assert_int_eq(unlink(rom_file), 0);
+    ck_assert_int_eq(rmdir(dir), 0);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+// ======================================================================
+Suite* gameboy_test_suite()
+{
+    Suite* s = suite_create("gameboy.c Tests");
+
+    Add_Case(s, tc1, "gameboy tests");
+    tcase_add_test(tc1, gameboy_create_err);
+    tcase_add_test(tc1, gameboy_create_from_memory_exec);
+    tcase_add_test(tc1, gameboy_threads_exec);
+    tcase_add_test(tc1, gameboy_state_err);
+    tcase_add_test(tc1, gameboy_state_exec);
+    tcase_add_test(tc1, gameboy_skip_boot_exec);
+    tcase_add_test(tc1, gameboy_arena_exec);
+    tcase_add_test(tc1, gameboy_battery_exec);
+    // a few million cycles are run on several gameboys
+    tcase_set_timeout(tc1, 60);
+
+    return s;
+}
+
+TEST_SUITE(gameboy_test_suite)
@@ -0,0 +1,242 @@
+/**
+ * @file unit-test-image.c
+ * @brief Unit test code for image and related functions
+ *
+ * @author C. Hölzl, EPFL
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "bit_vector.h"
+#include "image.h"
+
+#define vector_match_vector(vec1, vec2) \
+    do{ \
+      ck_assert((vec1)->size == (vec2)->size); \
+      const size_t bound = (vec1)->size / IMAGE_LINE_WORD_BITS + ((vec1)->size % IMAGE_LINE_WORD_BITS ? 1 :0); \
+      for (size_t i = 0; i < bound; ++i) { ck_assert_int_eq((vec1)->content[i], (vec2)->content[i]); } \
+    } while(0)
+
+START_TEST(image_line_map_below_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    const palette_t palettes[] = { DEFAULT_PALETTE, 0x1B, 0x00, 0xFF, 0x93 };
+    const int64_t offsets[] = { 0, 7, -7, 32, -40, 100, 159, -255, 300 };
+    image_line_t src, line;
+    ck_assert_err_none(image_line_create(&src, 256));
+    ck_assert_err_none(image_line_create(&line, 160));
+    bit_vector_256_t opacity;
+    ck_assert_ptr_nonnull(bit_vector_fixed_init(&opacity, 0));
+
+    // pixel by pixel, for all the palettes
+    for (unsigned map = 0; map <= 0xFF; ++map) {
+        const uint32_t msb = (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+        const uint32_t lsb = (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+        uint32_t m = msb, l = lsb;
+        image_word_map_colors(&m, &l, (palette_t) map);
+        for (unsigned i = 0; i < IMAGE_LINE_WORD_BITS; ++i) {
+            const unsigned color = ((msb >> i) & 1) << 1 | ((lsb >> i) & 1);
+            ck_assert_uint_eq(((m >> i) & 1) << 1 | ((l >> i) & 1), (map >> (2 * color)) & 3);
+        }
+    }
+
+    ck_assert_bad_param(image_line_map_below(NULL, src, 0, NULL, 0));
+    ck_assert_bad_param(image_line_map_below(&line, src, 0, line.opacity, 0));
+
+    for (size_t p = 0; p < sizeof(palettes) / sizeof(palettes[0]); ++p) {
+        for (size_t o = 0; o < sizeof(offsets) / sizeof(offsets[0]); ++o) {
+            for (size_t w = 0; w < 8; ++w) {
+                ck_assert_err_none(image_line_set_word(&src, w, (uint32_t) rand() ^ ((uint32_t) rand() << 16),
+                                                       (uint32_t) rand() ^ ((uint32_t) rand() << 16)));
+                opacity.content[w] = (uint32_t) rand() ^ ((uint32_t) rand() << 16);
+            }
+            for (size_t w = 0; w < 5; ++w) {
+                ck_assert_err_none(image_line_set_word(&line, w, (uint32_t) rand() ^ ((uint32_t) rand() << 16), 0));
+            }
+            const int64_t x = offsets[o];
+            const bit_vector_t* p_opacity = o % 2 ? bit_vector_fixed(&opacity) : NULL;
+
+            // the same with the allocating functions: map, place on the line, then compose
+            image_line_t mapped, shifted, expected;
+            bit_vector_t* placed = NULL;
+            ck_assert_err_none(image_line_map_colors(&mapped, src, palettes[p]));
+            ck_assert_err_none(image_line_extract_wrap_ext(&shifted, mapped, 0, 160));
+            ck_assert_ptr_nonnull(bit_vector_extract_zero_ext_to(shifted.msb, mapped.msb, -x));
+            ck_assert_ptr_nonnull(bit_vector_extract_zero_ext_to(shifted.lsb, mapped.lsb, -x));
+            ck_assert_ptr_nonnull(placed = bit_vector_extract_zero_ext(p_opacity == NULL ? src.opacity : p_opacity, -x, 160));
+            ck_assert_err_none(image_line_below_with_opacity(&expected, line, shifted, placed));
+
+            ck_assert_err_none(image_line_map_below(&line, src, palettes[p], p_opacity, x));
+            vector_match_vector(line.msb, expected.msb);
+            vector_match_vector(line.lsb, expected.lsb);
+            vector_match_vector(line.opacity, expected.opacity);
+
+            image_line_free(&mapped);
+            image_line_free(&shifted);
+            image_line_free(&expected);
+            bit_vector_free(&placed);
+        }
+    }
+
+    image_line_free(&src);
+    image_line_free(&line);
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(image_planes_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    image_t image, copy;
+    ck_assert_bad_param(image_create(&image, 0, 144));
+    ck_assert_bad_param(image_create(&image, 160, 0));
+    ck_assert_err_none(image_create(&image, 160, 144));
+    ck_assert_err_none(image_create(&copy, 160, 144));
+
+    // all the bit vectors are in the planes, one stride apart
+    ck_assert_int_eq(image.planes_size, 3 * 144 * image.stride);
+    for (size_t y = 0; y < 144; ++y) {
+        ck_assert_ptr_eq((uint8_t*) image.content[y].lsb, image.planes + y * image.stride);
+        ck_assert_ptr_eq((uint8_t*) image.content[y].msb, image.planes + (144 + y) * image.stride);
+        ck_assert_ptr_eq((uint8_t*) image.content[y].opacity, image.planes + (288 + y) * image.stride);
+        ck_assert_int_eq(image.content[y].msb->size, 160);
+        for (size_t w = 0; w < 5; ++w) {
+            ck_assert_err_none(image_line_set_word(&image.content[y], w, (uint32_t) rand() ^ ((uint32_t) rand() << 16),
+                                                   (uint32_t) rand() ^ ((uint32_t) rand() << 16)));
+        }
+    }
+
+    // a line given to the image
+    image_line_t line;
+    ck_assert_err_none(image_line_create(&line, 160));
+    ck_assert_err_none(image_line_set_word(&line, 2, 0xdeadb055, 0xaaaa));
+    ck_assert_err_none(image_own_line_content(&image, 7, line));
+    uint8_t pixel = 0;
+    ck_assert_err_none(image_get_pixel(&pixel, &image, 64, 7));
+    ck_assert_int_eq(pixel, 0x2);
+    ck_assert_err_none(image_get_pixel(&pixel, &image, 65, 7));
+    ck_assert_int_eq(pixel, 0x1);
+    ck_assert_err_none(image_get_pixel(&pixel, &image, 0, 7));
+    ck_assert_int_eq(pixel, 0x0);
+    ck_assert_bad_param(image_get_pixel(&pixel, &image, 160, 7));
+    ck_assert_bad_param(image_get_pixel(&pixel, &image, 0, 144));
+
+    // a frame is copied (and compared) as a whole
+    ck_assert_int_eq(copy.planes_size, image.planes_size);
+    ck_assert(memcmp(copy.planes, image.planes, image.planes_size) != 0);
+    memcpy(copy.planes, image.planes, image.planes_size);
+    for (size_t y = 0; y < 144; ++y) {
+        for (size_t x = 0; x < 160; ++x) {
+            uint8_t expected = 0;
+            ck_assert_err_none(image_get_pixel(&expected, &image, x, y));
+            ck_assert_err_none(image_get_pixel(&pixel, &copy, x, y));
+            ck_assert_int_eq(pixel, expected);
+        }
+    }
+
+    image_free(&image);
+    image_free(&copy);
+    ck_assert_ptr_null(image.content);
+    ck_assert_int_eq(image.height, 0);
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(image_rgb24_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    // odd width, not a multiple of the words
+    const size_t width = 37, height = 5, padding = 5;
+    const uint8_t colors[PALETTE_COLOR_COUNT][IMAGE_RGB_BYTES] = {
+        { 255, 254, 253 }, { 170, 169, 168 }, { 85, 84, 83 }, { 0, 1, 2 }
+    };
+    image_t image;
+    ck_assert_err_none(image_create(&image, width, height));
+    for (size_t y = 0; y < height; ++y) {
+        for (size_t w = 0; w < 2; ++w) {
+            ck_assert_err_none(image_line_set_word(&image.content[y], w, (uint32_t) rand() ^ ((uint32_t) rand() << 16),
+                                                   (uint32_t) rand() ^ ((uint32_t) rand() << 16)));
+        }
+    }
+
+    for (size_t scale = 1; scale <= 3; ++scale) {
+        const size_t rowstride = IMAGE_RGB_BYTES * width * scale + padding;
+        uint8_t* rgb = malloc(rowstride * height * scale);
+        ck_assert_ptr_nonnull(rgb);
+        memset(rgb, 0x5a, rowstride * height * scale);
+
+        ck_assert_err_none(image_to_rgb24_scaled(rgb, rowstride, &image, colors, scale));
+        for (size_t h = 0; h < height * scale; ++h) {
+            for (size_t w = 0; w < width * scale; ++w) {
+                uint8_t pixel = 0;
+                ck_assert_err_none(image_get_pixel(&pixel, &image, w / scale, h / scale));
+                ck_assert(memcmp(rgb + h * rowstride + w * IMAGE_RGB_BYTES, colors[pixel], IMAGE_RGB_BYTES) == 0);
+            }
+            // the end of the rows is left as it is
+            for (size_t i = rowstride - padding; i < rowstride; ++i) {
+                ck_assert_int_eq(rgb[h * rowstride + i], 0x5a);
+            }
+        }
+
+        ck_assert_bad_param(image_to_rgb24_scaled(rgb, rowstride - padding - 1, &image, colors, scale));
+        free(rgb);
+    }
+
+    uint8_t rgb[IMAGE_RGB_BYTES];
+    ck_assert_bad_param(image_to_rgb24_scaled(NULL, 3 * width, &image, colors, 1));
+    ck_assert_bad_param(image_to_rgb24_scaled(rgb, 3 * width, NULL, colors, 1));
+    ck_assert_bad_param(image_to_rgb24_scaled(rgb, 3 * width, &image, NULL, 1));
+    ck_assert_bad_param(image_to_rgb24_scaled(rgb, 3 * width, &image, colors, 0));
+    ck_assert_bad_param(image_to_rgb24_scaled(rgb, 3 * width * 17, &image, colors, IMAGE_RGB_MAX_SCALE + 1));
+
+    image_free(&image);
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+Suite* image_test_suite()
+{
+
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("image.c Tests");
+
+    Add_Case(s, tc1, "Image Tests");
+    tcase_add_test(tc1, image_line_map_below_exec);
+    tcase_add_test(tc1, image_planes_exec);
+    tcase_add_test(tc1, image_rgb24_exec);
+
+    return s;
+}
+
+TEST_SUITE(image_test_suite)
@@ -0,0 +1,173 @@
+/**
+ * @file unit-test-joypad.c
+ * @brief Unit test code for the joypad: row selection and interrupts
+ *
+ * @date 2020
+ */
+
+#include <stdio.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "util.h"
+#include "tests.h"
+#include "joypad.h"
+#include "cpu.h"
+#include "bus.h"
+
+#define INIT \
+    joypad_t pad; \
+    cpu_t cpu; \
+    zero_init_var(pad); \
+    zero_init_var(cpu); \
+    bus_t bus; \
+    zero_init_var(bus); \
+    data_t reg_P1 = 0; \
+    data_t reg_IF = 0; \
+    bus_map_byte(bus, REG_P1, &reg_P1); \
+    bus_map_byte(bus, REG_IF, &reg_IF); \
+    cpu.bus = &bus
+
+// what the CPU writes in P1 to select the rows (active low, bits 4 and 5)
+#define SELECT_NONE       0x30
+#define SELECT_DIRECTIONS 0x20
+#define SELECT_BUTTONS    0x10
+#define SELECT_BOTH       0x00
+
+#define JOYPAD_IF (1 << JOYPAD)
+
+/**
+ * @brief Writes P1 as the CPU does, then notifies the joypad
+ */
+static void select_rows(joypad_t* pad, data_t* reg_P1, data_t select)
+{
+    *reg_P1 = select;
+    ck_assert_err_none(joypad_bus_listener(pad, REG_P1));
+}
+
+START_TEST(joypad_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    ck_assert_bad_param(joypad_init_and_plug(NULL, &cpu));
+    ck_assert_bad_param(joypad_init_and_plug(&pad, NULL));
+    ck_assert_bad_param(joypad_bus_listener(NULL, REG_P1));
+    ck_assert_bad_param(joypad_key_pressed(NULL, A_KEY));
+    ck_assert_bad_param(joypad_key_released(NULL, A_KEY));
+
+    ck_assert_err_none(joypad_init_and_plug(&pad, &cpu));
+    ck_assert_bad_param(joypad_key_pressed(&pad, NB_GB_KEYS));
+    ck_assert_bad_param(joypad_key_released(&pad, NB_GB_KEYS));
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(joypad_rows_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    ck_assert_err_none(joypad_init_and_plug(&pad, &cpu));
+    ck_assert_ptr_eq(pad.p_P1, &reg_P1);
+    // nothing selected, nothing pressed: all the lines high
+    ck_assert_int_eq(reg_P1 & 0x0F, 0x0F);
+
+    ck_assert_err_none(joypad_key_pressed(&pad, UP_KEY));
+    ck_assert_err_none(joypad_key_pressed(&pad, START_KEY));
+    ck_assert_int_eq(reg_P1 & 0x0F, 0x0F);
+
+    // the key of the selected row pulls its line low, the other one is not seen
+    select_rows(&pad, &reg_P1, SELECT_DIRECTIONS);
+    ck_assert_int_eq(reg_P1, 0xC0 | SELECT_DIRECTIONS | (0x0F & ~(1 << UP_KEY)));
+    select_rows(&pad, &reg_P1, SELECT_BUTTONS);
+    ck_assert_int_eq(reg_P1, 0xC0 | SELECT_BUTTONS | (0x0F & ~(1 << (START_KEY - A_KEY))));
+    // both rows: both lines
+    select_rows(&pad, &reg_P1, SELECT_BOTH);
+    ck_assert_int_eq(reg_P1, 0xC0 | SELECT_BOTH | (0x0F & ~(1 << UP_KEY) & ~(1 << (START_KEY - A_KEY))));
+    select_rows(&pad, &reg_P1, SELECT_NONE);
+    ck_assert_int_eq(reg_P1, 0xC0 | SELECT_NONE | 0x0F);
+
+    // the key lines cannot be written by the CPU
+    select_rows(&pad, &reg_P1, SELECT_DIRECTIONS);
+    select_rows(&pad, &reg_P1, SELECT_DIRECTIONS | 0x0F);
+    ck_assert_int_eq(reg_P1 & 0x0F, 0x0F & ~(1 << UP_KEY));
+    ck_assert_err_none(joypad_key_released(&pad, UP_KEY));
+    ck_assert_int_eq(reg_P1 & 0x0F, 0x0F);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(joypad_interrupt_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    INIT;
+    ck_assert_err_none(joypad_init_and_plug(&pad, &cpu));
+    select_rows(&pad, &reg_P1, SELECT_BUTTONS);
+    ck_assert_int_eq(cpu.IF, 0);
+
+    // a press on the selected row requests the interrupt
+    ck_assert_err_none(joypad_key_pressed(&pad, A_KEY));
+    ck_assert_int_eq(cpu.IF, JOYPAD_IF);
+    ck_assert_int_eq(reg_IF & JOYPAD_IF, JOYPAD_IF);
+
+    // a release never does
+    cpu.IF = reg_IF = 0;
+    ck_assert_err_none(joypad_key_released(&pad, A_KEY));
+    ck_assert_int_eq(cpu.IF, 0);
+    ck_assert_int_eq(reg_IF, 0);
+    ck_assert_int_eq(reg_P1 & 0x0F, 0x0F);
+
+    // nor does a press on a row that is not selected
+    ck_assert_err_none(joypad_key_pressed(&pad, LEFT_KEY));
+    ck_assert_int_eq(cpu.IF, 0);
+    ck_assert_int_eq(reg_P1 & 0x0F, 0x0F);
+    ck_assert_err_none(joypad_key_released(&pad, LEFT_KEY));
+    ck_assert_int_eq(cpu.IF, 0);
+
+    // a second key pressed on the row pulls another line low: requested again
+    ck_assert_err_none(joypad_key_pressed(&pad, B_KEY));
+    cpu.IF = reg_IF = 0;
+    ck_assert_err_none(joypad_key_pressed(&pad, SELECT_KEY));
+    ck_assert_int_eq(cpu.IF, JOYPAD_IF);
+
+    // releasing one of them keeps the other one low, without interrupt
+    cpu.IF = reg_IF = 0;
+    ck_assert_err_none(joypad_key_released(&pad, B_KEY));
+    ck_assert_int_eq(cpu.IF, 0);
+    ck_assert_int_eq(reg_P1 & 0x0F, 0x0F & ~(1 << (SELECT_KEY - A_KEY)));
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+// ======================================================================
+Suite* joypad_test_suite()
+{
+    Suite* s = suite_create("joypad.c Tests");
+
+    Add_Case(s, tc1, "joypad tests");
+    tcase_add_test(tc1, joypad_err);
+    tcase_add_test(tc1, joypad_rows_exec);
+    tcase_add_test(tc1, joypad_interrupt_exec);
+
+    return s;
+}
+
+TEST_SUITE(joypad_test_suite)
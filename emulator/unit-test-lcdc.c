@@ -0,0 +1,127 @@
+/**
+ * @file unit-test-lcdc.c
+ * @brief Unit test code for the LCD controller: the frames drawn by ROMs
+ *        are compared with the ones of the reference library it replaces
+ *
+ * @date 2020
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "gameboy.h"
+
+#define FNV_OFFSET 14695981039346656037ULL
+#define FNV_PRIME  1099511628211ULL
+
+/**
+ * @brief A frame of a ROM, and the hash of its pixels drawn by the reference library (libcs212gbfinalext)
+ */
+typedef struct {
+    const char* rom;
+    unsigned frames;
+    uint64_t hash;
+} frame_ref_t;
+
+static const frame_ref_t frame_refs[] = {
+    { "tests/data/fibonacci.gb",                   60, 0x67e31c31e3a2fe29ULL },
+    // the name of the ROM, then its result below
+    { "tests/data/blargg_roms/06-ld r,r.gb",       60, 0x30f371eb3dc8eb6dULL },
+    { "tests/data/blargg_roms/06-ld r,r.gb",      180, 0x89005478c53160e1ULL },
+    { "tests/data/blargg_roms/02-interrupts.gb",  180, 0x66812a5916480810ULL },
+    { "tests/data/blargg_roms/instr_timing.gb",   180, 0xef5e88f08b198a44ULL }
+};
+
+/**
+ * @brief Ignores the bytes sent on the serial port
+ */
+static void no_serial(void* ctx, data_t byte)
+{
+    (void) ctx;
+    (void) byte;
+}
+
+/**
+ * @brief FNV-1a hash of the pixels (colors 0 to 3) of the display, line by line
+ */
+static uint64_t display_hash(gameboy_t* gb)
+{
+    uint64_t hash = FNV_OFFSET;
+    for (size_t y = 0; y < LCD_HEIGHT; ++y) {
+        for (size_t x = 0; x < LCD_WIDTH; ++x) {
+            uint8_t pixel = 0;
+            ck_assert_err_none(image_get_pixel(&pixel, &gb->screen.display, x, y));
+            hash = (hash ^ pixel) * FNV_PRIME;
+        }
+    }
+    return hash;
+}
+
+START_TEST(lcdc_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    bus_t bus;
+    ck_assert_bad_param(lcdc_init(NULL));
+    ck_assert_bad_param(lcdc_plug(NULL, bus));
+    ck_assert_bad_param(lcdc_cycle(NULL, 0));
+    ck_assert_bad_param(lcdc_bus_listener(NULL, REG_LCDC));
+    lcdc_free(NULL);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(lcdc_frames_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    gameboy_t* gb = calloc(1, sizeof(gameboy_t));
+    ck_assert_ptr_nonnull(gb);
+
+    for (size_t i = 0; i < sizeof(frame_refs) / sizeof(frame_refs[0]); ++i) {
+        const frame_ref_t* ref = &frame_refs[i];
+        ck_assert_err_none(gameboy_create(gb, ref->rom));
+        ck_assert_err_none(gameboy_set_serial_output(gb, no_serial, NULL));
+        ck_assert_err_none(gameboy_run_until(gb, (uint64_t) ref->frames * FRAME_TOTAL_CYCLES));
+        const uint64_t hash = display_hash(gb);
+#ifdef WITH_PRINT
+        printf("%s, frame %u: %016" PRIx64 "\n", ref->rom, ref->frames, hash);
+#endif
+        ck_assert_msg(hash == ref->hash, "%s, frame %u: hash %016" PRIx64 " instead of %016" PRIx64,
+                      ref->rom, ref->frames, hash, ref->hash);
+        gameboy_free(gb);
+    }
+    free(gb);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+// ======================================================================
+Suite* lcdc_test_suite()
+{
+    Suite* s = suite_create("lcdc.c Tests");
+
+    Add_Case(s, tc1, "lcdc tests");
+    tcase_add_test(tc1, lcdc_err);
+    tcase_add_test(tc1, lcdc_frames_exec);
+    // a few hundred frames are drawn
+    tcase_set_timeout(tc1, 60);
+
+    return s;
+}
+
+TEST_SUITE(lcdc_test_suite)
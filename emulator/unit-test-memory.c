@@ -76,6 +76,54 @@ START_TEST(mem_create_free_exec)
 }
 END_TEST
 
+START_TEST(mem_arena_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    mem_arena_t arena = {0};
+    memory_t* a = NULL;
+    memory_t* b = NULL;
+    memory_t* c = NULL;
+
+    ck_assert_bad_param(mem_arena_create(NULL, 1));
+    ck_assert_bad_param(mem_arena_create(&arena, 0));
+    ck_assert_bad_param(mem_arena_alloc(&arena, &a, 1));
+
+    ck_assert_err_none(mem_arena_create(&arena, mem_arena_size(mem_arena_block(100) + mem_arena_block(1), 2)));
+    ck_assert_int_eq((uintptr_t) arena.base % MEM_ARENA_PAGE, 0);
+    ck_assert_int_eq(arena.size, MEM_ARENA_PAGE);
+    ck_assert_bad_param(mem_arena_alloc(&arena, NULL, 1));
+    ck_assert_bad_param(mem_arena_alloc(&arena, &a, 0));
+
+    // one after the other, aligned, zeroed
+    ck_assert_err_none(mem_arena_alloc(&arena, &a, 100));
+    ck_assert_err_none(mem_arena_alloc(&arena, &b, 1));
+    ck_assert_ptr_eq(a->memory, arena.base);
+    ck_assert_ptr_eq(b->memory, arena.base + mem_arena_block(100));
+    ck_assert_int_eq(a->size, 100);
+    ck_assert(a->in_arena && b->in_arena);
+    ck_assert_int_eq(a->memory[99] | b->memory[0], 0);
+
+    // up to the memory_t structures at the top
+    ck_assert_err_mem(mem_arena_alloc(&arena, &c, MEM_ARENA_PAGE));
+    ck_assert_err_none(mem_arena_alloc(&arena, &c, (MEM_ARENA_PAGE - 3 * sizeof(memory_t) - arena.used) / MEM_ARENA_ALIGN * MEM_ARENA_ALIGN));
+    ck_assert((data_t*) c > c->memory + c->size - 1);
+    ck_assert_err_mem(mem_arena_alloc(&arena, &c, 1));
+
+    // freed with the arena
+    mem_free(a);
+    ck_assert_ptr_null(a->memory);
+    mem_arena_free(&arena);
+    ck_assert_ptr_null(arena.base);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
 Suite* bus_test_suite()
 {
 #pragma GCC diagnostic push
@@ -89,6 +137,7 @@ Suite* bus_test_suite()
     Add_Case(s, tc1, "mem tests");
     tcase_add_test(tc1, mem_create_free_err);
     tcase_add_test(tc1, mem_create_free_exec);
+    tcase_add_test(tc1, mem_arena_exec);
 
     return s;
 }
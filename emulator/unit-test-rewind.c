@@ -0,0 +1,188 @@
+/**
+ * @file unit-test-rewind.c
+ * @brief Unit test code for the rewind buffer
+ *
+ * @author S. Horvath-Mikulas & R. Gerber
+ * @date 2020
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "rewind.h"
+
+#define TEST_ROM   "tests/data/blargg_roms/06-ld r,r.gb"
+#define NB_FRAMES  150
+#define KEYFRAMES  10
+
+/**
+ * @brief Runs a gameboy frame by frame, pushing a snapshot after each frame,
+ *        and keeps the states pushed to check what the rewind gives back
+ */
+static void run_frames(gameboy_t* gb, rewind_t* rw, uint8_t* states, size_t nb_frames)
+{
+    const size_t size = gameboy_state_size(gb);
+    for (size_t f = 0; f < nb_frames; ++f) {
+        ck_assert_err_none(gameboy_run_until(gb, gb->cycles + FRAME_TOTAL_CYCLES));
+        ck_assert_err_none(rewind_push(rw, gb));
+        ck_assert_err_none(gameboy_save_state(gb, states + f * size, size));
+    }
+}
+
+/**
+ * @brief Pops all the snapshots of a rewind buffer, the latest first,
+ *        checking that they are the latest states pushed
+ */
+static void check_rewind(gameboy_t* gb, rewind_t* rw, const uint8_t* states, size_t nb_frames)
+{
+    const size_t size = gameboy_state_size(gb);
+    uint8_t* state = malloc(size);
+    ck_assert_ptr_nonnull(state);
+
+    const size_t count = rw->count;
+    for (size_t k = 0; k < count; ++k) {
+        ck_assert_err_none(rewind_pop(rw, gb));
+        ck_assert_err_none(gameboy_save_state(gb, state, size));
+        ck_assert(memcmp(state, states + (nb_frames - 1 - k) * size, size) == 0);
+    }
+    ck_assert_int_eq(rw->count, 0);
+    ck_assert_bad_param(rewind_pop(rw, gb));
+
+    free(state);
+}
+
+START_TEST(rewind_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    rewind_t rw;
+    gameboy_t* gb = calloc(1, sizeof(gameboy_t));
+    ck_assert_ptr_nonnull(gb);
+    ck_assert_err_none(gameboy_create(gb, TEST_ROM));
+
+    ck_assert_bad_param(rewind_init(NULL, gb, 10, 1 << 20, 1));
+    ck_assert_bad_param(rewind_init(&rw, NULL, 10, 1 << 20, 1));
+    ck_assert_bad_param(rewind_init(&rw, gb, 0, 1 << 20, 1));
+    ck_assert_bad_param(rewind_init(&rw, gb, 10, 0, 1));
+    ck_assert_bad_param(rewind_init(&rw, gb, 10, 1 << 20, 0));
+
+    // too small for a single snapshot
+    ck_assert_err_none(rewind_init(&rw, gb, 10, 16, 1));
+    ck_assert_bad_param(rewind_push(NULL, gb));
+    ck_assert_bad_param(rewind_push(&rw, NULL));
+    ck_assert_err_mem(rewind_push(&rw, gb));
+    ck_assert_bad_param(rewind_pop(&rw, gb));
+    ck_assert_bad_param(rewind_pop(NULL, gb));
+    ck_assert_int_eq(rewind_used(&rw), 0);
+    rewind_free(&rw);
+
+    gameboy_free(gb);
+    free(gb);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(rewind_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    rewind_t rw;
+    gameboy_t* gb = calloc(1, sizeof(gameboy_t));
+    ck_assert_ptr_nonnull(gb);
+    ck_assert_err_none(gameboy_create(gb, TEST_ROM));
+    uint8_t* states = malloc(NB_FRAMES * gameboy_state_size(gb));
+    ck_assert_ptr_nonnull(states);
+
+    // everything fits
+    ck_assert_err_none(rewind_init(&rw, gb, NB_FRAMES, 16 << 20, KEYFRAMES));
+    run_frames(gb, &rw, states, NB_FRAMES);
+    ck_assert_int_eq(rw.count, NB_FRAMES);
+    // deltas are much smaller than the states
+    ck_assert(rewind_used(&rw) < NB_FRAMES * gameboy_state_size(gb) / 4);
+    check_rewind(gb, &rw, states, NB_FRAMES);
+
+    // rewinding halfway (not at a keyframe), then going on from the state restored
+    const size_t pushed = NB_FRAMES - 3;
+    const size_t kept = pushed - NB_FRAMES / 2 + 5;
+    run_frames(gb, &rw, states, pushed);
+    for (size_t k = kept; k < pushed; ++k) {
+        ck_assert_err_none(rewind_pop(&rw, gb));
+    }
+    run_frames(gb, &rw, states + kept * gameboy_state_size(gb), NB_FRAMES - kept);
+    ck_assert_int_eq(rw.count, NB_FRAMES);
+    check_rewind(gb, &rw, states, NB_FRAMES);
+    rewind_free(&rw);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+    gameboy_free(gb);
+    free(gb);
+    free(states);
+}
+END_TEST
+
+START_TEST(rewind_full_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    rewind_t rw;
+    gameboy_t* gb = calloc(1, sizeof(gameboy_t));
+    ck_assert_ptr_nonnull(gb);
+    ck_assert_err_none(gameboy_create(gb, TEST_ROM));
+    uint8_t* states = malloc(NB_FRAMES * gameboy_state_size(gb));
+    ck_assert_ptr_nonnull(states);
+
+    // limited number of snapshots: the oldest keyframes go with their deltas
+    ck_assert_err_none(rewind_init(&rw, gb, NB_FRAMES / 3, 16 << 20, KEYFRAMES));
+    run_frames(gb, &rw, states, NB_FRAMES);
+    ck_assert(rw.count <= NB_FRAMES / 3 && rw.count > NB_FRAMES / 3 - KEYFRAMES);
+    check_rewind(gb, &rw, states, NB_FRAMES);
+    rewind_free(&rw);
+
+    // limited memory: the ring wraps around
+    ck_assert_err_none(rewind_init(&rw, gb, NB_FRAMES, 64 << 10, KEYFRAMES));
+    run_frames(gb, &rw, states, NB_FRAMES);
+    ck_assert(rw.count > 0 && rw.count < NB_FRAMES);
+    ck_assert(rewind_used(&rw) <= 64 << 10);
+    check_rewind(gb, &rw, states, NB_FRAMES);
+    rewind_free(&rw);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+    gameboy_free(gb);
+    free(gb);
+    free(states);
+}
+END_TEST
+
+// ======================================================================
+Suite* rewind_test_suite()
+{
+    Suite* s = suite_create("rewind.c Tests");
+
+    Add_Case(s, tc1, "rewind tests");
+    tcase_add_test(tc1, rewind_err);
+    tcase_add_test(tc1, rewind_exec);
+    tcase_add_test(tc1, rewind_full_exec);
+    // a few hundred frames are run
+    tcase_set_timeout(tc1, 60);
+
+    return s;
+}
+
+TEST_SUITE(rewind_test_suite)
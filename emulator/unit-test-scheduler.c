@@ -0,0 +1,131 @@
+/**
+ * @file unit-test-scheduler.c
+ * @brief Unit test code for the event scheduler
+ *
+ * @author S. Horvath-Mikulas & R. Gerber
+ * @date 2020
+ */
+
+// for thread-safe randomization
+#include <time.h>
+#include <stdlib.h>
+#include <sys/types.h>
+#include <unistd.h>
+#include <pthread.h>
+
+#include <check.h>
+#include <inttypes.h>
+
+#include "tests.h"
+#include "scheduler.h"
+
+START_TEST(scheduler_err)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    scheduler_t sched;
+    ck_assert_bad_param(scheduler_init(NULL));
+    ck_assert_bad_param(scheduler_set(NULL, SCHED_CPU, 1));
+    ck_assert_err_none(scheduler_init(&sched));
+    ck_assert_bad_param(scheduler_set(&sched, SCHED_NB_EVENTS, 1));
+    ck_assert(scheduler_next(NULL) == SCHED_NEVER);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(scheduler_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    scheduler_t sched;
+    ck_assert_err_none(scheduler_init(&sched));
+    ck_assert(scheduler_next(&sched) == SCHED_NEVER);
+
+    ck_assert_err_none(scheduler_set(&sched, SCHED_TIMER, 40));
+    ck_assert_err_none(scheduler_set(&sched, SCHED_LCDC, 20));
+    ck_assert_err_none(scheduler_set(&sched, SCHED_CPU, 30));
+    ck_assert(scheduler_next(&sched) == 20);
+    ck_assert_int_eq(scheduler_next_event(&sched), SCHED_LCDC);
+
+    // rescheduling later
+    ck_assert_err_none(scheduler_set(&sched, SCHED_LCDC, 50));
+    ck_assert(scheduler_next(&sched) == 30);
+    ck_assert_int_eq(scheduler_next_event(&sched), SCHED_CPU);
+
+    // rescheduling earlier
+    ck_assert_err_none(scheduler_set(&sched, SCHED_TIMER, 10));
+    ck_assert(scheduler_next(&sched) == 10);
+    ck_assert_int_eq(scheduler_next_event(&sched), SCHED_TIMER);
+
+    // unscheduling
+    ck_assert_err_none(scheduler_set(&sched, SCHED_TIMER, SCHED_NEVER));
+    ck_assert_err_none(scheduler_set(&sched, SCHED_CPU, SCHED_NEVER));
+    ck_assert(scheduler_next(&sched) == 50);
+    ck_assert_err_none(scheduler_set(&sched, SCHED_LCDC, SCHED_NEVER));
+    ck_assert(scheduler_next(&sched) == SCHED_NEVER);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+START_TEST(scheduler_random)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    scheduler_t sched;
+    uint64_t due[SCHED_NB_EVENTS];
+    ck_assert_err_none(scheduler_init(&sched));
+    for (int i = 0; i < SCHED_NB_EVENTS; ++i) {
+        due[i] = SCHED_NEVER;
+    }
+
+    for (int n = 0; n < 1000; ++n) {
+        const sched_event_t e = (sched_event_t) (rand() % SCHED_NB_EVENTS);
+        due[e] = (uint64_t) (rand() % 100);
+        ck_assert_err_none(scheduler_set(&sched, e, due[e]));
+
+        uint64_t min = SCHED_NEVER;
+        for (int i = 0; i < SCHED_NB_EVENTS; ++i) {
+            min = due[i] < min ? due[i] : min;
+        }
+        ck_assert(scheduler_next(&sched) == min);
+        ck_assert(due[scheduler_next_event(&sched)] == min);
+    }
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+}
+END_TEST
+
+// ======================================================================
+Suite* scheduler_test_suite()
+{
+#pragma GCC diagnostic push
+#pragma GCC diagnostic ignored "-Wsign-conversion"
+#pragma GCC diagnostic ignored "-Wconversion"
+    srand(time(NULL) ^ getpid() ^ pthread_self());
+#pragma GCC diagnostic pop
+
+    Suite* s = suite_create("scheduler.c tests");
+
+    Add_Case(s, tc1, "scheduler tests");
+    tcase_add_test(tc1, scheduler_err);
+    tcase_add_test(tc1, scheduler_exec);
+    tcase_add_test(tc1, scheduler_random);
+
+    return s;
+}
+
+TEST_SUITE(scheduler_test_suite)
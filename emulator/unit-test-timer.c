@@ -30,7 +30,7 @@
 
 #define register(X) \
     data_t reg_ ## X ## _var = 0; \
-    bus[REG_ ## X] = &reg_ ## X ## _var
+    bus_map_byte(bus, REG_ ## X, &reg_ ## X ## _var)
 
 #define INIT_BUS \
     bus_t bus; \
@@ -41,6 +41,26 @@
     register(TAC); \
     cpu.bus = &bus
 
+// a second timer, stepped cycle by cycle, on its own cpu and registers (ref_regs),
+// both timers starting from the same random state; TAC enabled, with one of the frequencies in tac_freqs
+#define INIT_REF(tac_freqs) \
+    gbtimer_t ref_timer; \
+    cpu_t ref_cpu; \
+    zero_init_var(ref_cpu); \
+    ck_assert_err_none(timer_init(&ref_timer, &ref_cpu)); \
+    bus_t ref_bus; \
+    zero_init_var(ref_bus); \
+    data_t ref_regs[TIMER_SIZE] = {0}; \
+    for (size_t i = 0; i < TIMER_SIZE; ++i) { \
+        bus_map_byte(ref_bus, (addr_t) (REG_DIV + i), &ref_regs[i]); \
+    } \
+    ref_cpu.bus = &ref_bus; \
+    *bus_lookup(bus, REG_TAC) = ref_regs[REG_TAC - REG_DIV] = (data_t) (4 | (rand() & (tac_freqs))); \
+    *bus_lookup(bus, REG_TIMA) = ref_regs[REG_TIMA - REG_DIV] = (data_t) rand(); \
+    *bus_lookup(bus, REG_TMA) = ref_regs[REG_TMA - REG_DIV] = (data_t) rand(); \
+    timer.counter = ref_timer.counter = (uint16_t) (rand() & 0xFFFC); \
+    *bus_lookup(bus, REG_DIV) = ref_regs[REG_DIV - REG_DIV] = msb8(timer.counter)
+
 START_TEST(timer_init_err)
 {
 // ------------------------------------------------------------
@@ -108,17 +128,17 @@ START_TEST(timer_cycle_exec)
     ck_assert_err_none(timer_init(&timer, &cpu));
 
     INIT_BUS;
-    *bus[REG_TAC] = CYCLE_TAC_VALUE;
+    *bus_lookup(bus, REG_TAC) = CYCLE_TAC_VALUE;
 
     for (size_t i = 0; i < CYCLE_COUNT_3FFF; ++i) { //do many cycles and check values
         timer_cycle(&timer);
     }
 
     ck_assert_int_eq(timer.counter, CYCLE_COUNT_3FFF_VALUE);
-    ck_assert_int_eq(*bus[REG_TAC], CYCLE_TAC_VALUE );
-    ck_assert_int_eq(*bus[REG_TIMA], CYCLE_TIMA_VALUE);
-    ck_assert_int_eq(*bus[REG_TMA], CYCLE_TMA_VALUE );
-    ck_assert_int_eq(*bus[REG_DIV], CYCLE_DIV_VALUE );
+    ck_assert_int_eq(*bus_lookup(bus, REG_TAC), CYCLE_TAC_VALUE );
+    ck_assert_int_eq(*bus_lookup(bus, REG_TIMA), CYCLE_TIMA_VALUE);
+    ck_assert_int_eq(*bus_lookup(bus, REG_TMA), CYCLE_TMA_VALUE );
+    ck_assert_int_eq(*bus_lookup(bus, REG_DIV), CYCLE_DIV_VALUE );
     ck_assert_int_eq(cpu.IF, 0);
 
     for (size_t i = 0; i < 3 * CYCLE_COUNT_3FFF + 4; ++i) { //cycle until interruption occurs
@@ -161,7 +181,7 @@ START_TEST(timer_listener_exec)
     timer.counter = 0xFF;
     ck_assert_err_none(timer_bus_listener(&timer, REG_DIV));
     ck_assert_int_eq(timer.counter, 0);
-    ck_assert_int_eq(*bus[REG_DIV], 0);
+    ck_assert_int_eq(*bus_lookup(bus, REG_DIV), 0);
 
     ck_assert_err_none(timer_bus_listener(&timer, REG_TAC));
 
@@ -174,8 +194,119 @@ START_TEST(timer_listener_exec)
 }
 END_TEST
 
+START_TEST(timer_advance_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    for (int n = 0; n < 100; ++n) {
+        INIT;
+        ck_assert_err_none(timer_init(&timer, &cpu));
+        INIT_BUS;
+
+        // the slowest and the fastest frequencies (TAC 0 and 1)
+        INIT_REF(1);
+
+        // no interrupt before the announced cycle...
+        const uint64_t wait = timer_cycles_to_event(&timer);
+        const uint64_t cycles = wait - 1 - (uint64_t) rand() % wait;
+        for (uint64_t i = 0; i < cycles; ++i) {
+            ck_assert_err_none(timer_cycle(&ref_timer));
+        }
+        ck_assert_err_none(timer_advance(&timer, cycles));
+        ck_assert_int_eq(timer.counter, ref_timer.counter);
+        ck_assert_int_eq(*bus_lookup(bus, REG_DIV), ref_regs[REG_DIV - REG_DIV]);
+        ck_assert_int_eq(*bus_lookup(bus, REG_TIMA), ref_regs[REG_TIMA - REG_DIV]);
+        ck_assert_int_eq(cpu.IF, 0);
+        ck_assert_int_eq(ref_cpu.IF, 0);
+
+        // ...and exactly there
+        ck_assert(timer_cycles_to_event(&timer) == wait - cycles);
+        for (uint64_t i = cycles; i + 1 < wait; ++i) {
+            ck_assert_err_none(timer_cycle(&ref_timer));
+        }
+        ck_assert_int_eq(ref_cpu.IF, 0);
+        ck_assert_err_none(timer_cycle(&ref_timer));
+        ck_assert_err_none(timer_advance(&timer, wait - cycles));
+        ck_assert_int_eq(ref_cpu.IF, 0x4);
+        ck_assert_int_eq(cpu.IF, 0x4);
+        ck_assert_int_eq(timer.counter, ref_timer.counter);
+        ck_assert_int_eq(*bus_lookup(bus, REG_TIMA), ref_regs[REG_TIMA - REG_DIV]);
+    }
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+
+}
+END_TEST
+
 
 // ======================================================================
+START_TEST(timer_sync_exec)
+{
+// ------------------------------------------------------------
+#ifdef WITH_PRINT
+    printf("=== %s:\n", __func__);
+#endif
+    ck_assert_bad_param(timer_sync(NULL, 1));
+    ck_assert_bad_param(timer_resync(NULL, 1));
+
+    for (int n = 0; n < 100; ++n) {
+        INIT;
+        ck_assert_err_none(timer_init(&timer, &cpu));
+        INIT_BUS;
+
+        // any of the four frequencies
+        INIT_REF(3);
+        const uint64_t start = 1 + (uint64_t) rand();
+        ck_assert_err_none(timer_resync(&timer, start));
+        ck_assert_int_eq(timer.synced, start);
+        ck_assert(timer.event != UINT64_MAX && timer.event >= start);
+
+        // the registers as of any cycle before the overflow
+        const uint64_t cycle = start + (uint64_t) rand() % (timer.event - start + 1);
+        for (uint64_t c = start; c < cycle; ++c) {
+            ck_assert_err_none(timer_cycle(&ref_timer));
+        }
+        const uint64_t event = timer.event;
+        ck_assert_err_none(timer_sync(&timer, cycle));
+        ck_assert_int_eq(timer.counter, ref_timer.counter);
+        ck_assert_int_eq(*bus_lookup(bus, REG_DIV), ref_regs[REG_DIV - REG_DIV]);
+        ck_assert_int_eq(*bus_lookup(bus, REG_TIMA), ref_regs[REG_TIMA - REG_DIV]);
+        ck_assert_int_eq(cpu.IF, 0);
+        ck_assert(timer.event == event);
+
+        // the overflow at the announced cycle
+        for (uint64_t c = cycle; c <= event; ++c) {
+            ck_assert_err_none(timer_cycle(&ref_timer));
+        }
+        ck_assert_err_none(timer_sync(&timer, event + 1));
+        ck_assert_int_eq(ref_cpu.IF, 0x4);
+        ck_assert_int_eq(cpu.IF, 0x4);
+        ck_assert_int_eq(*bus_lookup(bus, REG_TIMA), ref_regs[REG_TIMA - REG_DIV]);
+        ck_assert(timer.event > event + 1 || timer.event == UINT64_MAX);
+
+        // syncing backwards does nothing
+        ck_assert_err_none(timer_sync(&timer, start));
+        ck_assert_int_eq(timer.synced, event + 1);
+    }
+
+    // no overflow when disabled
+    INIT;
+    ck_assert_err_none(timer_init(&timer, &cpu));
+    INIT_BUS;
+    ck_assert_err_none(timer_resync(&timer, 1));
+    ck_assert(timer.event == UINT64_MAX);
+
+#ifdef WITH_PRINT
+    printf("=== END of %s\n", __func__);
+#endif
+
+}
+END_TEST
+
 Suite* timer_test_suite()
 {
 
@@ -195,6 +326,8 @@ Suite* timer_test_suite()
     tcase_add_test(tc1, timer_cycle_exec);
     tcase_add_test(tc1, timer_listener_err);
     tcase_add_test(tc1, timer_listener_exec);
+    tcase_add_test(tc1, timer_advance_exec);
+    tcase_add_test(tc1, timer_sync_exec);
 
     return s;
 }
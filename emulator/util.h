@@ -26,6 +26,18 @@
 #define zero_init_var(X) memset(&X, 0, sizeof(X))
 #define zero_init_ptr(X) memset(X, 0, sizeof(*X))
 
+/**
+ * @brief expand F(i) for consecutive indexes, to build constant lookup tables at compile time
+ *        (e.g. { LUT_256(F, 0) } holds F(0), F(1), ..., F(255))
+ */
+#define LUT_4(F, i)    F(i), F((i) + 1), F((i) + 2), F((i) + 3)
+#define LUT_16(F, i)   LUT_4(F, i), LUT_4(F, (i) + 4), LUT_4(F, (i) + 8), LUT_4(F, (i) + 12)
+#define LUT_64(F, i)   LUT_16(F, i), LUT_16(F, (i) + 16), LUT_16(F, (i) + 32), LUT_16(F, (i) + 48)
+#define LUT_256(F, i)  LUT_64(F, i), LUT_64(F, (i) + 64), LUT_64(F, (i) + 128), LUT_64(F, (i) + 192)
+#define LUT_512(F, i)  LUT_256(F, i), LUT_256(F, (i) + 256)
+#define LUT_1024(F, i) LUT_512(F, i), LUT_512(F, (i) + 512)
+#define LUT_2048(F, i) LUT_1024(F, i), LUT_1024(F, (i) + 1024)
+
 /**
  * @brief useful to have C99 (!) %zu to compile in Windows
  */